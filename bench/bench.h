@@ -0,0 +1,129 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef UTIL_BENCH_H
+#define UTIL_BENCH_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+/** \brief Minimal benchmark harness for util_bench.
+ *
+ * Benchmarks are registered at static initialization time with UTIL_BENCH(name). The body
+ * receives a bench::context, and must perform the measured operation ctx.iterations() times.
+ * The harness chooses the iteration count so that each benchmark runs for at least the
+ * configured minimum time, and reports time, throughput and heap allocations per operation.
+ */
+
+namespace bench
+{
+
+/** \brief Count of calls to global operator new, maintained by the replacement operators in main.cpp.
+ */
+std::atomic<std::uint64_t>&
+allocation_count();
+
+class context
+{
+public:
+	explicit context(std::uint64_t iterations) : m_iterations{iterations}, m_bytes_per_op{0} {}
+
+	std::uint64_t
+	iterations() const
+	{
+		return m_iterations;
+	}
+
+	/** \brief Declare the number of bytes processed per operation, for throughput reporting.
+	 */
+	void
+	bytes_per_op(std::uint64_t n)
+	{
+		m_bytes_per_op = n;
+	}
+
+	std::uint64_t
+	bytes_per_op() const
+	{
+		return m_bytes_per_op;
+	}
+
+private:
+	std::uint64_t m_iterations;
+	std::uint64_t m_bytes_per_op;
+};
+
+using bench_func = std::function<void(context&)>;
+
+struct entry
+{
+	std::string name;
+	bench_func  func;
+};
+
+std::vector<entry>&
+registry();
+
+struct registration
+{
+	registration(const char* name, bench_func func)
+	{
+		registry().push_back(entry{name, std::move(func)});
+	}
+};
+
+/** \brief Prevent the compiler from discarding a computed value.
+ */
+template<class T>
+inline void
+keep(T const& value)
+{
+	asm volatile("" : : "g"(&value) : "memory");
+}
+
+/** \brief Prevent the compiler from assuming memory is unchanged across this point.
+ */
+inline void
+clobber()
+{
+	asm volatile("" : : : "memory");
+}
+
+}    // namespace bench
+
+#define UTIL_BENCH_CAT_(a, b) a##b
+#define UTIL_BENCH_CAT(a, b) UTIL_BENCH_CAT_(a, b)
+
+#define UTIL_BENCH(name)                                                                                               \
+	static void UTIL_BENCH_CAT(util_bench_func_, __LINE__)(bench::context&);                                           \
+	static bench::registration UTIL_BENCH_CAT(util_bench_reg_, __LINE__){name,                                         \
+																		 &UTIL_BENCH_CAT(util_bench_func_, __LINE__)}; \
+	static void UTIL_BENCH_CAT(util_bench_func_, __LINE__)(bench::context & ctx)
+/**/
+
+#endif    // UTIL_BENCH_H
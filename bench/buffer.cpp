@@ -0,0 +1,90 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "bench.h"
+#include <util/buffer.h>
+#include <vector>
+
+UTIL_BENCH("buffer/mutable_buffer::expand doubling to 64KiB")
+{
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		util::mutable_buffer buf{16};
+		for (util::size_type cap = 32; cap <= 65536; cap *= 2)
+		{
+			buf.size(buf.capacity());
+			buf.expand(cap);
+		}
+		bench::keep(buf.data());
+	}
+}
+
+UTIL_BENCH("buffer/mutable_buffer::expand by 1KiB to 64KiB")
+{
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		util::mutable_buffer buf{1024};
+		for (util::size_type cap = 2048; cap <= 65536; cap += 1024)
+		{
+			buf.size(buf.capacity());
+			buf.expand(cap);
+		}
+		bench::keep(buf.data());
+	}
+}
+
+UTIL_BENCH("buffer/buffer::checksum 64KiB")
+{
+	util::size_type      size{65536};
+	util::mutable_buffer buf{size};
+	buf.fill(0, size, 0x5a);
+	buf.size(size);
+	ctx.bytes_per_op(size);
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		auto sum = buf.checksum();
+		bench::keep(sum);
+		bench::clobber();
+	}
+}
+
+UTIL_BENCH("buffer/shared_buffer from mutable_buffer")
+{
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		util::mutable_buffer mbuf{64};
+		util::shared_buffer  sbuf{std::move(mbuf)};
+		bench::keep(sbuf.data());
+	}
+}
+
+UTIL_BENCH("buffer/shared_buffer copy and destroy")
+{
+	util::shared_buffer sbuf{"shared buffer contents", 22};
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		util::shared_buffer copy{sbuf};
+		bench::keep(copy);
+	}
+}
@@ -0,0 +1,81 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "bench.h"
+#include <util/coro.h>
+
+using util::promise;
+
+namespace
+{
+
+constexpr int chain_length = 8;
+
+promise<int>
+step(promise<int> p)
+{
+	co_return co_await p + 1;
+}
+
+promise<int>
+steps(promise<int> p)
+{
+	int value = co_await p;
+	for (int d = 0; d < chain_length; ++d)
+	{
+		value = co_await promise<int>::build(value + 1);
+	}
+	co_return value;
+}
+
+}    // namespace
+
+UTIL_BENCH("coro/co_await chain of 8 coroutines, resolved after chaining")
+{
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		int          result{0};
+		promise<int> p;
+		auto         q = p;
+		for (int d = 0; d < chain_length; ++d)
+		{
+			q = step(q);
+		}
+		q.then([&result](int v) { result = v; });
+		p.resolve(0);
+		bench::keep(result);
+	}
+}
+
+UTIL_BENCH("coro/8 co_awaits in one coroutine")
+{
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		int          result{0};
+		promise<int> p;
+		steps(p).then([&result](int v) { result = v; });
+		p.resolve(0);
+		bench::keep(result);
+	}
+}
@@ -0,0 +1,143 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "bench.h"
+#include <atomic>
+#include <thread>
+#include <unistd.h>
+#include <util/event_loop.h>
+#include "../test/util/ghetto_async.h"
+
+#if (BOOST_OS_LINUX)
+
+namespace
+{
+
+using namespace std::chrono_literals;
+
+constexpr int dispatch_batch = 64;
+
+void
+wait_for(std::atomic<std::uint64_t> const& count, std::uint64_t expected)
+{
+	while (count.load(std::memory_order_acquire) < expected)
+	{
+		std::this_thread::yield();
+	}
+}
+
+}    // namespace
+
+UTIL_BENCH("event_loop/dispatch round trip from another thread")
+{
+	util::event_loop           loop;
+	std::atomic<std::uint64_t> count{0};
+	std::thread                runner{[&]() { loop.run(); }};
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		loop.dispatch([&count]() { count.fetch_add(1, std::memory_order_release); });
+		wait_for(count, i + 1);
+	}
+	loop.stop();
+	runner.join();
+}
+
+UTIL_BENCH("event_loop/dispatch on the loop thread, batches of 64, per task")
+{
+	util::event_loop loop;
+	std::uint64_t    count{0};
+	for (std::uint64_t i = 0; i < ctx.iterations(); i += dispatch_batch)
+	{
+		for (int j = 0; j < dispatch_batch; ++j)
+		{
+			loop.dispatch([&count]() { ++count; });
+		}
+		loop.poll();
+	}
+	bench::keep(count);
+}
+
+UTIL_BENCH("event_loop/pipe readiness round trip")
+{
+	util::event_loop           loop;
+	std::atomic<std::uint64_t> count{0};
+	int                        fds[2];
+	if (::pipe(fds) != 0)
+	{
+		return;
+	}
+	loop.watch(fds[0], EPOLLIN, [&](std::uint32_t) {
+		char c;
+		while (::read(fds[0], &c, 1) != 1)
+		{}
+		count.fetch_add(1, std::memory_order_release);
+	});
+	std::thread runner{[&]() { loop.run(); }};
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		char c{'x'};
+		while (::write(fds[1], &c, 1) != 1)
+		{}
+		wait_for(count, i + 1);
+	}
+	loop.stop();
+	runner.join();
+	loop.unwatch(fds[0]);
+	::close(fds[0]);
+	::close(fds[1]);
+}
+
+UTIL_BENCH("event_loop/1 ms timer, 100 us tick, wall time per expiry")
+{
+	util::event_loop loop;
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		loop.schedule(1ms, [&loop](std::error_code const&) { loop.stop(); });
+		loop.run();
+	}
+}
+
+UTIL_BENCH("event_loop/1 ms timer, 1 ms tick, wall time per expiry")
+{
+	util::event_loop loop{1ms};
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		loop.schedule(1ms, [&loop](std::error_code const&) { loop.stop(); });
+		loop.run();
+	}
+}
+
+UTIL_BENCH("event_loop/ghetto_async 1 ms timer, wall time per expiry")
+{
+	using async_io = ghetto_async::async_adapter;
+
+	auto lp = async_io::create_loop();
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		async_io::schedule(lp, 1ms, [](std::error_code const&) {});
+		async_io::run_loop(lp);
+	}
+}
+
+#endif
@@ -0,0 +1,117 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "bench.h"
+#include <util/format.h>
+#include <util/membuf.h>
+#include <util/memio.h>
+
+namespace
+{
+
+constexpr int row_count = 1000;
+
+template<class Stream>
+void
+write_csv(Stream& os)
+{
+	for (int i = 0; i < row_count; ++i)
+	{
+		os << i << ',' << (i * 7919) << ',' << (i * 0.001) << ',' << "name" << '\n';
+	}
+}
+
+}    // namespace
+
+UTIL_BENCH("format/std::ostream into omembuf, csv rows")
+{
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		util::omembuf mbuf{util::mutable_buffer{65536}};
+		std::ostream  os{&mbuf};
+		write_csv(os);
+		bench::keep(mbuf.position());
+	}
+}
+
+UTIL_BENCH("format/formatter into omembuf, csv rows")
+{
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		util::omembuf                    mbuf{util::mutable_buffer{65536}};
+		util::formatter<util::omembuf> fmt{mbuf};
+		write_csv(fmt);
+		bench::keep(mbuf.position());
+	}
+}
+
+UTIL_BENCH("format/formatter into omemqbuf, csv rows")
+{
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		util::omemqbuf                  mbuf{16384};
+		util::formatter<util::omemqbuf> fmt{mbuf};
+		write_csv(fmt);
+		bench::keep(mbuf.position());
+	}
+}
+
+UTIL_BENCH("format/formatter into membuf_sink, csv rows")
+{
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		util::membuf_sink                  sink{65536};
+		util::formatter<util::membuf_sink> fmt{sink};
+		write_csv(fmt);
+		bench::keep(sink.position());
+	}
+}
+
+UTIL_BENCH("format/std::ostream into omembuf, doubles")
+{
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		util::omembuf mbuf{util::mutable_buffer{65536}};
+		std::ostream  os{&mbuf};
+		for (int n = 1; n <= row_count; ++n)
+		{
+			os << (1.0 / n) << ' ';
+		}
+		bench::keep(mbuf.position());
+	}
+}
+
+UTIL_BENCH("format/formatter into omembuf, doubles")
+{
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		util::omembuf                  mbuf{util::mutable_buffer{65536}};
+		util::formatter<util::omembuf> fmt{mbuf};
+		for (int n = 1; n <= row_count; ++n)
+		{
+			fmt << (1.0 / n) << ' ';
+		}
+		bench::keep(mbuf.position());
+	}
+}
@@ -0,0 +1,120 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "bench.h"
+#include <atomic>
+#include <thread>
+#include <util/loop_group.h>
+
+#if (BOOST_OS_LINUX)
+
+namespace
+{
+
+constexpr int message_batch = 1000;
+
+void
+wait_for(std::atomic<std::uint64_t> const& count, std::uint64_t expected)
+{
+	while (count.load(std::memory_order_acquire) < expected)
+	{
+		std::this_thread::yield();
+	}
+}
+
+// loop 0 sends pongs back and forth with loop 1, until the count is exhausted
+void
+ping(util::loop_group& group, std::size_t to, std::uint64_t remaining, std::atomic<std::uint64_t>& done)
+{
+	if (remaining == 0)
+	{
+		done.store(1, std::memory_order_release);
+		return;
+	}
+	group.dispatch(to, [&group, to, remaining, &done]() { ping(group, 1 - to, remaining - 1, done); });
+}
+
+}    // namespace
+
+UTIL_BENCH("loop_group/cross-loop messages, spsc queues, per message")
+{
+	util::loop_group           group{2, true};
+	std::atomic<std::uint64_t> received{0};
+	std::uint64_t              sent{0};
+	while (sent < ctx.iterations())
+	{
+		group.dispatch(0, [&group, &received]() {
+			for (int i = 0; i < message_batch; ++i)
+			{
+				group.dispatch(1, [&received]() { received.fetch_add(1, std::memory_order_release); });
+			}
+		});
+		sent += message_batch;
+		wait_for(received, sent);
+	}
+}
+
+UTIL_BENCH("loop_group/cross-loop messages, event_loop::dispatch, per message")
+{
+	util::loop_group           group{2, true};
+	std::atomic<std::uint64_t> received{0};
+	std::uint64_t              sent{0};
+	while (sent < ctx.iterations())
+	{
+		group.dispatch(0, [&group, &received]() {
+			for (int i = 0; i < message_batch; ++i)
+			{
+				group.loop(1).dispatch([&received]() { received.fetch_add(1, std::memory_order_release); });
+			}
+		});
+		sent += message_batch;
+		wait_for(received, sent);
+	}
+}
+
+UTIL_BENCH("loop_group/ping-pong between loops, per hop")
+{
+	util::loop_group           group{2, true};
+	std::atomic<std::uint64_t> done{0};
+	group.dispatch(0, [&group, &done, count = ctx.iterations()]() { ping(group, 1, count, done); });
+	wait_for(done, 1);
+}
+
+UTIL_BENCH("loop_group/submit round trip")
+{
+	util::loop_group           group{2, true};
+	std::atomic<std::uint64_t> done{0};
+	std::function<void(std::uint64_t)> next = [&](std::uint64_t remaining) {
+		if (remaining == 0)
+		{
+			done.store(1, std::memory_order_release);
+			return;
+		}
+		group.submit(1, [remaining]() { return remaining - 1; }).then([&](std::uint64_t r) { next(r); });
+	};
+	group.dispatch(0, [&next, count = ctx.iterations()]() { next(count); });
+	wait_for(done, 1);
+}
+
+#endif
@@ -0,0 +1,297 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * usage: util_bench [--json] [--min-time <milliseconds>] [filter ...]
+ *
+ * Runs each registered benchmark whose name contains any of the filter strings
+ * (or all benchmarks, if no filters are given).
+ */
+
+#include "bench.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+namespace
+{
+
+std::atomic<std::uint64_t> g_allocation_count{0};
+
+struct result
+{
+	std::string   name;
+	std::uint64_t iterations;
+	double        ns_per_op;
+	double        bytes_per_sec;
+	double        allocs_per_op;
+};
+
+result
+run(bench::entry const& e, std::chrono::nanoseconds min_time)
+{
+	using clock = std::chrono::steady_clock;
+
+	std::uint64_t            iterations{1};
+	std::chrono::nanoseconds elapsed{0};
+	std::uint64_t            allocs{0};
+	std::uint64_t            bytes_per_op{0};
+
+	for (;;)
+	{
+		bench::context ctx{iterations};
+		auto           allocs_before = g_allocation_count.load(std::memory_order_relaxed);
+		auto           start         = clock::now();
+		e.func(ctx);
+		elapsed      = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start);
+		allocs       = g_allocation_count.load(std::memory_order_relaxed) - allocs_before;
+		bytes_per_op = ctx.bytes_per_op();
+
+		if (elapsed >= min_time || iterations >= (std::uint64_t{1} << 40))
+		{
+			break;
+		}
+
+		// aim for 1.5 x min_time, growing by at most 100 x per round
+		double scale = (elapsed.count() > 0) ? (1.5 * min_time.count()) / elapsed.count() : 100.0;
+		scale        = (scale > 100.0) ? 100.0 : ((scale < 2.0) ? 2.0 : scale);
+		iterations   = static_cast<std::uint64_t>(iterations * scale);
+	}
+
+	result r;
+	r.name          = e.name;
+	r.iterations    = iterations;
+	r.ns_per_op     = static_cast<double>(elapsed.count()) / iterations;
+	r.bytes_per_sec = (bytes_per_op > 0) ? (bytes_per_op * 1.0e9) / r.ns_per_op : 0.0;
+	r.allocs_per_op = static_cast<double>(allocs) / iterations;
+	return r;
+}
+
+std::string
+format_rate(double bytes_per_sec)
+{
+	static const char* units[] = {"B/s", "KiB/s", "MiB/s", "GiB/s"};
+	char               buf[32];
+	if (bytes_per_sec <= 0.0)
+	{
+		return "-";
+	}
+	int unit{0};
+	while (bytes_per_sec >= 1024.0 && unit < 3)
+	{
+		bytes_per_sec /= 1024.0;
+		++unit;
+	}
+	std::snprintf(buf, sizeof(buf), "%.2f %s", bytes_per_sec, units[unit]);
+	return buf;
+}
+
+void
+print_human(result const& r)
+{
+	std::printf(
+			"%-60s %12llu %14.2f %16s %12.3f\n",
+			r.name.c_str(),
+			static_cast<unsigned long long>(r.iterations),
+			r.ns_per_op,
+			format_rate(r.bytes_per_sec).c_str(),
+			r.allocs_per_op);
+	std::fflush(stdout);
+}
+
+std::string
+json_escape(std::string const& s)
+{
+	std::string result;
+	for (char c : s)
+	{
+		if (c == '"' || c == '\\')
+		{
+			result.push_back('\\');
+		}
+		result.push_back(c);
+	}
+	return result;
+}
+
+void
+print_json(std::vector<result> const& results)
+{
+	std::printf("{\n  \"benchmarks\": [\n");
+	for (std::size_t i = 0; i < results.size(); ++i)
+	{
+		auto const& r = results[i];
+		std::printf(
+				"    {\"name\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.3f, \"bytes_per_sec\": %.1f, "
+				"\"allocs_per_op\": %.4f}%s\n",
+				json_escape(r.name).c_str(),
+				static_cast<unsigned long long>(r.iterations),
+				r.ns_per_op,
+				r.bytes_per_sec,
+				r.allocs_per_op,
+				(i + 1 < results.size()) ? "," : "");
+	}
+	std::printf("  ]\n}\n");
+}
+
+}    // namespace
+
+std::atomic<std::uint64_t>&
+bench::allocation_count()
+{
+	return g_allocation_count;
+}
+
+std::vector<bench::entry>&
+bench::registry()
+{
+	static std::vector<bench::entry> instance;
+	return instance;
+}
+
+void*
+operator new(std::size_t n)
+{
+	g_allocation_count.fetch_add(1, std::memory_order_relaxed);
+	void* p = std::malloc(n ? n : 1);
+	if (!p)
+	{
+		throw std::bad_alloc{};
+	}
+	return p;
+}
+
+void*
+operator new[](std::size_t n)
+{
+	return ::operator new(n);
+}
+
+void*
+operator new(std::size_t n, std::nothrow_t const&) noexcept
+{
+	g_allocation_count.fetch_add(1, std::memory_order_relaxed);
+	return std::malloc(n ? n : 1);
+}
+
+void*
+operator new[](std::size_t n, std::nothrow_t const& tag) noexcept
+{
+	return ::operator new(n, tag);
+}
+
+void
+operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+void
+operator delete[](void* p) noexcept
+{
+	std::free(p);
+}
+
+void
+operator delete(void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+void
+operator delete[](void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+int
+main(int argc, char** argv)
+{
+	bool                     json{false};
+	std::chrono::nanoseconds min_time{std::chrono::milliseconds{200}};
+	std::vector<std::string> filters;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::strcmp(argv[i], "--json") == 0)
+		{
+			json = true;
+		}
+		else if (std::strcmp(argv[i], "--min-time") == 0 && i + 1 < argc)
+		{
+			min_time = std::chrono::milliseconds{std::atol(argv[++i])};
+		}
+		else if (std::strcmp(argv[i], "--help") == 0)
+		{
+			std::cout << "usage: " << argv[0] << " [--json] [--min-time <milliseconds>] [filter ...]" << std::endl;
+			return 0;
+		}
+		else
+		{
+			filters.emplace_back(argv[i]);
+		}
+	}
+
+	auto selected = [&](std::string const& name) {
+		if (filters.empty())
+		{
+			return true;
+		}
+		for (auto const& f : filters)
+		{
+			if (name.find(f) != std::string::npos)
+			{
+				return true;
+			}
+		}
+		return false;
+	};
+
+	if (!json)
+	{
+		std::printf("%-60s %12s %14s %16s %12s\n", "benchmark", "iterations", "ns/op", "throughput", "allocs/op");
+	}
+
+	std::vector<result> results;
+	for (auto const& e : bench::registry())
+	{
+		if (selected(e.name))
+		{
+			results.push_back(run(e, min_time));
+			if (!json)
+			{
+				print_human(results.back());
+			}
+		}
+	}
+
+	if (json)
+	{
+		print_json(results);
+	}
+	return 0;
+}
@@ -0,0 +1,163 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "bench.h"
+#include <sstream>
+#include <string>
+#include <util/membuf.h>
+
+namespace
+{
+
+constexpr int record_count = 1000;
+
+template<class Stream>
+void
+write_records(Stream& os)
+{
+	for (int i = 0; i < record_count; ++i)
+	{
+		os << i << ' ' << "record" << ' ' << (i * 31) << '\n';
+	}
+}
+
+std::string const&
+chunk()
+{
+	static std::string instance(256, 'x');
+	return instance;
+}
+
+constexpr util::size_type stream_size = 1024 * 1024;
+
+}    // namespace
+
+UTIL_BENCH("membuf/omembuf formatted records")
+{
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		util::omembuf mbuf{util::mutable_buffer{1024}};
+		std::ostream  os{&mbuf};
+		write_records(os);
+		auto buf = mbuf.release_buffer();
+		bench::keep(buf.data());
+	}
+}
+
+UTIL_BENCH("membuf/std::ostringstream formatted records")
+{
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		std::ostringstream os;
+		write_records(os);
+		auto s = os.str();
+		bench::keep(s.data());
+	}
+}
+
+UTIL_BENCH("membuf/omembuf write 1MiB in 256B chunks")
+{
+	ctx.bytes_per_op(stream_size);
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		util::omembuf mbuf{util::mutable_buffer{4096}};
+		for (util::size_type n = 0; n < stream_size; n += chunk().size())
+		{
+			mbuf.sputn(chunk().data(), chunk().size());
+		}
+		auto buf = mbuf.release_buffer();
+		bench::keep(buf.data());
+	}
+}
+
+UTIL_BENCH("membuf/std::ostringstream write 1MiB in 256B chunks")
+{
+	ctx.bytes_per_op(stream_size);
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		std::ostringstream os;
+		for (util::size_type n = 0; n < stream_size; n += chunk().size())
+		{
+			os.rdbuf()->sputn(chunk().data(), chunk().size());
+		}
+		auto s = os.str();
+		bench::keep(s.data());
+	}
+}
+
+UTIL_BENCH("membuf/omemqbuf write 1MiB in 256B chunks")
+{
+	ctx.bytes_per_op(stream_size);
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		util::omemqbuf mbuf{16384};
+		for (util::size_type n = 0; n < stream_size; n += chunk().size())
+		{
+			mbuf.sputn(chunk().data(), chunk().size());
+		}
+		auto segments = mbuf.release_buffer();
+		bench::keep(segments.size());
+	}
+}
+
+UTIL_BENCH("membuf/omemqbuf put 1MiB by character")
+{
+	ctx.bytes_per_op(stream_size);
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		util::omemqbuf mbuf{16384};
+		for (util::size_type n = 0; n < stream_size; ++n)
+		{
+			mbuf.sputc('x');
+		}
+		auto segments = mbuf.release_buffer();
+		bench::keep(segments.size());
+	}
+}
+
+UTIL_BENCH("membuf/imemqbuf read 1MiB in 256B chunks")
+{
+	util::omemqbuf obuf{16384};
+	for (util::size_type n = 0; n < stream_size; n += chunk().size())
+	{
+		obuf.sputn(chunk().data(), chunk().size());
+	}
+	std::deque<util::const_buffer> segments;
+	for (auto& segment : obuf.release_buffer())
+	{
+		segments.emplace_back(std::move(segment));
+	}
+
+	ctx.bytes_per_op(stream_size);
+	char dst[256];
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		util::imemqbuf ibuf{std::move(segments)};
+		while (ibuf.sgetn(dst, sizeof(dst)) > 0)
+		{
+			bench::keep(dst[0]);
+		}
+		segments = ibuf.release_buffer();    // reuse the segments for the next iteration
+	}
+}
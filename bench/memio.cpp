@@ -0,0 +1,255 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "bench.h"
+#include <util/membuf.h>
+#include <util/memio.h>
+
+namespace
+{
+
+constexpr util::size_type stream_size = 1024 * 1024;
+constexpr int             record_count = 10000;
+
+struct record
+{
+	std::uint32_t id;
+	std::uint16_t flags;
+	char          tag;
+};
+
+// the same serializer, instantiated for a sink and for std::ostream
+template<class Sink>
+void
+write_records(Sink& sink)
+{
+	for (int i = 0; i < record_count; ++i)
+	{
+		record r{static_cast<std::uint32_t>(i), static_cast<std::uint16_t>(i & 0xff), 'r'};
+		sink.put(r.tag);
+		sink.putn(&r.id, sizeof(r.id));
+		sink.putn(&r.flags, sizeof(r.flags));
+	}
+}
+
+struct ostream_sink
+{
+	std::ostream& os;
+
+	void
+	put(char c)
+	{
+		os.put(c);
+	}
+
+	void
+	putn(const void* src, util::size_type n)
+	{
+		os.write(reinterpret_cast<const char*>(src), n);
+	}
+};
+
+struct streambuf_sink
+{
+	std::streambuf& sbuf;
+
+	void
+	put(char c)
+	{
+		sbuf.sputc(c);
+	}
+
+	void
+	putn(const void* src, util::size_type n)
+	{
+		sbuf.sputn(reinterpret_cast<const char*>(src), n);
+	}
+};
+
+}    // namespace
+
+UTIL_BENCH("memio/membuf_sink put 1MiB by character")
+{
+	ctx.bytes_per_op(stream_size);
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		util::membuf_sink sink{4096};
+		for (util::size_type n = 0; n < stream_size; ++n)
+		{
+			sink.put('x');
+		}
+		auto buf = sink.release_buffer();
+		bench::keep(buf.data());
+	}
+}
+
+UTIL_BENCH("memio/omembuf sputc 1MiB by character")
+{
+	ctx.bytes_per_op(stream_size);
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		util::omembuf mbuf{util::mutable_buffer{4096}};
+		for (util::size_type n = 0; n < stream_size; ++n)
+		{
+			mbuf.sputc('x');
+		}
+		auto buf = mbuf.release_buffer();
+		bench::keep(buf.data());
+	}
+}
+
+UTIL_BENCH("memio/memqbuf_sink put 1MiB by character")
+{
+	ctx.bytes_per_op(stream_size);
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		util::memqbuf_sink sink{16384};
+		for (util::size_type n = 0; n < stream_size; ++n)
+		{
+			sink.put('x');
+		}
+		auto segments = sink.release_buffer();
+		bench::keep(segments.size());
+	}
+}
+
+UTIL_BENCH("memio/membuf_sink binary records")
+{
+	ctx.bytes_per_op(record_count * 7);
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		util::membuf_sink sink{4096};
+		write_records(sink);
+		auto buf = sink.release_buffer();
+		bench::keep(buf.data());
+	}
+}
+
+UTIL_BENCH("memio/memqbuf_sink binary records")
+{
+	ctx.bytes_per_op(record_count * 7);
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		util::memqbuf_sink sink{16384};
+		write_records(sink);
+		auto segments = sink.release_buffer();
+		bench::keep(segments.size());
+	}
+}
+
+UTIL_BENCH("memio/omembuf via std::streambuf binary records")
+{
+	ctx.bytes_per_op(record_count * 7);
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		util::omembuf  mbuf{util::mutable_buffer{4096}};
+		streambuf_sink sink{mbuf};
+		write_records(sink);
+		auto buf = mbuf.release_buffer();
+		bench::keep(buf.data());
+	}
+}
+
+UTIL_BENCH("memio/omembuf via std::ostream binary records")
+{
+	ctx.bytes_per_op(record_count * 7);
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		util::omembuf mbuf{util::mutable_buffer{4096}};
+		std::ostream  os{&mbuf};
+		ostream_sink  sink{os};
+		write_records(sink);
+		auto buf = mbuf.release_buffer();
+		bench::keep(buf.data());
+	}
+}
+
+UTIL_BENCH("memio/memqbuf_sink via sink_streambuf binary records")
+{
+	ctx.bytes_per_op(record_count * 7);
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		util::memqbuf_sink                       sink{16384};
+		util::sink_streambuf<util::memqbuf_sink> sbuf{sink};
+		streambuf_sink                           adapter{sbuf};
+		write_records(adapter);
+		auto segments = sink.release_buffer();
+		bench::keep(segments.size());
+	}
+}
+
+UTIL_BENCH("memio/memqbuf_source get 1MiB by character")
+{
+	util::memqbuf_sink sink{16384};
+	for (util::size_type n = 0; n < stream_size; ++n)
+	{
+		sink.put('x');
+	}
+	util::memqbuf_source::buffer_type segments;
+	for (auto& segment : sink.release_buffer())
+	{
+		segments.emplace_back(std::move(segment));
+	}
+
+	ctx.bytes_per_op(stream_size);
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		util::memqbuf_source source{std::move(segments)};
+		char                 c{0};
+		std::uint64_t        sum{0};
+		while (source.get(c))
+		{
+			sum += c;
+		}
+		bench::keep(sum);
+		segments = source.release_buffer();
+	}
+}
+
+UTIL_BENCH("memio/imemqbuf sbumpc 1MiB by character")
+{
+	util::memqbuf_sink sink{16384};
+	for (util::size_type n = 0; n < stream_size; ++n)
+	{
+		sink.put('x');
+	}
+	util::imemqbuf::buffer_type segments;
+	for (auto& segment : sink.release_buffer())
+	{
+		segments.emplace_back(std::move(segment));
+	}
+
+	ctx.bytes_per_op(stream_size);
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		util::imemqbuf ibuf{std::move(segments)};
+		std::uint64_t  sum{0};
+		for (auto c = ibuf.sbumpc(); c != std::char_traits<char>::eof(); c = ibuf.sbumpc())
+		{
+			sum += c;
+		}
+		bench::keep(sum);
+		segments = ibuf.release_buffer();
+	}
+}
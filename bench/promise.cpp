@@ -0,0 +1,253 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "bench.h"
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <util/mt_promise.h>
+#include <util/promise.h>
+
+namespace
+{
+
+constexpr int chain_length = 8;
+constexpr int fan_out      = 10000;
+
+void
+callback_chain(int depth, int value, std::function<void(int)> const& done)
+{
+	if (depth == 0)
+	{
+		done(value);
+	}
+	else
+	{
+		std::function<void(int)> next = [depth, &done](int v) { callback_chain(depth - 1, v + 1, done); };
+		next(value);
+	}
+}
+
+}    // namespace
+
+UTIL_BENCH("promise/promise::then chain of 8, resolved after chaining")
+{
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		int                 result{0};
+		util::promise<int> p;
+		auto               q = p;
+		for (int d = 0; d < chain_length; ++d)
+		{
+			q = q.then([](int v) { return v + 1; });
+		}
+		q.then([&result](int v) { result = v; });
+		p.resolve(0);
+		bench::keep(result);
+	}
+}
+
+UTIL_BENCH("promise/promise::then chain of 8, resolved before chaining")
+{
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		int                result{0};
+		util::promise<int> p;
+		p.resolve(0);
+		auto q = p;
+		for (int d = 0; d < chain_length; ++d)
+		{
+			q = q.then([](int v) { return v + 1; });
+		}
+		q.then([&result](int v) { result = v; });
+		bench::keep(result);
+	}
+}
+
+UTIL_BENCH("promise/promise::then, one link")
+{
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		int                result{0};
+		util::promise<int> p;
+		p.then([](int v) { return v + 1; }).then([&result](int v) { result = v; });
+		p.resolve(0);
+		bench::keep(result);
+	}
+}
+
+UTIL_BENCH("promise/promise::then_on inline executor, one link")
+{
+	util::inline_executor ex;
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		int                result{0};
+		util::promise<int> p;
+		p.then_on(ex, [](int v) { return v + 1; }).then([&result](int v) { result = v; });
+		p.resolve(0);
+		bench::keep(result);
+	}
+}
+
+UTIL_BENCH("promise/promise::all, 10000-way fan-out")
+{
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		std::size_t                       result{0};
+		util::promise<int>::promises_type promises(fan_out);
+		util::promise<int>::all(promises).then([&result](auto&& values) { result = values.size(); });
+		for (auto& p : promises)
+		{
+			p.resolve(1);
+		}
+		bench::keep(result);
+	}
+}
+
+UTIL_BENCH("promise/when_all, 10000-way fan-out")
+{
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		std::size_t                       result{0};
+		util::promise<int>::promises_type promises(fan_out);
+		util::when_all(promises).then([&result](std::vector<int>&& values) { result = values.size(); });
+		for (auto& p : promises)
+		{
+			p.resolve(1);
+		}
+		bench::keep(result);
+	}
+}
+
+UTIL_BENCH("promise/when_all, three heterogeneous promises")
+{
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		int                       result{0};
+		util::promise<int>        p1;
+		util::promise<double>     p2;
+		util::promise<void>       p3;
+		util::when_all(p1, p2, p3).then([&result](auto&& values) { result = std::get<0>(values); });
+		p1.resolve(1);
+		p2.resolve(2.0);
+		p3.resolve();
+		bench::keep(result);
+	}
+}
+
+UTIL_BENCH("promise/promise::then chain of 8 bound to a token, cancelled")
+{
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		int                       result{0};
+		util::cancellation_source source;
+		util::promise<int>        p;
+		p.with_cancellation(source.token());
+		auto q = p;
+		for (int d = 0; d < chain_length; ++d)
+		{
+			q = q.then([](int v) { return v + 1; });
+		}
+		q.then([](int) {}, [&result](std::error_code const& err) { result = err.value(); });
+		source.cancel();
+		bench::keep(result);
+	}
+}
+
+UTIL_BENCH("promise/promise::race of 8, losers cancelled")
+{
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		int                               result{0};
+		util::promise<int>::promises_type promises(chain_length);
+		util::promise<int>::race(promises).then([&result](int v) { result = v; });
+		promises[chain_length / 2].resolve(1);
+		bench::keep(result);
+	}
+}
+
+UTIL_BENCH("promise/mt::promise::then, one link")
+{
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		int                    result{0};
+		util::mt::promise<int> p;
+		p.then([](int v) { return v + 1; }).then([&result](int v) { result = v; });
+		p.resolve(0);
+		bench::keep(result);
+	}
+}
+
+UTIL_BENCH("promise/mt::promise cross-thread handoff")
+{
+	// a worker resolves promises that the bench thread attaches continuations to; the worker
+	// takes its own reference before clearing the slot
+	std::atomic<util::mt::promise<int>*> slot{nullptr};
+	std::atomic<bool>                    done{false};
+
+	auto resolver = [&]() {
+		while (!done.load(std::memory_order_relaxed))
+		{
+			auto ptr = slot.load(std::memory_order_acquire);
+			if (ptr)
+			{
+				util::mt::promise<int> p{*ptr};
+				slot.store(nullptr, std::memory_order_release);
+				p.resolve(1);
+			}
+			else
+			{
+				std::this_thread::yield();
+			}
+		}
+	};
+	std::thread worker{resolver};
+
+	std::atomic<std::uint64_t> sum{0};
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		util::mt::promise<int> p;
+		auto                   q = p;
+		slot.store(&q, std::memory_order_release);
+		p.then([&sum](int v) { sum.fetch_add(v, std::memory_order_relaxed); });
+		while (slot.load(std::memory_order_acquire) || !p.is_finished())
+		{
+			std::this_thread::yield();
+		}
+	}
+	done.store(true);
+	worker.join();
+	bench::keep(sum);
+}
+
+UTIL_BENCH("promise/std::function callback chain of 8")
+{
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		int                      result{0};
+		std::function<void(int)> done = [&result](int v) { result = v; };
+		callback_chain(chain_length, 0, done);
+		bench::keep(result);
+	}
+}
@@ -0,0 +1,94 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "bench.h"
+#include <util/atomic_shared_ptr.h>
+#include <util/reclaim.h>
+
+namespace
+{
+
+struct payload
+{
+	payload(int v) : value{v} {}
+	int value;
+};
+
+}    // namespace
+
+UTIL_BENCH("reclaim/epoch_domain guard and read")
+{
+	std::atomic<payload*> current{new payload{7}};
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		util::epoch_domain::guard guard;
+		bench::keep(current.load(std::memory_order_acquire)->value);
+	}
+	delete current.load();
+}
+
+UTIL_BENCH("reclaim/hazard_pointer protect and read")
+{
+	std::atomic<payload*>               current{new payload{7}};
+	util::hazard_domain::hazard_pointer hp;
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		bench::keep(hp.protect(current)->value);
+		hp.reset();
+	}
+	delete current.load();
+}
+
+UTIL_BENCH("reclaim/atomic_shared_ptr load and read")
+{
+	util::atomic_shared_ptr<payload> current{util::mt::make_shared<payload>(7)};
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		bench::keep(current.load()->value);
+	}
+}
+
+UTIL_BENCH("reclaim/epoch_domain replace and retire")
+{
+	auto&                 domain = util::epoch_domain::instance();
+	std::atomic<payload*> current{new payload{0}};
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		domain.retire(current.exchange(new payload{static_cast<int>(i)}, std::memory_order_acq_rel));
+	}
+	domain.retire(current.load());
+	domain.flush();
+}
+
+UTIL_BENCH("reclaim/hazard_domain replace and retire")
+{
+	auto&                 domain = util::hazard_domain::instance();
+	std::atomic<payload*> current{new payload{0}};
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		domain.retire(current.exchange(new payload{static_cast<int>(i)}, std::memory_order_acq_rel));
+	}
+	domain.retire(current.load());
+	domain.collect();
+}
@@ -0,0 +1,307 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "bench.h"
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <util/atomic_shared_ptr.h>
+#include <util/biased_refcount.h>
+#include <util/intrusive_ptr.h>
+#include <util/pool_allocator.h>
+#include <util/shared_ptr.h>
+#include <vector>
+
+namespace
+{
+
+struct payload
+{
+	payload(int v) : value{v} {}
+	int value;
+};
+
+struct intrusive_payload : util::intrusive_refcount<intrusive_payload>
+{
+	intrusive_payload(int v) : value{v} {}
+	int value;
+};
+
+/* Four threads share ctx.iterations() reads of a hot-swapped value, while the calling
+ * thread replaces the value every 50 microseconds.
+ */
+template<class Load, class Store>
+void
+read_mostly(bench::context& ctx, Load load, Store store)
+{
+	constexpr std::uint64_t  reader_count = 4;
+	std::atomic<int>         running{reader_count};
+	std::vector<std::thread> readers;
+	for (std::uint64_t t = 0; t < reader_count; ++t)
+	{
+		readers.emplace_back([&]() {
+			for (std::uint64_t i = 0; i < ctx.iterations() / reader_count; ++i)
+			{
+				auto p = load();
+				bench::keep(p->value);
+			}
+			--running;
+		});
+	}
+	for (int version = 1; running.load() > 0; ++version)
+	{
+		store(version);
+		std::this_thread::sleep_for(std::chrono::microseconds{50});
+	}
+	for (auto& reader : readers)
+	{
+		reader.join();
+	}
+}
+
+template<class Ptr>
+void
+copy_destroy(bench::context& ctx, Ptr const& src)
+{
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		Ptr copy{src};
+		bench::keep(copy);
+	}
+}
+
+}    // namespace
+
+UTIL_BENCH("shared_ptr/util::shared_ptr copy and destroy")
+{
+	auto p = util::make_shared<payload>(7);
+	copy_destroy(ctx, p);
+}
+
+UTIL_BENCH("shared_ptr/util::mt::shared_ptr copy and destroy")
+{
+	auto p = util::mt::make_shared<payload>(7);
+	copy_destroy(ctx, p);
+}
+
+UTIL_BENCH("shared_ptr/util::biased::shared_ptr copy and destroy (owner)")
+{
+	auto p = util::biased::make_shared<payload>(7);
+	copy_destroy(ctx, p);
+}
+
+UTIL_BENCH("shared_ptr/util::biased::shared_ptr copy and destroy (other)")
+{
+	util::biased::shared_ptr<payload> p;
+	std::thread{[&p]() { p = util::biased::make_shared<payload>(7); }}.join();
+	copy_destroy(ctx, p);
+}
+
+UTIL_BENCH("shared_ptr/util::compact::shared_ptr copy and destroy")
+{
+	auto p = util::compact::make_shared<payload>(7);
+	copy_destroy(ctx, p);
+}
+
+UTIL_BENCH("shared_ptr/util::intrusive_ptr copy and destroy")
+{
+	auto p = util::make_intrusive<intrusive_payload>(7);
+	copy_destroy(ctx, p);
+}
+
+UTIL_BENCH("shared_ptr/std::shared_ptr copy and destroy")
+{
+	auto p = std::make_shared<payload>(7);
+	copy_destroy(ctx, p);
+}
+
+UTIL_BENCH("shared_ptr/util::make_shared and destroy")
+{
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		auto p = util::make_shared<payload>(static_cast<int>(i));
+		bench::keep(p);
+	}
+}
+
+UTIL_BENCH("shared_ptr/util::compact::make_shared and destroy")
+{
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		auto p = util::compact::make_shared<payload>(static_cast<int>(i));
+		bench::keep(p);
+	}
+}
+
+UTIL_BENCH("shared_ptr/util::noweak::make_shared and destroy")
+{
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		auto p = util::noweak::make_shared<payload>(static_cast<int>(i));
+		bench::keep(p);
+	}
+}
+
+UTIL_BENCH("shared_ptr/util::make_pooled and destroy")
+{
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		auto p = util::make_pooled<payload>(static_cast<int>(i));
+		bench::keep(p);
+	}
+}
+
+UTIL_BENCH("shared_ptr/util::mt::make_pooled and destroy")
+{
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		auto p = util::mt::make_pooled<payload>(static_cast<int>(i));
+		bench::keep(p);
+	}
+}
+
+UTIL_BENCH("shared_ptr/util::make_shared batch of 256")
+{
+	std::vector<util::shared_ptr<payload>> batch;
+	batch.reserve(256);
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		batch.push_back(util::make_shared<payload>(static_cast<int>(i)));
+		if (batch.size() == 256)
+		{
+			batch.clear();
+		}
+	}
+}
+
+UTIL_BENCH("shared_ptr/util::make_pooled batch of 256")
+{
+	std::vector<util::shared_ptr<payload>> batch;
+	batch.reserve(256);
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		batch.push_back(util::make_pooled<payload>(static_cast<int>(i)));
+		if (batch.size() == 256)
+		{
+			batch.clear();
+		}
+	}
+}
+
+UTIL_BENCH("shared_ptr/util::make_shared<int[]>(64) and destroy")
+{
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		auto p = util::make_shared<int[]>(64);
+		bench::keep(p);
+	}
+}
+
+UTIL_BENCH("shared_ptr/util::make_shared<std::vector<int>>(64) and destroy")
+{
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		auto p = util::make_shared<std::vector<int>>(64);
+		bench::keep(p);
+	}
+}
+
+UTIL_BENCH("shared_ptr/std::make_shared and destroy")
+{
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		auto p = std::make_shared<payload>(static_cast<int>(i));
+		bench::keep(p);
+	}
+}
+
+UTIL_BENCH("shared_ptr/util::mt::weak_ptr lock")
+{
+	auto                        p = util::mt::make_shared<payload>(7);
+	util::mt::weak_ptr<payload> wp{p};
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		auto locked = wp.lock();
+		bench::keep(locked);
+	}
+}
+
+UTIL_BENCH("shared_ptr/std::weak_ptr lock")
+{
+	auto                   p = std::make_shared<payload>(7);
+	std::weak_ptr<payload> wp{p};
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		auto locked = wp.lock();
+		bench::keep(locked);
+	}
+}
+
+UTIL_BENCH("shared_ptr/util::atomic_shared_ptr load")
+{
+	util::atomic_shared_ptr<payload> ap{util::mt::make_shared<payload>(7)};
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		auto p = ap.load();
+		bench::keep(p);
+	}
+}
+
+UTIL_BENCH("shared_ptr/mutex-guarded util::mt::shared_ptr load")
+{
+	std::mutex                    mutex;
+	util::mt::shared_ptr<payload> sp{util::mt::make_shared<payload>(7)};
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		std::unique_lock<std::mutex> lock{mutex};
+		auto                         p = sp;
+		lock.unlock();
+		bench::keep(p);
+	}
+}
+
+UTIL_BENCH("shared_ptr/util::atomic_shared_ptr read-mostly (4 readers)")
+{
+	util::atomic_shared_ptr<payload> ap{util::mt::make_shared<payload>(0)};
+	read_mostly(
+			ctx, [&]() { return ap.load(); }, [&](int v) { ap.store(util::mt::make_shared<payload>(v)); });
+}
+
+UTIL_BENCH("shared_ptr/mutex-guarded util::mt::shared_ptr read-mostly (4 readers)")
+{
+	std::mutex                    mutex;
+	util::mt::shared_ptr<payload> sp{util::mt::make_shared<payload>(0)};
+	read_mostly(
+			ctx,
+			[&]() {
+				std::lock_guard<std::mutex> lock{mutex};
+				return sp;
+			},
+			[&](int v) {
+				auto                        p = util::mt::make_shared<payload>(v);
+				std::lock_guard<std::mutex> lock{mutex};
+				sp.swap(p);
+			});
+}
@@ -0,0 +1,120 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "bench.h"
+#include <random>
+#include <util/promise_timer.h>
+#include <util/timer_wheel.h>
+#include <vector>
+#include "../test/util/ghetto_async.h"
+
+namespace
+{
+
+constexpr int pending_timers = 10000;
+
+using namespace std::chrono_literals;
+
+// timers spread over the next minute, so that every level below the top is occupied
+std::vector<std::chrono::milliseconds>
+spread_delays(int count)
+{
+	std::minstd_rand                       rng{7};
+	std::vector<std::chrono::milliseconds> result;
+	for (int i = 0; i < count; ++i)
+	{
+		result.emplace_back(1000 + rng() % 60000);
+	}
+	return result;
+}
+
+}    // namespace
+
+UTIL_BENCH("timer_wheel/start+cancel, 10000 pending")
+{
+	util::timer_wheel wheel;
+	for (auto delay : spread_delays(pending_timers))
+	{
+		wheel.start(wheel.create_timer(), delay, [](std::error_code const&) {});
+	}
+
+	auto t = wheel.create_timer();
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		wheel.start(t, 30s, [](std::error_code const&) {});
+		wheel.cancel(t);
+	}
+}
+
+UTIL_BENCH("timer_wheel/ghetto_async start+cancel, 10000 pending")
+{
+	using async_io = ghetto_async::async_adapter;
+
+	// schedule() does not check for duplicates, so populating the queue is not itself quadratic
+	auto lp = async_io::create_loop();
+	for (auto delay : spread_delays(pending_timers))
+	{
+		async_io::schedule(lp, delay, [](std::error_code const&) {});
+	}
+
+	auto t = async_io::create_timer(lp);
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		async_io::start_timer(t, 30s, [](std::error_code const&) {});
+		async_io::cancel_timer(t);
+	}
+	lp->shutdown();
+	lp->run();
+}
+
+UTIL_BENCH("timer_wheel/expire 10000 timers, per timer")
+{
+	auto delays = spread_delays(pending_timers);
+	for (std::uint64_t i = 0; i < ctx.iterations(); i += pending_timers)
+	{
+		auto              origin = util::timer_wheel::clock_type::now();
+		util::timer_wheel wheel{1ms, 0ms, origin};
+		std::size_t       fired{0};
+		for (auto delay : delays)
+		{
+			wheel.start_at(wheel.create_timer(), origin + delay, [&fired](std::error_code const&) { ++fired; });
+		}
+		wheel.advance(origin + 62s);
+		bench::keep(fired);
+	}
+}
+
+UTIL_BENCH("timer_wheel/promise with timeout, resolved before expiry")
+{
+	util::timer_wheel wheel;
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		int                result{0};
+		util::promise<int> p;
+		p.timeout(util::promise_timer<util::timer_wheel_adapter>{30s, &wheel});
+		p.then([&result](int value) { result = value; });
+		p.resolve(1);
+		bench::keep(result);
+	}
+}
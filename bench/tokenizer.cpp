@@ -0,0 +1,147 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "bench.h"
+#include <sstream>
+#include <string>
+#include <util/membuf.h>
+#include <util/tokenizer.h>
+
+namespace
+{
+
+constexpr util::size_type segment_size = 65536;
+
+std::string const&
+line_content()
+{
+	static std::string const instance = [] {
+		std::ostringstream os;
+		for (int i = 0; os.tellp() < 16 * 1024 * 1024; ++i)
+		{
+			os << "GET /index/" << i << ".html HTTP/1.1 host=example.com agent=bench\n";
+		}
+		return os.str();
+	}();
+	return instance;
+}
+
+std::string const&
+number_content()
+{
+	static std::string const instance = [] {
+		std::ostringstream os;
+		for (int i = 0; i < 200000; ++i)
+		{
+			os << (i * 7919) << ' ';
+		}
+		return os.str();
+	}();
+	return instance;
+}
+
+std::deque<util::const_buffer>
+segments_of(std::string const& content)
+{
+	std::deque<util::const_buffer> result;
+	for (std::size_t offset = 0; offset < content.size(); offset += segment_size)
+	{
+		auto n = std::min<std::size_t>(segment_size, content.size() - offset);
+		// alias the content rather than copying it, so that only tokenizing is measured
+		result.emplace_back(const_cast<char*>(content.data()) + offset, n, util::null_delete<util::byte_type>{});
+	}
+	return result;
+}
+
+}    // namespace
+
+UTIL_BENCH("tokenizer/segment_tokenizer::next_line 16MiB")
+{
+	auto const& content = line_content();
+	ctx.bytes_per_op(content.size());
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		util::segment_tokenizer tok{segments_of(content)};
+		std::string_view        line;
+		std::size_t             count{0};
+		while (tok.next_line(line))
+		{
+			count += line.size();
+		}
+		bench::keep(count);
+	}
+}
+
+UTIL_BENCH("tokenizer/std::getline over imemqbuf 16MiB")
+{
+	auto const& content = line_content();
+	ctx.bytes_per_op(content.size());
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		util::imemqbuf ibuf{segments_of(content)};
+		std::istream   is{&ibuf};
+		std::string    line;
+		std::size_t    count{0};
+		while (std::getline(is, line))
+		{
+			count += line.size();
+		}
+		bench::keep(count);
+	}
+}
+
+UTIL_BENCH("tokenizer/segment_tokenizer::next_number integers")
+{
+	auto const& content = number_content();
+	ctx.bytes_per_op(content.size());
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		util::segment_tokenizer tok{segments_of(content)};
+		long                    value{0};
+		long                    sum{0};
+		while (tok.next_number(value))
+		{
+			sum += value;
+		}
+		bench::keep(sum);
+	}
+}
+
+UTIL_BENCH("tokenizer/std::istream >> over imemqbuf integers")
+{
+	auto const& content = number_content();
+	ctx.bytes_per_op(content.size());
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		util::imemqbuf ibuf{segments_of(content)};
+		std::istream   is{&ibuf};
+		long           value{0};
+		long           sum{0};
+		while (is >> value)
+		{
+			sum += value;
+		}
+		bench::keep(sum);
+	}
+}
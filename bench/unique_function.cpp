@@ -0,0 +1,75 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "bench.h"
+#include <functional>
+#include <memory>
+#include <util/unique_function.h>
+
+namespace
+{
+
+// a capture of the size typical of a promise continuation: a promise, a shared_ptr and some scalars
+struct capture
+{
+	void*                m_promise;
+	std::shared_ptr<int> m_state;
+	std::uint64_t        m_index;
+};
+
+}    // namespace
+
+UTIL_BENCH("unique_function/std::function, 32-byte capture")
+{
+	capture c{nullptr, std::make_shared<int>(1), 0};
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		std::function<std::uint64_t(std::uint64_t)> f = [c](std::uint64_t v) { return v + c.m_index + *c.m_state; };
+		auto                                         g = std::move(f);
+		bench::keep(g(i));
+	}
+}
+
+UTIL_BENCH("unique_function/unique_function, 32-byte capture")
+{
+	capture c{nullptr, std::make_shared<int>(1), 0};
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		util::unique_function<std::uint64_t(std::uint64_t)> f = [c](std::uint64_t v) {
+			return v + c.m_index + *c.m_state;
+		};
+		auto g = std::move(f);
+		bench::keep(g(i));
+	}
+}
+
+UTIL_BENCH("unique_function/unique_function, move-only capture")
+{
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		util::unique_function<std::uint64_t()> f = [p = std::unique_ptr<std::uint64_t>{}, i]() { return p ? *p : i; };
+		auto                                   g = std::move(f);
+		bench::keep(g());
+	}
+}
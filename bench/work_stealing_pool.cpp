@@ -0,0 +1,125 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "bench.h"
+#include <atomic>
+#include <thread>
+#include <util/executor.h>
+#include <util/work_stealing_pool.h>
+#include <vector>
+
+namespace
+{
+
+constexpr int fan_out_depth = 9;    // 1023 tasks
+constexpr int workers       = 4;
+constexpr int producers     = 4;
+constexpr int tasks_per_op  = 256;
+
+template<class Pool>
+void
+fan_out(Pool& pool, std::atomic<int>& count, int depth)
+{
+	count.fetch_add(1, std::memory_order_relaxed);
+	if (depth > 0)
+	{
+		pool.post([&pool, &count, depth]() { fan_out(pool, count, depth - 1); });
+		pool.post([&pool, &count, depth]() { fan_out(pool, count, depth - 1); });
+	}
+}
+
+void
+wait_for(std::atomic<int> const& count, int expected)
+{
+	while (count.load(std::memory_order_relaxed) < expected)
+	{
+		std::this_thread::yield();
+	}
+}
+
+// each op is one fan-out tree, spawned from within the pool
+template<class Pool>
+void
+fork_join(bench::context& ctx)
+{
+	constexpr int    tasks = (1 << (fan_out_depth + 1)) - 1;
+	Pool             pool{workers};
+	std::atomic<int> count{0};
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		count.store(0, std::memory_order_relaxed);
+		pool.post([&]() { fan_out(pool, count, fan_out_depth); });
+		wait_for(count, tasks);
+	}
+}
+
+// each op is tasks_per_op tasks posted by each of several threads outside the pool
+template<class Pool>
+void
+contention(bench::context& ctx)
+{
+	Pool             pool{workers};
+	std::atomic<int> count{0};
+	for (std::uint64_t i = 0; i < ctx.iterations(); ++i)
+	{
+		count.store(0, std::memory_order_relaxed);
+		std::vector<std::thread> threads;
+		for (int t = 0; t < producers; ++t)
+		{
+			threads.emplace_back([&]() {
+				for (int n = 0; n < tasks_per_op; ++n)
+				{
+					pool.post([&]() { count.fetch_add(1, std::memory_order_relaxed); });
+				}
+			});
+		}
+		for (auto& t : threads)
+		{
+			t.join();
+		}
+		wait_for(count, producers * tasks_per_op);
+	}
+}
+
+}    // namespace
+
+UTIL_BENCH("work_stealing_pool/fork-join fan-out of 1023 tasks")
+{
+	fork_join<util::work_stealing_pool>(ctx);
+}
+
+UTIL_BENCH("work_stealing_pool/thread_pool fork-join fan-out of 1023 tasks")
+{
+	fork_join<util::thread_pool>(ctx);
+}
+
+UTIL_BENCH("work_stealing_pool/4 producers x 256 tasks")
+{
+	contention<util::work_stealing_pool>(ctx);
+}
+
+UTIL_BENCH("work_stealing_pool/thread_pool 4 producers x 256 tasks")
+{
+	contention<util::thread_pool>(ctx);
+}
@@ -0,0 +1,335 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef UTIL_ATOMIC_SHARED_PTR_H
+#define UTIL_ATOMIC_SHARED_PTR_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <util/shared_ptr.h>
+
+namespace util
+{
+
+#if (UTIL_USE_STD_SHARED_PTR)
+
+template<class T>
+class atomic_shared_ptr
+{
+public:
+	using value_type = mt::shared_ptr<T>;
+
+	atomic_shared_ptr() = default;
+	atomic_shared_ptr(value_type desired) : m_value{std::move(desired)} {}
+	atomic_shared_ptr(atomic_shared_ptr const&) = delete;
+	atomic_shared_ptr&
+	operator=(atomic_shared_ptr const&) = delete;
+
+	bool
+	is_lock_free() const
+	{
+		return std::atomic_is_lock_free(&m_value);
+	}
+
+	value_type
+	load(std::memory_order order = std::memory_order_seq_cst) const
+	{
+		return std::atomic_load_explicit(&m_value, order);
+	}
+
+	void
+	store(value_type desired, std::memory_order order = std::memory_order_seq_cst)
+	{
+		std::atomic_store_explicit(&m_value, std::move(desired), order);
+	}
+
+	value_type
+	exchange(value_type desired, std::memory_order order = std::memory_order_seq_cst)
+	{
+		return std::atomic_exchange_explicit(&m_value, std::move(desired), order);
+	}
+
+	bool
+	compare_exchange_strong(value_type& expected, value_type desired)
+	{
+		return std::atomic_compare_exchange_strong(&m_value, &expected, std::move(desired));
+	}
+
+	bool
+	compare_exchange_weak(value_type& expected, value_type desired)
+	{
+		return std::atomic_compare_exchange_weak(&m_value, &expected, std::move(desired));
+	}
+
+	operator value_type() const
+	{
+		return load();
+	}
+
+private:
+	value_type m_value;
+};
+
+#else
+
+/** \brief Lock-free atomic holder for a util::mt::shared_ptr.
+ *
+ * The stored value is a single word that packs a pointer to an immutable node, holding the
+ * shared_ptr, with a 16-bit count of readers that are copying it (split reference counting).
+ * load() increments the reader count and copies the node's shared_ptr, which increments the
+ * atomic use count of the control block; it then decrements the reader count if the node is
+ * still installed, or otherwise decrements the node's own count. A writer that replaces the node
+ * transfers the reader count it removed to the node's own count, and whichever thread brings
+ * that count to zero deletes the node. No operation takes a lock or waits for another thread.
+ *
+ * store(), exchange() and a successful compare_exchange allocate one node for a non-null
+ * value, so this is intended for read-mostly state such as configuration that is replaced
+ * occasionally. Nodes are addressed with 48 bits, and at most 65535 loads may be in progress
+ * on one atomic_shared_ptr at once.
+ */
+template<class T>
+class atomic_shared_ptr
+{
+public:
+	using value_type = mt::shared_ptr<T>;
+
+	atomic_shared_ptr() : m_word{0} {}
+
+	atomic_shared_ptr(value_type desired) : m_word{make_word(make_node(std::move(desired)))} {}
+
+	atomic_shared_ptr(atomic_shared_ptr const&) = delete;
+	atomic_shared_ptr&
+	operator=(atomic_shared_ptr const&) = delete;
+
+	~atomic_shared_ptr()
+	{
+		delete node_of(m_word.load(std::memory_order_relaxed));
+	}
+
+	bool
+	is_lock_free() const
+	{
+		return m_word.is_lock_free();
+	}
+
+	value_type
+	load(std::memory_order order = std::memory_order_seq_cst) const
+	{
+		(void)order;
+		auto n = acquire();
+		if (!n)
+		{
+			return value_type{};
+		}
+		value_type result{n->value};
+		release(n);
+		return result;
+	}
+
+	void
+	store(value_type desired, std::memory_order order = std::memory_order_seq_cst)
+	{
+		exchange(std::move(desired), order);
+	}
+
+	value_type
+	exchange(value_type desired, std::memory_order order = std::memory_order_seq_cst)
+	{
+		(void)order;
+		auto old = m_word.exchange(make_word(make_node(std::move(desired))), std::memory_order_acq_rel);
+		return retire(old, 0);
+	}
+
+	/** \brief Replace the value with \e desired if it is equivalent to \e expected.
+	 *
+	 * Values are equivalent if they point to the same object and share a control block.
+	 * If they are not, \e expected is side-effected with the current value.
+	 */
+	bool
+	compare_exchange_strong(value_type& expected, value_type desired)
+	{
+		node* replacement{nullptr};
+		bool  result{false};
+		for (;;)
+		{
+			auto current = m_word.load(std::memory_order_acquire);
+			auto n       = node_of(current);
+			if (n)
+			{
+				n = acquire();
+				if (!n)
+				{
+					continue;
+				}
+				current = m_word.load(std::memory_order_acquire);
+			}
+
+			if (n ? !equivalent(n->value, expected) : static_cast<bool>(expected.get_ctrl_blk() || expected.get()))
+			{
+				if (n)
+				{
+					expected = n->value;
+					release(n);
+				}
+				else
+				{
+					expected.reset();
+				}
+				goto exit;
+			}
+
+			if (!replacement && desired)
+			{
+				replacement = make_node(std::move(desired));
+			}
+
+			// retry while the same node is installed and only the reader count changes
+			while (node_of(current) == n)
+			{
+				if (m_word.compare_exchange_weak(
+							current, make_word(replacement), std::memory_order_acq_rel, std::memory_order_acquire))
+				{
+					retire(current, n ? 1 : 0);
+					replacement = nullptr;
+					result      = true;
+					goto exit;
+				}
+			}
+			if (n)
+			{
+				release(n);
+			}
+		}
+
+	exit:
+		delete replacement;
+		return result;
+	}
+
+	bool
+	compare_exchange_weak(value_type& expected, value_type desired)
+	{
+		return compare_exchange_strong(expected, std::move(desired));
+	}
+
+	operator value_type() const
+	{
+		return load();
+	}
+
+private:
+	struct node
+	{
+		node(value_type&& v) : value{std::move(v)}, count{0} {}
+
+		value_type        value;
+		std::atomic<long> count;    // reader count transferred by the remover, less completed late releases
+	};
+
+	static constexpr int           count_shift = 48;
+	static constexpr std::uint64_t count_unit  = std::uint64_t{1} << count_shift;
+	static constexpr std::uint64_t ptr_mask    = count_unit - 1;
+
+	static_assert(sizeof(void*) == sizeof(std::uint64_t), "atomic_shared_ptr requires 64-bit pointers");
+
+	static node*
+	make_node(value_type&& value)
+	{
+		return value ? new node{std::move(value)} : nullptr;
+	}
+
+	static std::uint64_t
+	make_word(node* n)
+	{
+		return reinterpret_cast<std::uint64_t>(n);
+	}
+
+	static node*
+	node_of(std::uint64_t word)
+	{
+		return reinterpret_cast<node*>(word & ptr_mask);
+	}
+
+	static bool
+	equivalent(value_type const& a, value_type const& b)
+	{
+		return a.get() == b.get() && a.get_ctrl_blk() == b.get_ctrl_blk();
+	}
+
+	/* Increment the reader count of the installed node. When no node is installed, the
+	 * increment is meaningless; it is discarded by the next replacement, or wraps.
+	 */
+	node*
+	acquire() const
+	{
+		return node_of(m_word.fetch_add(count_unit, std::memory_order_acquire));
+	}
+
+	void
+	release(node* n) const
+	{
+		auto word = m_word.load(std::memory_order_relaxed);
+		while (node_of(word) == n)
+		{
+			if (m_word.compare_exchange_weak(word, word - count_unit, std::memory_order_release, std::memory_order_relaxed))
+			{
+				return;
+			}
+		}
+		// the node was removed, and our read was transferred to its own count
+		if (n->count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			delete n;
+		}
+	}
+
+	/* Take the value from a removed word, transferring its reader count (less \e own, the
+	 * remover's own read) to the node.
+	 */
+	static value_type
+	retire(std::uint64_t word, long own)
+	{
+		auto n = node_of(word);
+		if (!n)
+		{
+			return value_type{};
+		}
+		value_type result{n->value};
+		auto       readers = static_cast<long>(word >> count_shift) - own;
+		if (n->count.fetch_add(readers, std::memory_order_acq_rel) == -readers)
+		{
+			delete n;
+		}
+		return result;
+	}
+
+	mutable std::atomic<std::uint64_t> m_word;
+};
+
+#endif    // UTIL_USE_STD_SHARED_PTR
+
+}    // namespace util
+
+#endif    // UTIL_ATOMIC_SHARED_PTR_H
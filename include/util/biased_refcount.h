@@ -0,0 +1,425 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef UTIL_BIASED_REFCOUNT_H
+#define UTIL_BIASED_REFCOUNT_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <util/shared_ptr.h>
+#include <vector>
+
+namespace util
+{
+
+class biased_refcount;
+
+namespace detail
+{
+
+/* Each thread that owns biased counts has a queue of objects whose shared counts were
+ * driven negative by other threads. The registry maps owner ids to queues for as long as
+ * the owning thread runs; at thread exit, the owner merges whatever remains in its queue.
+ */
+class biased_registry
+{
+public:
+	using queue_type = std::vector<biased_refcount*>;
+
+	static biased_registry&
+	get()
+	{
+		static biased_registry instance;
+		return instance;
+	}
+
+	/* Returns false if the owner has exited; the caller must then merge the counts itself.
+	 */
+	bool
+	enqueue(std::uint64_t owner, biased_refcount* counts)
+	{
+		std::lock_guard<std::mutex> lock{m_mutex};
+		auto                        it = m_queues.find(owner);
+		if (it == m_queues.end())
+		{
+			return false;
+		}
+		it->second.push_back(counts);
+		return true;
+	}
+
+	queue_type
+	take(std::uint64_t owner)
+	{
+		queue_type                  result;
+		std::lock_guard<std::mutex> lock{m_mutex};
+		auto                        it = m_queues.find(owner);
+		if (it != m_queues.end())
+		{
+			result.swap(it->second);
+		}
+		return result;
+	}
+
+	void
+	add_owner(std::uint64_t owner)
+	{
+		std::lock_guard<std::mutex> lock{m_mutex};
+		m_queues.emplace(owner, queue_type{});
+	}
+
+	queue_type
+	remove_owner(std::uint64_t owner)
+	{
+		queue_type                  result;
+		std::lock_guard<std::mutex> lock{m_mutex};
+		auto                        it = m_queues.find(owner);
+		if (it != m_queues.end())
+		{
+			result.swap(it->second);
+			m_queues.erase(it);
+		}
+		return result;
+	}
+
+	std::uint64_t
+	next_id()
+	{
+		return m_next_id.fetch_add(1, std::memory_order_relaxed);
+	}
+
+private:
+	biased_registry() : m_next_id{1} {}
+
+	std::mutex                                    m_mutex;
+	std::unordered_map<std::uint64_t, queue_type> m_queues;
+	std::atomic<std::uint64_t>                    m_next_id;
+};
+
+inline std::uint64_t&
+biased_thread_id()
+{
+	static thread_local std::uint64_t id{0};
+	return id;
+}
+
+/* Registers the calling thread as an owner on first use, and merges its queue at thread exit.
+ */
+class biased_owner
+{
+public:
+	static std::uint64_t
+	current()
+	{
+		static thread_local biased_owner instance;
+		return instance.m_id;
+	}
+
+	~biased_owner();
+
+private:
+	biased_owner() : m_id{biased_registry::get().next_id()}
+	{
+		biased_registry::get().add_owner(m_id);
+		biased_thread_id() = m_id;
+	}
+
+	std::uint64_t m_id;
+};
+
+}    // namespace detail
+
+/** \brief Biased reference counts, for objects that are mostly shared within one thread.
+ *
+ * The thread that creates an object owns its counts. References added and removed on the
+ * owner thread update a biased count without atomic read-modify-write operations; references
+ * added and removed on any other thread update an atomic shared count. The use count of the
+ * object is the sum of the two, and the shared count alone may be negative (for example,
+ * when a pointer copied on the owner thread is destroyed on another thread).
+ *
+ * The counts are merged, and the shared count alone becomes authoritative, when:
+ *
+ * - the biased count reaches zero on the owner thread;
+ * - the owner thread calls merge_queued(), for objects whose shared counts another thread
+ *   has driven negative (such objects are queued for the owner the first time this happens);
+ * - the owner thread exits, for objects still in its queue; or
+ * - another thread drives the shared count negative after the owner thread has exited.
+ *
+ * An object whose last reference is released on a non-owner thread, while the owner still
+ * holds biased counts for it, is destroyed when the counts are merged. Event loops that own
+ * objects should therefore call merge_queued() periodically.
+ *
+ * This class is a counting policy for util::shared_ptr (see namespace util::biased), and is
+ * only usable as the base of a control block.
+ */
+class biased_refcount
+{
+public:
+	biased_refcount() : m_owner{detail::biased_owner::current()}, m_biased{1}, m_shared{0}, m_weak_count{1} {}
+
+	long
+	increment_use()
+	{
+		long result;
+		if (owns_biased())
+		{
+			result = m_biased.load(std::memory_order_relaxed) + 1;
+			m_biased.store(result, std::memory_order_relaxed);
+		}
+		else
+		{
+			result = shared_count(m_shared.fetch_add(unit, std::memory_order_relaxed) + unit);
+		}
+		return result;
+	}
+
+	/** \brief Remove a reference.
+	 *
+	 * \return zero if the use count of the object became zero; otherwise, a positive value
+	 */
+	long
+	decrement_use()
+	{
+		long result;
+		if (owns_biased())
+		{
+			result = m_biased.load(std::memory_order_relaxed) - 1;
+			m_biased.store(result, std::memory_order_relaxed);
+			if (result == 0)
+			{
+				auto word = m_shared.fetch_or(merged_flag, std::memory_order_acq_rel);
+				result    = shared_count(word);
+			}
+		}
+		else
+		{
+			auto word = m_shared.fetch_sub(unit, std::memory_order_acq_rel) - unit;
+			if (word & merged_flag)
+			{
+				result = shared_count(word);
+			}
+			else if (shared_count(word) < 0 && !(word & queued_flag)
+					 && !(m_shared.fetch_or(queued_flag, std::memory_order_acq_rel) & queued_flag))
+			{
+				result = enqueue();
+			}
+			else
+			{
+				result = 1;    // the owner still holds biased counts
+			}
+		}
+		return result;
+	}
+
+	long
+	increment_weak()
+	{
+		return m_weak_count.fetch_add(1, std::memory_order_relaxed) + 1;
+	}
+
+	long
+	decrement_weak()
+	{
+		return m_weak_count.fetch_sub(1, std::memory_order_acq_rel) - 1;
+	}
+
+	bool
+	try_increment_use()
+	{
+		if (owns_biased())
+		{
+			m_biased.store(m_biased.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			return true;
+		}
+
+		auto word = m_shared.load(std::memory_order_relaxed);
+		while (!(word & merged_flag) || shared_count(word) > 0)
+		{
+			if (m_shared.compare_exchange_weak(
+						word, word + unit, std::memory_order_acquire, std::memory_order_relaxed))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	long
+	use_count() const
+	{
+		return m_biased.load(std::memory_order_relaxed) + shared_count(m_shared.load(std::memory_order_relaxed));
+	}
+
+	long
+	weak_count() const
+	{
+		return m_weak_count.load(std::memory_order_relaxed);
+	}
+
+	/** \brief Merge the counts of objects owned by the calling thread that were queued by other threads.
+	 *
+	 * Objects whose use counts are zero after merging are destroyed.
+	 */
+	static void
+	merge_queued()
+	{
+		auto id = detail::biased_thread_id();
+		if (id != 0)
+		{
+			release_merged(detail::biased_registry::get().take(id));
+		}
+	}
+
+protected:
+	~biased_refcount() = default;
+
+	virtual void
+	on_zero_use_count()
+			= 0;
+
+	virtual void
+	on_zero_weak_count()
+			= 0;
+
+private:
+	friend class detail::biased_owner;
+
+	using word_type = std::intptr_t;
+
+	static constexpr word_type merged_flag = 1;
+	static constexpr word_type queued_flag = 2;
+	static constexpr word_type unit        = 4;
+
+	static long
+	shared_count(word_type word)
+	{
+		return static_cast<long>((word - (word & (unit - 1))) / unit);
+	}
+
+	bool
+	owns_biased() const
+	{
+		return m_owner == detail::biased_thread_id() && m_biased.load(std::memory_order_relaxed) > 0;
+	}
+
+	/* Fold the biased count into the shared count; called on the owner thread, or after the
+	 * owner has exited. Returns true if the use count is zero.
+	 */
+	bool
+	merge()
+	{
+		auto word = m_shared.load(std::memory_order_acquire);
+		if (word & merged_flag)
+		{
+			return false;    // the owner's biased count reached zero after the object was queued
+		}
+		auto biased = m_biased.load(std::memory_order_relaxed);
+		m_biased.store(0, std::memory_order_relaxed);
+		word = m_shared.fetch_add(biased * unit + merged_flag, std::memory_order_acq_rel) + biased * unit;
+		return shared_count(word) == 0;
+	}
+
+	/* The queue holds a weak reference, so that the control block survives until the owner
+	 * merges it, even if the object is destroyed in the meantime.
+	 */
+	long
+	enqueue()
+	{
+		increment_weak();
+		if (detail::biased_registry::get().enqueue(m_owner, this))
+		{
+			return 1;
+		}
+		decrement_weak();
+		return merge() ? 0 : 1;
+	}
+
+	static void
+	release_merged(detail::biased_registry::queue_type&& queue)
+	{
+		for (auto counts : queue)
+		{
+			if (counts->merge())
+			{
+				counts->on_zero_use_count();
+			}
+			if (counts->decrement_weak() == 0)
+			{
+				counts->on_zero_weak_count();
+			}
+		}
+	}
+
+	std::uint64_t          m_owner;
+	std::atomic<long>      m_biased;
+	std::atomic<word_type> m_shared;
+	std::atomic<long>      m_weak_count;
+};
+
+inline detail::biased_owner::~biased_owner()
+{
+	biased_thread_id() = 0;
+	biased_refcount::release_merged(biased_registry::get().remove_owner(m_id));
+}
+
+#if (!UTIL_USE_STD_SHARED_PTR)
+
+/** \brief Shared pointers with biased reference counts.
+ */
+namespace biased
+{
+
+template<class T>
+using shared_ptr = util::shared_ptr<T, biased_refcount>;
+
+template<class T>
+using weak_ptr = util::weak_ptr<T, biased_refcount>;
+
+template<class T>
+using enable_shared_from_this = util::enable_shared_from_this<T, biased_refcount>;
+
+template<class T, class... Args>
+shared_ptr<T>
+make_shared(Args&&... args)
+{
+	return detail::shared_factory<biased_refcount>::make<T>(std::forward<Args>(args)...);
+}
+
+template<class T, class Alloc, class... Args>
+shared_ptr<T>
+allocate_shared(Alloc&& alloc, Args&&... args)
+{
+	return detail::shared_factory<biased_refcount>::allocate<T>(
+			std::forward<Alloc>(alloc), std::forward<Args>(args)...);
+}
+
+}    // namespace biased
+
+#endif
+
+}    // namespace util
+
+#endif    // UTIL_BIASED_REFCOUNT_H
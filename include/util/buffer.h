@@ -28,6 +28,7 @@
 #include <cassert>
 #include <cmath>
 #include <cstdint>
+#include <cstring>
 #include <deque>
 #include <functional>
 #include <iostream>
@@ -1407,7 +1408,7 @@ public:
 class shared_buffer : public buffer
 {
 protected:
-	util::shared_ptr<region> m_region;
+	region::iptr m_region;
 
 public:
 	~shared_buffer()
@@ -1453,7 +1454,7 @@ public:
 	// 	}
 	// }
 
-	shared_buffer() : m_region{util::make_shared<alloc_region<default_alloc>>()}
+	shared_buffer() : m_region{util::make_intrusive<alloc_region<default_alloc>>()}
 	{
 		m_data = nullptr;
 		m_size = 0;
@@ -1463,7 +1464,7 @@ public:
 
 	template<class _Del>
 	shared_buffer(void* data, size_type size, _Del&& del)
-		: m_region{util::make_shared<del_region<_Del>>(
+		: m_region{util::make_intrusive<del_region<_Del>>(
 				  reinterpret_cast<byte_type*>(data),
 				  size,
 				  std::forward<_Del>(del))}
@@ -1476,7 +1477,7 @@ public:
 
 	template<class _Alloc, class = typename std::enable_if_t<std::is_same<typename _Alloc::pointer, byte_type*>::value>>
 	shared_buffer(const void* data, size_type size, _Alloc&& alloc)
-		: m_region{util::make_shared<alloc_region<_Alloc>>(
+		: m_region{util::make_intrusive<alloc_region<_Alloc>>(
 				  reinterpret_cast<const byte_type*>(data),
 				  size,
 				  std::forward<_Alloc>(alloc))}
@@ -1488,7 +1489,7 @@ public:
 	}
 
 	shared_buffer(const void* data, size_type size)
-		: m_region{util::make_shared<alloc_region<default_alloc>>(reinterpret_cast<const byte_type*>(data), size)}
+		: m_region{util::make_intrusive<alloc_region<default_alloc>>(reinterpret_cast<const byte_type*>(data), size)}
 	{
 		m_data = m_region->data();
 		m_size = size;
@@ -1517,7 +1518,7 @@ public:
 
 	template<class _Alloc, class = typename std::enable_if_t<std::is_same<typename _Alloc::pointer, byte_type*>::value>>
 	shared_buffer(buffer const& rhs, _Alloc&& alloc)
-		: m_region{util::make_shared<alloc_region<_Alloc>>(rhs.data(), rhs.size(), std::forward<_Alloc>(alloc))}
+		: m_region{util::make_intrusive<alloc_region<_Alloc>>(rhs.data(), rhs.size(), std::forward<_Alloc>(alloc))}
 	{
 		m_data = m_region->data();
 		m_size = rhs.size();
@@ -1531,7 +1532,7 @@ public:
 			class = typename std::enable_if_t<
 					is_buffer_type<Buffer>::value && std::is_same<typename _Alloc::pointer, byte_type*>::value>>
 	shared_buffer(std::deque<Buffer> const& bufs, _Alloc&& alloc)
-		: m_region{util::make_shared<alloc_region<_Alloc>>(total_size(bufs), std::forward<_Alloc>(alloc))}
+		: m_region{util::make_intrusive<alloc_region<_Alloc>>(total_size(bufs), std::forward<_Alloc>(alloc))}
 	{
 		auto p = m_region->data();
 		for (auto const& buf : bufs)
@@ -1546,7 +1547,7 @@ public:
 
 	template<class Buffer, class = typename std::enable_if_t<is_buffer_type<Buffer>::value>>
 	shared_buffer(std::deque<Buffer> const& bufs)
-		: m_region{util::make_shared<alloc_region<default_alloc>>(total_size(bufs))}
+		: m_region{util::make_intrusive<alloc_region<default_alloc>>(total_size(bufs))}
 	{
 		auto p = m_region->data();
 		for (auto const& buf : bufs)
@@ -1559,7 +1560,7 @@ public:
 		ASSERT_SHARED_BUFFER_INVARIANTS(*this);
 	}
 
-	shared_buffer(buffer const& rhs) : m_region{util::make_shared<alloc_region<default_alloc>>(rhs.data(), rhs.size())}
+	shared_buffer(buffer const& rhs) : m_region{util::make_intrusive<alloc_region<default_alloc>>(rhs.data(), rhs.size())}
 	{
 		m_data = m_region->data();
 		m_size = rhs.size();
@@ -1834,7 +1835,7 @@ public:
 	shared_buffer&
 	operator=(buffer const& rhs)
 	{
-		m_region = util::make_shared<alloc_region<default_alloc>>(rhs.data(), rhs.size());
+		m_region = util::make_intrusive<alloc_region<default_alloc>>(rhs.data(), rhs.size());
 		m_data   = m_region->data();
 		m_size   = rhs.size();
 		ASSERT_SHARED_BUFFER_INVARIANTS(*this);
@@ -0,0 +1,301 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef UTIL_CANCELLATION_H
+#define UTIL_CANCELLATION_H
+
+#include <memory>
+#include <util/intrusive_ptr.h>
+#include <util/unique_function.h>
+
+namespace util
+{
+
+template<class T>
+class promise;
+
+class cancellation_source;
+class cancellation_token;
+
+namespace detail
+{
+
+struct cancellation_state;
+
+/** \brief Hook by which an object is linked into the list of a cancellation_state.
+ *
+ * A link holds a reference to the state it is bound to, even after it is unlinked, so that
+ * the binding can be inherited (see util::promise::with_cancellation()). Destroying a link
+ * unlinks it. When the state is cancelled, each link is unlinked and then \e fire is invoked
+ * with it; \e fire may destroy the link.
+ */
+struct cancellation_link
+{
+	cancellation_link() noexcept = default;
+
+	cancellation_link(cancellation_link const&) = delete;
+
+	cancellation_link&
+	operator=(cancellation_link const&) = delete;
+
+	~cancellation_link()
+	{
+		unlink();
+	}
+
+	bool
+	linked() const noexcept
+	{
+		return next != nullptr;
+	}
+
+	void
+	unlink() noexcept
+	{
+		if (next)
+		{
+			prev->next = next;
+			next->prev = prev;
+			prev       = nullptr;
+			next       = nullptr;
+		}
+	}
+
+	cancellation_link*                prev{nullptr};
+	cancellation_link*                next{nullptr};
+	void                              (*fire)(cancellation_link*){nullptr};
+	intrusive_ptr<cancellation_state> state;
+};
+
+struct cancellation_state : public intrusive_refcount<cancellation_state>
+{
+	cancellation_state() noexcept
+	{
+		head.prev = &head;
+		head.next = &head;
+	}
+
+	// link \e link at the tail; the caller checks for cancellation first
+	void
+	link(cancellation_link& link, void (*fire)(cancellation_link*)) noexcept
+	{
+		link.unlink();
+		link.fire       = fire;
+		link.prev       = head.prev;
+		link.next       = &head;
+		head.prev->next = &link;
+		head.prev       = &link;
+	}
+
+	void
+	cancel()
+	{
+		if (!cancelled)
+		{
+			cancelled = true;
+
+			// links may be unlinked or destroyed by any callback, so always start again from the head
+			while (head.next != &head)
+			{
+				auto link = head.next;
+				link->unlink();
+				link->fire(link);
+			}
+		}
+	}
+
+	bool              cancelled{false};
+	cancellation_link head;
+};
+
+struct cancellation_callback : public cancellation_link
+{
+	template<class F>
+	explicit cancellation_callback(F&& f) : func{std::forward<F>(f)}
+	{}
+
+	static void
+	invoke(cancellation_link* link)
+	{
+		// the callback may destroy its registration, and captured state should not outlive the call
+		auto func = std::move(static_cast<cancellation_callback*>(link)->func);
+		func();
+	}
+
+	unique_function<void()> func;
+};
+
+}    // namespace detail
+
+/** \brief Ownership of a callback registered with cancellation_token::on_cancel().
+ *
+ * Destroying (or resetting) the registration deregisters the callback, if it has not run.
+ */
+class cancellation_registration
+{
+public:
+	cancellation_registration() noexcept = default;
+
+	cancellation_registration(cancellation_registration&&) noexcept = default;
+
+	cancellation_registration&
+	operator=(cancellation_registration&&) noexcept = default;
+
+	void
+	reset() noexcept
+	{
+		m_callback.reset();
+	}
+
+	/** \brief Whether the callback is registered, and has not yet run.
+	 */
+	bool
+	pending() const noexcept
+	{
+		return m_callback && m_callback->linked();
+	}
+
+private:
+	friend class cancellation_token;
+
+	explicit cancellation_registration(std::unique_ptr<detail::cancellation_callback> callback) noexcept
+		: m_callback{std::move(callback)}
+	{}
+
+	std::unique_ptr<detail::cancellation_callback> m_callback;
+};
+
+/** \brief Observer of a cancellation_source.
+ *
+ * Tokens are cheap to copy; all copies observe the same source. A default-constructed token
+ * is never cancelled. Like util::promise, tokens and sources must be used on a single thread.
+ */
+class cancellation_token
+{
+public:
+	cancellation_token() noexcept = default;
+
+	/** \brief Whether the token is associated with a source (and so may be cancelled).
+	 */
+	bool
+	can_be_cancelled() const noexcept
+	{
+		return static_cast<bool>(m_state);
+	}
+
+	bool
+	is_cancelled() const noexcept
+	{
+		return m_state && m_state->cancelled;
+	}
+
+	/** \brief Invoke \e func when the source is cancelled.
+	 *
+	 * If the source is already cancelled, \e func is invoked immediately. The callback (and
+	 * anything it captures) is destroyed once it has run.
+	 *
+	 * \return a registration that deregisters the callback when destroyed
+	 */
+	template<class F>
+	cancellation_registration
+	on_cancel(F&& func) const
+	{
+		cancellation_registration result;
+		if (is_cancelled())
+		{
+			func();
+		}
+		else if (m_state)
+		{
+			auto callback = std::make_unique<detail::cancellation_callback>(std::forward<F>(func));
+			m_state->link(*callback, &detail::cancellation_callback::invoke);
+			result = cancellation_registration{std::move(callback)};
+		}
+		return result;
+	}
+
+	friend bool
+	operator==(cancellation_token const& lhs, cancellation_token const& rhs) noexcept
+	{
+		return lhs.m_state == rhs.m_state;
+	}
+
+	friend bool
+	operator!=(cancellation_token const& lhs, cancellation_token const& rhs) noexcept
+	{
+		return lhs.m_state != rhs.m_state;
+	}
+
+private:
+	friend class cancellation_source;
+
+	template<class T>
+	friend class promise;
+
+	explicit cancellation_token(intrusive_ptr<detail::cancellation_state> state) noexcept : m_state{std::move(state)}
+	{}
+
+	intrusive_ptr<detail::cancellation_state> m_state;
+};
+
+/** \brief Requests cancellation of the work observing its tokens.
+ *
+ * Cancelling runs every registered callback and cancels every bound promise (see
+ * util::promise::with_cancellation()), in the order in which they were registered. Nothing
+ * is allocated per bound promise; each promise's shared state contains its own list link.
+ * Copies of a source share its state.
+ */
+class cancellation_source
+{
+public:
+	cancellation_source() : m_state{make_intrusive<detail::cancellation_state>()} {}
+
+	cancellation_token
+	token() const noexcept
+	{
+		return cancellation_token{m_state};
+	}
+
+	bool
+	is_cancelled() const noexcept
+	{
+		return m_state->cancelled;
+	}
+
+	/** \brief Cancel the source; subsequent calls have no effect.
+	 */
+	void
+	cancel()
+	{
+		auto state = m_state;    // a callback may destroy this source
+		state->cancel();
+	}
+
+private:
+	intrusive_ptr<detail::cancellation_state> m_state;
+};
+
+}    // namespace util
+
+#endif    // UTIL_CANCELLATION_H
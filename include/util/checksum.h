@@ -0,0 +1,341 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef UTIL_CHECKSUM_H
+#define UTIL_CHECKSUM_H
+
+#include <algorithm>
+#include <boost/crc.hpp>
+#include <cassert>
+#include <cstdint>
+#include <util/types.h>
+#include <vector>
+
+#ifndef UTIL_CHECKSUM_BLOCK_SIZE
+#define UTIL_CHECKSUM_BLOCK_SIZE 4096
+#endif
+
+namespace util
+{
+
+/** \brief Selects which running checksums an output streambuf maintains.
+ *
+ * The CRC32 value is identical to that produced by buffer::checksum(). The fast
+ * checksum is Adler-32, which is considerably cheaper to compute than CRC32 and,
+ * like CRC32, can be combined across blocks without revisiting the data.
+ */
+enum class checksum_mode
+{
+	none,
+	crc32,
+	crc32_adler32
+};
+
+/** \brief Checksum values for a byte sequence.
+ */
+struct checksum_result
+{
+	checksum_type crc{0};
+	checksum_type fast{1};
+};
+
+namespace detail
+{
+
+static constexpr std::uint32_t crc32_poly  = 0xedb88320u;
+static constexpr std::uint32_t adler32_mod = 65521u;
+static constexpr std::size_t   adler32_nmax = 5552;
+
+// multiply a and b modulo the CRC32 polynomial (reflected representation)
+inline std::uint32_t
+crc32_multmodp(std::uint32_t a, std::uint32_t b)
+{
+	std::uint32_t m = std::uint32_t{1} << 31;
+	std::uint32_t p = 0;
+	for (;;)
+	{
+		if (a & m)
+		{
+			p ^= b;
+			if ((a & (m - 1)) == 0)
+			{
+				break;
+			}
+		}
+		m >>= 1;
+		b = (b & 1) ? ((b >> 1) ^ crc32_poly) : (b >> 1);
+	}
+	return p;
+}
+
+// x^(2^n) modulo the CRC32 polynomial, for n in [0, 32)
+inline std::uint32_t const*
+crc32_x2n_table()
+{
+	static std::uint32_t const* table = [] {
+		static std::uint32_t t[32];
+		std::uint32_t        p = std::uint32_t{1} << 30;    // x^1
+		t[0]                   = p;
+		for (int n = 1; n < 32; ++n)
+		{
+			t[n] = p = crc32_multmodp(p, p);
+		}
+		return t;
+	}();
+	return table;
+}
+
+// x^(n * 2^k) modulo the CRC32 polynomial
+inline std::uint32_t
+crc32_x2nmodp(std::uint64_t n, unsigned k)
+{
+	auto          table = crc32_x2n_table();
+	std::uint32_t p     = std::uint32_t{1} << 31;    // x^0 == 1
+	while (n)
+	{
+		if (n & 1)
+		{
+			p = crc32_multmodp(table[k & 31], p);
+		}
+		n >>= 1;
+		++k;
+	}
+	return p;
+}
+
+}    // namespace detail
+
+/** \brief Calculate the CRC32 value for a byte sequence.
+ *
+ * Equivalent to buffer::checksum() applied to a buffer with the same contents.
+ */
+inline checksum_type
+crc32(const void* data, size_type length)
+{
+	boost::crc_32_type crc;
+	if (data && length > 0)
+	{
+		crc.process_bytes(data, length);
+	}
+	return crc.checksum();
+}
+
+/** \brief Combine the CRC32 values of two adjacent byte sequences.
+ *
+ * \param crc1 CRC32 value of the first sequence
+ * \param crc2 CRC32 value of the second sequence
+ * \param length2 length of the second sequence, in bytes
+ * \return CRC32 value of the concatenated sequence
+ */
+inline checksum_type
+crc32_combine(checksum_type crc1, checksum_type crc2, std::uint64_t length2)
+{
+	return detail::crc32_multmodp(detail::crc32_x2nmodp(length2, 3), crc1) ^ crc2;
+}
+
+/** \brief Calculate the Adler-32 value for a byte sequence.
+ *
+ * \param data pointer to the byte sequence
+ * \param length length of the sequence, in bytes
+ * \param adler Adler-32 value of preceding bytes, if the calculation is being continued
+ * \return Adler-32 value
+ */
+inline checksum_type
+adler32(const void* data, size_type length, checksum_type adler = 1)
+{
+	std::uint32_t a = adler & 0xffff;
+	std::uint32_t b = (adler >> 16) & 0xffff;
+	auto          p = reinterpret_cast<const byte_type*>(data);
+	while (length > 0)
+	{
+		auto chunk = std::min(length, detail::adler32_nmax);
+		length -= chunk;
+		while (chunk-- > 0)
+		{
+			a += *p++;
+			b += a;
+		}
+		a %= detail::adler32_mod;
+		b %= detail::adler32_mod;
+	}
+	return (b << 16) | a;
+}
+
+/** \brief Combine the Adler-32 values of two adjacent byte sequences.
+ *
+ * \param adler1 Adler-32 value of the first sequence
+ * \param adler2 Adler-32 value of the second sequence
+ * \param length2 length of the second sequence, in bytes
+ * \return Adler-32 value of the concatenated sequence
+ */
+inline checksum_type
+adler32_combine(checksum_type adler1, checksum_type adler2, std::uint64_t length2)
+{
+	constexpr std::uint64_t base = detail::adler32_mod;
+
+	std::uint64_t rem  = length2 % base;
+	std::uint64_t sum1 = adler1 & 0xffff;
+	std::uint64_t sum2 = (rem * sum1) % base;
+	sum1 += (adler2 & 0xffff) + base - 1;
+	sum2 += ((adler1 >> 16) & 0xffff) + ((adler2 >> 16) & 0xffff) + base - rem;
+	if (sum1 >= base)
+		sum1 -= base;
+	if (sum1 >= base)
+		sum1 -= base;
+	if (sum2 >= (base << 1))
+		sum2 -= (base << 1);
+	if (sum2 >= base)
+		sum2 -= base;
+	return static_cast<checksum_type>(sum1 | (sum2 << 16));
+}
+
+/** \brief Maintains checksums over a byte sequence as a series of fixed-size blocks.
+ *
+ * Each block's checksum is calculated independently, and the checksum of the entire
+ * sequence is obtained by combining block checksums. When bytes in a block are
+ * (re)written, the owner reports the affected range by calling written(); complete blocks
+ * in that range are folded immediately (while the bytes are likely to be in cache), and
+ * a trailing partial block is marked stale and folded when the result is requested.
+ * Rewriting a region after seeking back only causes the affected blocks to be revisited.
+ */
+class block_checksum
+{
+public:
+	block_checksum(checksum_mode mode, size_type block_size) : m_mode{mode}, m_block_size{block_size}
+	{
+		assert(m_block_size > 0);
+	}
+
+	checksum_mode
+	mode() const
+	{
+		return m_mode;
+	}
+
+	size_type
+	block_size() const
+	{
+		return m_block_size;
+	}
+
+	void
+	reset()
+	{
+		m_blocks.clear();
+	}
+
+	/** \brief Report that the bytes in [begin, end) have been written.
+	 *
+	 * \param begin offset of the first byte written
+	 * \param end offset following the last byte written
+	 * \param block_data callable with signature const byte_type*(size_type index), returning
+	 * a pointer to the beginning of the block with the specified index
+	 */
+	template<class BlockData>
+	void
+	written(std::int64_t begin, std::int64_t end, BlockData&& block_data)
+	{
+		if (end <= begin)
+		{
+			return;
+		}
+		size_type first = static_cast<size_type>(begin) / m_block_size;
+		size_type full  = static_cast<size_type>(end) / m_block_size;
+		for (auto index = first; index < full; ++index)
+		{
+			update(index, block_data(index), m_block_size);
+		}
+		if ((static_cast<size_type>(end) % m_block_size) != 0)
+		{
+			invalidate(full);
+		}
+	}
+
+	/** \brief Calculate checksums for the first \e size bytes of the sequence.
+	 *
+	 * Stale blocks are folded before combining.
+	 */
+	template<class BlockData>
+	checksum_result
+	result(size_type size, BlockData&& block_data)
+	{
+		checksum_result sums;
+		size_type       nblocks = (size + m_block_size - 1) / m_block_size;
+		for (size_type index = 0; index < nblocks; ++index)
+		{
+			size_type length = std::min(m_block_size, size - (index * m_block_size));
+			if (index >= m_blocks.size() || !m_blocks[index].valid || m_blocks[index].length != length)
+			{
+				update(index, block_data(index), length);
+			}
+			auto const& blk = m_blocks[index];
+			sums.crc        = crc32_combine(sums.crc, blk.crc, length);
+			if (m_mode == checksum_mode::crc32_adler32)
+			{
+				sums.fast = adler32_combine(sums.fast, blk.fast, length);
+			}
+		}
+		return sums;
+	}
+
+private:
+	struct block_state
+	{
+		checksum_type crc{0};
+		checksum_type fast{1};
+		size_type     length{0};
+		bool          valid{false};
+	};
+
+	void
+	invalidate(size_type index)
+	{
+		if (index < m_blocks.size())
+		{
+			m_blocks[index].valid = false;
+		}
+	}
+
+	void
+	update(size_type index, const byte_type* data, size_type length)
+	{
+		if (index >= m_blocks.size())
+		{
+			m_blocks.resize(index + 1);
+		}
+		auto& blk  = m_blocks[index];
+		blk.crc    = crc32(data, length);
+		blk.fast   = (m_mode == checksum_mode::crc32_adler32) ? adler32(data, length) : 1;
+		blk.length = length;
+		blk.valid  = true;
+	}
+
+	checksum_mode            m_mode;
+	size_type                m_block_size;
+	std::vector<block_state> m_blocks;
+};
+
+}    // namespace util
+
+#endif    // UTIL_CHECKSUM_H
@@ -0,0 +1,299 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef UTIL_CORO_H
+#define UTIL_CORO_H
+
+#if !defined(__cpp_impl_coroutine)
+#error "util/coro.h requires C++20 coroutine support"
+#endif
+
+#include <coroutine>
+#include <cstddef>
+#include <optional>
+#include <system_error>
+#include <type_traits>
+#include <util/error.h>
+#include <util/pool_allocator.h>
+#include <util/promise.h>
+#include <utility>
+
+#ifndef UTIL_CORO_POOL_FRAMES
+#define UTIL_CORO_POOL_FRAMES 1
+#endif
+
+/*
+ * C++20 coroutine support for util::promise.
+ *
+ * A util::promise<T> may be awaited with co_await, which suspends the coroutine until the
+ * promise is finished. If the promise is resolved, co_await yields the value; if rejected,
+ * co_await throws std::system_error. co_await util::as_result(p) instead yields the error
+ * code (for promise<void>) or a std::pair<std::error_code, T>, and never throws.
+ *
+ * A coroutine may also return util::promise<T>. The coroutine starts eagerly, and the
+ * returned promise is resolved by co_return, or rejected if an exception escapes the body
+ * (with the exception's code, for std::system_error, or util::errc::unhandled_exception).
+ * Coroutine frames are allocated from size-classed object pools (unless
+ * UTIL_CORO_POOL_FRAMES is 0).
+ *
+ * util::promise is not thread safe; a coroutine resumes on the thread that resolves the
+ * promise it awaits.
+ */
+
+namespace util
+{
+namespace detail
+{
+
+template<std::size_t Size>
+struct alignas(std::max_align_t) coro_frame_block
+{
+	unsigned char bytes[Size];
+};
+
+template<std::size_t Size>
+using coro_frame_pool = object_pool<coro_frame_block<Size>>;
+
+// the compiler passes the same size to the sized operator delete, so no header is needed
+inline void*
+allocate_frame(std::size_t size)
+{
+#if (UTIL_CORO_POOL_FRAMES)
+	if (size <= 128)
+		return coro_frame_pool<128>::instance().allocate();
+	if (size <= 256)
+		return coro_frame_pool<256>::instance().allocate();
+	if (size <= 512)
+		return coro_frame_pool<512>::instance().allocate();
+	if (size <= 1024)
+		return coro_frame_pool<1024>::instance().allocate();
+#endif
+	return ::operator new(size);
+}
+
+inline void
+deallocate_frame(void* frame, std::size_t size) noexcept
+{
+#if (UTIL_CORO_POOL_FRAMES)
+	if (size <= 128)
+		return coro_frame_pool<128>::instance().deallocate(frame);
+	if (size <= 256)
+		return coro_frame_pool<256>::instance().deallocate(frame);
+	if (size <= 512)
+		return coro_frame_pool<512>::instance().deallocate(frame);
+	if (size <= 1024)
+		return coro_frame_pool<1024>::instance().deallocate(frame);
+#endif
+	::operator delete(frame);
+}
+
+template<class T>
+class coroutine_promise_base
+{
+public:
+	util::promise<T>
+	get_return_object()
+	{
+		return m_promise;
+	}
+
+	std::suspend_never
+	initial_suspend() noexcept
+	{
+		return {};
+	}
+
+	std::suspend_never
+	final_suspend() noexcept
+	{
+		return {};
+	}
+
+	void
+	unhandled_exception()
+	{
+		try
+		{
+			throw;
+		}
+		catch (std::system_error const& e)
+		{
+			m_promise.reject(e.code());
+		}
+		catch (...)
+		{
+			m_promise.reject(make_error_code(util::errc::unhandled_exception));
+		}
+	}
+
+	static void*
+	operator new(std::size_t size)
+	{
+		return allocate_frame(size);
+	}
+
+	static void
+	operator delete(void* frame, std::size_t size) noexcept
+	{
+		deallocate_frame(frame, size);
+	}
+
+protected:
+	util::promise<T> m_promise;
+};
+
+template<class T>
+class coroutine_promise : public coroutine_promise_base<T>
+{
+public:
+	void
+	return_value(T value)
+	{
+		this->m_promise.resolve(std::move(value));
+	}
+};
+
+template<>
+class coroutine_promise<void> : public coroutine_promise_base<void>
+{
+public:
+	void
+	return_void()
+	{
+		m_promise.resolve();
+	}
+};
+
+/** \brief Awaiter for util::promise.
+ *
+ * Callbacks are always attached in await_suspend(); if the promise is already finished, they
+ * run immediately, and await_suspend() returns false, so the coroutine is not suspended.
+ */
+template<class T, bool Throw>
+class promise_awaiter
+{
+public:
+	explicit promise_awaiter(util::promise<T> p) : m_promise{std::move(p)} {}
+
+	bool
+	await_ready() const noexcept
+	{
+		return false;
+	}
+
+	bool
+	await_suspend(std::coroutine_handle<> handle)
+	{
+		m_handle = handle;
+		if constexpr (std::is_void<T>::value)
+		{
+			m_promise.then([this]() { finish(); }, [this](std::error_code const& err) { finish(err); });
+		}
+		else
+		{
+			m_promise.then(
+					[this](T&& value) {
+						m_value.emplace(std::move(value));
+						finish();
+					},
+					[this](std::error_code const& err) { finish(err); });
+		}
+		m_suspended = !m_done;
+		return m_suspended;
+	}
+
+	decltype(auto)
+	await_resume()
+	{
+		if constexpr (Throw)
+		{
+			if (m_err)
+			{
+				throw std::system_error{m_err};
+			}
+			if constexpr (!std::is_void<T>::value)
+			{
+				return std::move(*m_value);
+			}
+		}
+		else if constexpr (std::is_void<T>::value)
+		{
+			return m_err;
+		}
+		else
+		{
+			return std::pair<std::error_code, T>{m_err, m_value ? std::move(*m_value) : T{}};
+		}
+	}
+
+private:
+	void
+	finish(std::error_code const& err = std::error_code{})
+	{
+		m_err  = err;
+		m_done = true;
+		if (m_suspended)
+		{
+			m_handle.resume();
+		}
+	}
+
+	using value_type = std::conditional_t<std::is_void<T>::value, char, T>;
+
+	util::promise<T>          m_promise;
+	std::coroutine_handle<>   m_handle;
+	std::optional<value_type> m_value;
+	std::error_code           m_err;
+	bool                      m_done{false};
+	bool                      m_suspended{false};
+};
+
+}    // namespace detail
+
+template<class T>
+inline auto
+operator co_await(promise<T> p)
+{
+	return detail::promise_awaiter<T, true>{std::move(p)};
+}
+
+/** \brief Await \e p without throwing; the result is a std::error_code (for promise<void>) or a
+ * std::pair<std::error_code, T>.
+ */
+template<class T>
+inline auto
+as_result(promise<T> p)
+{
+	return detail::promise_awaiter<T, false>{std::move(p)};
+}
+
+}    // namespace util
+
+template<class T, class... Args>
+struct std::coroutine_traits<util::promise<T>, Args...>
+{
+	using promise_type = util::detail::coroutine_promise<T>;
+};
+
+#endif    // UTIL_CORO_H
@@ -35,6 +35,10 @@ enum class errc : int
 {
 	ok = 0,
 	invalid_error_category,
+	filter_error,
+	filter_data_corrupt,
+	filter_data_truncated,
+	unhandled_exception,
 };
 
 class util_category_impl : public std::error_category
@@ -55,6 +59,14 @@ public:
 				return "success";
 			case util::errc::invalid_error_category:
 				return "error category not found in error context";
+			case util::errc::filter_error:
+				return "filter stream error";
+			case util::errc::filter_data_corrupt:
+				return "filter input data is corrupt";
+			case util::errc::filter_data_truncated:
+				return "filter input data is truncated";
+			case util::errc::unhandled_exception:
+				return "unhandled exception";
 			default:
 				return "unknown util error";
 		}
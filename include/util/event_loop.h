@@ -0,0 +1,689 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef UTIL_EVENT_LOOP_H
+#define UTIL_EVENT_LOOP_H
+
+#include <boost/predef.h>
+
+#if (BOOST_OS_LINUX)
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <system_error>
+#include <thread>
+#include <unistd.h>
+#include <util/intrusive_ptr.h>
+#include <util/timer_wheel.h>
+#include <util/unique_function.h>
+#include <vector>
+
+/*
+ * Maximum number of readiness events retrieved by a single call to epoll_wait().
+ */
+#ifndef UTIL_EVENT_LOOP_BATCH_SIZE
+#define UTIL_EVENT_LOOP_BATCH_SIZE 64
+#endif
+
+namespace util
+{
+
+/** \brief Single-threaded event loop for Linux, built on epoll.
+ *
+ * The loop multiplexes three sources of work:
+ *
+ * - file descriptor readiness, for descriptors registered with watch();
+ * - timers, kept in a util::timer_wheel on steady_clock, with a timerfd armed for the earliest
+ *   deadline (and re-armed only when an earlier deadline appears);
+ * - tasks posted with dispatch(), from any thread. A dispatch from another thread wakes the loop
+ *   through an eventfd, written at most once until the loop next drains it.
+ *
+ * Each iteration runs all dispatched tasks queued so far, fires expired timers, and then
+ * processes up to UTIL_EVENT_LOOP_BATCH_SIZE readiness events from one epoll_wait() call.
+ *
+ * dispatch(), stop() and shutdown() may be called from any thread. All other member functions,
+ * and all handlers, run on the thread that runs the loop (or, before the loop is run, on the
+ * thread that owns it). Handlers must not throw.
+ */
+class event_loop
+{
+public:
+	using clock_type    = timer_wheel::clock_type;
+	using time_point    = timer_wheel::time_point;
+	using duration      = timer_wheel::duration;
+	using timer_ptr     = timer_wheel::timer_ptr;
+	using timer_handler = timer_wheel::handler_type;
+	using task_type     = util::unique_function<void()>;
+	using io_handler    = util::unique_function<void(std::uint32_t events)>;
+
+	static constexpr int batch_size = UTIL_EVENT_LOOP_BATCH_SIZE;
+
+	/** \brief Construct a loop.
+	 *
+	 * \param timer_tick the granularity of the loop's timer wheel; since deadlines are rounded up to
+	 * a tick, this bounds how late a timer may fire (beyond wakeup latency)
+	 * \throw std::system_error if the epoll, eventfd or timerfd descriptor cannot be created
+	 */
+	explicit event_loop(duration timer_tick = std::chrono::microseconds{100});
+
+	event_loop(event_loop const&) = delete;
+	event_loop&
+	operator=(event_loop const&) = delete;
+
+	/** \brief Destroy the loop; pending timers are cancelled, and undispatched tasks are discarded.
+	 */
+	~event_loop();
+
+	/** \brief Run the loop until stop() or shutdown() is called.
+	 *
+	 * The stop request is consumed, so the loop may be run again.
+	 *
+	 * \return the number of handlers run
+	 */
+	std::size_t
+	run();
+
+	/** \brief Run the handlers that are ready, without blocking.
+	 *
+	 * \return the number of handlers run
+	 */
+	std::size_t
+	poll();
+
+	/** \brief Request that run() return; may be called from any thread.
+	 */
+	void
+	stop()
+	{
+		request(stop_requested);
+	}
+
+	/** \brief Cancel all pending timers, then stop; may be called from any thread.
+	 */
+	void
+	shutdown()
+	{
+		request(stop_requested | shutdown_requested);
+	}
+
+	/** \brief Queue a task to run on the loop's thread; may be called from any thread.
+	 */
+	void
+	dispatch(task_type task)
+	{
+		{
+			std::lock_guard<std::mutex> lock{m_mutex};
+			m_dispatched.push_back(std::move(task));
+		}
+		if (!running_in_this_thread())
+		{
+			wake();
+		}
+	}
+
+	bool
+	running_in_this_thread() const
+	{
+		return m_owner.load(std::memory_order_relaxed) == std::this_thread::get_id();
+	}
+
+	/** \brief Invoke \e handler with the ready events whenever \e fd is ready for \e events.
+	 *
+	 * \param events a mask of EPOLLIN, EPOLLOUT, EPOLLET, etc.
+	 * \param err side-effected with std::errc::file_exists if \e fd is already watched, or
+	 * the error reported by epoll_ctl()
+	 */
+	void
+	watch(int fd, std::uint32_t events, io_handler handler, std::error_code& err);
+
+	void
+	watch(int fd, std::uint32_t events, io_handler handler)
+	{
+		std::error_code err;
+		watch(fd, events, std::move(handler), err);
+		if (err)
+		{
+			throw std::system_error{err};
+		}
+	}
+
+	/** \brief Change the events for which a watched descriptor is monitored.
+	 */
+	void
+	modify(int fd, std::uint32_t events, std::error_code& err);
+
+	void
+	modify(int fd, std::uint32_t events)
+	{
+		std::error_code err;
+		modify(fd, events, err);
+		if (err)
+		{
+			throw std::system_error{err};
+		}
+	}
+
+	/** \brief Stop watching a descriptor; this may be called from the descriptor's own handler.
+	 *
+	 * The descriptor must be unwatched before it is closed.
+	 */
+	void
+	unwatch(int fd, std::error_code& err);
+
+	void
+	unwatch(int fd)
+	{
+		std::error_code err;
+		unwatch(fd, err);
+		if (err)
+		{
+			throw std::system_error{err};
+		}
+	}
+
+	timer_wheel&
+	timers()
+	{
+		return m_timers;
+	}
+
+	timer_ptr
+	create_timer()
+	{
+		return m_timers.create_timer();
+	}
+
+	void
+	start_timer(timer_ptr const& t, duration delay, timer_handler handler)
+	{
+		m_timers.start(t, delay, std::move(handler));
+	}
+
+	bool
+	cancel_timer(timer_ptr const& t)
+	{
+		return m_timers.cancel(t);
+	}
+
+	/** \brief Invoke \e handler once, after \e delay.
+	 */
+	void
+	schedule(duration delay, timer_handler handler)
+	{
+		m_timers.start(m_timers.create_timer(), delay, std::move(handler));
+	}
+
+private:
+	struct io_watch : public intrusive_refcount<io_watch>
+	{
+		io_watch(io_handler&& h, std::uint32_t g) : handler{std::move(h)}, generation{g} {}
+
+		io_handler    handler;
+		std::uint32_t generation;
+	};
+
+	static constexpr unsigned stop_requested     = 1;
+	static constexpr unsigned shutdown_requested = 2;
+
+	// epoll keys hold the descriptor and a generation, so that a stale event for a descriptor
+	// unwatched (and perhaps rewatched) earlier in the same batch is ignored; internal
+	// descriptors have generation zero
+	static std::uint64_t
+	make_key(int fd, std::uint32_t generation)
+	{
+		return (std::uint64_t{generation} << 32) | static_cast<std::uint32_t>(fd);
+	}
+
+	static std::error_code
+	last_error()
+	{
+		return std::error_code{errno, std::system_category()};
+	}
+
+	void
+	request(unsigned flags)
+	{
+		m_requests.fetch_or(flags, std::memory_order_release);
+		wake();
+	}
+
+	void
+	wake()
+	{
+		if (!m_wake_pending.exchange(true, std::memory_order_acq_rel))
+		{
+			std::uint64_t one{1};
+			while (::write(m_wakefd, &one, sizeof(one)) < 0 && errno == EINTR)
+			{}
+		}
+	}
+
+	// read the counter of an eventfd or timerfd, resetting it
+	static std::uint64_t
+	drain(int fd)
+	{
+		std::uint64_t value{0};
+		if (::read(fd, &value, sizeof(value)) != sizeof(value))
+		{
+			value = 0;
+		}
+		return value;
+	}
+
+	bool
+	has_dispatched()
+	{
+		std::lock_guard<std::mutex> lock{m_mutex};
+		return !m_dispatched.empty();
+	}
+
+	std::size_t
+	run_dispatched();
+
+	void
+	arm_timer();
+
+	std::size_t
+	process(bool block);
+
+	int                                  m_epollfd;
+	int                                  m_wakefd;
+	int                                  m_timerfd;
+	timer_wheel                          m_timers;
+	time_point                           m_armed;
+	std::vector<intrusive_ptr<io_watch>> m_watches;    // indexed by descriptor
+	std::uint32_t                        m_generation;
+	std::mutex                           m_mutex;
+	std::vector<task_type>               m_dispatched;
+	std::vector<task_type>               m_batch;
+	std::atomic<bool>                    m_wake_pending;
+	std::atomic<unsigned>                m_requests;
+	std::atomic<std::thread::id>         m_owner;
+};
+
+inline event_loop::event_loop(duration timer_tick)
+	: m_epollfd{-1},
+	  m_wakefd{-1},
+	  m_timerfd{-1},
+	  m_timers{timer_tick},
+	  m_armed{time_point::max()},
+	  m_generation{0},
+	  m_wake_pending{false},
+	  m_requests{0},
+	  m_owner{std::this_thread::get_id()}
+{
+	std::error_code err;
+	epoll_event     ev{};
+
+	m_epollfd = ::epoll_create1(EPOLL_CLOEXEC);
+	if (m_epollfd < 0)
+	{
+		err = last_error();
+		goto exit;
+	}
+
+	m_wakefd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (m_wakefd < 0)
+	{
+		err = last_error();
+		goto exit;
+	}
+	ev.events   = EPOLLIN;
+	ev.data.u64 = make_key(m_wakefd, 0);
+	if (::epoll_ctl(m_epollfd, EPOLL_CTL_ADD, m_wakefd, &ev) < 0)
+	{
+		err = last_error();
+		goto exit;
+	}
+
+	m_timerfd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (m_timerfd < 0)
+	{
+		err = last_error();
+		goto exit;
+	}
+	ev.events   = EPOLLIN;
+	ev.data.u64 = make_key(m_timerfd, 0);
+	if (::epoll_ctl(m_epollfd, EPOLL_CTL_ADD, m_timerfd, &ev) < 0)
+	{
+		err = last_error();
+		goto exit;
+	}
+
+exit:
+	if (err)
+	{
+		for (int fd : {m_timerfd, m_wakefd, m_epollfd})
+		{
+			if (fd >= 0)
+			{
+				::close(fd);
+			}
+		}
+		throw std::system_error{err};
+	}
+}
+
+inline event_loop::~event_loop()
+{
+	// cancel before anything else is torn down, since handlers may dispatch to this loop
+	m_timers.cancel_all();
+	::close(m_timerfd);
+	::close(m_wakefd);
+	::close(m_epollfd);
+}
+
+inline std::size_t
+event_loop::run()
+{
+	std::size_t count{0};
+	auto        previous = m_owner.exchange(std::this_thread::get_id(), std::memory_order_relaxed);
+
+	for (;;)
+	{
+		auto requests = m_requests.exchange(0, std::memory_order_acquire);
+		if (requests & shutdown_requested)
+		{
+			count += m_timers.cancel_all();
+		}
+		if (requests & stop_requested)
+		{
+			break;
+		}
+		count += process(true);
+	}
+
+	m_owner.store(previous, std::memory_order_relaxed);
+	return count;
+}
+
+inline std::size_t
+event_loop::poll()
+{
+	auto previous = m_owner.exchange(std::this_thread::get_id(), std::memory_order_relaxed);
+	auto count    = process(false);
+	m_owner.store(previous, std::memory_order_relaxed);
+	return count;
+}
+
+inline void
+event_loop::watch(int fd, std::uint32_t events, io_handler handler, std::error_code& err)
+{
+	err.clear();
+	epoll_event ev{};
+	auto        generation = ++m_generation;
+
+	if (generation == 0)    // zero is reserved for internal descriptors
+	{
+		generation = ++m_generation;
+	}
+
+	if (fd < 0)
+	{
+		err = std::make_error_code(std::errc::bad_file_descriptor);
+		goto exit;
+	}
+	if (static_cast<std::size_t>(fd) < m_watches.size() && m_watches[fd])
+	{
+		err = std::make_error_code(std::errc::file_exists);
+		goto exit;
+	}
+
+	ev.events   = events;
+	ev.data.u64 = make_key(fd, generation);
+	if (::epoll_ctl(m_epollfd, EPOLL_CTL_ADD, fd, &ev) < 0)
+	{
+		err = last_error();
+		goto exit;
+	}
+
+	if (static_cast<std::size_t>(fd) >= m_watches.size())
+	{
+		m_watches.resize(static_cast<std::size_t>(fd) + 1);
+	}
+	m_watches[fd] = make_intrusive<io_watch>(std::move(handler), generation);
+
+exit:
+	return;
+}
+
+inline void
+event_loop::modify(int fd, std::uint32_t events, std::error_code& err)
+{
+	err.clear();
+	epoll_event ev{};
+
+	if (fd < 0 || static_cast<std::size_t>(fd) >= m_watches.size() || !m_watches[fd])
+	{
+		err = std::make_error_code(std::errc::no_such_file_or_directory);
+		goto exit;
+	}
+
+	ev.events   = events;
+	ev.data.u64 = make_key(fd, m_watches[fd]->generation);
+	if (::epoll_ctl(m_epollfd, EPOLL_CTL_MOD, fd, &ev) < 0)
+	{
+		err = last_error();
+		goto exit;
+	}
+
+exit:
+	return;
+}
+
+inline void
+event_loop::unwatch(int fd, std::error_code& err)
+{
+	err.clear();
+
+	if (fd < 0 || static_cast<std::size_t>(fd) >= m_watches.size() || !m_watches[fd])
+	{
+		err = std::make_error_code(std::errc::no_such_file_or_directory);
+		goto exit;
+	}
+
+	if (::epoll_ctl(m_epollfd, EPOLL_CTL_DEL, fd, nullptr) < 0)
+	{
+		err = last_error();
+	}
+	m_watches[fd].reset();    // a handler in progress holds its own reference
+
+exit:
+	return;
+}
+
+inline std::size_t
+event_loop::run_dispatched()
+{
+	{
+		std::lock_guard<std::mutex> lock{m_mutex};
+		m_batch.swap(m_dispatched);
+	}
+
+	// tasks dispatched by these tasks run in the next iteration
+	auto count = m_batch.size();
+	for (auto& task : m_batch)
+	{
+		task();
+	}
+	m_batch.clear();
+	return count;
+}
+
+inline void
+event_loop::arm_timer()
+{
+	// the timerfd is only moved earlier; a deadline that has moved later causes one spurious wakeup
+	auto next = m_timers.next_deadline();
+	if (next < m_armed)
+	{
+		auto       since_epoch = next.time_since_epoch();
+		auto       seconds     = std::chrono::duration_cast<std::chrono::seconds>(since_epoch);
+		itimerspec spec{};
+		spec.it_value.tv_sec  = static_cast<time_t>(seconds.count());
+		spec.it_value.tv_nsec = static_cast<long>(std::chrono::nanoseconds{since_epoch - seconds}.count());
+		if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0)
+		{
+			spec.it_value.tv_nsec = 1;    // zero would disarm
+		}
+		::timerfd_settime(m_timerfd, TFD_TIMER_ABSTIME, &spec, nullptr);
+		m_armed = next;
+	}
+}
+
+inline std::size_t
+event_loop::process(bool block)
+{
+	std::size_t count = run_dispatched();
+	count += m_timers.advance();
+
+	int timeout{0};
+	if (block && m_requests.load(std::memory_order_acquire) == 0 && !has_dispatched())
+	{
+		arm_timer();
+		timeout = -1;
+	}
+
+	epoll_event events[batch_size];
+	int         ready = ::epoll_wait(m_epollfd, events, batch_size, timeout);
+	if (ready < 0 && errno != EINTR)
+	{
+		throw std::system_error{last_error()};
+	}
+
+	for (int i = 0; i < ready; ++i)
+	{
+		auto key = events[i].data.u64;
+		if (key == make_key(m_wakefd, 0))
+		{
+			drain(m_wakefd);
+			m_wake_pending.store(false, std::memory_order_release);
+		}
+		else if (key == make_key(m_timerfd, 0))
+		{
+			drain(m_timerfd);
+			m_armed = time_point::max();
+		}
+		else
+		{
+			auto fd         = static_cast<std::size_t>(key & 0xffffffff);
+			auto generation = static_cast<std::uint32_t>(key >> 32);
+			if (fd < m_watches.size() && m_watches[fd] && m_watches[fd]->generation == generation)
+			{
+				auto held = m_watches[fd];    // the handler may unwatch its descriptor
+				held->handler(events[i].events);
+				++count;
+			}
+		}
+	}
+
+	if (ready > 0)
+	{
+		count += m_timers.advance();
+	}
+	return count;
+}
+
+/** \brief AsyncAdapter for util::promise_timer and util::loop_executor, using an event_loop.
+ */
+class event_loop_adapter
+{
+public:
+	using loop_type         = std::shared_ptr<event_loop>;
+	using loop_param_type   = loop_type const&;
+	using timer_type        = event_loop::timer_ptr;
+	using timer_param_type  = timer_type const&;
+	using scheduled_action  = event_loop::timer_handler;
+	using dispatched_action = event_loop::task_type;
+
+	static loop_type
+	create_loop()
+	{
+		return std::make_shared<event_loop>();
+	}
+
+	static void
+	run_loop(loop_param_type loop)
+	{
+		loop->run();
+	}
+
+	static void
+	stop_loop(loop_param_type loop)
+	{
+		loop->stop();
+	}
+
+	static void
+	shutdown_loop(loop_param_type loop)
+	{
+		loop->shutdown();
+	}
+
+	static timer_type
+	create_timer(loop_param_type loop)
+	{
+		return loop->create_timer();
+	}
+
+	static void
+	start_timer(timer_param_type timer, std::chrono::milliseconds ms, scheduled_action action)
+	{
+		timer->wheel()->start(timer, ms, std::move(action));
+	}
+
+	static void
+	cancel_timer(timer_param_type timer)
+	{
+		if (timer->pending())
+		{
+			timer->wheel()->cancel(timer);
+		}
+	}
+
+	static void
+	schedule(loop_param_type loop, std::chrono::milliseconds ms, scheduled_action action)
+	{
+		loop->schedule(ms, std::move(action));
+	}
+
+	static void
+	dispatch(loop_param_type loop, dispatched_action action)
+	{
+		loop->dispatch(std::move(action));
+	}
+};
+
+}    // namespace util
+
+#endif    // BOOST_OS_LINUX
+
+#endif    // UTIL_EVENT_LOOP_H
@@ -0,0 +1,224 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef UTIL_EXECUTOR_H
+#define UTIL_EXECUTOR_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <util/unique_function.h>
+#include <utility>
+#include <vector>
+
+namespace util
+{
+
+/*
+ * An executor is a lightweight, copyable handle with a member function
+ *
+ *     void post(F&& f);
+ *
+ * that arranges for the nullary callable f to be invoked exactly once, either immediately
+ * or later, on some thread chosen by the executor. Executors are passed and stored by
+ * value, so a handle to a shared resource (a loop, a thread pool) should be cheap to copy.
+ * An executor used with util::mt::promise must accept post() calls from any thread.
+ *
+ * util::promise is not thread safe, so its then_on(), catcher_on() and finally_on() only
+ * accept executors that run work on the thread that owns the promise chain (inline_executor,
+ * or a loop_executor for the chain's own loop); these declare a static constexpr bool member
+ * runs_on_calling_thread. To move a stage to a thread_pool, use the three-argument then_on(),
+ * which hands the result back to the chain's loop, or util::mt::promise.
+ */
+
+/** \brief True if Executor declares that it runs work on the thread that owns the promise chain.
+ */
+template<class Executor, class = void>
+struct runs_on_calling_thread : std::false_type
+{};
+
+template<class Executor>
+struct runs_on_calling_thread<Executor, std::enable_if_t<Executor::runs_on_calling_thread>> : std::true_type
+{};
+
+/** \brief Executor that invokes work immediately, on the calling thread.
+ */
+class inline_executor
+{
+public:
+	static constexpr bool runs_on_calling_thread = true;
+
+	template<class F>
+	void
+	post(F&& f) const
+	{
+		std::forward<F>(f)();
+	}
+};
+
+/** \brief Executor that dispatches work to an event loop.
+ *
+ * Work is queued with AsyncAdapter::dispatch(), and runs on a later iteration of the loop,
+ * after the currently executing handler returns.
+ */
+template<class AsyncAdapter>
+class loop_executor
+{
+public:
+	using async_io          = AsyncAdapter;
+	using loop_type         = typename async_io::loop_type;
+	using dispatched_action = typename async_io::dispatched_action;
+
+	static constexpr bool runs_on_calling_thread = true;
+
+	explicit loop_executor(loop_type loop) : m_loop{std::move(loop)} {}
+
+	template<class F>
+	void
+	post(F&& f) const
+	{
+		async_io::dispatch(m_loop, dispatched_action{std::forward<F>(f)});
+	}
+
+	loop_type const&
+	loop() const
+	{
+		return m_loop;
+	}
+
+private:
+	loop_type m_loop;
+};
+
+/** \brief Fixed-size pool of threads that run work from a shared queue.
+ *
+ * Work posted before the pool is destroyed is run before the destructor returns.
+ */
+class thread_pool
+{
+public:
+	using task_type = util::unique_function<void()>;
+
+	class executor_type
+	{
+	public:
+		template<class F>
+		void
+		post(F&& f) const
+		{
+			m_pool->post(std::forward<F>(f));
+		}
+
+	private:
+		friend class thread_pool;
+
+		explicit executor_type(thread_pool* pool) : m_pool{pool} {}
+
+		thread_pool* m_pool;
+	};
+
+	explicit thread_pool(std::size_t threads = std::thread::hardware_concurrency()) : m_stopping{false}
+	{
+		threads = std::max(threads, std::size_t{1});
+		m_threads.reserve(threads);
+		for (std::size_t i = 0; i < threads; ++i)
+		{
+			m_threads.emplace_back([this]() { run(); });
+		}
+	}
+
+	thread_pool(thread_pool const&) = delete;
+	thread_pool&
+	operator=(thread_pool const&) = delete;
+
+	~thread_pool()
+	{
+		{
+			std::lock_guard<std::mutex> lock{m_mutex};
+			m_stopping = true;
+		}
+		m_cond.notify_all();
+		for (auto& thread : m_threads)
+		{
+			thread.join();
+		}
+	}
+
+	template<class F>
+	void
+	post(F&& f)
+	{
+		{
+			std::lock_guard<std::mutex> lock{m_mutex};
+			m_queue.emplace_back(std::forward<F>(f));
+		}
+		m_cond.notify_one();
+	}
+
+	executor_type
+	executor()
+	{
+		return executor_type{this};
+	}
+
+	std::size_t
+	size() const
+	{
+		return m_threads.size();
+	}
+
+private:
+	void
+	run()
+	{
+		for (;;)
+		{
+			task_type task;
+			{
+				std::unique_lock<std::mutex> lock{m_mutex};
+				m_cond.wait(lock, [this]() { return m_stopping || !m_queue.empty(); });
+				if (m_queue.empty())
+				{
+					return;
+				}
+				task = std::move(m_queue.front());
+				m_queue.pop_front();
+			}
+			task();
+		}
+	}
+
+	std::mutex               m_mutex;
+	std::condition_variable  m_cond;
+	std::deque<task_type>    m_queue;
+	std::vector<std::thread> m_threads;
+	bool                     m_stopping;
+};
+
+}    // namespace util
+
+#endif    // UTIL_EXECUTOR_H
@@ -0,0 +1,979 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef UTIL_FILTER_H
+#define UTIL_FILTER_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <streambuf>
+#include <system_error>
+#include <util/buffer.h>
+#include <util/error.h>
+#include <vector>
+#include <zlib.h>
+
+#ifndef UTIL_FILTER_DEFAULT_SEGMENT_SIZE
+#define UTIL_FILTER_DEFAULT_SEGMENT_SIZE 16384
+#endif
+
+namespace util
+{
+
+/** \brief Destination for the output of a filter.
+ *
+ * Filters write directly into memory owned by the sink: prepare() exposes a writable
+ * window, and commit() declares how many bytes of the window were used.
+ */
+class segment_sink
+{
+public:
+	virtual ~segment_sink() {}
+
+	/** \brief Obtain a writable window of at least one byte.
+	 *
+	 * \param available side-effected with the size of the window
+	 * \param err side-effected with an error code if the window could not be provided
+	 * \return pointer to the window, or nullptr if an error occurred
+	 */
+	virtual byte_type*
+	prepare(size_type& available, std::error_code& err)
+			= 0;
+
+	/** \brief Declare that the first \e n bytes of the most recently prepared window were written.
+	 */
+	virtual void
+	commit(size_type n)
+			= 0;
+};
+
+/** \brief Segment sink that accumulates output in a queue of mutable_buffer segments.
+ *
+ * The segment queue has the same form as that produced by omemqbuf::release_buffer(), and
+ * can be moved into an imemqbuf for reading.
+ */
+class segment_queue_sink : public segment_sink
+{
+public:
+	using buffer_type = std::deque<util::mutable_buffer>;
+
+	segment_queue_sink(size_type alloc_size = UTIL_FILTER_DEFAULT_SEGMENT_SIZE)
+		: m_factory{std::make_unique<util::mutable_buffer_alloc_factory<>>(alloc_size)}, m_size{0}
+	{}
+
+	segment_queue_sink(std::unique_ptr<mutable_buffer_factory>&& factory) : m_factory{std::move(factory)}, m_size{0} {}
+
+	virtual byte_type*
+	prepare(size_type& available, std::error_code& err) override
+	{
+		err.clear();
+		byte_type* result{nullptr};
+		available = 0;
+		try
+		{
+			if (m_buf.empty() || m_buf.back().size() >= m_buf.back().capacity())
+			{
+				m_buf.emplace_back(m_factory->create());
+			}
+			auto& segment = m_buf.back();
+			available     = segment.capacity() - segment.size();
+			result        = segment.data() + segment.size();
+		}
+		catch (std::bad_alloc const&)
+		{
+			err = make_error_code(std::errc::not_enough_memory);
+		}
+		return result;
+	}
+
+	virtual void
+	commit(size_type n) override
+	{
+		assert(!m_buf.empty());
+		auto& segment = m_buf.back();
+		assert(segment.size() + n <= segment.capacity());
+		segment.size(segment.size() + n);
+		m_size += n;
+	}
+
+	/** \brief Total number of bytes committed to the sink.
+	 */
+	size_type
+	size() const
+	{
+		return m_size;
+	}
+
+	buffer_type const&
+	get_buffer() const
+	{
+		return m_buf;
+	}
+
+	buffer_type
+	release_buffer()
+	{
+		m_size = 0;
+		return std::move(m_buf);
+	}
+
+	/** \brief Remove and return the oldest segment.
+	 *
+	 * \return the oldest segment; if there are no segments, the result is empty
+	 */
+	util::mutable_buffer
+	pop_front()
+	{
+		util::mutable_buffer result;
+		if (!m_buf.empty())
+		{
+			result = std::move(m_buf.front());
+			m_buf.pop_front();
+			m_size -= result.size();
+		}
+		return result;
+	}
+
+	std::size_t
+	segment_count() const
+	{
+		return m_buf.size();
+	}
+
+private:
+	std::unique_ptr<mutable_buffer_factory> m_factory;
+	buffer_type                             m_buf;
+	size_type                               m_size;
+};
+
+/** \brief A single transformation stage.
+ *
+ * A filter consumes input incrementally with write(), emitting any output it is able
+ * to produce into the sink. Calling finish() signals the end of the input; the filter
+ * emits any remaining output. After finish(), reset() prepares the filter for a new stream.
+ */
+class filter
+{
+public:
+	virtual ~filter() {}
+
+	virtual void
+	write(const byte_type* data, size_type length, segment_sink& out, std::error_code& err)
+			= 0;
+
+	virtual void
+	finish(segment_sink& out, std::error_code& err)
+			= 0;
+
+	virtual void
+	reset()
+			= 0;
+};
+
+/** \brief A filter that copies its input unchanged.
+ *
+ * Primarily useful for measuring the overhead of the filter framework itself.
+ */
+class pass_through_filter : public filter
+{
+public:
+	virtual void
+	write(const byte_type* data, size_type length, segment_sink& out, std::error_code& err) override
+	{
+		err.clear();
+		while (length > 0)
+		{
+			size_type  available{0};
+			byte_type* window = out.prepare(available, err);
+			if (err)
+			{
+				goto exit;
+			}
+			auto chunk = std::min(available, length);
+			std::memcpy(window, data, chunk);
+			out.commit(chunk);
+			data += chunk;
+			length -= chunk;
+		}
+	exit:
+		return;
+	}
+
+	virtual void
+	finish(segment_sink&, std::error_code& err) override
+	{
+		err.clear();
+	}
+
+	virtual void
+	reset() override
+	{}
+};
+
+namespace detail
+{
+
+inline std::error_code
+zlib_error_code(int status)
+{
+	switch (status)
+	{
+		case Z_OK:
+		case Z_STREAM_END:
+			return std::error_code{};
+		case Z_MEM_ERROR:
+			return make_error_code(std::errc::not_enough_memory);
+		case Z_DATA_ERROR:
+		case Z_NEED_DICT:
+			return make_error_code(util::errc::filter_data_corrupt);
+		default:
+			return make_error_code(util::errc::filter_error);
+	}
+}
+
+/** \brief Common driver for zlib deflate and inflate streams.
+ *
+ * Policy provides the static members init(z_stream&), process(z_stream&, int flush),
+ * reset(z_stream&) and end(z_stream&).
+ */
+template<class Policy>
+class zlib_filter : public filter
+{
+public:
+	zlib_filter(int param) : m_param{param}, m_initialized{false}, m_stream_end{false}
+	{
+		std::memset(&m_strm, 0, sizeof(m_strm));
+	}
+
+	zlib_filter(zlib_filter const&) = delete;
+	zlib_filter&
+	operator=(zlib_filter const&) = delete;
+
+	virtual ~zlib_filter()
+	{
+		if (m_initialized)
+		{
+			Policy::end(m_strm);
+		}
+	}
+
+	virtual void
+	reset() override
+	{
+		if (m_initialized)
+		{
+			Policy::reset(m_strm);
+		}
+		m_stream_end = false;
+	}
+
+protected:
+	void
+	init(std::error_code& err)
+	{
+		err.clear();
+		if (!m_initialized)
+		{
+			int status = Policy::init(m_strm, m_param);
+			if (status != Z_OK)
+			{
+				err = zlib_error_code(status);
+				goto exit;
+			}
+			m_initialized = true;
+		}
+	exit:
+		return;
+	}
+
+	/** \brief Run the stream until the input is consumed (or, when finishing, until the stream ends).
+	 */
+	void
+	run(const byte_type* data, size_type length, int flush, segment_sink& out, std::error_code& err)
+	{
+		// avail_in is a uInt, so inputs larger than that are fed to zlib in chunks
+		size_type pending = length;
+
+		init(err);
+		if (err)
+			goto exit;
+
+		m_strm.next_in  = const_cast<Bytef*>(reinterpret_cast<const Bytef*>(data));
+		m_strm.avail_in = 0;
+
+		while (!m_stream_end && (m_strm.avail_in > 0 || pending > 0 || flush == Z_FINISH))
+		{
+			if (m_strm.avail_in == 0 && pending > 0)
+			{
+				m_strm.avail_in = static_cast<uInt>(std::min<size_type>(pending, std::numeric_limits<uInt>::max()));
+				pending -= m_strm.avail_in;
+			}
+
+			size_type  available{0};
+			byte_type* window = out.prepare(available, err);
+			if (err)
+				goto exit;
+
+			m_strm.next_out  = reinterpret_cast<Bytef*>(window);
+			m_strm.avail_out = static_cast<uInt>(std::min<size_type>(available, std::numeric_limits<uInt>::max()));
+			auto window_size = m_strm.avail_out;
+
+			int status = Policy::process(m_strm, flush);
+
+			out.commit(window_size - m_strm.avail_out);
+
+			if (status == Z_STREAM_END)
+			{
+				m_stream_end = true;
+			}
+			else if (status == Z_BUF_ERROR)
+			{
+				if (m_strm.avail_out > 0)
+				{
+					// no progress possible without more input
+					if (flush == Z_FINISH)
+					{
+						err = make_error_code(util::errc::filter_data_truncated);
+					}
+					goto exit;
+				}
+			}
+			else if (status != Z_OK)
+			{
+				err = zlib_error_code(status);
+				goto exit;
+			}
+		}
+
+	exit:
+		m_strm.next_in  = nullptr;
+		m_strm.avail_in = 0;
+		return;
+	}
+
+	z_stream m_strm;
+	int      m_param;
+	bool     m_initialized;
+	bool     m_stream_end;
+};
+
+struct deflate_policy
+{
+	static int
+	init(z_stream& strm, int level)
+	{
+		return deflateInit(&strm, level);
+	}
+
+	static int
+	process(z_stream& strm, int flush)
+	{
+		return deflate(&strm, flush);
+	}
+
+	static int
+	reset(z_stream& strm)
+	{
+		return deflateReset(&strm);
+	}
+
+	static int
+	end(z_stream& strm)
+	{
+		return deflateEnd(&strm);
+	}
+};
+
+struct inflate_policy
+{
+	static int
+	init(z_stream& strm, int)
+	{
+		return inflateInit(&strm);
+	}
+
+	static int
+	process(z_stream& strm, int flush)
+	{
+		return inflate(&strm, flush);
+	}
+
+	static int
+	reset(z_stream& strm)
+	{
+		return inflateReset(&strm);
+	}
+
+	static int
+	end(z_stream& strm)
+	{
+		return inflateEnd(&strm);
+	}
+};
+
+}    // namespace detail
+
+/** \brief Compresses its input in zlib format.
+ */
+class deflate_filter : public detail::zlib_filter<detail::deflate_policy>
+{
+public:
+	deflate_filter(int level = Z_DEFAULT_COMPRESSION) : zlib_filter{level} {}
+
+	virtual void
+	write(const byte_type* data, size_type length, segment_sink& out, std::error_code& err) override
+	{
+		run(data, length, Z_NO_FLUSH, out, err);
+	}
+
+	virtual void
+	finish(segment_sink& out, std::error_code& err) override
+	{
+		run(nullptr, 0, Z_FINISH, out, err);
+	}
+};
+
+/** \brief Decompresses zlib-format input.
+ *
+ * Input following the end of the compressed stream is ignored. If finish() is called before
+ * the end of the compressed stream has been seen, util::errc::filter_data_truncated results.
+ */
+class inflate_filter : public detail::zlib_filter<detail::inflate_policy>
+{
+public:
+	inflate_filter() : zlib_filter{0} {}
+
+	virtual void
+	write(const byte_type* data, size_type length, segment_sink& out, std::error_code& err) override
+	{
+		run(data, length, Z_NO_FLUSH, out, err);
+	}
+
+	virtual void
+	finish(segment_sink& out, std::error_code& err) override
+	{
+		run(nullptr, 0, Z_FINISH, out, err);
+		if (!err && !m_stream_end)
+		{
+			err = make_error_code(util::errc::filter_data_truncated);
+		}
+	}
+};
+
+/** \brief A sequence of filters, applied in order.
+ *
+ * Output of each stage is collected in a staging segment; when the segment fills it is
+ * passed to the next stage, so no stage's complete output is ever materialized. An empty
+ * chain copies its input to the sink.
+ */
+class filter_chain
+{
+private:
+	class stage_sink : public segment_sink
+	{
+	public:
+		stage_sink(filter_chain* chain, std::size_t index, size_type stage_size)
+			: m_chain{chain}, m_index{index}, m_segment{stage_size}
+		{}
+
+		virtual byte_type*
+		prepare(size_type& available, std::error_code& err) override
+		{
+			err.clear();
+			byte_type* result{nullptr};
+			if (m_segment.size() >= m_segment.capacity())
+			{
+				flush(err);
+				if (err)
+					goto exit;
+			}
+			available = m_segment.capacity() - m_segment.size();
+			result    = m_segment.data() + m_segment.size();
+		exit:
+			return result;
+		}
+
+		virtual void
+		commit(size_type n) override
+		{
+			m_segment.size(m_segment.size() + n);
+		}
+
+		void
+		flush(std::error_code& err)
+		{
+			err.clear();
+			if (m_segment.size() > 0)
+			{
+				auto next = m_index + 1;
+				m_chain->m_stages[next]->write(m_segment.data(), m_segment.size(), m_chain->sink_for(next), err);
+				m_segment.size(0);
+			}
+		}
+
+		void
+		clear()
+		{
+			m_segment.size(0);
+		}
+
+		void
+		rebind(filter_chain* chain)
+		{
+			m_chain = chain;
+		}
+
+	private:
+		filter_chain*        m_chain;
+		std::size_t          m_index;
+		util::mutable_buffer m_segment;
+	};
+
+public:
+	filter_chain(size_type stage_size = UTIL_FILTER_DEFAULT_SEGMENT_SIZE) : m_stage_size{stage_size}, m_out{nullptr}
+	{}
+
+	filter_chain(filter_chain&& rhs)
+		: m_stage_size{rhs.m_stage_size},
+		  m_stages{std::move(rhs.m_stages)},
+		  m_links{std::move(rhs.m_links)},
+		  m_out{nullptr}
+	{
+		for (auto& link : m_links)
+		{
+			link->rebind(this);
+		}
+	}
+
+	filter_chain&
+	push_back(std::unique_ptr<filter>&& f)
+	{
+		if (!m_stages.empty())
+		{
+			m_links.emplace_back(std::make_unique<stage_sink>(this, m_stages.size() - 1, m_stage_size));
+		}
+		m_stages.emplace_back(std::move(f));
+		return *this;
+	}
+
+	template<class Filter, class... Args>
+	filter_chain&
+	emplace_back(Args&&... args)
+	{
+		return push_back(std::make_unique<Filter>(std::forward<Args>(args)...));
+	}
+
+	std::size_t
+	size() const
+	{
+		return m_stages.size();
+	}
+
+	void
+	write(const byte_type* data, size_type length, segment_sink& out, std::error_code& err)
+	{
+		m_out = &out;
+		if (m_stages.empty())
+		{
+			pass_through_filter{}.write(data, length, out, err);
+		}
+		else
+		{
+			m_stages.front()->write(data, length, sink_for(0), err);
+		}
+	}
+
+	void
+	write(const byte_type* data, size_type length, segment_sink& out)
+	{
+		std::error_code err;
+		write(data, length, out, err);
+		if (err)
+		{
+			throw std::system_error{err};
+		}
+	}
+
+	void
+	write(buffer const& segment, segment_sink& out, std::error_code& err)
+	{
+		write(segment.data(), segment.size(), out, err);
+	}
+
+	void
+	write(buffer const& segment, segment_sink& out)
+	{
+		write(segment.data(), segment.size(), out);
+	}
+
+	/** \brief Filter a sequence of segments, such as those released by omemqbuf.
+	 */
+	template<class Buffer>
+	void
+	write(std::deque<Buffer> const& segments, segment_sink& out, std::error_code& err)
+	{
+		err.clear();
+		for (auto const& segment : segments)
+		{
+			write(segment.data(), segment.size(), out, err);
+			if (err)
+				goto exit;
+		}
+	exit:
+		return;
+	}
+
+	template<class Buffer>
+	void
+	write(std::deque<Buffer> const& segments, segment_sink& out)
+	{
+		std::error_code err;
+		write(segments, out, err);
+		if (err)
+		{
+			throw std::system_error{err};
+		}
+	}
+
+	/** \brief Signal the end of input, finishing each stage in order.
+	 */
+	void
+	finish(segment_sink& out, std::error_code& err)
+	{
+		err.clear();
+		m_out = &out;
+		for (std::size_t i = 0; i < m_stages.size(); ++i)
+		{
+			m_stages[i]->finish(sink_for(i), err);
+			if (err)
+				goto exit;
+			if (i < m_links.size())
+			{
+				m_links[i]->flush(err);
+				if (err)
+					goto exit;
+			}
+		}
+	exit:
+		return;
+	}
+
+	void
+	finish(segment_sink& out)
+	{
+		std::error_code err;
+		finish(out, err);
+		if (err)
+		{
+			throw std::system_error{err};
+		}
+	}
+
+	void
+	reset()
+	{
+		for (auto& stage : m_stages)
+		{
+			stage->reset();
+		}
+		for (auto& link : m_links)
+		{
+			link->clear();
+		}
+	}
+
+private:
+	segment_sink&
+	sink_for(std::size_t index)
+	{
+		assert(m_out != nullptr);
+		return (index < m_links.size()) ? static_cast<segment_sink&>(*m_links[index]) : *m_out;
+	}
+
+	size_type                                m_stage_size;
+	std::vector<std::unique_ptr<filter>>     m_stages;
+	std::vector<std::unique_ptr<stage_sink>> m_links;    // m_links[i] connects stage i to stage i + 1
+	segment_sink*                            m_out;
+};
+
+/** \brief Output streambuf that passes written data through a filter chain.
+ *
+ * Data is collected in a single segment; each time the segment fills it is sealed, passed
+ * through the chain and reused, so memory use is bounded by the segment size regardless of
+ * the amount written. Output of the chain accumulates in a segment queue, which is obtained
+ * with release_buffer() (typically to construct an imemqbuf). The streambuf is not seekable.
+ */
+class ofilterbuf : public std::streambuf
+{
+public:
+	using buffer_type = segment_queue_sink::buffer_type;
+
+	ofilterbuf(filter_chain&& chain, size_type alloc_size = UTIL_FILTER_DEFAULT_SEGMENT_SIZE)
+		: m_chain{std::move(chain)}, m_segment{alloc_size}, m_out{alloc_size}, m_finished{false}
+	{
+		reset_ptrs();
+		pubimbue(std::locale::classic());
+	}
+
+	/** \brief Finish the chain and release the output segments.
+	 */
+	buffer_type
+	release_buffer(std::error_code& err)
+	{
+		err = m_err;
+		if (err)
+			goto exit;
+
+		seal(err);
+		if (err)
+			goto exit;
+
+		if (!m_finished)
+		{
+			m_chain.finish(m_out, err);
+			if (err)
+				goto exit;
+			m_finished = true;
+			// no put area, so later writes reach overflow()/xsputn() and fail
+			setp(nullptr, nullptr);
+		}
+	exit:
+		return m_out.release_buffer();
+	}
+
+	buffer_type
+	release_buffer()
+	{
+		std::error_code err;
+		auto            result = release_buffer(err);
+		if (err)
+		{
+			throw std::system_error{err};
+		}
+		return result;
+	}
+
+	/** \brief The first error encountered while filtering, if any.
+	 *
+	 * Errors that occur while the streambuf is being written cause the associated stream
+	 * to go bad; this reports the cause.
+	 */
+	std::error_code
+	error() const
+	{
+		return m_err;
+	}
+
+	/** \brief Total number of bytes written to the streambuf (before filtering).
+	 */
+	size_type
+	position() const
+	{
+		return m_sealed + (pptr() - pbase());
+	}
+
+protected:
+	void
+	reset_ptrs()
+	{
+		char_type* base = reinterpret_cast<char_type*>(m_segment.data());
+		setp(base, base + m_segment.capacity());
+	}
+
+	void
+	seal(std::error_code& err)
+	{
+		err.clear();
+		size_type length = pptr() - pbase();
+		if (length > 0)
+		{
+			m_chain.write(m_segment.data(), length, m_out, err);
+			m_sealed += length;
+			reset_ptrs();
+		}
+	}
+
+	virtual std::streamsize
+	xsputn(const char_type* src, std::streamsize n) override
+	{
+		if (m_err || m_finished)
+			return 0;
+
+		std::streamsize remaining = n;
+		while (remaining > 0)
+		{
+			if (pptr() >= epptr())
+			{
+				seal(m_err);
+				if (m_err)
+					break;
+			}
+			std::streamsize chunk = std::min<std::streamsize>(remaining, epptr() - pptr());
+			std::memcpy(pptr(), src, chunk);
+			pbump(static_cast<int>(chunk));
+			src += chunk;
+			remaining -= chunk;
+		}
+		return n - remaining;
+	}
+
+	virtual int_type
+	overflow(int_type ch = traits_type::eof()) override
+	{
+		int_type result = traits_type::not_eof(ch);
+		if (m_err || m_finished)
+		{
+			result = traits_type::eof();
+		}
+		else if (!traits_type::eq_int_type(ch, traits_type::eof()))
+		{
+			if (pptr() >= epptr())
+			{
+				seal(m_err);
+			}
+			if (m_err)
+			{
+				result = traits_type::eof();
+			}
+			else
+			{
+				*pptr() = ch;
+				pbump(1);
+			}
+		}
+		return result;
+	}
+
+	filter_chain         m_chain;
+	util::mutable_buffer m_segment;
+	segment_queue_sink   m_out;
+	size_type            m_sealed{0};
+	bool                 m_finished;
+	std::error_code      m_err;
+};
+
+/** \brief Input streambuf that reads a segment sequence through a filter chain.
+ *
+ * Source segments are filtered on demand: underflow() passes source segments through the
+ * chain only until a filtered segment is available, so the source is never decoded in its
+ * entirety ahead of the reader. Filtering errors are reported by error() and appear to the
+ * reader as end of file.
+ */
+class ifilterbuf : public std::streambuf
+{
+public:
+	using source_type = std::deque<util::const_buffer>;
+
+	ifilterbuf(filter_chain&& chain, source_type&& source, size_type alloc_size = UTIL_FILTER_DEFAULT_SEGMENT_SIZE)
+		: m_chain{std::move(chain)}, m_source{std::move(source)}, m_out{alloc_size}, m_finished{false}
+	{
+		setg(nullptr, nullptr, nullptr);
+		pubimbue(std::locale::classic());
+	}
+
+	ifilterbuf(filter_chain&& chain, std::deque<util::mutable_buffer>&& source,
+			   size_type alloc_size = UTIL_FILTER_DEFAULT_SEGMENT_SIZE)
+		: ifilterbuf{std::move(chain), to_source(std::move(source)), alloc_size}
+	{}
+
+	std::error_code
+	error() const
+	{
+		return m_err;
+	}
+
+protected:
+	static source_type
+	to_source(std::deque<util::mutable_buffer>&& segments)
+	{
+		source_type result;
+		for (auto& segment : segments)
+		{
+			result.emplace_back(std::move(segment));
+		}
+		segments.clear();
+		return result;
+	}
+
+	bool
+	next_segment()
+	{
+		bool result{false};
+		while (!m_err)
+		{
+			if (m_out.segment_count() > 1 || (m_finished && m_out.segment_count() > 0))
+			{
+				m_current = m_out.pop_front();
+				if (m_current.size() > 0)
+				{
+					char_type* base = reinterpret_cast<char_type*>(m_current.data());
+					setg(base, base, base + m_current.size());
+					result = true;
+					break;
+				}
+			}
+			else if (!m_source.empty())
+			{
+				m_chain.write(m_source.front(), m_out, m_err);
+				m_source.pop_front();
+			}
+			else if (!m_finished)
+			{
+				m_chain.finish(m_out, m_err);
+				m_finished = true;
+			}
+			else
+			{
+				break;
+			}
+		}
+		return result;
+	}
+
+	virtual int_type
+	underflow() override
+	{
+		int_type result = traits_type::eof();
+		if (gptr() < egptr() || next_segment())
+		{
+			result = traits_type::to_int_type(*gptr());
+		}
+		return result;
+	}
+
+	filter_chain         m_chain;
+	source_type          m_source;
+	segment_queue_sink   m_out;
+	util::mutable_buffer m_current;
+	bool                 m_finished;
+	std::error_code      m_err;
+};
+
+}    // namespace util
+
+#endif    // UTIL_FILTER_H
@@ -0,0 +1,363 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef UTIL_FORMAT_H
+#define UTIL_FORMAT_H
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <util/types.h>
+
+namespace util
+{
+
+/** \brief Text formatter that writes directly into a sink's storage.
+ *
+ * Numbers are converted with std::to_chars, so formatting is locale-independent and
+ * floating point values are written in the shortest form that round-trips. The formatter
+ * reserves the maximum space a conversion can require with the sink's prepare(), converts
+ * in place, and commits only the bytes actually produced; no per-character virtual calls
+ * are made.
+ *
+ * Sink may be omembuf, omemqbuf, membuf_sink, memqbuf_sink, or any type that provides:
+ *
+ *     byte_type* prepare(size_type n);    // nullptr if n contiguous bytes are unavailable
+ *     void commit(size_type n);
+ *     void put(char c);
+ *     void putn(const void* src, size_type n);
+ *
+ * When prepare() fails (for example, when a conversion would straddle omemqbuf segments),
+ * the conversion is performed in a local buffer and written with putn().
+ */
+template<class Sink>
+class formatter
+{
+public:
+	static constexpr std::size_t max_integer_size  = 66;    // 64 binary digits, sign, slack
+	static constexpr std::size_t max_floating_size = 32;    // shortest round-trip double
+	static constexpr int         max_precision     = 64;
+
+	explicit formatter(Sink& sink) : m_sink{sink} {}
+
+	Sink&
+	sink()
+	{
+		return m_sink;
+	}
+
+	formatter&
+	put(char c)
+	{
+		m_sink.put(c);
+		return *this;
+	}
+
+	formatter&
+	write(std::string_view s)
+	{
+		m_sink.putn(s.data(), s.size());
+		return *this;
+	}
+
+	template<class T, class = std::enable_if_t<std::is_integral<T>::value>>
+	formatter&
+	integer(T value, int base = 10)
+	{
+		return emit(max_integer_size, [=](char* first, char* last) {
+			return std::to_chars(first, last, value, base).ptr;
+		});
+	}
+
+	/** \brief Write a floating point value in the shortest form that round-trips.
+	 */
+	formatter&
+	floating(double value)
+	{
+		return emit(max_floating_size, [=](char* first, char* last) { return std::to_chars(first, last, value).ptr; });
+	}
+
+	/** \brief Write a floating point value in fixed notation with the specified precision.
+	 */
+	formatter&
+	fixed(double value, int precision)
+	{
+		precision = std::min(std::max(precision, 0), max_precision);
+		return emit(fixed_size(value, precision), [=](char* first, char* last) {
+			return std::to_chars(first, last, value, std::chars_format::fixed, precision).ptr;
+		});
+	}
+
+	/** \brief Write an integer right-aligned in a field of at least \e width characters.
+	 *
+	 * If \e fill is '0', the sign (if any) precedes the padding.
+	 */
+	template<class T, class = std::enable_if_t<std::is_integral<T>::value>>
+	formatter&
+	integer(T value, std::size_t width, char fill)
+	{
+		char tmp[max_integer_size];
+		auto end = std::to_chars(tmp, tmp + sizeof(tmp), value).ptr;
+		return pad(std::string_view{tmp, static_cast<std::size_t>(end - tmp)}, width, fill);
+	}
+
+	/** \brief Write a fixed-notation value right-aligned in a field of at least \e width characters.
+	 */
+	formatter&
+	fixed(double value, int precision, std::size_t width, char fill = ' ')
+	{
+		precision = std::min(std::max(precision, 0), max_precision);
+		std::string long_tmp;
+		char        tmp[max_floating_size + max_precision];
+		char*       first = tmp;
+		char*       last  = tmp + sizeof(tmp);
+		auto        size  = fixed_size(value, precision);
+		if (size > sizeof(tmp))
+		{
+			long_tmp.resize(size);
+			first = &long_tmp[0];
+			last  = first + size;
+		}
+		auto end = std::to_chars(first, last, value, std::chars_format::fixed, precision).ptr;
+		return pad(std::string_view{first, static_cast<std::size_t>(end - first)}, width, fill);
+	}
+
+	/** \brief Write a string left-aligned in a field of at least \e width characters.
+	 */
+	formatter&
+	left(std::string_view s, std::size_t width, char fill = ' ')
+	{
+		write(s);
+		return fill_n(fill, (width > s.size()) ? width - s.size() : 0);
+	}
+
+	/** \brief Write a string right-aligned in a field of at least \e width characters.
+	 */
+	formatter&
+	right(std::string_view s, std::size_t width, char fill = ' ')
+	{
+		fill_n(fill, (width > s.size()) ? width - s.size() : 0);
+		return write(s);
+	}
+
+	/** \brief Write a string with JSON escaping applied.
+	 *
+	 * Quotation marks, backslashes and control characters are escaped; runs of characters
+	 * that need no escaping are copied in one operation.
+	 */
+	formatter&
+	escaped(std::string_view s)
+	{
+		static const char hex[] = "0123456789abcdef";
+
+		auto run = s.data();
+		auto end = s.data() + s.size();
+		for (auto p = run; p != end; ++p)
+		{
+			auto c = static_cast<unsigned char>(*p);
+			if (c >= 0x20 && c != '"' && c != '\\')
+			{
+				continue;
+			}
+			m_sink.putn(run, static_cast<size_type>(p - run));
+			run = p + 1;
+			switch (c)
+			{
+				case '"':
+					write("\\\"");
+					break;
+				case '\\':
+					write("\\\\");
+					break;
+				case '\b':
+					write("\\b");
+					break;
+				case '\f':
+					write("\\f");
+					break;
+				case '\n':
+					write("\\n");
+					break;
+				case '\r':
+					write("\\r");
+					break;
+				case '\t':
+					write("\\t");
+					break;
+				default:
+				{
+					char esc[] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf]};
+					m_sink.putn(esc, sizeof(esc));
+				}
+			}
+		}
+		m_sink.putn(run, static_cast<size_type>(end - run));
+		return *this;
+	}
+
+	/** \brief Write a string, escaped and surrounded with quotation marks.
+	 */
+	formatter&
+	quoted(std::string_view s)
+	{
+		put('"');
+		escaped(s);
+		return put('"');
+	}
+
+	formatter&
+	operator<<(char c)
+	{
+		return put(c);
+	}
+
+	formatter&
+	operator<<(bool b)
+	{
+		return write(b ? "true" : "false");
+	}
+
+	formatter&
+	operator<<(std::string_view s)
+	{
+		return write(s);
+	}
+
+	formatter&
+	operator<<(const char* s)
+	{
+		return write(std::string_view{s});
+	}
+
+	formatter&
+	operator<<(std::string const& s)
+	{
+		return write(std::string_view{s});
+	}
+
+	template<class T, class = std::enable_if_t<std::is_integral<T>::value>>
+	formatter&
+	operator<<(T value)
+	{
+		return integer(value);
+	}
+
+	formatter&
+	operator<<(double value)
+	{
+		return floating(value);
+	}
+
+	formatter&
+	operator<<(float value)
+	{
+		return emit(max_floating_size, [=](char* first, char* last) { return std::to_chars(first, last, value).ptr; });
+	}
+
+private:
+	static std::size_t
+	fixed_size(double value, int precision)
+	{
+		// sign, integer digits, point, fraction digits
+		std::size_t int_digits = (std::isfinite(value) && std::fabs(value) < 1e17) ? 18 : 310;
+		return 2 + int_digits + static_cast<std::size_t>(precision);
+	}
+
+	/** \brief Convert with \e convert directly into the sink if possible, otherwise via a local buffer.
+	 *
+	 * \param max_size an upper bound on the size of the converted result
+	 * \param convert callable with signature char*(char* first, char* last), returning the end of the result
+	 */
+	template<class Convert>
+	formatter&
+	emit(std::size_t max_size, Convert&& convert)
+	{
+		auto first = reinterpret_cast<char*>(m_sink.prepare(max_size));
+		if (first)
+		{
+			auto last = convert(first, first + max_size);
+			m_sink.commit(static_cast<size_type>(last - first));
+		}
+		else if (max_size <= local_size)
+		{
+			char tmp[local_size];
+			auto last = convert(tmp, tmp + max_size);
+			m_sink.putn(tmp, static_cast<size_type>(last - tmp));
+		}
+		else
+		{
+			std::string tmp(max_size, '\0');
+			auto        last = convert(&tmp[0], &tmp[0] + max_size);
+			m_sink.putn(tmp.data(), static_cast<size_type>(last - tmp.data()));
+		}
+		return *this;
+	}
+
+	formatter&
+	pad(std::string_view s, std::size_t width, char fill)
+	{
+		if (fill == '0' && !s.empty() && (s.front() == '-' || s.front() == '+'))
+		{
+			put(s.front());
+			s.remove_prefix(1);
+			width = (width > 0) ? width - 1 : 0;
+		}
+		return right(s, width, fill);
+	}
+
+	formatter&
+	fill_n(char fill, std::size_t n)
+	{
+		while (n > 0)
+		{
+			auto chunk = std::min(n, local_size);
+			auto p     = m_sink.prepare(chunk);
+			if (p)
+			{
+				std::memset(p, fill, chunk);
+				m_sink.commit(chunk);
+			}
+			else
+			{
+				char tmp[local_size];
+				std::memset(tmp, fill, chunk);
+				m_sink.putn(tmp, chunk);
+			}
+			n -= chunk;
+		}
+		return *this;
+	}
+
+	static constexpr std::size_t local_size = 128;
+
+	Sink& m_sink;
+};
+
+}    // namespace util
+
+#endif    // UTIL_FORMAT_H
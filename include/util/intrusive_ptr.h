@@ -0,0 +1,421 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef UTIL_INTRUSIVE_PTR_H
+#define UTIL_INTRUSIVE_PTR_H
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <util/macros.h>
+#include <utility>
+
+namespace util
+{
+
+/** \brief Embeddable, non-atomic reference count for use with intrusive_ptr.
+ *
+ * Derived is the most-derived class whose destructor is invoked when the count reaches zero
+ * (or a base class with a virtual destructor). As with util::shared_ptr, objects counted by
+ * intrusive_refcount must not be shared concurrently between threads.
+ *
+ * Copying an object does not copy its reference count.
+ */
+template<class Derived>
+class intrusive_refcount
+{
+public:
+	long
+	use_count() const noexcept
+	{
+		return m_use_count;
+	}
+
+protected:
+	intrusive_refcount() noexcept : m_use_count{0} {}
+
+	intrusive_refcount(intrusive_refcount const&) noexcept : m_use_count{0} {}
+
+	intrusive_refcount&
+	operator=(intrusive_refcount const&) noexcept
+	{
+		return *this;
+	}
+
+	~intrusive_refcount() = default;
+
+private:
+	friend void
+	intrusive_ptr_add_ref(intrusive_refcount const* p) noexcept
+	{
+		++p->m_use_count;
+	}
+
+	friend void
+	intrusive_ptr_release(intrusive_refcount const* p) noexcept
+	{
+		assert(p->m_use_count > 0);
+		if (--p->m_use_count == 0)
+		{
+			dispose(p);
+		}
+	}
+
+	// out of line, so that callers do not see the deallocation (GCC reports later
+	// decrements through other pointers to the same object as -Wuse-after-free)
+	static UTIL_NOINLINE void
+	dispose(intrusive_refcount const* p) noexcept
+	{
+		delete static_cast<Derived const*>(p);
+	}
+
+	mutable long m_use_count;
+};
+
+/** \brief Embeddable, atomic reference count for use with intrusive_ptr.
+ *
+ * Increments are relaxed, and decrements are acquire-release, as for atomic_refcount.
+ */
+template<class Derived>
+class atomic_intrusive_refcount
+{
+public:
+	long
+	use_count() const noexcept
+	{
+		return m_use_count.load(std::memory_order_relaxed);
+	}
+
+protected:
+	atomic_intrusive_refcount() noexcept : m_use_count{0} {}
+
+	atomic_intrusive_refcount(atomic_intrusive_refcount const&) noexcept : m_use_count{0} {}
+
+	atomic_intrusive_refcount&
+	operator=(atomic_intrusive_refcount const&) noexcept
+	{
+		return *this;
+	}
+
+	~atomic_intrusive_refcount() = default;
+
+private:
+	friend void
+	intrusive_ptr_add_ref(atomic_intrusive_refcount const* p) noexcept
+	{
+		p->m_use_count.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	friend void
+	intrusive_ptr_release(atomic_intrusive_refcount const* p) noexcept
+	{
+		if (p->m_use_count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			dispose(p);
+		}
+	}
+
+	// out of line, as for intrusive_refcount
+	static UTIL_NOINLINE void
+	dispose(atomic_intrusive_refcount const* p) noexcept
+	{
+		delete static_cast<Derived const*>(p);
+	}
+
+	mutable std::atomic<long> m_use_count;
+};
+
+/** \brief Shared-ownership pointer to an object that contains its own reference count.
+ *
+ * The reference count is manipulated through the unqualified functions intrusive_ptr_add_ref(T*)
+ * and intrusive_ptr_release(T*), found by argument-dependent lookup. Deriving T from
+ * intrusive_refcount<T> or atomic_intrusive_refcount<T> provides them.
+ *
+ * An intrusive_ptr is one pointer wide, requires no separate control block, and may be
+ * constructed from a raw pointer to an object that is already shared, at any time. There
+ * are no weak references.
+ */
+template<class T>
+class intrusive_ptr
+{
+public:
+	using element_type = T;
+
+	template<class U>
+	friend class intrusive_ptr;
+
+	intrusive_ptr() noexcept : m_ptr{nullptr} {}
+
+	intrusive_ptr(std::nullptr_t) noexcept : m_ptr{nullptr} {}
+
+	intrusive_ptr(element_type* p, bool add_ref = true) : m_ptr{p}
+	{
+		if (m_ptr && add_ref)
+		{
+			intrusive_ptr_add_ref(m_ptr);
+		}
+	}
+
+	template<class U, class = std::enable_if_t<std::is_convertible<U*, element_type*>::value>>
+	intrusive_ptr(std::unique_ptr<U>&& up) : intrusive_ptr{up.release()}
+	{}
+
+	intrusive_ptr(intrusive_ptr const& rhs) : intrusive_ptr{rhs.m_ptr} {}
+
+	template<class U, class = std::enable_if_t<std::is_convertible<U*, element_type*>::value>>
+	intrusive_ptr(intrusive_ptr<U> const& rhs) : intrusive_ptr{rhs.m_ptr}
+	{}
+
+	intrusive_ptr(intrusive_ptr&& rhs) noexcept : m_ptr{rhs.m_ptr}
+	{
+		rhs.m_ptr = nullptr;
+	}
+
+	template<class U, class = std::enable_if_t<std::is_convertible<U*, element_type*>::value>>
+	intrusive_ptr(intrusive_ptr<U>&& rhs) noexcept : m_ptr{rhs.m_ptr}
+	{
+		rhs.m_ptr = nullptr;
+	}
+
+	~intrusive_ptr()
+	{
+		if (m_ptr)
+		{
+			intrusive_ptr_release(m_ptr);
+		}
+	}
+
+	intrusive_ptr&
+	operator=(intrusive_ptr const& rhs)
+	{
+		intrusive_ptr{rhs}.swap(*this);
+		return *this;
+	}
+
+	template<class U>
+	std::enable_if_t<std::is_convertible<U*, element_type*>::value, intrusive_ptr&>
+	operator=(intrusive_ptr<U> const& rhs)
+	{
+		intrusive_ptr{rhs}.swap(*this);
+		return *this;
+	}
+
+	intrusive_ptr&
+	operator=(intrusive_ptr&& rhs) noexcept
+	{
+		intrusive_ptr{std::move(rhs)}.swap(*this);
+		return *this;
+	}
+
+	template<class U>
+	std::enable_if_t<std::is_convertible<U*, element_type*>::value, intrusive_ptr&>
+	operator=(intrusive_ptr<U>&& rhs) noexcept
+	{
+		intrusive_ptr{std::move(rhs)}.swap(*this);
+		return *this;
+	}
+
+	template<class U>
+	std::enable_if_t<std::is_convertible<U*, element_type*>::value, intrusive_ptr&>
+	operator=(std::unique_ptr<U>&& rhs)
+	{
+		intrusive_ptr{std::move(rhs)}.swap(*this);
+		return *this;
+	}
+
+	void
+	swap(intrusive_ptr& rhs) noexcept
+	{
+		std::swap(m_ptr, rhs.m_ptr);
+	}
+
+	void
+	reset() noexcept
+	{
+		intrusive_ptr{}.swap(*this);
+	}
+
+	void
+	reset(element_type* p, bool add_ref = true)
+	{
+		intrusive_ptr{p, add_ref}.swap(*this);
+	}
+
+	/** \brief Relinquish ownership without releasing the reference.
+	 *
+	 * \return the pointer, whose reference count still includes the reference held by this instance
+	 */
+	element_type*
+	detach() noexcept
+	{
+		auto result = m_ptr;
+		m_ptr       = nullptr;
+		return result;
+	}
+
+	element_type*
+	get() const noexcept
+	{
+		return m_ptr;
+	}
+
+	element_type& operator*() const noexcept
+	{
+		return *m_ptr;
+	}
+
+	element_type* operator->() const noexcept
+	{
+		return m_ptr;
+	}
+
+	explicit operator bool() const noexcept
+	{
+		return m_ptr != nullptr;
+	}
+
+	long
+	use_count() const noexcept
+	{
+		return m_ptr ? m_ptr->use_count() : 0;
+	}
+
+private:
+	element_type* m_ptr;
+};
+
+template<class T, class U>
+inline bool
+operator==(intrusive_ptr<T> const& lhs, intrusive_ptr<U> const& rhs) noexcept
+{
+	return lhs.get() == rhs.get();
+}
+
+template<class T, class U>
+inline bool
+operator!=(intrusive_ptr<T> const& lhs, intrusive_ptr<U> const& rhs) noexcept
+{
+	return lhs.get() != rhs.get();
+}
+
+template<class T>
+inline bool
+operator==(intrusive_ptr<T> const& lhs, std::nullptr_t) noexcept
+{
+	return !lhs;
+}
+
+template<class T>
+inline bool
+operator!=(intrusive_ptr<T> const& lhs, std::nullptr_t) noexcept
+{
+	return bool(lhs);
+}
+
+template<class T>
+inline void
+swap(intrusive_ptr<T>& x, intrusive_ptr<T>& y) noexcept
+{
+	x.swap(y);
+}
+
+template<class T, class... Args>
+inline intrusive_ptr<T>
+make_intrusive(Args&&... args)
+{
+	return intrusive_ptr<T>{new T(std::forward<Args>(args)...)};
+}
+
+template<class T, class U>
+inline intrusive_ptr<T>
+static_pointer_cast(intrusive_ptr<U> const& p)
+{
+	return intrusive_ptr<T>{static_cast<T*>(p.get())};
+}
+
+template<class T, class U>
+inline intrusive_ptr<T>
+dynamic_pointer_cast(intrusive_ptr<U> const& p)
+{
+	return intrusive_ptr<T>{dynamic_cast<T*>(p.get())};
+}
+
+/** \brief Counterpart of enable_shared_from_this for intrusively counted classes.
+ *
+ * Since the reference count is part of the object, an intrusive_ptr can be made from
+ * \e this at any time, including in the constructor; this class exists so that types
+ * converted from enable_shared_from_this keep the same interface. T must also derive from
+ * intrusive_refcount<T> or atomic_intrusive_refcount<T>.
+ */
+template<class T>
+class enable_intrusive_from_this
+{
+protected:
+	enable_intrusive_from_this() noexcept {}
+	enable_intrusive_from_this(enable_intrusive_from_this const&) noexcept {}
+	enable_intrusive_from_this&
+	operator=(enable_intrusive_from_this const&) noexcept
+	{
+		return *this;
+	}
+	~enable_intrusive_from_this() {}
+
+public:
+	intrusive_ptr<T>
+	intrusive_from_this()
+	{
+		return intrusive_ptr<T>{static_cast<T*>(this)};
+	}
+
+	intrusive_ptr<T const>
+	intrusive_from_this() const
+	{
+		return intrusive_ptr<T const>{static_cast<T const*>(this)};
+	}
+};
+
+}    // namespace util
+
+namespace std
+{
+
+template<class U>
+struct hash<util::intrusive_ptr<U>>
+{
+	typedef util::intrusive_ptr<U> argument_type;
+	typedef std::size_t            result_type;
+
+	result_type
+	operator()(const argument_type& v) const
+	{
+		return std::hash<U*>()(v.get());
+	}
+};
+
+}    // namespace std
+
+#endif    // UTIL_INTRUSIVE_PTR_H
@@ -0,0 +1,589 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef UTIL_LOOP_GROUP_H
+#define UTIL_LOOP_GROUP_H
+
+#include <boost/predef.h>
+
+#if (BOOST_OS_LINUX)
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <pthread.h>
+#include <sched.h>
+#include <stdexcept>
+#include <sys/eventfd.h>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <unistd.h>
+#include <util/error.h>
+#include <util/event_loop.h>
+#include <util/promise.h>
+#include <util/unique_function.h>
+#include <vector>
+
+/*
+ * Capacity of each queue between a pair of loops in a loop_group (rounded up to a power of two).
+ */
+#ifndef UTIL_LOOP_GROUP_QUEUE_CAPACITY
+#define UTIL_LOOP_GROUP_QUEUE_CAPACITY 256
+#endif
+
+namespace util
+{
+namespace detail
+{
+
+/** \brief Bounded single-producer, single-consumer queue.
+ *
+ * Each side caches the other side's index, so that the shared indices are read only when the
+ * cached value suggests the queue is full (or empty).
+ */
+template<class T>
+class spsc_queue
+{
+public:
+	explicit spsc_queue(std::size_t capacity)
+		: m_mask{round_up(capacity) - 1}, m_slots(m_mask + 1), m_head{0}, m_tail_cache{0}, m_tail{0}, m_head_cache{0}
+	{}
+
+	spsc_queue(spsc_queue const&) = delete;
+	spsc_queue&
+	operator=(spsc_queue const&) = delete;
+
+	/** \brief Called by the producer only.
+	 *
+	 * \return false if the queue is full, in which case \e value is unchanged
+	 */
+	bool
+	try_push(T& value)
+	{
+		auto tail = m_tail.load(std::memory_order_relaxed);
+		if (tail - m_head_cache > m_mask)
+		{
+			m_head_cache = m_head.load(std::memory_order_acquire);
+			if (tail - m_head_cache > m_mask)
+			{
+				return false;
+			}
+		}
+		m_slots[tail & m_mask] = std::move(value);
+		m_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	/** \brief Called by the consumer only.
+	 */
+	bool
+	try_pop(T& value)
+	{
+		auto head = m_head.load(std::memory_order_relaxed);
+		if (head == m_tail_cache)
+		{
+			m_tail_cache = m_tail.load(std::memory_order_acquire);
+			if (head == m_tail_cache)
+			{
+				return false;
+			}
+		}
+		auto& slot = m_slots[head & m_mask];
+		value      = std::move(slot);
+		slot       = T{};    // release captured state now, rather than when the slot is reused
+		m_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	std::size_t
+	capacity() const
+	{
+		return m_mask + 1;
+	}
+
+private:
+	static std::size_t
+	round_up(std::size_t n)
+	{
+		std::size_t result{1};
+		while (result < n)
+		{
+			result <<= 1;
+		}
+		return result;
+	}
+
+	const std::size_t m_mask;
+	std::vector<T>    m_slots;
+
+	alignas(64) std::atomic<std::size_t> m_head;    // written by the consumer
+	std::size_t m_tail_cache;                       // consumer's copy of m_tail
+
+	alignas(64) std::atomic<std::size_t> m_tail;    // written by the producer
+	std::size_t m_head_cache;                       // producer's copy of m_head
+};
+
+}    // namespace detail
+
+/** \brief A group of event loops, one per thread, each optionally pinned to a core.
+ *
+ * Work moves between loops with dispatch(). Between each ordered pair of loops there is a
+ * bounded single-producer, single-consumer queue, so a dispatch from one loop of the group to
+ * another takes no lock. Each loop has an eventfd doorbell; a producer rings it only if it has
+ * not been rung since the target loop last drained its queues, so a burst of messages costs one
+ * wakeup. Messages between a pair of loops are delivered in the order they were dispatched. If
+ * a queue is full, the excess is held by the producing loop, and the consumer rings the
+ * producer's doorbell when it has made room, so neither side polls. Dispatches from threads
+ * outside the group use event_loop::dispatch().
+ *
+ * submit() runs a function on another loop, and delivers its result to a util::promise owned
+ * by the calling loop, so continuations run on the loop that attached them. Since util::promise
+ * is not thread-safe, the promise is only ever copied or destroyed on its owning loop.
+ *
+ * The loops run until the group is destroyed. Tasks must not throw (but functions given to
+ * submit() may).
+ */
+class loop_group
+{
+public:
+	using task_type = event_loop::task_type;
+
+	static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+	/** \brief Executor that dispatches work to one loop of a group.
+	 */
+	class executor_type
+	{
+	public:
+		executor_type(loop_group& group, std::size_t index) : m_group{&group}, m_index{index} {}
+
+		template<class F>
+		void
+		post(F&& f) const
+		{
+			m_group->dispatch(m_index, task_type{std::forward<F>(f)});
+		}
+
+		std::size_t
+		index() const
+		{
+			return m_index;
+		}
+
+	private:
+		loop_group* m_group;
+		std::size_t m_index;
+	};
+
+	/** \brief Construct a group, and start its loops.
+	 *
+	 * \param loops the number of loops
+	 * \param pin_threads if true, the thread running loop i is bound to core i modulo the number of cores
+	 * \param queue_capacity the capacity of the queue between each pair of loops
+	 * \throw std::system_error if a loop or doorbell cannot be created
+	 */
+	explicit loop_group(
+			std::size_t loops          = std::thread::hardware_concurrency(),
+			bool        pin_threads    = false,
+			std::size_t queue_capacity = UTIL_LOOP_GROUP_QUEUE_CAPACITY);
+
+	loop_group(loop_group const&) = delete;
+	loop_group&
+	operator=(loop_group const&) = delete;
+
+	/** \brief Stop and join all loops; undelivered tasks are discarded.
+	 */
+	~loop_group();
+
+	std::size_t
+	size() const
+	{
+		return m_members.size();
+	}
+
+	event_loop&
+	loop(std::size_t index)
+	{
+		return *m_members[index]->loop;
+	}
+
+	/** \brief The index of the calling thread's loop, or npos if the caller is not a loop of this group.
+	 */
+	std::size_t
+	current() const
+	{
+		auto const& ctx = context();
+		return (ctx.group == this) ? ctx.index : npos;
+	}
+
+	executor_type
+	executor(std::size_t index)
+	{
+		return executor_type{*this, index};
+	}
+
+	/** \brief Run \e task on loop \e target.
+	 */
+	void
+	dispatch(std::size_t target, task_type task);
+
+	/** \brief Run \e f on loop \e target, and resolve the returned promise with its result on the calling loop.
+	 *
+	 * If \e f throws, the promise is rejected with the code of a std::system_error, or with
+	 * util::errc::unhandled_exception for any other exception.
+	 *
+	 * \throw std::logic_error if not called from a loop of this group
+	 */
+	template<class F, class R = std::invoke_result_t<std::decay_t<F>&>>
+	util::promise<R>
+	submit(std::size_t target, F&& f)
+	{
+		static_assert(!is_promise<R>::value, "loop_group::submit() does not support functions returning promises");
+
+		auto origin = current();
+		if (origin == npos)
+		{
+			throw std::logic_error{"loop_group::submit() must be called from a loop of the group"};
+		}
+
+		util::promise<R> result;
+		dispatch(target, [this, origin, result, f = std::forward<F>(f)]() mutable {
+			// result was copied on the owning loop; here it is only moved, and then moved back
+			std::error_code err;
+			if constexpr (std::is_void<R>::value)
+			{
+				try
+				{
+					f();
+				}
+				catch (...)
+				{
+					err = exception_error();
+				}
+				dispatch(origin, [result = std::move(result), err]() mutable {
+					if (err)
+					{
+						result.reject(err);
+					}
+					else
+					{
+						result.resolve();
+					}
+				});
+			}
+			else
+			{
+				std::optional<R> value;
+				try
+				{
+					value.emplace(f());
+				}
+				catch (...)
+				{
+					err = exception_error();
+				}
+				dispatch(origin, [result = std::move(result), value = std::move(value), err]() mutable {
+					if (err)
+					{
+						result.reject(err);
+					}
+					else
+					{
+						result.resolve(std::move(*value));
+					}
+				});
+			}
+		});
+		return result;
+	}
+
+	/** \brief Number of messages that found a queue full (or not empty of earlier overflow), and were
+	 * held by the producer.
+	 */
+	std::size_t
+	overflow_count() const
+	{
+		return m_overflow_count.load(std::memory_order_relaxed);
+	}
+
+private:
+	// the queue from one loop to another, and whether the producer is waiting for room in it
+	struct channel
+	{
+		explicit channel(std::size_t capacity) : queue{capacity}, blocked{false} {}
+
+		detail::spsc_queue<task_type> queue;
+		std::atomic<bool>             blocked;
+	};
+
+	struct member
+	{
+		std::unique_ptr<event_loop>           loop;
+		std::thread                           thread;
+		int                                   doorbell{-1};
+		std::atomic<bool>                     rung{false};
+		std::vector<std::unique_ptr<channel>> inbound;     // indexed by producer
+		std::vector<std::deque<task_type>>    overflow;    // indexed by consumer; touched only by this loop
+	};
+
+	struct loop_context
+	{
+		loop_group* group{nullptr};
+		std::size_t index{npos};
+	};
+
+	static loop_context&
+	context()
+	{
+		static thread_local loop_context ctx;
+		return ctx;
+	}
+
+	// the error with which submit() rejects for the exception being handled
+	static std::error_code
+	exception_error()
+	{
+		try
+		{
+			throw;
+		}
+		catch (std::system_error const& e)
+		{
+			return e.code();
+		}
+		catch (...)
+		{
+			return make_error_code(util::errc::unhandled_exception);
+		}
+	}
+
+	static void
+	pin(std::thread& thread, std::size_t index)
+	{
+		auto      cores = std::max(std::thread::hardware_concurrency(), 1u);
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(static_cast<int>(index % cores), &set);
+		::pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+	}
+
+	void
+	ring(member& target)
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);    // order the push before reading the flag
+		if (!target.rung.exchange(true, std::memory_order_seq_cst))
+		{
+			std::uint64_t one{1};
+			while (::write(target.doorbell, &one, sizeof(one)) < 0 && errno == EINTR)
+			{}
+		}
+	}
+
+	void
+	answer(std::size_t index);
+
+	bool
+	flush(std::size_t origin, std::size_t target);
+
+	std::vector<std::unique_ptr<member>> m_members;
+	std::atomic<std::size_t>             m_overflow_count;
+};
+
+inline loop_group::loop_group(std::size_t loops, bool pin_threads, std::size_t queue_capacity)
+	: m_overflow_count{0}
+{
+	loops = std::max<std::size_t>(loops, 1);
+	for (std::size_t i = 0; i < loops; ++i)
+	{
+		auto m      = std::make_unique<member>();
+		m->loop     = std::make_unique<event_loop>();
+		m->doorbell = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (m->doorbell < 0)
+		{
+			throw std::system_error{std::error_code{errno, std::system_category()}};
+		}
+		m->inbound.resize(loops);
+		m->overflow.resize(loops);
+		for (std::size_t j = 0; j < loops; ++j)
+		{
+			if (j != i)
+			{
+				m->inbound[j] = std::make_unique<channel>(queue_capacity);
+			}
+		}
+		m->loop->watch(m->doorbell, EPOLLIN, [this, i](std::uint32_t) { answer(i); });
+		m_members.push_back(std::move(m));
+	}
+
+	for (std::size_t i = 0; i < loops; ++i)
+	{
+		m_members[i]->thread = std::thread{[this, i]() {
+			context() = loop_context{this, i};
+			m_members[i]->loop->run();
+			context() = loop_context{};
+		}};
+		if (pin_threads)
+		{
+			pin(m_members[i]->thread, i);
+		}
+	}
+}
+
+inline loop_group::~loop_group()
+{
+	for (auto& m : m_members)
+	{
+		m->loop->stop();
+	}
+	for (auto& m : m_members)
+	{
+		if (m->thread.joinable())
+		{
+			m->thread.join();
+		}
+	}
+	for (auto& m : m_members)
+	{
+		m->loop->unwatch(m->doorbell);
+		::close(m->doorbell);
+	}
+}
+
+inline void
+loop_group::dispatch(std::size_t target, task_type task)
+{
+	auto origin = current();
+	if (origin == npos || origin == target)
+	{
+		m_members[target]->loop->dispatch(std::move(task));
+		return;
+	}
+
+	auto& pending = m_members[origin]->overflow[target];
+	if (pending.empty() && m_members[target]->inbound[origin]->queue.try_push(task))
+	{
+		ring(*m_members[target]);
+		return;
+	}
+
+	// preserve ordering behind earlier overflow; the consumer rings back when it has made room
+	m_overflow_count.fetch_add(1, std::memory_order_relaxed);
+	pending.push_back(std::move(task));
+	if (pending.size() == 1)
+	{
+		flush(origin, target);
+	}
+}
+
+inline void
+loop_group::answer(std::size_t index)
+{
+	auto&         self = *m_members[index];
+	std::uint64_t value;
+	while (::read(self.doorbell, &value, sizeof(value)) < 0 && errno == EINTR)
+	{}
+
+	// clear the flag before draining, so that a push after the drain rings again
+	self.rung.store(false, std::memory_order_seq_cst);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	// move held messages into queues that consumers have made room in
+	for (std::size_t target = 0; target < m_members.size(); ++target)
+	{
+		if (!self.overflow[target].empty())
+		{
+			flush(index, target);
+		}
+	}
+
+	// take at most one queue's worth from each producer, so that a busy producer cannot starve the loop
+	task_type task;
+	bool      more{false};
+	for (std::size_t producer = 0; producer < m_members.size(); ++producer)
+	{
+		auto& ch = self.inbound[producer];
+		if (!ch)
+		{
+			continue;
+		}
+		std::size_t count{0};
+		while (count < ch->queue.capacity() && ch->queue.try_pop(task))
+		{
+			task();
+			++count;
+		}
+		more = more || count == ch->queue.capacity();
+		if (count > 0)
+		{
+			std::atomic_thread_fence(std::memory_order_seq_cst);    // order the pops before reading the flag
+			if (ch->blocked.exchange(false, std::memory_order_seq_cst))
+			{
+				ring(*m_members[producer]);
+			}
+		}
+	}
+	if (more)
+	{
+		ring(self);
+	}
+}
+
+inline bool
+loop_group::flush(std::size_t origin, std::size_t target)
+{
+	auto& pending = m_members[origin]->overflow[target];
+	auto& ch      = *m_members[target]->inbound[origin];
+	bool  pushed{false};
+	for (;;)
+	{
+		while (!pending.empty() && ch.queue.try_push(pending.front()))
+		{
+			pending.pop_front();
+			pushed = true;
+		}
+		if (pending.empty() || ch.blocked.load(std::memory_order_seq_cst))
+		{
+			break;
+		}
+
+		// ask the consumer to ring back when it makes room, then look again, in case it already has
+		ch.blocked.store(true, std::memory_order_seq_cst);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+	}
+	if (pushed)
+	{
+		ring(*m_members[target]);
+	}
+	return pending.empty();
+}
+
+}    // namespace util
+
+#endif    // BOOST_OS_LINUX
+
+#endif    // UTIL_LOOP_GROUP_H
@@ -82,4 +82,14 @@
 /**/
 #endif
 
+// keep a function out of line
+
+#if (BOOST_COMP_MSVC)
+#define UTIL_NOINLINE __declspec(noinline)
+#elif (BOOST_COMP_CLANG || BOOST_COMP_GNUC)
+#define UTIL_NOINLINE __attribute__((noinline))
+#else
+#define UTIL_NOINLINE
+#endif
+
 #endif    // UTIL_MACROS_H
\ No newline at end of file
@@ -8,6 +8,7 @@
 #include <streambuf>
 #include <system_error>
 #include <util/buffer.h>
+#include <util/checksum.h>
 #include <util/dumpster.h>
 #include <vector>
 
@@ -157,11 +158,13 @@ private:
 	static constexpr std::streamsize min_alloc_size
 			= (UTIL_BUFFER_OUT_STREAMBUF_MIN_ALLOC_SIZE > 16) ? UTIL_BUFFER_OUT_STREAMBUF_MIN_ALLOC_SIZE : 16;
 
-	util::mutable_buffer m_buf;
-	char*                m_high_watermark;
+	util::mutable_buffer            m_buf;
+	char*                           m_high_watermark;
+	std::unique_ptr<block_checksum> m_checksum;
+	off_type                        m_checksum_mark;    // position of pptr when last observed
 
 public:
-	omembuf() : m_buf{}, m_high_watermark{nullptr}
+	omembuf() : m_buf{}, m_high_watermark{nullptr}, m_checksum_mark{0}
 	{
 		auto base = reinterpret_cast<char_type*>(m_buf.data());
 		setp(base, base + m_buf.capacity());
@@ -170,7 +173,7 @@ public:
 		ASSERT_VALID_PPTRS(*this);
 	}
 
-	omembuf(buffer_type&& buf) : m_buf(std::move(buf)), m_high_watermark{nullptr}
+	omembuf(buffer_type&& buf) : m_buf(std::move(buf)), m_high_watermark{nullptr}, m_checksum_mark{0}
 	{
 		auto base = reinterpret_cast<char_type*>(m_buf.data());
 		setp(base, base + m_buf.capacity());
@@ -179,7 +182,7 @@ public:
 		ASSERT_VALID_PPTRS(*this);
 	}
 
-	omembuf(std::size_t capacity) : m_buf(capacity), m_high_watermark{nullptr}
+	omembuf(std::size_t capacity) : m_buf(capacity), m_high_watermark{nullptr}, m_checksum_mark{0}
 	{
 		auto base = reinterpret_cast<char_type*>(m_buf.data());
 		setp(base, base + m_buf.capacity());
@@ -188,7 +191,11 @@ public:
 		ASSERT_VALID_PPTRS(*this);
 	}
 
-	omembuf(omembuf&& rhs) : m_buf{std::move(rhs.m_buf)}, m_high_watermark{rhs.m_high_watermark}
+	omembuf(omembuf&& rhs)
+		: m_buf{std::move(rhs.m_buf)},
+		  m_high_watermark{rhs.m_high_watermark},
+		  m_checksum{std::move(rhs.m_checksum)},
+		  m_checksum_mark{rhs.m_checksum_mark}
 	{
 		setp(reinterpret_cast<char*>(m_buf.data()), reinterpret_cast<char*>(m_buf.data()) + m_buf.capacity());
 		pbump(rhs.pptr() - rhs.pbase());
@@ -205,7 +212,9 @@ public:
 	omembuf&
 	operator=(omembuf&& rhs)
 	{
-		m_buf = std::move(rhs.m_buf);
+		m_buf           = std::move(rhs.m_buf);
+		m_checksum      = std::move(rhs.m_checksum);
+		m_checksum_mark = rhs.m_checksum_mark;
 		hwm(rhs.hwm());
 		char* p = reinterpret_cast<char*>(m_buf.data());
 		setp(p, p + m_buf.capacity());
@@ -235,6 +244,7 @@ public:
 			setp(nullptr, nullptr);
 			hwm(nullptr);
 		}
+		reset_checksum();
 		ASSERT_VALID_PPTRS(*this);
 		return *this;
 	}
@@ -251,9 +261,80 @@ public:
 	{
 		sync_buffer_size();
 		reset_ptrs_offsets();
+		reset_checksum();
 		return std::move(m_buf);
 	}
 
+	/** \brief Release the buffer, along with checksums of its contents.
+	 *
+	 * If checksum-on-write is enabled, the checksums are obtained from the running state,
+	 * so only blocks that were not already folded during writing are read.
+	 *
+	 * \param sums side-effected with the checksums of the released buffer contents
+	 */
+	buffer_type
+	release_buffer(checksum_result& sums)
+	{
+		sums = checksums();
+		return release_buffer();
+	}
+
+	/** \brief Enable (or disable) checksum-on-write.
+	 *
+	 * When enabled, checksums are updated in blocks of UTIL_CHECKSUM_BLOCK_SIZE bytes as the
+	 * blocks are filled. Bytes rewritten after a seek cause only the affected blocks to be
+	 * recalculated. Existing buffer contents are included in the checksum.
+	 */
+	void
+	enable_checksum(checksum_mode mode = checksum_mode::crc32)
+	{
+		if (mode == checksum_mode::none)
+		{
+			m_checksum.reset();
+		}
+		else
+		{
+			m_checksum = std::make_unique<block_checksum>(mode, UTIL_CHECKSUM_BLOCK_SIZE);
+		}
+		m_checksum_mark = pbase() ? (pptr() - pbase()) : 0;
+	}
+
+	checksum_mode
+	checksum_enabled() const
+	{
+		return m_checksum ? m_checksum->mode() : checksum_mode::none;
+	}
+
+	/** \brief Checksums of the current buffer contents.
+	 *
+	 * If checksum-on-write is not enabled, the checksums are calculated in a single pass.
+	 */
+	checksum_result
+	checksums()
+	{
+		checksum_result result;
+		std::size_t     length = static_cast<std::size_t>(size());
+		if (m_checksum)
+		{
+			observe_checksum();
+			result = m_checksum->result(length, [this](size_type index) { return checksum_block(index); });
+		}
+		else if (length > 0)
+		{
+			result.crc  = crc32(pbase(), length);
+			result.fast = adler32(pbase(), length);
+		}
+		return result;
+	}
+
+	/** \brief CRC32 value of the current buffer contents.
+	 */
+	checksum_type
+	checksum()
+	{
+		return checksums().crc;
+	}
+
 	void
 	print_state()
 	{
@@ -280,7 +361,79 @@ public:
 		return static_cast<std::streamsize>(pptr() - pbase());
 	}
 
+	/** \brief Obtain contiguous space for \e n bytes at the current position.
+	 *
+	 * With commit(), this allows formatters to write directly into the buffer without a
+	 * virtual call per character. The buffer is expanded if necessary.
+	 *
+	 * \return pointer to the space, or nullptr if the buffer is not expandable and has insufficient room
+	 */
+	byte_type*
+	prepare(size_type n)
+	{
+		byte_type* result{nullptr};
+		if (static_cast<size_type>(epptr() - pptr()) < n)
+		{
+			if (!m_buf.is_expandable())
+				goto exit;
+			make_room(n);
+		}
+		result = reinterpret_cast<byte_type*>(pptr());
+	exit:
+		return result;
+	}
+
+	/** \brief Advance the current position past \e n bytes written into space obtained from prepare().
+	 */
+	void
+	commit(size_type n)
+	{
+		assert(static_cast<size_type>(epptr() - pptr()) >= n);
+		pbump(static_cast<int>(n));
+	}
+
+	void
+	put(char c)
+	{
+		sputc(c);
+	}
+
+	void
+	putn(const void* src, size_type n)
+	{
+		sputn(reinterpret_cast<const char_type*>(src), static_cast<std::streamsize>(n));
+	}
+
 protected:
+	const byte_type*
+	checksum_block(size_type index) const
+	{
+		return reinterpret_cast<const byte_type*>(pbase()) + (index * m_checksum->block_size());
+	}
+
+	// Bytes may have been written (by sputc/sputn, without a virtual call) from the last
+	// observed position up to pptr(); report them before pptr() moves non-sequentially.
+	void
+	observe_checksum()
+	{
+		if (m_checksum && pbase())
+		{
+			off_type pos = pptr() - pbase();
+			m_checksum->written(m_checksum_mark, pos, [this](size_type index) { return checksum_block(index); });
+			m_checksum_mark = pos;
+		}
+	}
+
+	void
+	reset_checksum()
+	{
+		if (m_checksum)
+		{
+			m_checksum->reset();
+		}
+		m_checksum_mark = pbase() ? (pptr() - pbase()) : 0;
+	}
+
 	char*
 	hwm() const
 	{
@@ -317,6 +470,7 @@ protected:
 		std::streamsize remaining = epptr() - pptr();
 		if (remaining < n)
 		{
+			sync_buffer_size();    // expand() preserves only size() bytes
 			std::ptrdiff_t  pptr_diff      = pptr() - pbase();
 			std::ptrdiff_t  hwm_diff       = hwm() - pbase();
 			std::streamsize required       = pptr_diff + n;
@@ -362,6 +516,7 @@ protected:
 	sync() override
 	{
 		sync_hwm();
+		observe_checksum();
 		return 0;
 	}
 
@@ -392,6 +547,10 @@ protected:
 				result = remaining;
 			}
 		}
+		if (m_checksum)
+		{
+			observe_checksum();
+		}
 		return result;
 	}
 
@@ -406,6 +565,7 @@ protected:
 				if (pptr() >= epptr())
 				{
 					assert(pptr() == epptr());
+					observe_checksum();
 					make_room(1);
 				}
 				*pptr() = ch;
@@ -454,9 +614,11 @@ protected:
 				new_off += off;
 				if (new_off >= 0 && new_off <= hwm_off)
 				{
+					observe_checksum();
 					setp(pbase(), epptr());
 					pbump(new_off);
-					result = pos_type{new_off};
+					m_checksum_mark = new_off;
+					result          = pos_type{new_off};
 				}
 			}
 		}
@@ -661,6 +823,8 @@ private:
 	off_type                                      m_high_watermark;
 	size_type                                     m_alloc_size;    // capacity of individual buffers
 	std::unique_ptr<util::mutable_buffer_factory> m_factory;
+	std::unique_ptr<block_checksum>               m_checksum;         // blocks correspond to segments
+	off_type                                      m_checksum_mark;    // position of pptr when last observed
 
 	omemqbuf(std::unique_ptr<mutable_buffer_factory>&& factory)
 		: m_buf{},
@@ -668,7 +832,8 @@ private:
 		  m_base_offset{-1},
 		  m_high_watermark{-1},
 		  m_alloc_size{factory->size()},
-		  m_factory{std::move(factory)}
+		  m_factory{std::move(factory)},
+		  m_checksum_mark{0}
 	{
 		setp(nullptr, nullptr);
 		pubimbue(std::locale::classic());
@@ -679,11 +844,14 @@ private:
 	{
 		ASSERT_VALID_QPPTRS(other);
 		bool result{false};
+		m_checksum      = std::move(other.m_checksum);
+		m_checksum_mark = 0;
 		if (other.m_buf.size() > 0)
 		{
 			other.sync_buffer_size();
-			m_buf     = std::move(other.m_buf);
-			m_current = other.m_current;
+			m_buf           = std::move(other.m_buf);
+			m_current       = other.m_current;
+			m_checksum_mark = other.m_checksum_mark;
 			hwm(other.hwm());
 			sync_current_segment();
 			pbump(other.pptr() - other.pbase());
@@ -739,6 +907,7 @@ public:
 		{
 			m_buf.clear();
 			reset_ptrs_offsets();
+			reset_checksum();
 		}
 
 		ASSERT_VALID_QPPTRS(*this);
@@ -758,9 +927,84 @@ public:
 	{
 		sync_buffer_size();
 		reset_ptrs_offsets();
+		reset_checksum();
 		return std::move(m_buf);
 	}
 
+	/** \brief Release the segments, along with checksums of their contents.
+	 *
+	 * If checksum-on-write is enabled, the checksums are obtained from the running state;
+	 * segments that were folded as they were filled are not read again.
+	 *
+	 * \param sums side-effected with the checksums of the released contents
+	 */
+	buffer_type
+	release_buffer(checksum_result& sums)
+	{
+		sums = checksums();
+		return release_buffer();
+	}
+
+	/** \brief Enable (or disable) checksum-on-write.
+	 *
+	 * When enabled, the checksums of each segment are calculated as the segment is
+	 * filled, so the final checksum requires only the last (partial) segment to be read.
+	 * Bytes rewritten after a seek cause only the affected segments to be recalculated.
+	 */
+	void
+	enable_checksum(checksum_mode mode = checksum_mode::crc32)
+	{
+		if (mode == checksum_mode::none)
+		{
+			m_checksum.reset();
+		}
+		else
+		{
+			m_checksum = std::make_unique<block_checksum>(mode, m_alloc_size);
+		}
+		m_checksum_mark = (m_current < 0) ? 0 : poff();
+	}
+
+	checksum_mode
+	checksum_enabled() const
+	{
+		return m_checksum ? m_checksum->mode() : checksum_mode::none;
+	}
+
+	/** \brief Checksums of the current contents.
+	 *
+	 * If checksum-on-write is not enabled, the checksums are calculated in a single pass
+	 * over the segments.
+	 */
+	checksum_result
+	checksums()
+	{
+		checksum_result result;
+		if (m_buf.size() > 0)
+		{
+			std::size_t length = static_cast<std::size_t>(size());
+			if (m_checksum)
+			{
+				observe_checksum();
+				result = m_checksum->result(length, [this](size_type index) { return m_buf[index].data(); });
+			}
+			else
+			{
+				block_checksum sums{checksum_mode::crc32_adler32, m_alloc_size};
+				result = sums.result(length, [this](size_type index) { return m_buf[index].data(); });
+			}
+		}
+		return result;
+	}
+
+	/** \brief CRC32 value of the current contents.
+	 */
+	checksum_type
+	checksum()
+	{
+		return checksums().crc;
+	}
+
 	void
 	print_state()
 	{
@@ -788,6 +1032,52 @@ public:
 		return poff();
 	}
 
+	/** \brief Obtain contiguous space for \e n bytes at the current position.
+	 *
+	 * With commit(), this allows formatters to write directly into the current segment
+	 * without a virtual call per character. Space cannot span segments; if fewer than \e n
+	 * bytes remain in the current segment (and the current segment is not full), or if
+	 * \e n exceeds the segment size, the result is nullptr, and the caller should write
+	 * with putn() instead.
+	 *
+	 * \return pointer to the space, or nullptr if it is not available
+	 */
+	byte_type*
+	prepare(size_type n)
+	{
+		byte_type* result{nullptr};
+		if (static_cast<size_type>(epptr() - pptr()) < n)
+		{
+			if (n > m_alloc_size || pptr() < epptr())
+				goto exit;
+			next_segment();
+		}
+		result = reinterpret_cast<byte_type*>(pptr());
+	exit:
+		return result;
+	}
+
+	/** \brief Advance the current position past \e n bytes written into space obtained from prepare().
+	 */
+	void
+	commit(size_type n)
+	{
+		assert(static_cast<size_type>(epptr() - pptr()) >= n);
+		pbump(static_cast<int>(n));
+	}
+
+	void
+	put(char c)
+	{
+		sputc(c);
+	}
+
+	void
+	putn(const void* src, size_type n)
+	{
+		sputn(reinterpret_cast<const char_type*>(src), static_cast<std::streamsize>(n));
+	}
+
 protected:
 	off_type
 	poff() const
@@ -826,6 +1116,29 @@ protected:
 		m_base_offset = -1;
 	}
 
+	// Bytes may have been written (by sputc/sputn, without a virtual call) from the last
+	// observed position up to pptr(); report them before pptr() moves non-sequentially.
+	void
+	observe_checksum()
+	{
+		if (m_checksum && m_current >= 0)
+		{
+			off_type pos = poff();
+			m_checksum->written(m_checksum_mark, pos, [this](size_type index) { return m_buf[index].data(); });
+			m_checksum_mark = pos;
+		}
+	}
+
+	void
+	reset_checksum()
+	{
+		if (m_checksum)
+		{
+			m_checksum->reset();
+		}
+		m_checksum_mark = (m_current < 0) ? 0 : poff();
+	}
+
 	void
 	sync_buffer_size()
 	{
@@ -876,6 +1189,10 @@ protected:
 					pbump(chunk_size);
 				}
 			}
+			if (m_checksum)
+			{
+				observe_checksum();
+			}
 		}
 		return n;
 	}
@@ -898,6 +1215,7 @@ protected:
 		{
 			assert(m_current < m_buf.size());
 			assert(poff() == (m_current + 1) * m_alloc_size);
+			observe_checksum();    // folds the segment just filled
 			if (m_current == m_buf.size() - 1)    // last buffer in deque, extend deque
 			{
 				m_buf[m_current].size(m_alloc_size);
@@ -1009,9 +1327,11 @@ protected:
 		}
 		if (new_current < m_buf.size())
 		{
+			observe_checksum();
 			m_current = new_current;
 			sync_current_segment();
 			pbump(seg_off);
+			m_checksum_mark = loc;
 		}
 		return loc;
 	}
@@ -0,0 +1,648 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef UTIL_MEMIO_H
+#define UTIL_MEMIO_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <streambuf>
+#include <string_view>
+#include <util/buffer.h>
+
+#ifndef UTIL_MEMIO_DEFAULT_CAPACITY
+#define UTIL_MEMIO_DEFAULT_CAPACITY 1024
+#endif
+
+/*
+ * Byte sinks and sources over mutable_buffer and segment storage.
+ *
+ * These are concrete classes with no virtual members; templated serializers that accept a
+ * Sink or Source type parameter are dispatched at compile time, and the common case of each
+ * operation (the bytes fit in the current window) is inlined. Unlike the streambuf classes
+ * in membuf.h, there is no locale, no sentry, and no virtual call per operation.
+ *
+ * A Sink provides:
+ *
+ *     void put(char c);
+ *     void putn(const void* src, size_type n);
+ *     byte_type* prepare(size_type n);    // contiguous space for n bytes, or nullptr
+ *     void commit(size_type n);           // n bytes of the prepared space were written
+ *     size_type position() const;
+ *
+ * A Source provides:
+ *
+ *     bool get(char& c);
+ *     int peek();                         // next byte, or -1 at end
+ *     size_type getn(void* dst, size_type n);
+ *     std::string_view contiguous();      // readable bytes in the current window
+ *     void advance(size_type n);          // consume n bytes of contiguous()
+ *     size_type position() const;
+ *     bool at_end();
+ *
+ * sink_streambuf and source_streambuf adapt sinks and sources to std::streambuf, for
+ * code that requires iostreams.
+ */
+
+namespace util
+{
+
+/** \brief Sink that writes into a single, expandable mutable_buffer.
+ */
+class membuf_sink
+{
+public:
+	membuf_sink(size_type capacity = UTIL_MEMIO_DEFAULT_CAPACITY) : membuf_sink{util::mutable_buffer{capacity}} {}
+
+	/** \brief Construct over an existing buffer; writing begins at the buffer's current size.
+	 */
+	membuf_sink(util::mutable_buffer&& buf) : m_buf{std::move(buf)}
+	{
+		reset_ptrs(m_buf.size());
+	}
+
+	membuf_sink(membuf_sink&& rhs) : m_buf{}
+	{
+		auto pos = rhs.position();
+		rhs.sync_size();
+		m_buf = std::move(rhs.m_buf);
+		reset_ptrs(pos);
+		rhs.reset_ptrs(0);
+	}
+
+	membuf_sink(membuf_sink const&) = delete;
+	membuf_sink&
+	operator=(membuf_sink const&) = delete;
+
+	void
+	put(char c)
+	{
+		if (m_next >= m_end)
+		{
+			grow(1);
+		}
+		*m_next++ = static_cast<byte_type>(c);
+	}
+
+	void
+	putn(const void* src, size_type n)
+	{
+		if (static_cast<size_type>(m_end - m_next) < n)
+		{
+			grow(n);
+		}
+		std::memcpy(m_next, src, n);
+		m_next += n;
+	}
+
+	byte_type*
+	prepare(size_type n)
+	{
+		if (static_cast<size_type>(m_end - m_next) < n)
+		{
+			grow(n);
+		}
+		return m_next;
+	}
+
+	void
+	commit(size_type n)
+	{
+		assert(m_next + n <= m_end);
+		m_next += n;
+	}
+
+	size_type
+	position() const
+	{
+		return static_cast<size_type>(m_next - m_buf.data());
+	}
+
+	util::mutable_buffer const&
+	get_buffer()
+	{
+		sync_size();
+		return m_buf;
+	}
+
+	util::mutable_buffer
+	release_buffer()
+	{
+		sync_size();
+		util::mutable_buffer result{std::move(m_buf)};
+		reset_ptrs(0);
+		return result;
+	}
+
+private:
+	void
+	reset_ptrs(size_type pos)
+	{
+		m_next = m_buf.data() + pos;
+		m_end  = m_buf.data() + m_buf.capacity();
+	}
+
+	void
+	sync_size()
+	{
+		m_buf.size(position());
+	}
+
+	void
+	grow(size_type n)
+	{
+		auto pos = position();
+		sync_size();    // expand() preserves only size() bytes
+		m_buf.expand(std::max(m_buf.capacity() * 2, std::max<size_type>(pos + n, UTIL_MEMIO_DEFAULT_CAPACITY)));
+		reset_ptrs(pos);
+	}
+
+	util::mutable_buffer m_buf;
+	byte_type*           m_next;
+	byte_type*           m_end;
+};
+
+/** \brief Sink that writes into a sequence of fixed-size segments.
+ *
+ * Segments are obtained from a mutable_buffer_factory, as in omemqbuf, and the released
+ * segment sequence can be used to construct an imemqbuf or a memqbuf_source. Segments are
+ * filled completely, except when prepare() requests more space than remains in the current
+ * segment; the current segment is then closed early.
+ */
+class memqbuf_sink
+{
+public:
+	using buffer_type = std::deque<util::mutable_buffer>;
+
+	memqbuf_sink(size_type alloc_size)
+		: memqbuf_sink{std::make_unique<util::mutable_buffer_alloc_factory<>>(alloc_size)}
+	{}
+
+	memqbuf_sink(std::unique_ptr<mutable_buffer_factory>&& factory)
+		: m_factory{std::move(factory)}, m_next{nullptr}, m_end{nullptr}, m_closed{0}
+	{}
+
+	memqbuf_sink(memqbuf_sink&& rhs)
+		: m_factory{std::move(rhs.m_factory)},
+		  m_buf(std::move(rhs.m_buf)),
+		  m_next{rhs.m_next},
+		  m_end{rhs.m_end},
+		  m_closed{rhs.m_closed}
+	{
+		rhs.m_buf.clear();
+		rhs.reset_ptrs();
+	}
+
+	memqbuf_sink(memqbuf_sink const&) = delete;
+	memqbuf_sink&
+	operator=(memqbuf_sink const&) = delete;
+
+	void
+	put(char c)
+	{
+		if (m_next >= m_end)
+		{
+			next_segment();
+		}
+		*m_next++ = static_cast<byte_type>(c);
+	}
+
+	void
+	putn(const void* src, size_type n)
+	{
+		auto p = reinterpret_cast<const byte_type*>(src);
+		while (n > 0)
+		{
+			if (m_next >= m_end)
+			{
+				next_segment();
+			}
+			auto chunk = std::min(n, static_cast<size_type>(m_end - m_next));
+			std::memcpy(m_next, p, chunk);
+			m_next += chunk;
+			p += chunk;
+			n -= chunk;
+		}
+	}
+
+	/** \brief Obtain contiguous space for \e n bytes.
+	 *
+	 * \return pointer to the space, or nullptr if \e n exceeds the segment size
+	 */
+	byte_type*
+	prepare(size_type n)
+	{
+		byte_type* result{nullptr};
+		if (static_cast<size_type>(m_end - m_next) < n)
+		{
+			if (n > m_factory->size())
+				goto exit;
+			next_segment();
+		}
+		result = m_next;
+	exit:
+		return result;
+	}
+
+	void
+	commit(size_type n)
+	{
+		assert(m_next + n <= m_end);
+		m_next += n;
+	}
+
+	size_type
+	position() const
+	{
+		return m_buf.empty() ? 0 : m_closed + static_cast<size_type>(m_next - m_buf.back().data());
+	}
+
+	buffer_type const&
+	get_buffer()
+	{
+		sync_size();
+		return m_buf;
+	}
+
+	buffer_type
+	release_buffer()
+	{
+		sync_size();
+		buffer_type result(std::move(m_buf));
+		m_buf.clear();
+		reset_ptrs();
+		return result;
+	}
+
+private:
+	void
+	reset_ptrs()
+	{
+		m_next   = nullptr;
+		m_end    = nullptr;
+		m_closed = 0;
+	}
+
+	void
+	sync_size()
+	{
+		if (!m_buf.empty())
+		{
+			m_buf.back().size(static_cast<size_type>(m_next - m_buf.back().data()));
+		}
+	}
+
+	void
+	next_segment()
+	{
+		if (!m_buf.empty())
+		{
+			sync_size();
+			m_closed += m_buf.back().size();
+		}
+		m_buf.emplace_back(m_factory->create());
+		auto& segment = m_buf.back();
+		m_next        = segment.data();
+		m_end         = segment.data() + segment.capacity();
+	}
+
+	std::unique_ptr<mutable_buffer_factory> m_factory;
+	buffer_type                             m_buf;
+	byte_type*                              m_next;
+	byte_type*                              m_end;
+	size_type                               m_closed;    // bytes in segments preceding the current segment
+};
+
+/** \brief Source that reads from a single buffer.
+ *
+ * The source owns the buffer it reads from.
+ */
+class membuf_source
+{
+public:
+	membuf_source(util::const_buffer&& buf) : m_buf{std::move(buf)}
+	{
+		m_next = m_buf.data();
+		m_end  = m_buf.data() + m_buf.size();
+	}
+
+	membuf_source(util::mutable_buffer&& buf) : membuf_source{util::const_buffer{std::move(buf)}} {}
+
+	bool
+	get(char& c)
+	{
+		bool result{false};
+		if (m_next < m_end)
+		{
+			c      = static_cast<char>(*m_next++);
+			result = true;
+		}
+		return result;
+	}
+
+	int
+	peek()
+	{
+		return (m_next < m_end) ? static_cast<int>(*m_next) : -1;
+	}
+
+	size_type
+	getn(void* dst, size_type n)
+	{
+		n = std::min(n, static_cast<size_type>(m_end - m_next));
+		std::memcpy(dst, m_next, n);
+		m_next += n;
+		return n;
+	}
+
+	std::string_view
+	contiguous()
+	{
+		return std::string_view{reinterpret_cast<const char*>(m_next), static_cast<size_type>(m_end - m_next)};
+	}
+
+	void
+	advance(size_type n)
+	{
+		assert(m_next + n <= m_end);
+		m_next += n;
+	}
+
+	size_type
+	position() const
+	{
+		return static_cast<size_type>(m_next - m_buf.data());
+	}
+
+	bool
+	at_end()
+	{
+		return m_next >= m_end;
+	}
+
+	util::const_buffer const&
+	get_buffer() const
+	{
+		return m_buf;
+	}
+
+private:
+	util::const_buffer m_buf;
+	const byte_type*   m_next;
+	const byte_type*   m_end;
+};
+
+/** \brief Source that reads from a sequence of segments.
+ *
+ * Accepts the segment sequences produced by omemqbuf and memqbuf_sink. Empty segments are
+ * skipped. contiguous() exposes the unread portion of the current segment only; callers
+ * that need to examine a run of bytes that straddles segments must assemble it themselves.
+ */
+class memqbuf_source
+{
+public:
+	using buffer_type = std::deque<util::const_buffer>;
+
+	memqbuf_source(buffer_type&& buf) : m_buf{std::move(buf)}, m_current{0}, m_base{0}
+	{
+		sync_current_segment();
+	}
+
+	memqbuf_source(std::deque<util::mutable_buffer>&& buf) : m_buf{}, m_current{0}, m_base{0}
+	{
+		for (auto& segment : buf)
+		{
+			m_buf.emplace_back(std::move(segment));
+		}
+		buf.clear();
+		sync_current_segment();
+	}
+
+	bool
+	get(char& c)
+	{
+		bool result{false};
+		if (m_next < m_end || next_segment())
+		{
+			c      = static_cast<char>(*m_next++);
+			result = true;
+		}
+		return result;
+	}
+
+	int
+	peek()
+	{
+		return (m_next < m_end || next_segment()) ? static_cast<int>(*m_next) : -1;
+	}
+
+	size_type
+	getn(void* dst, size_type n)
+	{
+		auto      p = reinterpret_cast<byte_type*>(dst);
+		size_type count{0};
+		while (count < n && (m_next < m_end || next_segment()))
+		{
+			auto chunk = std::min(n - count, static_cast<size_type>(m_end - m_next));
+			std::memcpy(p + count, m_next, chunk);
+			m_next += chunk;
+			count += chunk;
+		}
+		return count;
+	}
+
+	std::string_view
+	contiguous()
+	{
+		if (m_next >= m_end)
+		{
+			next_segment();
+		}
+		return std::string_view{reinterpret_cast<const char*>(m_next), static_cast<size_type>(m_end - m_next)};
+	}
+
+	void
+	advance(size_type n)
+	{
+		assert(m_next + n <= m_end);
+		m_next += n;
+	}
+
+	size_type
+	position() const
+	{
+		return (m_current < m_buf.size()) ? m_base + static_cast<size_type>(m_next - m_buf[m_current].data()) : m_base;
+	}
+
+	bool
+	at_end()
+	{
+		return m_next >= m_end && !next_segment();
+	}
+
+	buffer_type const&
+	get_buffer() const
+	{
+		return m_buf;
+	}
+
+	buffer_type
+	release_buffer()
+	{
+		buffer_type result(std::move(m_buf));
+		m_buf.clear();
+		m_current = 0;
+		m_base    = 0;
+		sync_current_segment();
+		return result;
+	}
+
+private:
+	void
+	sync_current_segment()
+	{
+		while (m_current < m_buf.size() && m_buf[m_current].size() == 0)
+		{
+			++m_current;
+		}
+		if (m_current < m_buf.size())
+		{
+			m_next = m_buf[m_current].data();
+			m_end  = m_next + m_buf[m_current].size();
+		}
+		else
+		{
+			m_next = nullptr;
+			m_end  = nullptr;
+		}
+	}
+
+	bool
+	next_segment()
+	{
+		bool result{false};
+		if (m_current < m_buf.size())
+		{
+			m_base += m_buf[m_current].size();
+			++m_current;
+			sync_current_segment();
+			result = m_next < m_end;
+		}
+		return result;
+	}
+
+	buffer_type      m_buf;
+	std::size_t      m_current;
+	size_type        m_base;    // offset of the current segment
+	const byte_type* m_next;
+	const byte_type* m_end;
+};
+
+/** \brief Output streambuf adapter for a sink.
+ *
+ * The adapter does not own the sink.
+ */
+template<class Sink>
+class sink_streambuf : public std::streambuf
+{
+public:
+	sink_streambuf(Sink& sink) : m_sink{sink}
+	{
+		setp(nullptr, nullptr);
+	}
+
+protected:
+	virtual std::streamsize
+	xsputn(const char_type* src, std::streamsize n) override
+	{
+		m_sink.putn(src, static_cast<size_type>(n));
+		return n;
+	}
+
+	virtual int_type
+	overflow(int_type ch = traits_type::eof()) override
+	{
+		if (!traits_type::eq_int_type(ch, traits_type::eof()))
+		{
+			m_sink.put(traits_type::to_char_type(ch));
+		}
+		return traits_type::not_eof(ch);
+	}
+
+	Sink& m_sink;
+};
+
+/** \brief Input streambuf adapter for a source.
+ *
+ * The get area is the source's current contiguous window, so characters are read without
+ * virtual calls until a window is exhausted. The source position is brought up to date
+ * by sync(), by underflow(), and on destruction. The adapter does not own the source.
+ */
+template<class Source>
+class source_streambuf : public std::streambuf
+{
+public:
+	source_streambuf(Source& source) : m_source{source}
+	{
+		setg(nullptr, nullptr, nullptr);
+	}
+
+	~source_streambuf()
+	{
+		sync();
+	}
+
+protected:
+	virtual int
+	sync() override
+	{
+		m_source.advance(static_cast<size_type>(gptr() - eback()));
+		setg(gptr(), gptr(), egptr());
+		return 0;
+	}
+
+	virtual int_type
+	underflow() override
+	{
+		int_type result = traits_type::eof();
+		sync();
+		auto window = m_source.contiguous();
+		if (!window.empty())
+		{
+			char_type* base = const_cast<char_type*>(window.data());
+			setg(base, base, base + window.size());
+			result = traits_type::to_int_type(*gptr());
+		}
+		return result;
+	}
+
+	Source& m_source;
+};
+
+}    // namespace util
+
+#endif    // UTIL_MEMIO_H
@@ -0,0 +1,442 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef UTIL_MT_PROMISE_H
+#define UTIL_MT_PROMISE_H
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <system_error>
+#include <type_traits>
+#include <util/executor.h>
+#include <util/pool_allocator.h>
+#include <util/unique_function.h>
+#include <utility>
+
+#ifndef UTIL_PROMISE_POOL_SHARED
+#define UTIL_PROMISE_POOL_SHARED 1
+#endif
+
+namespace util
+{
+namespace mt
+{
+template<class T>
+class promise;
+}    // namespace mt
+
+namespace detail
+{
+
+template<class T>
+struct is_mt_promise : public std::false_type
+{};
+
+template<class T>
+struct is_mt_promise<mt::promise<T>> : public std::true_type
+{};
+
+template<class R>
+struct mt_unwrap_promise
+{
+	using type = R;
+};
+
+template<class U>
+struct mt_unwrap_promise<mt::promise<U>>
+{
+	using type = U;
+};
+
+template<class T, class F>
+struct mt_invoke_result
+{
+	using type = std::invoke_result_t<F&, T&&>;
+};
+
+template<class F>
+struct mt_invoke_result<void, F>
+{
+	using type = std::invoke_result_t<F&>;
+};
+
+struct mt_void_value
+{};
+
+/** \brief Shared state of a util::mt::promise.
+ *
+ * The result and the continuation are each published by setting a bit in \e flags with an
+ * acquire-release fetch_or. Whichever side sets its bit second observes the other's bit, and
+ * runs the continuation; the two never contend for a lock.
+ */
+template<class T>
+struct mt_promise_state
+{
+	using value_type     = std::conditional_t<std::is_void<T>::value, mt_void_value, T>;
+	using continuation_f = util::unique_function<void(mt_promise_state&)>;
+
+	static constexpr std::uint32_t claimed  = 1;    // a producer has begun to set the result
+	static constexpr std::uint32_t ready    = 2;    // the result is published
+	static constexpr std::uint32_t failed   = 4;    // the result is an error
+	static constexpr std::uint32_t attached = 8;    // the continuation is published
+
+	/** \brief Obtain the exclusive right to set the result.
+	 */
+	bool
+	claim()
+	{
+		return (flags.fetch_or(claimed, std::memory_order_acquire) & claimed) == 0;
+	}
+
+	void
+	publish(std::uint32_t result_flags)
+	{
+		auto prev = flags.fetch_or(ready | result_flags, std::memory_order_acq_rel);
+		if (prev & attached)
+		{
+			run_continuation();
+		}
+	}
+
+	void
+	attach(continuation_f&& func)
+	{
+		continuation = std::move(func);
+		auto prev    = flags.fetch_or(attached, std::memory_order_acq_rel);
+		assert((prev & attached) == 0);    // only one continuation may be attached
+		if (prev & ready)
+		{
+			run_continuation();
+		}
+	}
+
+	void
+	run_continuation()
+	{
+		auto func = std::move(continuation);
+		func(*this);
+	}
+
+	bool
+	is_failed() const
+	{
+		return (flags.load(std::memory_order_relaxed) & failed) != 0;
+	}
+
+	std::atomic<std::uint32_t> refs{1};
+	std::atomic<std::uint32_t> flags{0};
+	continuation_f             continuation;
+	std::optional<value_type>  value;
+	std::error_code            err;
+};
+
+}    // namespace detail
+
+namespace mt
+{
+
+/** \brief Promise that may be resolved on one thread while continuations are attached on another.
+ *
+ * Unlike util::promise, the shared state is reference counted atomically, and the result and
+ * the continuation are handed off without locking. A promise has at most one continuation,
+ * attached with one of then(), then_on(), catcher() or catcher_on(). The continuation of
+ * then_on() or catcher_on() is posted to the given executor (see util/executor.h), rather
+ * than being run on whichever thread resolved the promise; then() and catcher() use
+ * util::inline_executor.
+ *
+ * then() and then_on() return a new promise for the result of the continuation. If the
+ * continuation returns an mt::promise, the returned promise adopts that promise's result.
+ * A rejection skips then() continuations, and propagates down the chain to a catcher().
+ */
+template<class T>
+class promise
+{
+public:
+	using value_type  = T;
+	using shared_type = util::detail::mt_promise_state<T>;
+
+	template<class U>
+	friend class promise;
+
+	promise() : m_shared{new_shared()} {}
+
+	promise(promise const& rhs) noexcept : m_shared{rhs.m_shared}
+	{
+		if (m_shared)
+		{
+			m_shared->refs.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	promise(promise&& rhs) noexcept : m_shared{rhs.m_shared}
+	{
+		rhs.m_shared = nullptr;
+	}
+
+	~promise()
+	{
+		release();
+	}
+
+	promise&
+	operator=(promise const& rhs) noexcept
+	{
+		promise{rhs}.swap(*this);
+		return *this;
+	}
+
+	promise&
+	operator=(promise&& rhs) noexcept
+	{
+		promise{std::move(rhs)}.swap(*this);
+		return *this;
+	}
+
+	void
+	swap(promise& rhs) noexcept
+	{
+		std::swap(m_shared, rhs.m_shared);
+	}
+
+	/** \brief Resolve the promise with a value constructed from \e args (no arguments for promise<void>).
+	 *
+	 * \return false if the promise was already resolved or rejected, in which case \e args are unused
+	 */
+	template<class... Args>
+	bool
+	resolve(Args&&... args)
+	{
+		assert(m_shared);
+		if (!m_shared->claim())
+		{
+			return false;
+		}
+		m_shared->value.emplace(std::forward<Args>(args)...);
+		m_shared->publish(0);
+		return true;
+	}
+
+	/** \brief Reject the promise.
+	 *
+	 * \return false if the promise was already resolved or rejected
+	 */
+	bool
+	reject(std::error_code const& err)
+	{
+		assert(m_shared);
+		if (!m_shared->claim())
+		{
+			return false;
+		}
+		m_shared->err = err;
+		m_shared->publish(shared_type::failed);
+		return true;
+	}
+
+	bool
+	is_finished() const
+	{
+		return m_shared && (m_shared->flags.load(std::memory_order_acquire) & shared_type::ready) != 0;
+	}
+
+	bool
+	is_resolved() const
+	{
+		return m_shared
+			   && (m_shared->flags.load(std::memory_order_acquire) & (shared_type::ready | shared_type::failed))
+						  == shared_type::ready;
+	}
+
+	bool
+	is_rejected() const
+	{
+		return m_shared && (m_shared->flags.load(std::memory_order_acquire) & shared_type::failed) != 0;
+	}
+
+	/** \brief Attach a continuation, to be posted to \e ex when the promise is resolved.
+	 *
+	 * \param func invoked with the value (or with no arguments, for promise<void>)
+	 * \return a promise for the result of \e func
+	 */
+	template<class Executor, class F>
+	promise<typename util::detail::mt_unwrap_promise<typename util::detail::mt_invoke_result<T, F>::type>::type>
+	then_on(Executor ex, F&& func)
+	{
+		using result_type = typename util::detail::mt_invoke_result<T, F>::type;
+		using ret_type    = promise<typename util::detail::mt_unwrap_promise<result_type>::type>;
+
+		assert(m_shared);
+		ret_type ret;
+		m_shared->attach([ex = std::move(ex), func = std::forward<F>(func), ret](shared_type& s) mutable {
+			if (s.is_failed())
+			{
+				ret.reject(s.err);
+			}
+			else
+			{
+				ex.post([func = std::move(func), ret = std::move(ret), self = promise{&s}]() mutable {
+					self.deliver(func, ret);
+				});
+			}
+		});
+		return ret;
+	}
+
+	template<class F>
+	auto
+	then(F&& func)
+	{
+		return then_on(util::inline_executor{}, std::forward<F>(func));
+	}
+
+	/** \brief Attach a continuation, to be posted to \e ex if the promise is rejected.
+	 *
+	 * \param func invoked with the std::error_code; not invoked if the promise is resolved
+	 */
+	template<class Executor, class F>
+	void
+	catcher_on(Executor ex, F&& func)
+	{
+		assert(m_shared);
+		m_shared->attach([ex = std::move(ex), func = std::forward<F>(func)](shared_type& s) mutable {
+			if (s.is_failed())
+			{
+				ex.post([func = std::move(func), err = s.err]() mutable { func(err); });
+			}
+		});
+	}
+
+	template<class F>
+	void
+	catcher(F&& func)
+	{
+		catcher_on(util::inline_executor{}, std::forward<F>(func));
+	}
+
+private:
+	explicit promise(shared_type* shared) noexcept : m_shared{shared}
+	{
+		m_shared->refs.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	template<class F>
+	decltype(auto)
+	invoke(F& func)
+	{
+		if constexpr (std::is_void<T>::value)
+		{
+			return func();
+		}
+		else
+		{
+			return func(std::move(*m_shared->value));
+		}
+	}
+
+	template<class F, class U>
+	void
+	deliver(F& func, promise<U>& ret)
+	{
+		using result_type = typename util::detail::mt_invoke_result<T, F>::type;
+		if constexpr (std::is_void<result_type>::value)
+		{
+			invoke(func);
+			ret.resolve();
+		}
+		else if constexpr (util::detail::is_mt_promise<result_type>::value)
+		{
+			invoke(func).forward_to(std::move(ret));
+		}
+		else
+		{
+			ret.resolve(invoke(func));
+		}
+	}
+
+	// settle target with this promise's result, on the thread that produces it
+	void
+	forward_to(promise target)
+	{
+		m_shared->attach([target = std::move(target)](shared_type& s) mutable {
+			if (s.is_failed())
+			{
+				target.reject(s.err);
+			}
+			else if constexpr (std::is_void<T>::value)
+			{
+				target.resolve();
+			}
+			else
+			{
+				target.resolve(std::move(*s.value));
+			}
+		});
+	}
+
+	void
+	release() noexcept
+	{
+		if (m_shared && m_shared->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			delete_shared(m_shared);
+		}
+		m_shared = nullptr;
+	}
+
+	static shared_type*
+	new_shared()
+	{
+#if (UTIL_PROMISE_POOL_SHARED)
+		if constexpr (alignof(shared_type) <= alignof(std::max_align_t))
+		{
+			return new (object_pool<shared_type>::instance().allocate()) shared_type;
+		}
+#endif
+		return new shared_type;
+	}
+
+	static void
+	delete_shared(shared_type* shared) noexcept
+	{
+#if (UTIL_PROMISE_POOL_SHARED)
+		if constexpr (alignof(shared_type) <= alignof(std::max_align_t))
+		{
+			shared->~shared_type();
+			object_pool<shared_type>::instance().deallocate(shared);
+			return;
+		}
+#endif
+		delete shared;
+	}
+
+	shared_type* m_shared;
+};
+
+}    // namespace mt
+}    // namespace util
+
+#endif    // UTIL_MT_PROMISE_H
@@ -0,0 +1,332 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef UTIL_POOL_ALLOCATOR_H
+#define UTIL_POOL_ALLOCATOR_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <util/shared_ptr.h>
+#include <vector>
+
+#ifndef UTIL_POOL_CACHE_LIMIT
+#define UTIL_POOL_CACHE_LIMIT 64
+#endif
+
+namespace util
+{
+
+/** \brief Occupancy statistics for an object_pool.
+ */
+struct pool_stats
+{
+	std::size_t block_size;    // bytes per block
+	std::size_t in_use;        // blocks currently allocated
+	std::size_t high_water;    // most blocks observed in use at once (sampled when caches refill, and by stats())
+	std::size_t capacity;      // blocks obtained from the heap
+};
+
+/** \brief Pool of fixed-size blocks for objects of type T, with a cache of free blocks per thread.
+ *
+ * Blocks are obtained from the heap in slabs, and are never returned to the heap. A freed
+ * block goes to the cache of the freeing thread; when a cache exceeds UTIL_POOL_CACHE_LIMIT
+ * blocks, half of them are moved to a shared free list, from which empty caches are refilled.
+ * Allocation and deallocation therefore take a lock only once per UTIL_POOL_CACHE_LIMIT / 2
+ * operations. A thread's cache is returned to the shared free list when the thread exits.
+ */
+template<class T>
+class object_pool
+{
+public:
+	static constexpr std::size_t block_size     = (sizeof(T) < sizeof(void*)) ? sizeof(void*) : sizeof(T);
+	static constexpr std::size_t cache_limit    = UTIL_POOL_CACHE_LIMIT;
+	static constexpr std::size_t transfer_count = (cache_limit / 2 > 0) ? cache_limit / 2 : 1;
+
+	static_assert(alignof(T) <= alignof(std::max_align_t), "object_pool does not support over-aligned types");
+
+	static object_pool&
+	instance()
+	{
+		// never destroyed, since thread caches may be returned during static destruction
+		static object_pool* pool = new object_pool;
+		return *pool;
+	}
+
+	void*
+	allocate()
+	{
+		auto& c = local();
+		c.m_balance.store(c.m_balance.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		if (!c.m_head)
+		{
+			refill(c);    // samples the high water mark, including this allocation
+		}
+		auto n   = c.m_head;
+		c.m_head = n->next;
+		--c.m_count;
+		return n;
+	}
+
+	void
+	deallocate(void* p)
+	{
+		auto& c  = local();
+		auto  n  = static_cast<node*>(p);
+		n->next  = c.m_head;
+		c.m_head = n;
+		++c.m_count;
+		c.m_balance.store(c.m_balance.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+		if (c.m_count > cache_limit)
+		{
+			std::lock_guard<std::mutex> lock{m_mutex};
+			transfer(c.m_head, c.m_count, m_free, m_free_count, transfer_count);
+		}
+	}
+
+	pool_stats
+	stats()
+	{
+		std::lock_guard<std::mutex> lock{m_mutex};
+		auto                        in_use = sample_in_use();
+		return pool_stats{block_size, in_use, m_high_water, m_capacity};
+	}
+
+private:
+	struct node
+	{
+		node* next;
+	};
+
+	struct cache
+	{
+		cache() : m_head{nullptr}, m_count{0}, m_balance{0}
+		{
+			object_pool::instance().attach(this);
+		}
+
+		~cache()
+		{
+			object_pool::instance().detach(this);
+		}
+
+		node*             m_head;
+		std::size_t       m_count;
+		std::atomic<long> m_balance;    // allocations less deallocations on this thread
+	};
+
+	object_pool() : m_free{nullptr}, m_free_count{0}, m_retired_balance{0}, m_high_water{0}, m_capacity{0} {}
+
+	static cache&
+	local()
+	{
+		static thread_local cache instance;
+		return instance;
+	}
+
+	static void
+	transfer(node*& from, std::size_t& from_count, node*& to, std::size_t& to_count, std::size_t count)
+	{
+		while (count > 0 && from)
+		{
+			auto n  = from;
+			from    = n->next;
+			n->next = to;
+			to      = n;
+			--from_count;
+			++to_count;
+			--count;
+		}
+	}
+
+	void
+	refill(cache& c)
+	{
+		std::lock_guard<std::mutex> lock{m_mutex};
+		if (!m_free)
+		{
+			auto slab = static_cast<char*>(::operator new(block_size * transfer_count));
+			m_slabs.push_back(slab);
+			for (std::size_t i = 0; i < transfer_count; ++i)
+			{
+				auto n  = reinterpret_cast<node*>(slab + (i * block_size));
+				n->next = m_free;
+				m_free  = n;
+				++m_free_count;
+			}
+			m_capacity += transfer_count;
+		}
+		transfer(m_free, m_free_count, c.m_head, c.m_count, transfer_count);
+		sample_in_use();
+	}
+
+	void
+	attach(cache* c)
+	{
+		std::lock_guard<std::mutex> lock{m_mutex};
+		m_caches.push_back(c);
+	}
+
+	void
+	detach(cache* c)
+	{
+		std::lock_guard<std::mutex> lock{m_mutex};
+		transfer(c->m_head, c->m_count, m_free, m_free_count, c->m_count);
+		m_retired_balance += c->m_balance.load(std::memory_order_relaxed);
+		m_caches.erase(std::remove(m_caches.begin(), m_caches.end(), c), m_caches.end());
+	}
+
+	// requires m_mutex
+	std::size_t
+	sample_in_use()
+	{
+		long in_use = m_retired_balance;
+		for (auto c : m_caches)
+		{
+			in_use += c->m_balance.load(std::memory_order_relaxed);
+		}
+		auto result  = static_cast<std::size_t>(std::max(in_use, 0L));
+		m_high_water = std::max(m_high_water, result);
+		return result;
+	}
+
+	std::mutex          m_mutex;
+	node*               m_free;
+	std::size_t         m_free_count;
+	std::vector<cache*> m_caches;
+	std::vector<char*>  m_slabs;
+	long                m_retired_balance;
+	std::size_t         m_high_water;
+	std::size_t         m_capacity;
+};
+
+/** \brief Allocator that takes single objects from object_pool<T>.
+ *
+ * Requests for more than one object are passed to the global operator new.
+ */
+template<class T>
+class pool_allocator
+{
+public:
+	using value_type      = T;
+	using pointer         = T*;
+	using const_pointer   = T const*;
+	using reference       = T&;
+	using const_reference = T const&;
+	using size_type       = std::size_t;
+	using difference_type = std::ptrdiff_t;
+
+	template<class U>
+	struct rebind
+	{
+		using other = pool_allocator<U>;
+	};
+
+	pool_allocator() noexcept {}
+
+	template<class U>
+	pool_allocator(pool_allocator<U> const&) noexcept
+	{}
+
+	pointer
+	allocate(size_type count)
+	{
+		if (count == 1)
+		{
+			return static_cast<pointer>(object_pool<T>::instance().allocate());
+		}
+		return static_cast<pointer>(::operator new(count * sizeof(T)));
+	}
+
+	void
+	deallocate(pointer p, size_type count)
+	{
+		if (count == 1)
+		{
+			object_pool<T>::instance().deallocate(p);
+		}
+		else
+		{
+			::operator delete(p);
+		}
+	}
+};
+
+template<class T, class U>
+inline bool
+operator==(pool_allocator<T> const&, pool_allocator<U> const&) noexcept
+{
+	return true;
+}
+
+template<class T, class U>
+inline bool
+operator!=(pool_allocator<T> const&, pool_allocator<U> const&) noexcept
+{
+	return false;
+}
+
+/** \brief Create a shared object whose control block and value are allocated from a per-type pool.
+ */
+template<class T, class... Args>
+inline shared_ptr<T>
+make_pooled(Args&&... args)
+{
+	static_assert(!std::is_array<T>::value, "make_pooled does not support array types");
+	return allocate_shared<T>(pool_allocator<T>{}, std::forward<Args>(args)...);
+}
+
+#if (!UTIL_USE_STD_SHARED_PTR)
+
+/** \brief Statistics for the pool used by make_pooled<T>().
+ */
+template<class T>
+inline pool_stats
+pooled_stats()
+{
+	return object_pool<detail::value_ctrl_blk<T, pool_allocator<T>>>::instance().stats();
+}
+
+namespace mt
+{
+
+template<class T, class... Args>
+inline shared_ptr<T>
+make_pooled(Args&&... args)
+{
+	static_assert(!std::is_array<T>::value, "make_pooled does not support array types");
+	return mt::allocate_shared<T>(pool_allocator<T>{}, std::forward<Args>(args)...);
+}
+
+}    // namespace mt
+
+#endif
+
+}    // namespace util
+
+#endif    // UTIL_POOL_ALLOCATOR_H
@@ -38,13 +38,29 @@
 #include <boost/container/deque.hpp>
 #include <cassert>
 #include <cstdlib>
-#include <functional>
 #include <iostream>
 #include <memory>
+#include <optional>
 #include <string>
 #include <system_error>
+#include <tuple>
+#include <util/cancellation.h>
+#include <util/error.h>
+#include <util/executor.h>
+#include <util/intrusive_ptr.h>
+#include <util/pool_allocator.h>
+#include <util/unique_function.h>
+#include <variant>
 #include <vector>
 
+/*
+ * If UTIL_PROMISE_POOL_SHARED is non-zero, the shared state of each promise is allocated from
+ * a per-type object_pool, with a cache of free blocks per thread, rather than from the heap.
+ */
+#ifndef UTIL_PROMISE_POOL_SHARED
+#define UTIL_PROMISE_POOL_SHARED 1
+#endif
+
 namespace util
 {
 
@@ -100,19 +116,31 @@ template<typename T>
 struct is_void_promise : public std::false_type
 {};
 
+template<typename T>
+struct promise_result
+{
+	using type = T;
+};
+
+template<typename T>
+struct promise_result<promise<T>>
+{
+	using type = T;
+};
+
 template<>
 struct is_void_promise<promise<void>> : public std::true_type
 {};
 
 template<class T>
-struct __promise_shared
+struct __promise_shared : public detail::cancellation_link
 {
-	typedef std::function<void(T&&)>                    resolve_f;
-	typedef std::function<void(std::error_code const&)> reject_f;
-	typedef std::function<void()>                       finally_f;
-	typedef boost::container::deque<T>                  maybe_array_type;
-	using timeout_f      = std::function<void(std::error_code const&)>;
-	using cancel_timer_f = std::function<void()>;
+	typedef util::unique_function<void(T&&)>                    resolve_f;
+	typedef util::unique_function<void(std::error_code const&)> reject_f;
+	typedef util::unique_function<void()>                       finally_f;
+	typedef boost::container::deque<T>                          maybe_array_type;
+	using timeout_f      = util::unique_function<void(std::error_code const&)>;
+	using cancel_timer_f = util::unique_function<void()>;
 
 	bool            resolved;
 	bool            rejected;
@@ -127,14 +155,14 @@ struct __promise_shared
 };
 
 template<>
-struct __promise_shared<void>
+struct __promise_shared<void> : public detail::cancellation_link
 {
-	typedef std::function<void()>                       resolve_f;
-	typedef std::function<void(std::error_code const&)> reject_f;
-	typedef std::function<void()>                       finally_f;
-	typedef void                                        maybe_array_type;
-	using timeout_f      = std::function<void(std::error_code const&)>;
-	using cancel_timer_f = std::function<void()>;
+	typedef util::unique_function<void()>                       resolve_f;
+	typedef util::unique_function<void(std::error_code const&)> reject_f;
+	typedef util::unique_function<void()>                       finally_f;
+	typedef void                                                maybe_array_type;
+	using timeout_f      = util::unique_function<void(std::error_code const&)>;
+	using cancel_timer_f = util::unique_function<void()>;
 
 	bool            resolved;
 	bool            rejected;
@@ -155,12 +183,16 @@ public:
 	typedef boost::container::deque<promise<T>>    array_type;
 	typedef __promise_shared<T>                    shared_type;
 	typedef typename shared_type::maybe_array_type maybe_array_type;
+	typedef T                                      value_type;
 
-	using timeout_f = std::function<void(std::error_code const&)>;
+	using timeout_f = util::unique_function<void(std::error_code const&)>;
 
 	template<class U>
 	friend class promise_timer;
 
+	template<class U>
+	friend class promise;
+
 	template<class Q = T>
 	static typename std::enable_if_t<std::is_void<Q>::value, promise<T>>
 	build()
@@ -230,7 +262,7 @@ public:
 		return ok;
 	}
 
-	promise() : m_shared(new __promise_shared<T>)
+	promise() : m_shared(new_shared())
 	{
 		m_shared->resolved     = false;
 		m_shared->rejected     = false;
@@ -242,7 +274,7 @@ public:
 		m_shared->refs         = 1;
 	}
 
-	promise(timeout_f tf) : m_shared(new __promise_shared<T>)
+	promise(timeout_f tf) : m_shared(new_shared())
 	{
 		m_shared->resolved     = false;
 		m_shared->rejected     = false;
@@ -260,7 +292,7 @@ public:
 		copy(rhs);
 	}
 
-	promise(promise&& rhs) : m_shared(nullptr)
+	promise(promise&& rhs) noexcept : m_shared(nullptr)
 	{
 		move(std::move(rhs));
 	}
@@ -278,7 +310,7 @@ public:
 	}
 
 	inline const promise&
-	operator=(promise&& rhs)
+	operator=(promise&& rhs) noexcept
 	{
 		move(std::move(rhs));
 		return *this;
@@ -398,12 +430,56 @@ public:
 			}
 			else
 			{
-				m_shared->err = err;
+				// the continuation can never run, so release whatever it captured
+				m_shared->resolve = nullptr;
+				cancel_timer();
 			}
 			m_shared->on_timeout = nullptr;
 		}
 	}
 
+	/** \brief Reject the promise with \e err, if it is not finished, releasing its captured state first.
+	 *
+	 * The continuation and timeout handler are destroyed, and any timer is cancelled, before the
+	 * rejection is delivered; stages chained from this promise are rejected in turn.
+	 */
+	void
+	cancel(std::error_code const& err = make_error_code(std::errc::operation_canceled))
+	{
+		if (m_shared && !is_finished())
+		{
+			m_shared->unlink();
+			m_shared->resolve    = nullptr;
+			m_shared->on_timeout = nullptr;
+			reject(err);
+		}
+	}
+
+	/** \brief Cancel this promise (with std::errc::operation_canceled) when \e token is cancelled.
+	 *
+	 * Promises returned by subsequent calls to then() and then_on() are bound to the same token,
+	 * so cancellation rejects every stage of the chain that is still pending, including stages
+	 * waiting on a promise returned by a continuation. Replaces any earlier binding. If the token
+	 * is already cancelled, the promise is cancelled immediately.
+	 */
+	promise<T>&
+	with_cancellation(cancellation_token const& token)
+	{
+		if (m_shared)
+		{
+			bind(token.m_state);
+		}
+		return *this;
+	}
+
+	/** \brief The token this promise is bound to, if any.
+	 */
+	cancellation_token
+	bound_token() const
+	{
+		return m_shared ? cancellation_token{m_shared->state} : cancellation_token{};
+	}
+
 	inline bool
 	is_resolved() const
 	{
@@ -474,8 +550,8 @@ public:
 		else
 		{
 			assert(rhs.m_shared->resolve != nullptr);
-			m_shared->resolve = rhs.m_shared->resolve;
-			m_shared->reject  = rhs.m_shared->reject;
+			m_shared->resolve = std::move(rhs.m_shared->resolve);
+			m_shared->reject  = std::move(rhs.m_shared->reject);
 			// TODO: copy finally? (and timer-related stuff)
 		}
 	}
@@ -495,8 +571,8 @@ public:
 		else
 		{
 			assert(rhs.m_shared->resolve != nullptr);
-			m_shared->resolve = rhs.m_shared->resolve;
-			m_shared->reject  = rhs.m_shared->reject;
+			m_shared->resolve = std::move(rhs.m_shared->resolve);
+			m_shared->reject  = std::move(rhs.m_shared->reject);
 			// TODO: copy finally? (and timer-related stuff)
 		}
 	}
@@ -542,12 +618,117 @@ public:
 		return *this;
 	}
 
+	/** \brief Like then(), but \e func is posted to \e ex, rather than run within resolve().
+	 *
+	 * A rejection is propagated to the returned promise without involving \e ex. Since
+	 * util::promise is not thread safe, \e ex must run work on the thread that owns this
+	 * chain (see runs_on_calling_thread); for other executors, use then_on(ex, home, func).
+	 *
+	 * \return a promise for the result of \e func; if \e func returns a promise, for that promise's result
+	 */
+	template<class Executor, class Func>
+	auto
+	then_on(Executor ex, Func&& func)
+	{
+		static_assert(
+				runs_on_calling_thread<Executor>::value,
+				"util::promise::then_on() requires an executor that runs work on the calling thread; "
+				"use then_on(ex, home, func) or util::mt::promise");
+
+		if constexpr (std::is_void<T>::value)
+		{
+			using result_type = std::invoke_result_t<std::decay_t<Func>&>;
+			using ret_type    = promise<typename promise_result<result_type>::type>;
+
+			return then([ex = std::move(ex), func = std::forward<Func>(func)]() mutable {
+				ret_type ret;
+				ex.post([func = std::move(func), ret]() mutable { settle(func, ret); });
+				return ret;
+			});
+		}
+		else
+		{
+			using result_type = std::invoke_result_t<std::decay_t<Func>&, T&&>;
+			using ret_type    = promise<typename promise_result<result_type>::type>;
+
+			return then([ex = std::move(ex), func = std::forward<Func>(func)](T&& val) mutable {
+				ret_type ret;
+				ex.post([func = std::move(func), ret, val = std::move(val)]() mutable {
+					settle(func, ret, std::move(val));
+				});
+				return ret;
+			});
+		}
+	}
+
+	/** \brief Like then(), but \e func runs on \e ex, which may be on another thread (a thread_pool,
+	 * for example), and the returned promise is settled on \e home, the loop that owns this chain.
+	 *
+	 * Only the outcome of \e func crosses back to \e home; no promise is copied or destroyed on
+	 * the thread that runs \e func. If \e func throws, the returned promise is rejected with the
+	 * code of a std::system_error, or with util::errc::unhandled_exception for any other exception.
+	 * \e func must not return a promise.
+	 */
+	template<class Executor, class AsyncAdapter, class Func>
+	auto
+	then_on(Executor ex, loop_executor<AsyncAdapter> home, Func&& func)
+	{
+		if constexpr (std::is_void<T>::value)
+		{
+			using result_type = std::invoke_result_t<std::decay_t<Func>&>;
+			static_assert(!is_promise<result_type>::value, "then_on(ex, home, func) does not support functions returning promises");
+
+			return then([ex = std::move(ex), home = std::move(home), func = std::forward<Func>(func)]() mutable {
+				return hand_off<result_type>(ex, home, std::move(func));
+			});
+		}
+		else
+		{
+			using result_type = std::invoke_result_t<std::decay_t<Func>&, T&&>;
+			static_assert(!is_promise<result_type>::value, "then_on(ex, home, func) does not support functions returning promises");
+
+			return then([ex = std::move(ex), home = std::move(home), func = std::forward<Func>(func)](T&& val) mutable {
+				return hand_off<result_type>(ex, home, [func = std::move(func), val = std::move(val)]() mutable {
+					return func(std::move(val));
+				});
+			});
+		}
+	}
+
+	/** \brief Like catcher(), but \e func is posted to \e ex, which must run work on the calling thread.
+	 */
+	template<class Executor, class F>
+	promise<T>&
+	catcher_on(Executor ex, F func)
+	{
+		static_assert(
+				runs_on_calling_thread<Executor>::value,
+				"util::promise::catcher_on() requires an executor that runs work on the calling thread");
+
+		return catcher([ex = std::move(ex), func = std::move(func)](std::error_code const& err) mutable {
+			ex.post([func = std::move(func), err]() mutable { func(err); });
+		});
+	}
+
+	/** \brief Like finally(), but \e func is posted to \e ex, which must run work on the calling thread.
+	 */
+	template<class Executor, class F>
+	promise<T>&
+	finally_on(Executor ex, F func)
+	{
+		static_assert(
+				runs_on_calling_thread<Executor>::value,
+				"util::promise::finally_on() requires an executor that runs work on the calling thread");
+
+		return finally([ex = std::move(ex), func = std::move(func)]() mutable { ex.post(std::move(func)); });
+	}
+
 	void
 	reset()
 	{
 		unshare();
 
-		m_shared = new __promise_shared<T>;
+		m_shared = new_shared();
 
 		m_shared->resolved     = false;
 		m_shared->rejected     = false;
@@ -611,10 +792,13 @@ private:
 	{
 		auto ret = promise<ResolveResult>();
 
-		m_shared->resolve = [=]() mutable { ret.resolve(std::move(resolve_func())); };
+		m_shared->resolve = [ret, resolve_func = std::forward<Resolve>(resolve_func)]() mutable {
+			ret.resolve(std::move(resolve_func()));
+		};
 
 		m_shared->reject = [=](std::error_code const& err) mutable { ret.reject(err); };
 
+		propagate_cancellation(ret);
 		maybe_direct_resolve_reject();
 
 		return ret;
@@ -633,10 +817,13 @@ private:
 	{
 		auto ret = promise<ResolveResult>();
 
-		m_shared->resolve = [=](Q&& val) mutable { ret.resolve(std::move(resolve_func(std::move(val)))); };
+		m_shared->resolve = [ret, resolve_func = std::forward<Resolve>(resolve_func)](Q&& val) mutable {
+			ret.resolve(std::move(resolve_func(std::move(val))));
+		};
 
 		m_shared->reject = [=](std::error_code const& err) mutable { ret.reject(err); };
 
+		propagate_cancellation(ret);
 		maybe_direct_resolve_reject();
 
 		return ret;
@@ -653,13 +840,14 @@ private:
 	{
 		ResolveResult ret;
 
-		m_shared->resolve = [=]() mutable {
+		m_shared->resolve = [ret, resolve_func = std::forward<Resolve>(resolve_func)]() mutable {
 			resolve_func().then(
 					[=]() mutable { ret.resolve(); }, [=](std::error_code const& err) mutable { ret.reject(err); });
 		};
 
 		m_shared->reject = [=](std::error_code const& err) mutable { ret.reject(err); };
 
+		propagate_cancellation(ret);
 		maybe_direct_resolve_reject();
 
 		return ret;
@@ -678,7 +866,7 @@ private:
 	{
 		ResolveResult ret;
 
-		m_shared->resolve = [=]() mutable {
+		m_shared->resolve = [ret, resolve_func = std::forward<Resolve>(resolve_func)]() mutable {
 			resolve_func().then(
 					[=](auto answer) mutable { ret.resolve(std::move(answer)); },
 					[=](std::error_code const& err) mutable { ret.reject(err); });
@@ -686,6 +874,7 @@ private:
 
 		m_shared->reject = [=](std::error_code const& err) mutable { ret.reject(err); };
 
+		propagate_cancellation(ret);
 		maybe_direct_resolve_reject();
 
 		return ret;
@@ -704,7 +893,7 @@ private:
 	{
 		ResolveResult ret;
 
-		m_shared->resolve = [=](Q&& val) mutable {
+		m_shared->resolve = [ret, resolve_func = std::forward<Resolve>(resolve_func)](Q&& val) mutable {
 			resolve_func(std::move(val))
 					.then([=]() mutable { ret.resolve(); },
 						  [=](std::error_code const& err) mutable { ret.reject(err); });
@@ -712,6 +901,7 @@ private:
 
 		m_shared->reject = [=](std::error_code const& err) mutable { ret.reject(err); };
 
+		propagate_cancellation(ret);
 		maybe_direct_resolve_reject();
 
 		return ret;
@@ -730,20 +920,127 @@ private:
 	{
 		ResolveResult ret;
 
-		m_shared->resolve = [=](Q&& val) mutable {
-			resolve_func(val).then(
-					[=](auto&& val) mutable { ret.resolve(std::move(val)); },
+		m_shared->resolve = [ret, resolve_func = std::forward<Resolve>(resolve_func)](Q&& val) mutable {
+			resolve_func(std::move(val))
+					.then([=](auto&& val) mutable { ret.resolve(std::move(val)); },
 					[=](std::error_code const& err) mutable { ret.reject(err); });
 		};
 
 		m_shared->reject = [=](std::error_code const& err) mutable { ret.reject(err); };
 
+		propagate_cancellation(ret);
 		maybe_direct_resolve_reject();
 
 		return ret;
 	}
 
 
+	// run f on ex, and post its outcome to home, which settles the returned promise; only a raw
+	// pointer to a copy of that promise crosses threads, and the copy is destroyed on home
+	template<class R, class Executor, class Home, class F>
+	static promise<R>
+	hand_off(Executor& ex, Home& home, F&& f)
+	{
+		promise<R> ret;
+		auto       slot = new promise<R>{ret};
+		ex.post([home, slot, f = std::forward<F>(f)]() mutable {
+			std::error_code err;
+			if constexpr (std::is_void<R>::value)
+			{
+				try
+				{
+					f();
+				}
+				catch (...)
+				{
+					err = exception_error();
+				}
+				home.post([slot, err]() {
+					std::unique_ptr<promise<R>> owned{slot};
+					if (err)
+					{
+						owned->reject(err);
+					}
+					else
+					{
+						owned->resolve();
+					}
+				});
+			}
+			else
+			{
+				std::optional<R> value;
+				try
+				{
+					value.emplace(f());
+				}
+				catch (...)
+				{
+					err = exception_error();
+				}
+				home.post([slot, value = std::move(value), err]() mutable {
+					std::unique_ptr<promise<R>> owned{slot};
+					if (err)
+					{
+						owned->reject(err);
+					}
+					else
+					{
+						owned->resolve(std::move(*value));
+					}
+				});
+			}
+		});
+		return ret;
+	}
+
+	// the error with which a promise is rejected for the exception being handled
+	static std::error_code
+	exception_error()
+	{
+		try
+		{
+			throw;
+		}
+		catch (std::system_error const& e)
+		{
+			return e.code();
+		}
+		catch (...)
+		{
+			return make_error_code(util::errc::unhandled_exception);
+		}
+	}
+
+	// invoke func, and settle ret with its result
+	template<class F, class U, class... Args>
+	static void
+	settle(F& func, promise<U>& ret, Args&&... args)
+	{
+		using result_type = std::invoke_result_t<F&, Args&&...>;
+		if constexpr (std::is_void<result_type>::value)
+		{
+			func(std::forward<Args>(args)...);
+			ret.resolve();
+		}
+		else if constexpr (is_void_promise<result_type>::value)
+		{
+			func(std::forward<Args>(args)...)
+					.then([ret]() mutable { ret.resolve(); },
+						  [ret](std::error_code const& err) mutable { ret.reject(err); });
+		}
+		else if constexpr (is_promise<result_type>::value)
+		{
+			func(std::forward<Args>(args)...)
+					.then([ret](U&& val) mutable { ret.resolve(std::move(val)); },
+						  [ret](std::error_code const& err) mutable { ret.reject(err); });
+		}
+		else
+		{
+			ret.resolve(func(std::forward<Args>(args)...));
+		}
+	}
+
 	template<class Q = T>
 	typename std::enable_if_t<std::is_void<Q>::value, void>
 	maybe_direct_resolve_reject()
@@ -818,11 +1115,37 @@ private:
 		if (m_shared && (--m_shared->refs == 0))
 		{
 			cancel_timer();
-			delete m_shared;
+			delete_shared(m_shared);
 			m_shared = nullptr;
 		}
 	}
 
+	static shared_type*
+	new_shared()
+	{
+#if (UTIL_PROMISE_POOL_SHARED)
+		if constexpr (alignof(shared_type) <= alignof(std::max_align_t))
+		{
+			return new (object_pool<shared_type>::instance().allocate()) shared_type;
+		}
+#endif
+		return new shared_type;
+	}
+
+	static void
+	delete_shared(shared_type* shared)
+	{
+#if (UTIL_PROMISE_POOL_SHARED)
+		if constexpr (alignof(shared_type) <= alignof(std::max_align_t))
+		{
+			shared->~shared_type();
+			object_pool<shared_type>::instance().deallocate(shared);
+			return;
+		}
+#endif
+		delete shared;
+	}
+
 	inline void
 	copy(const promise& rhs)
 	{
@@ -831,7 +1154,7 @@ private:
 	}
 
 	inline void
-	move(promise&& rhs)
+	move(promise&& rhs) noexcept
 	{
 		unshare();
 
@@ -839,6 +1162,50 @@ private:
 		rhs.m_shared = nullptr;
 	}
 
+	struct adopt_tag
+	{};
+
+	promise(shared_type* shared, adopt_tag) noexcept : m_shared{shared}
+	{
+		++m_shared->refs;
+	}
+
+	void
+	bind(intrusive_ptr<detail::cancellation_state> const& state)
+	{
+		m_shared->unlink();
+		m_shared->state = state;
+		if (state && !is_finished())
+		{
+			if (state->cancelled)
+			{
+				cancel();
+			}
+			else
+			{
+				state->link(*m_shared, &promise::fire_cancellation);
+			}
+		}
+	}
+
+	// bind a promise created by a stage of this chain to this promise's token
+	template<class U>
+	void
+	propagate_cancellation(promise<U>& stage) const
+	{
+		if (m_shared->state && stage.m_shared && !stage.m_shared->state)
+		{
+			stage.bind(m_shared->state);
+		}
+	}
+
+	static void
+	fire_cancellation(detail::cancellation_link* link)
+	{
+		promise<T> p{static_cast<shared_type*>(link), adopt_tag{}};    // hold a reference while rejecting
+		p.cancel();
+	}
+
 	void
 	cancel_timer()
 	{
@@ -854,240 +1221,308 @@ private:
 
 }    // namespace util
 
-template<class T>
-inline util::promise<typename util::promise<T>::maybe_array_type>
-util::promise<T>::all(promises_type promises)
+namespace util
+{
+namespace detail
 {
-	auto count       = std::make_shared<std::uint32_t>(0);
-	auto total       = promises.size();
-	auto is_finished = [count, total]() { return *count == total; };
-	auto ret         = promise<boost::container::deque<T>>();
 
-	if (promises.size() > 0)
-	{
-		auto result = std::make_shared<boost::container::deque<T>>(total);
-		auto index  = 0;
+/** \brief Shared state of a when_all() combination.
+ *
+ * One allocation holds the pre-sized values (a container, or a tuple), the number of promises
+ * still outstanding, and the combined promise. Each constituent promise's callbacks hold an
+ * intrusive reference and an index, which fit within unique_function's inline storage.
+ */
+template<class Values>
+struct all_state : public intrusive_refcount<all_state<Values>>
+{
+	template<class... Args>
+	explicit all_state(std::size_t count, Args&&... args) : values(std::forward<Args>(args)...), remaining{count}
+	{}
 
-		for (auto& promise : promises)
+	void
+	arrive()
+	{
+		if (--remaining == 0 && !combined.is_finished())
 		{
-			promise.then(
-					[=](T val) mutable {
-						(*count)++;
-
-						if (!ret.is_finished())
-						{
-							result->at(index) = std::move(val);
-
-							if (is_finished())
-							{
-								ret.resolve(std::move(*result));
-							}
-						}
-					},
-					[=](auto err) mutable {
-						(*count)++;
-
-						if (!ret.is_finished())
-						{
-							ret.reject(err);
-						}
-					});
-
-			index++;
+			combined.resolve(std::move(values));
 		}
 	}
-	else
+
+	void
+	fail(std::error_code const& err)
 	{
-		ret.resolve(boost::container::deque<T>());
+		if (!combined.is_finished())
+		{
+			combined.reject(err);
+		}
 	}
 
-	return ret;
-}
+	Values          values;
+	std::size_t     remaining;
+	promise<Values> combined;
+};
 
 template<>
-inline util::promise<typename util::promise<void>::maybe_array_type>
-util::promise<void>::all(promises_type promises)
+struct all_state<void> : public intrusive_refcount<all_state<void>>
 {
-	auto count       = std::make_shared<std::uint32_t>(0);
-	auto total       = promises.size();
-	auto is_finished = [count, total]() { return *count == total; };
-	auto ret         = promise<void>();
+	explicit all_state(std::size_t count) : remaining{count} {}
 
-	if (promises.size() > 0)
+	void
+	arrive()
 	{
-		for (auto& promise : promises)
+		if (--remaining == 0 && !combined.is_finished())
 		{
-			promise.then(
-					[=]() mutable {
-						(*count)++;
-
-						if (!ret.is_finished() && is_finished())
-						{
-							ret.resolve();
-						}
-					},
-					[=](auto err) mutable {
-						(*count)++;
-
-						if (!ret.is_finished())
-						{
-							ret.reject(err);
-						}
-					});
+			combined.resolve();
 		}
 	}
-	else
+
+	void
+	fail(std::error_code const& err)
 	{
-		ret.resolve();
+		if (!combined.is_finished())
+		{
+			combined.reject(err);
+		}
 	}
 
-	return ret;
-}
+	std::size_t   remaining;
+	promise<void> combined;
+};
 
-template<class T>
-inline util::promise<T>
-util::promise<T>::race(promises_type promises)
+// store the value of p in element I of the state's values (by index for containers, by std::get for tuples);
+// the closures init-capture state so that they hold a non-const intrusive_ptr, keeping them nothrow movable
+// (and therefore inline in unique_function)
+template<class Values, class T, class Store>
+inline void
+attach_all(intrusive_ptr<all_state<Values>> const& state, promise<T>& p, Store store)
 {
-	promise<T> ret;
-
-	if (promises.size() > 0)
+	if constexpr (std::is_void<T>::value)
 	{
-		for (auto& promise : promises)
-		{
-			promise.then(
-					[=](T val) mutable {
-						if (!ret.is_finished())
-						{
-							ret.resolve(std::move(val));
-						}
-					},
-					[=](std::error_code const& err) mutable {
-						if (!ret.is_finished())
-						{
-							ret.reject(err);
-						}
-					});
-		}
+		p.then([state = state]() { state->arrive(); }, [state = state](std::error_code const& err) { state->fail(err); });
 	}
 	else
 	{
-		ret.reject(make_error_code(std::errc::invalid_argument));
+		p.then([state = state, store](T&& value) mutable {
+			store(state->values, std::move(value));
+			state->arrive();
+		},
+			   [state = state](std::error_code const& err) { state->fail(err); });
 	}
-
-	return ret;
 }
 
-template<>
-inline util::promise<void>
-util::promise<void>::race(promises_type promises)
+template<class Values, class Range>
+inline promise<Values>
+all_of_range(Range& promises)
 {
-	promise<void> ret;
+	std::size_t                      count = promises.size();
+	intrusive_ptr<all_state<Values>> state;
+	if constexpr (std::is_void<Values>::value)
+	{
+		state = make_intrusive<all_state<void>>(count);
+	}
+	else
+	{
+		state = make_intrusive<all_state<Values>>(count, count);
+	}
+	auto combined = state->combined;
 
-	if (promises.size() > 0)
+	if (count == 0)
 	{
-		for (auto& promise : promises)
+		if constexpr (std::is_void<Values>::value)
+		{
+			combined.resolve();
+		}
+		else
 		{
-			promise.then(
-					[=]() mutable {
-						if (!ret.is_finished())
-						{
-							ret.resolve();
-						}
-					},
-					[=](std::error_code const& err) mutable {
-						if (!ret.is_finished())
-						{
-							ret.reject(err);
-						}
-					});
+			combined.resolve(Values{});
 		}
 	}
 	else
 	{
-		ret.reject(make_error_code(std::errc::invalid_argument));
+		std::size_t index{0};
+		for (auto& p : promises)
+		{
+			attach_all(state, p, [index](auto& values, auto&& value) { values[index] = std::move(value); });
+			++index;
+		}
 	}
-
-	return ret;
+	return combined;
 }
 
+/** \brief Shared state of a race() or any() combination.
+ *
+ * Each constituent promise is bound to the state's cancellation source, which is cancelled as
+ * soon as the combined promise is settled, so the losing branches release their continuations
+ * and timers immediately. A constituent that was already bound to another token keeps observing
+ * it, through a registration that cancels the whole combination.
+ */
 template<class T>
-inline util::promise<T>
-util::promise<T>::any(promises_type promises)
+struct race_state : public intrusive_refcount<race_state<T>>
 {
-	auto count       = std::make_shared<std::uint32_t>(0);
-	auto total       = promises.size();
-	auto is_finished = [count, total]() { return *count == total; };
-	auto ret         = promise<T>();
+	race_state(promise<T> ret, std::size_t count, bool any) : combined{std::move(ret)}, remaining{count}, any{any} {}
 
-	if (promises.size() > 0)
+	void
+	enlist(promise<T>& p)
 	{
-		for (auto& promise : promises)
+		auto bound = p.bound_token();
+		if (bound.can_be_cancelled() && bound != losers.token())
 		{
-			promise.then(
-					[=](T val) mutable {
-						(*count)++;
-
-						if (!ret.is_finished())
-						{
-							ret.resolve(std::move(val));
-						}
-					},
-					[=](std::error_code const& err) mutable {
-						(*count)++;
-
-						if (!ret.is_finished() && is_finished())
-						{
-							ret.reject(err);
-						}
-					});
+			parents.push_back(bound.on_cancel([losers = losers]() mutable { losers.cancel(); }));
 		}
+		p.with_cancellation(losers.token());
 	}
-	else
+
+	template<class... Args>
+	void
+	arrive(Args&&... args)
 	{
-		ret.reject(make_error_code(std::errc::invalid_argument));
+		--remaining;
+		if (!settled)
+		{
+			settle();
+			combined.resolve(std::forward<Args>(args)...);
+		}
 	}
 
-	return ret;
-}
+	void
+	fail(std::error_code const& err)
+	{
+		--remaining;
+		if (!settled && (!any || remaining == 0))
+		{
+			settle();
+			combined.reject(err);
+		}
+	}
 
-template<>
-inline util::promise<void>
-util::promise<void>::any(promises_type promises)
+	void
+	settle()
+	{
+		settled = true;
+		losers.cancel();
+		parents.clear();
+	}
+
+	promise<T>                             combined;
+	std::size_t                            remaining;
+	bool                                   any;
+	bool                                   settled{false};
+	cancellation_source                    losers;
+	std::vector<cancellation_registration> parents;
+};
+
+// race (any == false) settles with the first result; any settles with the first value, or the last error
+template<class T>
+inline promise<T>
+race_of_range(boost::container::deque<promise<T>>& promises, bool any)
 {
-	auto count       = std::make_shared<std::uint32_t>(0);
-	auto total       = promises.size();
-	auto is_finished = [count, total]() { return *count == total; };
-	auto ret         = promise<void>();
+	promise<T> combined;
+	if (promises.empty())
+	{
+		combined.reject(make_error_code(std::errc::invalid_argument));
+		return combined;
+	}
 
-	if (promises.size() > 0)
+	auto state = make_intrusive<race_state<T>>(combined, promises.size(), any);
+	for (auto& p : promises)
 	{
-		for (auto& promise : promises)
+		state->enlist(p);
+		if constexpr (std::is_void<T>::value)
+		{
+			p.then([state]() { state->arrive(); }, [state](std::error_code const& err) { state->fail(err); });
+		}
+		else
 		{
-			promise.then(
-					[=]() mutable {
-						(*count)++;
-
-						if (!ret.is_finished())
-						{
-							ret.resolve();
-						}
-					},
-					[=](auto err) mutable {
-						(*count)++;
-
-						if (!ret.is_finished() && is_finished())
-						{
-							ret.reject(err);
-						}
-					});
+			p.then([state](T&& value) { state->arrive(std::move(value)); },
+				   [state](std::error_code const& err) { state->fail(err); });
 		}
 	}
+	return combined;
+}
+
+template<class T>
+using when_all_element_t = std::conditional_t<std::is_void<T>::value, std::monostate, T>;
+
+template<class... Ts, std::size_t... Is>
+inline promise<std::tuple<when_all_element_t<Ts>...>>
+when_all_tuple(std::index_sequence<Is...>, promise<Ts>&... promises)
+{
+	using values_type = std::tuple<when_all_element_t<Ts>...>;
+
+	auto state    = make_intrusive<all_state<values_type>>(sizeof...(Ts));
+	auto combined = state->combined;
+	if constexpr (sizeof...(Ts) == 0)
+	{
+		combined.resolve(values_type{});
+	}
 	else
 	{
-		ret.reject(make_error_code(std::errc::invalid_argument));
+		(attach_all(state,
+					promises,
+					[](values_type& values, auto&& value) { std::get<Is>(values) = std::move(value); }),
+		 ...);
 	}
+	return combined;
+}
+
+}    // namespace detail
+
+/** \brief Combine a range of promises of the same type into a promise for all of their values.
+ *
+ * The values are delivered in a std::vector, in the order of the range (for promises of void,
+ * the result is a promise<void>). The combined promise is rejected with the first error. All
+ * bookkeeping lives in a single shared state, so the cost per promise is two callbacks that
+ * fit in unique_function's inline storage.
+ */
+template<class Range, class = std::enable_if_t<!is_promise<std::decay_t<Range>>::value>>
+inline auto
+when_all(Range&& promises)
+{
+	using value_type  = typename std::decay_t<Range>::value_type::value_type;
+	using values_type = std::conditional_t<std::is_void<value_type>::value, void, std::vector<value_type>>;
+	return detail::all_of_range<values_type>(promises);
+}
+
+/** \brief Combine promises of (possibly) different types into a promise for a tuple of their values.
+ *
+ * Promises of void contribute a std::monostate element. The combined promise is rejected
+ * with the first error.
+ */
+template<class... Ts>
+inline promise<std::tuple<detail::when_all_element_t<Ts>...>>
+when_all(promise<Ts>... promises)
+{
+	return detail::when_all_tuple(std::index_sequence_for<Ts...>{}, promises...);
+}
+
+}    // namespace util
+
+template<class T>
+inline util::promise<typename util::promise<T>::maybe_array_type>
+util::promise<T>::all(promises_type promises)
+{
+	return detail::all_of_range<boost::container::deque<T>>(promises);
+}
 
-	return ret;
+template<>
+inline util::promise<typename util::promise<void>::maybe_array_type>
+util::promise<void>::all(promises_type promises)
+{
+	return detail::all_of_range<void>(promises);
+}
+
+template<class T>
+inline util::promise<T>
+util::promise<T>::race(promises_type promises)
+{
+	return detail::race_of_range(promises, false);
+}
+
+template<class T>
+inline util::promise<T>
+util::promise<T>::any(promises_type promises)
+{
+	return detail::race_of_range(promises, true);
 }
 
 #endif    // UTIL_PROMISE_H
@@ -26,9 +26,16 @@
 #define ARMI_PROMISE_TIMER_H
 
 #include <chrono>
-#include <functional>
 #include <util/promise.h>
 
+/** \brief Rejects a promise with a timeout error if it is not finished within a given interval.
+ *
+ * AsyncAdapter provides the loop and timer types, and static functions create_timer(),
+ * start_timer() and cancel_timer(). The completion handler passed to start_timer() is a
+ * move-only util::unique_function<void(std::error_code const&)>, so adapters must accept
+ * handlers by value (or rvalue reference) and move, never copy, them. util::timer_wheel_adapter
+ * (util/timer_wheel.h) is such an adapter.
+ */
 template<class AsyncAdapter>
 class util::promise_timer
 {
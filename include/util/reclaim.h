@@ -0,0 +1,644 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef UTIL_RECLAIM_H
+#define UTIL_RECLAIM_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <util/shared_ptr.h>
+#include <vector>
+
+#ifndef UTIL_RECLAIM_THRESHOLD
+#define UTIL_RECLAIM_THRESHOLD 64
+#endif
+
+#ifndef UTIL_HAZARD_SLOTS
+#define UTIL_HAZARD_SLOTS 4
+#endif
+
+namespace util
+{
+
+/** \brief Counts of retired and reclaimed objects, and the delay between retirement and reclamation.
+ */
+struct reclaim_stats
+{
+	std::uint64_t retired;
+	std::uint64_t reclaimed;
+	std::uint64_t pending;
+	std::uint64_t mean_latency_ns;
+	std::uint64_t max_latency_ns;
+};
+
+namespace detail
+{
+
+struct retired_object
+{
+	using clock_type = std::chrono::steady_clock;
+
+	void*                  ptr;
+	void                   (*reclaim)(void*);
+	const void*            key;      // the address readers protect, for hazard pointers
+	std::uint64_t          epoch;    // the epoch at retirement, for epoch-based reclamation
+	clock_type::time_point retired_at;
+};
+
+template<class T>
+void
+reclaim_delete(void* p)
+{
+	delete static_cast<T*>(p);
+}
+
+class reclaim_counters
+{
+public:
+	reclaim_counters() : m_retired{0}, m_reclaimed{0}, m_total_latency{0}, m_max_latency{0} {}
+
+	void
+	on_retire()
+	{
+		m_retired.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	/* Reclaim the objects in [first, last), and record their latencies.
+	 */
+	template<class Iterator>
+	void
+	reclaim(Iterator first, Iterator last)
+	{
+		if (first == last)
+		{
+			return;
+		}
+		auto          now = retired_object::clock_type::now();
+		std::uint64_t total{0};
+		std::uint64_t max{0};
+		std::uint64_t count{0};
+		for (auto it = first; it != last; ++it)
+		{
+			auto latency = static_cast<std::uint64_t>(
+					std::chrono::duration_cast<std::chrono::nanoseconds>(now - it->retired_at).count());
+			total += latency;
+			max = std::max(max, latency);
+			++count;
+			it->reclaim(it->ptr);
+		}
+		m_total_latency.fetch_add(total, std::memory_order_relaxed);
+		auto current = m_max_latency.load(std::memory_order_relaxed);
+		while (current < max && !m_max_latency.compare_exchange_weak(current, max, std::memory_order_relaxed))
+		{}
+		m_reclaimed.fetch_add(count, std::memory_order_relaxed);
+	}
+
+	reclaim_stats
+	stats() const
+	{
+		reclaim_stats result;
+		result.reclaimed       = m_reclaimed.load(std::memory_order_relaxed);
+		result.retired         = std::max(m_retired.load(std::memory_order_relaxed), result.reclaimed);
+		result.pending         = result.retired - result.reclaimed;
+		result.mean_latency_ns = (result.reclaimed > 0)
+										 ? m_total_latency.load(std::memory_order_relaxed) / result.reclaimed
+										 : 0;
+		result.max_latency_ns = m_max_latency.load(std::memory_order_relaxed);
+		return result;
+	}
+
+private:
+	std::atomic<std::uint64_t> m_retired;
+	std::atomic<std::uint64_t> m_reclaimed;
+	std::atomic<std::uint64_t> m_total_latency;
+	std::atomic<std::uint64_t> m_max_latency;
+};
+
+/* Per-thread records are kept on a push-only list and are never freed; a record released
+ * at thread exit is claimed again by a later thread.
+ */
+template<class Record>
+class record_list
+{
+public:
+	record_list() : m_head{nullptr} {}
+
+	Record*
+	claim()
+	{
+		for (auto r = m_head.load(std::memory_order_acquire); r; r = r->next)
+		{
+			bool expected{false};
+			if (!r->in_use.load(std::memory_order_relaxed)
+				&& r->in_use.compare_exchange_strong(expected, true, std::memory_order_acquire))
+			{
+				return r;
+			}
+		}
+		auto r = new Record;
+		r->in_use.store(true, std::memory_order_relaxed);
+		r->next = m_head.load(std::memory_order_relaxed);
+		while (!m_head.compare_exchange_weak(r->next, r, std::memory_order_release, std::memory_order_relaxed))
+		{}
+		return r;
+	}
+
+	static void
+	release(Record* r)
+	{
+		r->in_use.store(false, std::memory_order_release);
+	}
+
+	Record*
+	head() const
+	{
+		return m_head.load(std::memory_order_acquire);
+	}
+
+private:
+	std::atomic<Record*> m_head;
+};
+
+}    // namespace detail
+
+/** \brief Epoch-based reclamation.
+ *
+ * A reader pins the current epoch for the duration of an epoch_domain::guard, which costs
+ * one atomic exchange. Objects unlinked from a shared structure are retired, rather than
+ * deleted; each thread keeps its retired objects in a local list, tagged with the epoch at
+ * retirement. The global epoch advances only when every pinned thread has observed it, so an
+ * object retired in epoch e can no longer be referenced by any reader once the epoch reaches
+ * e + 2. When a thread's list reaches UTIL_RECLAIM_THRESHOLD objects, it attempts to advance the
+ * epoch and reclaims every object that has become safe, in one batch.
+ *
+ * A reader that stays pinned indefinitely prevents reclamation in all threads. Objects retired
+ * by a thread that exits are passed to the domain, and reclaimed by the next thread to collect.
+ */
+class epoch_domain
+{
+public:
+	static constexpr std::size_t collect_threshold = UTIL_RECLAIM_THRESHOLD;
+
+	/** \brief Pins the calling thread's epoch for the lifetime of the guard. Guards may be nested.
+	 */
+	class guard
+	{
+	public:
+		guard() : m_domain{epoch_domain::instance()}
+		{
+			m_domain.pin();
+		}
+
+		~guard()
+		{
+			m_domain.unpin();
+		}
+
+		guard(guard const&) = delete;
+		guard&
+		operator=(guard const&) = delete;
+
+	private:
+		epoch_domain& m_domain;
+	};
+
+	static epoch_domain&
+	instance()
+	{
+		// never destroyed, since thread exit may retire objects during static destruction
+		static epoch_domain* domain = new epoch_domain;
+		return *domain;
+	}
+
+	/** \brief Defer a call to \e reclaim(p) until no pinned reader can hold \e p.
+	 */
+	void
+	retire(void* p, void (*reclaim)(void*))
+	{
+		auto& local = local_state();
+		local.retired.push_back(detail::retired_object{
+				p, reclaim, p, m_epoch.load(std::memory_order_seq_cst), detail::retired_object::clock_type::now()});
+		m_counters.on_retire();
+		if (local.retired.size() >= collect_threshold)
+		{
+			collect();
+		}
+	}
+
+	template<class T>
+	void
+	retire(T* p)
+	{
+		retire(p, &detail::reclaim_delete<T>);
+	}
+
+	/** \brief Defer the release of a shared reference until no pinned reader can hold the object.
+	 */
+	template<class T, class Count>
+	void
+	retire(shared_ptr<T, Count> p)
+	{
+		if (p)
+		{
+			retire(new shared_ptr<T, Count>{std::move(p)});
+		}
+	}
+
+	/** \brief Attempt to advance the epoch, and reclaim the calling thread's objects that are safe.
+	 *
+	 * \return the number of objects retired by the calling thread that remain unreclaimed
+	 */
+	std::size_t
+	collect()
+	{
+		auto& local = local_state();
+		adopt_orphans(local);
+		try_advance();
+		auto safe  = m_epoch.load(std::memory_order_acquire);
+		auto first = std::stable_partition(local.retired.begin(), local.retired.end(), [=](auto const& r) {
+			return r.epoch + 2 > safe;
+		});
+		std::vector<detail::retired_object> reclaimable(first, local.retired.end());
+		local.retired.erase(first, local.retired.end());
+		m_counters.reclaim(reclaimable.begin(), reclaimable.end());    // reclaiming may retire more objects
+		return local.retired.size();
+	}
+
+	/** \brief Collect repeatedly until the calling thread's retired objects are reclaimed.
+	 *
+	 * Succeeds only if no thread remains pinned in an old epoch.
+	 *
+	 * \return the number of objects that remain unreclaimed
+	 */
+	std::size_t
+	flush()
+	{
+		std::size_t pending{0};
+		for (int i = 0; i < 3; ++i)
+		{
+			pending = collect();
+			if (pending == 0)
+			{
+				break;
+			}
+		}
+		return pending;
+	}
+
+	std::uint64_t
+	epoch() const
+	{
+		return m_epoch.load(std::memory_order_acquire);
+	}
+
+	reclaim_stats
+	stats() const
+	{
+		return m_counters.stats();
+	}
+
+private:
+	static constexpr std::uint64_t inactive = std::numeric_limits<std::uint64_t>::max();
+
+	struct record
+	{
+		std::atomic<std::uint64_t> epoch{inactive};
+		std::atomic<bool>          in_use{false};
+		unsigned                   nesting{0};
+		record*                    next{nullptr};
+	};
+
+	struct thread_state
+	{
+		thread_state() : rec{epoch_domain::instance().m_records.claim()} {}
+
+		~thread_state()
+		{
+			auto& domain = epoch_domain::instance();
+			{
+				std::lock_guard<std::mutex> lock{domain.m_mutex};
+				domain.m_orphans.insert(domain.m_orphans.end(), retired.begin(), retired.end());
+			}
+			rec->epoch.store(inactive, std::memory_order_release);
+			rec->nesting = 0;
+			detail::record_list<record>::release(rec);
+		}
+
+		record*                             rec;
+		std::vector<detail::retired_object> retired;
+	};
+
+	epoch_domain() : m_epoch{0} {}
+
+	static thread_state&
+	local_state()
+	{
+		static thread_local thread_state state;
+		return state;
+	}
+
+	void
+	pin()
+	{
+		auto rec = local_state().rec;
+		if (rec->nesting++ == 0)
+		{
+			// a full barrier, so that the pin is visible before the reader loads shared pointers
+			rec->epoch.exchange(m_epoch.load(std::memory_order_relaxed), std::memory_order_seq_cst);
+		}
+	}
+
+	void
+	unpin()
+	{
+		auto rec = local_state().rec;
+		if (--rec->nesting == 0)
+		{
+			rec->epoch.store(inactive, std::memory_order_release);
+		}
+	}
+
+	bool
+	try_advance()
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		auto current = m_epoch.load(std::memory_order_relaxed);
+		for (auto r = m_records.head(); r; r = r->next)
+		{
+			auto observed = r->epoch.load(std::memory_order_acquire);
+			if (observed != inactive && observed != current)
+			{
+				return false;
+			}
+		}
+		return m_epoch.compare_exchange_strong(current, current + 1, std::memory_order_acq_rel);
+	}
+
+	void
+	adopt_orphans(thread_state& local)
+	{
+		std::lock_guard<std::mutex> lock{m_mutex};
+		if (!m_orphans.empty())
+		{
+			local.retired.insert(local.retired.end(), m_orphans.begin(), m_orphans.end());
+			m_orphans.clear();
+		}
+	}
+
+	std::atomic<std::uint64_t>          m_epoch;
+	detail::record_list<record>         m_records;
+	std::mutex                          m_mutex;
+	std::vector<detail::retired_object> m_orphans;
+	detail::reclaim_counters            m_counters;
+};
+
+/** \brief Hazard pointer reclamation.
+ *
+ * A reader publishes the address of each object it uses in a hazard_pointer slot. Retired
+ * objects are kept in a per-thread list; when the list reaches the larger of
+ * UTIL_RECLAIM_THRESHOLD and twice the number of slots in the domain, the thread gathers every
+ * published address and reclaims, in one batch, the retired objects that are not among them.
+ * Unlike epochs, a stalled reader delays the reclamation of only the objects it protects.
+ */
+class hazard_domain
+{
+public:
+	static constexpr std::size_t slots_per_record  = UTIL_HAZARD_SLOTS;
+	static constexpr std::size_t collect_threshold = UTIL_RECLAIM_THRESHOLD;
+
+	/** \brief One published slot, owned by the calling thread for the lifetime of the object.
+	 */
+	class hazard_pointer
+	{
+	public:
+		hazard_pointer() : m_slot{hazard_domain::instance().acquire_slot()} {}
+
+		~hazard_pointer()
+		{
+			m_slot->store(nullptr, std::memory_order_release);
+			hazard_domain::instance().release_slot(m_slot);
+		}
+
+		hazard_pointer(hazard_pointer const&) = delete;
+		hazard_pointer&
+		operator=(hazard_pointer const&) = delete;
+
+		/** \brief Load \e src and publish the result, which may be used until reset() or destruction.
+		 */
+		template<class T>
+		T*
+		protect(std::atomic<T*> const& src)
+		{
+			auto p = src.load(std::memory_order_relaxed);
+			for (;;)
+			{
+				m_slot->store(const_cast<void*>(static_cast<const void*>(p)), std::memory_order_seq_cst);
+				auto q = src.load(std::memory_order_seq_cst);
+				if (q == p)
+				{
+					return p;
+				}
+				p = q;
+			}
+		}
+
+		void
+		reset()
+		{
+			m_slot->store(nullptr, std::memory_order_release);
+		}
+
+	private:
+		std::atomic<void*>* m_slot;
+	};
+
+	static hazard_domain&
+	instance()
+	{
+		// never destroyed, since thread exit may retire objects during static destruction
+		static hazard_domain* domain = new hazard_domain;
+		return *domain;
+	}
+
+	/** \brief Defer a call to \e reclaim(p) until no hazard_pointer publishes \e p.
+	 */
+	void
+	retire(void* p, void (*reclaim)(void*))
+	{
+		retire(p, reclaim, p);
+	}
+
+	template<class T>
+	void
+	retire(T* p)
+	{
+		retire(p, &detail::reclaim_delete<T>, p);
+	}
+
+	/** \brief Defer the release of a shared reference until no hazard_pointer publishes p.get().
+	 */
+	template<class T, class Count>
+	void
+	retire(shared_ptr<T, Count> p)
+	{
+		if (p)
+		{
+			const void* key = p.get();
+			retire(new shared_ptr<T, Count>{std::move(p)}, &detail::reclaim_delete<shared_ptr<T, Count>>, key);
+		}
+	}
+
+	/** \brief Reclaim the calling thread's retired objects that are not published.
+	 *
+	 * \return the number of objects retired by the calling thread that remain unreclaimed
+	 */
+	std::size_t
+	collect()
+	{
+		auto& local = local_state();
+		{
+			std::lock_guard<std::mutex> lock{m_mutex};
+			local.retired.insert(local.retired.end(), m_orphans.begin(), m_orphans.end());
+			m_orphans.clear();
+		}
+
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		std::vector<const void*> published;
+		for (auto r = m_records.head(); r; r = r->next)
+		{
+			for (auto& slot : r->slots)
+			{
+				auto p = slot.load(std::memory_order_acquire);
+				if (p)
+				{
+					published.push_back(p);
+				}
+			}
+		}
+		std::sort(published.begin(), published.end());
+
+		auto first = std::stable_partition(local.retired.begin(), local.retired.end(), [&](auto const& r) {
+			return std::binary_search(published.begin(), published.end(), r.key);
+		});
+		std::vector<detail::retired_object> reclaimable(first, local.retired.end());
+		local.retired.erase(first, local.retired.end());
+		m_counters.reclaim(reclaimable.begin(), reclaimable.end());
+		return local.retired.size();
+	}
+
+	reclaim_stats
+	stats() const
+	{
+		return m_counters.stats();
+	}
+
+private:
+	struct record
+	{
+		std::atomic<void*> slots[slots_per_record] = {};
+		std::atomic<bool>  in_use{false};
+		record*            next{nullptr};
+	};
+
+	struct thread_state
+	{
+		~thread_state()
+		{
+			auto& domain = hazard_domain::instance();
+			{
+				std::lock_guard<std::mutex> lock{domain.m_mutex};
+				domain.m_orphans.insert(domain.m_orphans.end(), retired.begin(), retired.end());
+			}
+			for (auto r : records)
+			{
+				detail::record_list<record>::release(r);
+			}
+			domain.m_slot_count.fetch_sub(records.size() * slots_per_record, std::memory_order_relaxed);
+		}
+
+		std::vector<record*>                records;
+		std::vector<std::atomic<void*>*>    free_slots;
+		std::vector<detail::retired_object> retired;
+	};
+
+	hazard_domain() : m_slot_count{0} {}
+
+	static thread_state&
+	local_state()
+	{
+		static thread_local thread_state state;
+		return state;
+	}
+
+	void
+	retire(void* p, void (*reclaim)(void*), const void* key)
+	{
+		auto& local = local_state();
+		local.retired.push_back(detail::retired_object{p, reclaim, key, 0, detail::retired_object::clock_type::now()});
+		m_counters.on_retire();
+		if (local.retired.size() >= std::max(collect_threshold, 2 * m_slot_count.load(std::memory_order_relaxed)))
+		{
+			collect();
+		}
+	}
+
+	std::atomic<void*>*
+	acquire_slot()
+	{
+		auto& local = local_state();
+		if (local.free_slots.empty())
+		{
+			auto r = m_records.claim();
+			local.records.push_back(r);
+			for (auto& slot : r->slots)
+			{
+				local.free_slots.push_back(&slot);
+			}
+			m_slot_count.fetch_add(slots_per_record, std::memory_order_relaxed);
+		}
+		auto slot = local.free_slots.back();
+		local.free_slots.pop_back();
+		return slot;
+	}
+
+	void
+	release_slot(std::atomic<void*>* slot)
+	{
+		local_state().free_slots.push_back(slot);
+	}
+
+	detail::record_list<record>         m_records;
+	std::atomic<std::size_t>            m_slot_count;
+	std::mutex                          m_mutex;
+	std::vector<detail::retired_object> m_orphans;
+	detail::reclaim_counters            m_counters;
+};
+
+}    // namespace util
+
+#endif    // UTIL_RECLAIM_H
@@ -28,12 +28,14 @@
 #include <cassert>
 #include <cmath>
 #include <cstdint>
+#include <cstring>
 #include <deque>
 #include <functional>
 #include <iostream>
 #include <limits>
 #include <stdexcept>
 #include <system_error>
+#include <util/intrusive_ptr.h>
 #include <util/macros.h>
 #include <util/shared_ptr.h>
 #include <util/types.h>
@@ -41,7 +43,13 @@
 namespace util
 {
 
-class region
+/** \brief Base class for memory regions owned by buffers.
+ *
+ * A region carries its own reference count, so that shared_buffer can share it through an
+ * intrusive_ptr: a region allocated for a mutable_buffer or const_buffer becomes shared
+ * without allocating a control block, and each share is one pointer wide.
+ */
+class region : public intrusive_refcount<region>
 {
 protected:
 	region(byte_type* data, size_type capacity) : m_data{data}, m_capacity{capacity} {}
@@ -49,6 +57,7 @@ protected:
 public:
 	using sptr = util::shared_ptr<region>;
 	using uptr = std::unique_ptr<region>;
+	using iptr = util::intrusive_ptr<region>;
 
 	virtual ~region() {}
 
@@ -25,10 +25,15 @@
 #ifndef UTIL_SHARED_PTR_H
 #define UTIL_SHARED_PTR_H
 
+#include <atomic>
 #include <cassert>
+#include <cstddef>
 #include <cstdint>
 #include <functional>
+#include <limits>
 #include <memory>
+#include <new>
+#include <util/macros.h>
 #include <util/traits.h>
 
 #define UTIL_USE_STD_SHARED_PTR 0
@@ -75,6 +80,34 @@ static_pointer_cast(shared_ptr<U> const& uptr)
 	return std::static_pointer_cast<T>(uptr);
 }
 
+namespace mt
+{
+
+template<class T>
+using shared_ptr = std::shared_ptr<T>;
+
+template<class T>
+using weak_ptr = std::weak_ptr<T>;
+
+template<class T>
+using enable_shared_from_this = std::enable_shared_from_this<T>;
+
+template<class T, class... Args>
+inline std::shared_ptr<T>
+make_shared(Args&&... args)
+{
+	return std::make_shared<T>(std::forward<Args>(args)...);
+}
+
+template<class T, class Alloc, class... Args>
+inline std::shared_ptr<T>
+allocate_shared(Alloc&& alloc, Args&&... args)
+{
+	return std::allocate_shared<T, Alloc>(std::forward<Alloc>(alloc), std::forward<Args>(args)...);
+}
+
+}    // namespace mt
+
 template<class Alloc>
 class alloc_deleter : protected Alloc
 {
@@ -186,187 +219,795 @@ allocate_unique(const Alloc& alloc, Args&&... args)
 }
 
 
+/** \brief Reference counts for objects that are shared within a single thread.
+ *
+ * This is the default counting policy for shared_ptr and weak_ptr. Counts are updated
+ * with plain arithmetic; pointers that share an object must not be copied or destroyed
+ * concurrently on different threads.
+ */
+class nonatomic_refcount
+{
+public:
+	nonatomic_refcount() : m_use_count{1}, m_weak_count{1} {}
+
+	long
+	increment_use()
+	{
+		return ++m_use_count;
+	}
+
+	long
+	decrement_use()
+	{
+		return --m_use_count;
+	}
+
+	long
+	increment_weak()
+	{
+		return ++m_weak_count;
+	}
+
+	long
+	decrement_weak()
+	{
+		return --m_weak_count;
+	}
+
+	bool
+	try_increment_use()
+	{
+		bool result{false};
+		if (m_use_count > 0)
+		{
+			++m_use_count;
+			result = true;
+		}
+		return result;
+	}
+
+	long
+	use_count() const
+	{
+		return m_use_count;
+	}
+
+	long
+	weak_count() const
+	{
+		return m_weak_count;
+	}
+
+private:
+	long m_use_count;
+	long m_weak_count;
+};
+
+/** \brief Reference counts that may be updated concurrently from multiple threads.
+ *
+ * Increments are relaxed, since a thread can only add a reference through one it already
+ * holds. Decrements are acquire-release, so that all accesses through other references
+ * happen before the object is destroyed. Locking a weak pointer increments the use count
+ * only if it is not already zero, with a compare-and-swap loop.
+ */
+class atomic_refcount
+{
+public:
+	atomic_refcount() : m_use_count{1}, m_weak_count{1} {}
+
+	long
+	increment_use()
+	{
+		return m_use_count.fetch_add(1, std::memory_order_relaxed) + 1;
+	}
+
+	long
+	decrement_use()
+	{
+		return m_use_count.fetch_sub(1, std::memory_order_acq_rel) - 1;
+	}
+
+	long
+	increment_weak()
+	{
+		return m_weak_count.fetch_add(1, std::memory_order_relaxed) + 1;
+	}
+
+	long
+	decrement_weak()
+	{
+		return m_weak_count.fetch_sub(1, std::memory_order_acq_rel) - 1;
+	}
+
+	bool
+	try_increment_use()
+	{
+		long count = m_use_count.load(std::memory_order_relaxed);
+		while (count > 0)
+		{
+			if (m_use_count.compare_exchange_weak(
+						count, count + 1, std::memory_order_acquire, std::memory_order_relaxed))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	long
+	use_count() const
+	{
+		return m_use_count.load(std::memory_order_relaxed);
+	}
+
+	long
+	weak_count() const
+	{
+		return m_weak_count.load(std::memory_order_relaxed);
+	}
+
+private:
+	std::atomic<long> m_use_count;
+	std::atomic<long> m_weak_count;
+};
+
+/** \brief Compact, non-atomic reference counts.
+ *
+ * Use and weak counts are 32 bits each, and together occupy one 64-bit word. Control blocks
+ * for this policy have no virtual functions; they are released through a single function
+ * pointer that takes the operation to perform. A control block created by make_shared
+ * is 8 bytes smaller than one with the default policy.
+ */
+class compact_refcount
+{
+public:
+	compact_refcount() : m_use_count{1}, m_weak_count{1} {}
+
+	long
+	increment_use()
+	{
+		assert(m_use_count < UINT32_MAX);
+		return ++m_use_count;
+	}
+
+	long
+	decrement_use()
+	{
+		return --m_use_count;
+	}
+
+	long
+	increment_weak()
+	{
+		assert(m_weak_count < UINT32_MAX);
+		return ++m_weak_count;
+	}
+
+	long
+	decrement_weak()
+	{
+		return --m_weak_count;
+	}
+
+	bool
+	try_increment_use()
+	{
+		bool result{false};
+		if (m_use_count > 0)
+		{
+			++m_use_count;
+			result = true;
+		}
+		return result;
+	}
+
+	long
+	use_count() const
+	{
+		return m_use_count;
+	}
+
+	long
+	weak_count() const
+	{
+		return m_weak_count;
+	}
+
+private:
+	std::uint32_t m_use_count;
+	std::uint32_t m_weak_count;
+};
+
+/** \brief Compact, non-atomic reference counts for objects that are never weakly referenced.
+ *
+ * There is only a 32-bit use count; weak_ptr and enable_shared_from_this cannot be used with
+ * this policy. When the use count reaches zero, the object is destroyed and its control
+ * block deallocated in one step. A value of up to 4 bytes fits in the control block's tail
+ * padding, so make_shared<int> requires a 16-byte block, rather than 32 bytes with the
+ * default policy.
+ */
+class compact_noweak_refcount
+{
+public:
+	compact_noweak_refcount() : m_use_count{1} {}
+
+	long
+	increment_use()
+	{
+		assert(m_use_count < UINT32_MAX);
+		return ++m_use_count;
+	}
+
+	long
+	decrement_use()
+	{
+		return --m_use_count;
+	}
+
+	long
+	use_count() const
+	{
+		return m_use_count;
+	}
+
+	long
+	weak_count() const
+	{
+		return 0;
+	}
+
+private:
+	std::uint32_t m_use_count;
+};
+
 namespace detail
 {
 
-class ctrl_blk
+template<class Count>
+struct is_compact_refcount : std::false_type
+{};
+
+template<>
+struct is_compact_refcount<compact_refcount> : std::true_type
+{};
+
+template<>
+struct is_compact_refcount<compact_noweak_refcount> : std::true_type
+{};
+
+template<class Count>
+struct has_weak_count : std::true_type
+{};
+
+template<>
+struct has_weak_count<compact_noweak_refcount> : std::false_type
+{};
+
+/* The counting policy is a base class of the control block, rather than a member, so that
+ * a policy may declare on_zero_use_count() and on_zero_weak_count() itself, and release
+ * objects outside the control flow of a pointer's destructor (see biased_refcount).
+ */
+template<class Count, class Enable = void>
+class basic_ctrl_blk : public Count
 {
 public:
-	ctrl_blk() : m_use_count{1}, m_weak_count{1} {}
+	using refcount_type = Count;
+
+	basic_ctrl_blk() : Count{} {}
 
 	virtual void
 	on_zero_use_count()
 			= 0;
 
-	virtual void
-	on_zero_weak_count()
-			= 0;
+	virtual void
+	on_zero_weak_count()
+			= 0;
+
+	long
+	increment_use_count()
+	{
+		return Count::increment_use();
+	}
+
+	long
+	decrement_use_count()
+	{
+		return Count::decrement_use();
+	}
+
+	long
+	increment_weak_count()
+	{
+		return Count::increment_weak();
+	}
+
+	long
+	decrement_weak_count()
+	{
+		return Count::decrement_weak();
+	}
+
+	long
+	use_count() const
+	{
+		return Count::use_count();
+	}
+
+	long
+	weak_count() const
+	{
+		return Count::weak_count();
+	}
+
+	basic_ctrl_blk*
+	lock()
+	{
+		return Count::try_increment_use() ? this : nullptr;
+	}
+};
+
+using ctrl_blk = basic_ctrl_blk<nonatomic_refcount>;
+
+template<class T, class Del, class Alloc, class Count = nonatomic_refcount, class Enable = void>
+class ptr_ctrl_blk : public basic_ctrl_blk<Count>, public Del, public Alloc
+{
+public:
+	using element_type   = T;
+	using allocator_type = Alloc;
+	using deleter_type   = Del;
+
+	template<class _Del, class _Alloc>
+	ptr_ctrl_blk(element_type* p, _Del&& del, _Alloc&& alloc)
+		: Del{std::forward<_Del>(del)}, Alloc{std::forward<_Alloc>(alloc)}, m_ptr{p}
+	{}
+
+	virtual void
+	on_zero_use_count()
+	{
+		static_cast<Del&> (*this)(m_ptr);
+		static_cast<Del&>(*this).~deleter_type();
+		m_ptr = nullptr;
+
+		assert(this->weak_count() >= 1);
+		if (this->decrement_weak_count() == 0)
+		{
+			this->on_zero_weak_count();
+		}
+	}
+
+	virtual void
+	on_zero_weak_count()
+	{
+		assert(this->use_count() == 0);
+		using ctrl_blk_allocator_type = typename allocator_type::template rebind<ptr_ctrl_blk>::other;
+		ctrl_blk_allocator_type cblk_alloc(static_cast<Alloc&>(*this));
+		static_cast<Alloc&>(*this).~allocator_type();
+		cblk_alloc.deallocate(this, 1);
+	}
+
+	element_type*
+	get_ptr() const noexcept
+	{
+		return m_ptr;
+	}
+
+private:
+	using element_pointer = element_type*;
+
+	element_type* m_ptr;
+};
+
+template<class T, class Alloc, class Count = nonatomic_refcount, class Enable = void>
+class value_ctrl_blk : public basic_ctrl_blk<Count>, public Alloc
+{
+public:
+	using element_type   = T;
+	using allocator_type = Alloc;
+
+	template<class _Alloc, class... Args>
+	value_ctrl_blk(_Alloc&& alloc, Args&&... args)
+		: Alloc{std::forward<Alloc>(alloc)}, m_value{std::forward<Args>(args)...}
+	{}
+
+	element_type*
+	get_ptr() noexcept
+	{
+		return &m_value;
+	}
+
+	virtual void
+	on_zero_use_count()
+	{
+		m_value.~element_type();
+		assert(this->weak_count() >= 1);
+		if (this->decrement_weak_count() == 0)
+		{
+			this->on_zero_weak_count();
+		}
+	}
+
+	virtual void
+	on_zero_weak_count()
+	{
+		assert(this->use_count() == 0);
+		using ctrl_blk_allocator_type = typename allocator_type::template rebind<value_ctrl_blk>::other;
+		ctrl_blk_allocator_type cblk_alloc(static_cast<Alloc&>(*this));
+		static_cast<Alloc&>(*this).~allocator_type();
+		cblk_alloc.deallocate(this, 1);
+	}
+
+private:
+	element_type m_value;
+};
+
+/* Compact control blocks replace the virtual functions of basic_ctrl_blk with one function
+ * pointer, set by the concrete block, that performs the requested release operation.
+ */
+enum class ctrl_op
+{
+	zero_use_count,
+	zero_weak_count
+};
+
+template<class Count>
+class basic_ctrl_blk<Count, std::enable_if_t<is_compact_refcount<Count>::value>>
+{
+public:
+	using refcount_type = Count;
+	using manager_type  = void (*)(basic_ctrl_blk*, ctrl_op);
+
+	explicit basic_ctrl_blk(manager_type manager) : m_manager{manager}, m_counts{} {}
+
+	void
+	on_zero_use_count()
+	{
+		m_manager(this, ctrl_op::zero_use_count);
+	}
+
+	void
+	on_zero_weak_count()
+	{
+		m_manager(this, ctrl_op::zero_weak_count);
+	}
+
+	long
+	increment_use_count()
+	{
+		return m_counts.increment_use();
+	}
+
+	long
+	decrement_use_count()
+	{
+		return m_counts.decrement_use();
+	}
+
+	long
+	increment_weak_count()
+	{
+		return m_counts.increment_weak();
+	}
+
+	long
+	decrement_weak_count()
+	{
+		return m_counts.decrement_weak();
+	}
+
+	long
+	use_count() const
+	{
+		return m_counts.use_count();
+	}
+
+	long
+	weak_count() const
+	{
+		return m_counts.weak_count();
+	}
+
+	basic_ctrl_blk*
+	lock()
+	{
+		return m_counts.try_increment_use() ? this : nullptr;
+	}
+
+private:
+	// the counts follow the manager, so that a 32-bit use count leaves tail padding that
+	// the concrete block can use for small values
+	manager_type  m_manager;
+	refcount_type m_counts;
+};
+
+template<class T, class Del, class Alloc, class Count>
+class ptr_ctrl_blk<T, Del, Alloc, Count, std::enable_if_t<is_compact_refcount<Count>::value>>
+	: public basic_ctrl_blk<Count>, public Del, public Alloc
+{
+public:
+	using element_type   = T;
+	using allocator_type = Alloc;
+	using deleter_type   = Del;
+
+	template<class _Del, class _Alloc>
+	ptr_ctrl_blk(element_type* p, _Del&& del, _Alloc&& alloc)
+		: basic_ctrl_blk<Count>{&manage},
+		  Del{std::forward<_Del>(del)},
+		  Alloc{std::forward<_Alloc>(alloc)},
+		  m_ptr{p}
+	{}
+
+	element_type*
+	get_ptr() const noexcept
+	{
+		return m_ptr;
+	}
+
+private:
+	static void
+	manage(basic_ctrl_blk<Count>* base, ctrl_op op)
+	{
+		auto self = static_cast<ptr_ctrl_blk*>(base);
+		if (op == ctrl_op::zero_use_count)
+		{
+			static_cast<Del&> (*self)(self->m_ptr);
+			static_cast<Del&>(*self).~deleter_type();
+			self->m_ptr = nullptr;
+			if constexpr (has_weak_count<Count>::value)
+			{
+				if (self->decrement_weak_count() != 0)
+				{
+					return;
+				}
+			}
+		}
+		assert(self->use_count() == 0);
+		using ctrl_blk_allocator_type = typename allocator_type::template rebind<ptr_ctrl_blk>::other;
+		ctrl_blk_allocator_type cblk_alloc(static_cast<Alloc&>(*self));
+		static_cast<Alloc&>(*self).~allocator_type();
+		cblk_alloc.deallocate(self, 1);
+	}
+
+	element_type* m_ptr;
+};
+
+template<class T, class Alloc, class Count>
+class value_ctrl_blk<T, Alloc, Count, std::enable_if_t<is_compact_refcount<Count>::value>>
+	: public basic_ctrl_blk<Count>, public Alloc
+{
+public:
+	using element_type   = T;
+	using allocator_type = Alloc;
+
+	template<class _Alloc, class... Args>
+	value_ctrl_blk(_Alloc&& alloc, Args&&... args)
+		: basic_ctrl_blk<Count>{&manage},
+		  Alloc{std::forward<Alloc>(alloc)},
+		  m_value{std::forward<Args>(args)...}
+	{}
+
+	element_type*
+	get_ptr() noexcept
+	{
+		return &m_value;
+	}
+
+private:
+	static void
+	manage(basic_ctrl_blk<Count>* base, ctrl_op op)
+	{
+		auto self = static_cast<value_ctrl_blk*>(base);
+		if (op == ctrl_op::zero_use_count)
+		{
+			self->m_value.~element_type();
+			if constexpr (has_weak_count<Count>::value)
+			{
+				if (self->decrement_weak_count() != 0)
+				{
+					return;
+				}
+			}
+		}
+		assert(self->use_count() == 0);
+		using ctrl_blk_allocator_type = typename allocator_type::template rebind<value_ctrl_blk>::other;
+		ctrl_blk_allocator_type cblk_alloc(static_cast<Alloc&>(*self));
+		static_cast<Alloc&>(*self).~allocator_type();
+		cblk_alloc.deallocate(self, 1);
+	}
+
+	element_type m_value;
+};
+
+/* Layout of a control block followed by an inline array of elements. The block and the
+ * array are allocated together, in units of max_align_t, with the allocator rebound to the
+ * unit type; the elements begin at the first suitably aligned offset past the block.
+ */
+template<class Blk, class E>
+struct array_layout
+{
+	using unit_type = std::aligned_storage_t<sizeof(std::max_align_t), alignof(std::max_align_t)>;
+
+	static_assert(alignof(E) <= alignof(std::max_align_t), "over-aligned array elements are not supported");
+	static_assert(!std::is_array<E>::value, "multidimensional arrays are not supported");
 
-	long
-	increment_use_count()
+	static constexpr std::size_t
+	offset()
 	{
-		return ++m_use_count;
+		return ((sizeof(Blk) + alignof(E) - 1) / alignof(E)) * alignof(E);
 	}
 
-	long
-	decrement_use_count()
+	static std::size_t
+	units(std::size_t size)
 	{
-		return --m_use_count;
+		if (size > (std::numeric_limits<std::size_t>::max() - offset() - sizeof(unit_type)) / sizeof(E))
+		{
+			throw std::bad_array_new_length{};
+		}
+		return (offset() + (size * sizeof(E)) + sizeof(unit_type) - 1) / sizeof(unit_type);
 	}
 
-	long
-	increment_weak_count()
+	static E*
+	elements(Blk* blk)
 	{
-		return ++m_weak_count;
+		return reinterpret_cast<E*>(reinterpret_cast<char*>(blk) + offset());
 	}
 
-	long
-	decrement_weak_count()
+	/* Allocate a block for \e size elements and construct them, as copies of \e init if it is
+	 * not null, or value-initialized otherwise.
+	 */
+	template<class Alloc>
+	static Blk*
+	create(Alloc&& alloc, std::size_t size, E const* init)
 	{
-		return --m_weak_count;
-	}
+		using unit_alloc_type = typename std::allocator_traits<std::decay_t<Alloc>>::template rebind_alloc<unit_type>;
 
-	long
-	use_count() const
-	{
-		return m_use_count;
+		auto            count = units(size);
+		unit_alloc_type unit_alloc{alloc};
+		auto            storage = unit_alloc.allocate(count);
+		try
+		{
+			auto first = elements(reinterpret_cast<Blk*>(storage));
+			if (init)
+			{
+				std::uninitialized_fill_n(first, size, *init);
+			}
+			else
+			{
+				std::uninitialized_value_construct_n(first, size);
+			}
+		}
+		catch (...)
+		{
+			unit_alloc.deallocate(storage, count);
+			throw;
+		}
+		return new (storage) Blk(std::forward<Alloc>(alloc), size);
 	}
 
-	long
-	weak_count() const
+	static void
+	destroy(E* first, std::size_t size)
 	{
-		return m_weak_count;
+		while (size > 0)
+		{
+			first[--size].~E();
+		}
 	}
 
-	ctrl_blk*
-	lock()
+	// destroys the block's allocator, then releases the storage with a copy of it
+	template<class Alloc>
+	static void
+	deallocate(Blk* blk, Alloc& alloc, std::size_t size)
 	{
-		ctrl_blk* result{nullptr};
+		using unit_alloc_type = typename std::allocator_traits<Alloc>::template rebind_alloc<unit_type>;
 
-		if (use_count() > 0)
-		{
-			increment_use_count();
-			result = this;
-		}
-		return result;
+		unit_alloc_type unit_alloc{alloc};
+		alloc.~Alloc();
+		unit_alloc.deallocate(reinterpret_cast<unit_type*>(blk), units(size));
 	}
-
-private:
-	long m_use_count;
-	long m_weak_count;
 };
 
-template<class T, class Del, class Alloc>
-class ptr_ctrl_blk : public ctrl_blk, public Del, public Alloc
+template<class E, class Alloc, class Count = nonatomic_refcount, class Enable = void>
+class array_ctrl_blk : public basic_ctrl_blk<Count>, public Alloc
 {
 public:
-	using element_type   = T;
+	using element_type   = E;
 	using allocator_type = Alloc;
-	using deleter_type   = Del;
+	using layout_type    = array_layout<array_ctrl_blk, E>;
 
-	template<class _Del, class _Alloc>
-	ptr_ctrl_blk(element_type* p, _Del&& del, _Alloc&& alloc)
-		: Del{std::forward<_Del>(del)}, Alloc{std::forward<_Alloc>(alloc)}, m_ptr{p}
+	template<class _Alloc>
+	array_ctrl_blk(_Alloc&& alloc, std::size_t size) : Alloc{std::forward<_Alloc>(alloc)}, m_size{size}
 	{}
 
+	element_type*
+	get_ptr() noexcept
+	{
+		return layout_type::elements(this);
+	}
+
 	virtual void
 	on_zero_use_count()
 	{
-		static_cast<Del&> (*this)(m_ptr);
-		static_cast<Del&>(*this).~deleter_type();
-		m_ptr = nullptr;
-
-		assert(weak_count() >= 1);
-		if (decrement_weak_count() == 0)
+		layout_type::destroy(get_ptr(), m_size);
+		assert(this->weak_count() >= 1);
+		if (this->decrement_weak_count() == 0)
 		{
-			on_zero_weak_count();
+			this->on_zero_weak_count();
 		}
 	}
 
 	virtual void
 	on_zero_weak_count()
 	{
-		assert(use_count() == 0);
-		using ctrl_blk_allocator_type = typename allocator_type::template rebind<ptr_ctrl_blk>::other;
-		ctrl_blk_allocator_type cblk_alloc(static_cast<Alloc&>(*this));
-		static_cast<Alloc&>(*this).~allocator_type();
-		cblk_alloc.deallocate(this, 1);
-	}
-
-	element_type*
-	get_ptr() const noexcept
-	{
-		return m_ptr;
+		assert(this->use_count() == 0);
+		layout_type::deallocate(this, static_cast<Alloc&>(*this), m_size);
 	}
 
 private:
-	using element_pointer = element_type*;
-
-	element_type* m_ptr;
+	std::size_t m_size;
 };
 
-template<class T, class Alloc>
-class value_ctrl_blk : public ctrl_blk, public Alloc
+template<class E, class Alloc, class Count>
+class array_ctrl_blk<E, Alloc, Count, std::enable_if_t<is_compact_refcount<Count>::value>>
+	: public basic_ctrl_blk<Count>, public Alloc
 {
 public:
-	using element_type   = T;
+	using element_type   = E;
 	using allocator_type = Alloc;
+	using layout_type    = array_layout<array_ctrl_blk, E>;
 
-	template<class _Alloc, class... Args>
-	value_ctrl_blk(_Alloc&& alloc, Args&&... args)
-		: Alloc{std::forward<Alloc>(alloc)}, m_value{std::forward<Args>(args)...}
+	template<class _Alloc>
+	array_ctrl_blk(_Alloc&& alloc, std::size_t size)
+		: basic_ctrl_blk<Count>{&manage}, Alloc{std::forward<_Alloc>(alloc)}, m_size{size}
 	{}
 
 	element_type*
 	get_ptr() noexcept
 	{
-		return &m_value;
+		return layout_type::elements(this);
 	}
 
-	virtual void
-	on_zero_use_count()
+private:
+	static void
+	manage(basic_ctrl_blk<Count>* base, ctrl_op op)
 	{
-		m_value.~element_type();
-		assert(weak_count() >= 1);
-		if (decrement_weak_count() == 0)
+		auto self = static_cast<array_ctrl_blk*>(base);
+		if (op == ctrl_op::zero_use_count)
 		{
-			on_zero_weak_count();
+			layout_type::destroy(self->get_ptr(), self->m_size);
+			if constexpr (has_weak_count<Count>::value)
+			{
+				if (self->decrement_weak_count() != 0)
+				{
+					return;
+				}
+			}
 		}
+		assert(self->use_count() == 0);
+		layout_type::deallocate(self, static_cast<Alloc&>(*self), self->m_size);
 	}
 
-	virtual void
-	on_zero_weak_count()
-	{
-		assert(use_count() == 0);
-		using ctrl_blk_allocator_type = typename allocator_type::template rebind<value_ctrl_blk>::other;
-		ctrl_blk_allocator_type cblk_alloc(static_cast<Alloc&>(*this));
-		static_cast<Alloc&>(*this).~allocator_type();
-		cblk_alloc.deallocate(this, 1);
-	}
-
-private:
-	element_type m_value;
+	std::size_t m_size;
 };
 
-template<class T>
+template<class T, class Count = nonatomic_refcount>
 class pstate
 {
 public:
 	using element_type = T;
+	using ctrl_type    = basic_ctrl_blk<Count>;
 
 	struct sig_flag
 	{
 		int iflag;
 	};
 
-	template<class U>
+	template<class U, class C>
 	friend class pstate;
 
-	pstate(ctrl_blk* cp, element_type* p) : m_ctrl{cp}, m_ptr{p} {}
+	pstate(ctrl_type* cp, element_type* p) : m_ctrl{cp}, m_ptr{p} {}
 	pstate(element_type* p) : m_ctrl{nullptr}, m_ptr{p} {}
 
 	template<class U>
-	pstate(ctrl_blk* cp, U* p, typename std::enable_if_t<std::is_convertible<U*, T*>::value, sig_flag> = sig_flag{})
+	pstate(ctrl_type* cp, U* p, typename std::enable_if_t<std::is_convertible<U*, T*>::value, sig_flag> = sig_flag{})
 		: m_ctrl{cp}, m_ptr{static_cast<T*>(p)}
 	{}
 
@@ -377,7 +1018,8 @@ public:
 	}
 
 	template<class U>
-	pstate(pstate<U>&& rhs, typename std::enable_if_t<std::is_convertible<U*, T*>::value, sig_flag> = sig_flag{})
+	pstate(pstate<U, Count>&& rhs,
+		   typename std::enable_if_t<std::is_convertible<U*, T*>::value, sig_flag> = sig_flag{})
 		: m_ctrl{rhs.m_ctrl}, m_ptr{static_cast<T*>(rhs.m_ptr)}
 	{
 		rhs.m_ctrl = nullptr;
@@ -387,20 +1029,21 @@ public:
 	pstate(pstate const& rhs) : m_ctrl{rhs.m_ctrl}, m_ptr{rhs.m_ptr} {}
 
 	template<class U>
-	pstate(pstate<U> const& rhs, typename std::enable_if_t<std::is_convertible<U*, T*>::value, sig_flag> = sig_flag{})
+	pstate(pstate<U, Count> const& rhs,
+		   typename std::enable_if_t<std::is_convertible<U*, T*>::value, sig_flag> = sig_flag{})
 		: m_ctrl{rhs.m_ctrl}, m_ptr{static_cast<T*>(rhs.m_ptr)}
 	{}
 
 	pstate() : m_ctrl{nullptr}, m_ptr{nullptr} {}
 
-	ctrl_blk*
+	ctrl_type*
 	ctrl() const
 	{
 		return m_ctrl;
 	}
 
 	void
-	ctrl(ctrl_blk* cp)
+	ctrl(ctrl_type* cp)
 	{
 		m_ctrl = cp;
 	}
@@ -426,7 +1069,7 @@ public:
 
 	template<class U>
 	typename std::enable_if_t<std::is_convertible_v<U*, T*>>
-	swap(pstate<U>& rhs) noexcept
+	swap(pstate<U, Count>& rhs) noexcept
 	{
 		std::swap(m_ctrl, rhs.m_ctrl);
 		std::swap(m_ptr, rhs.m_ptr);
@@ -441,7 +1084,7 @@ public:
 
 	template<class U>
 	typename std::enable_if_t<std::is_convertible_v<U*, T*>, pstate&>
-	operator=(pstate<U> const& rhs)
+	operator=(pstate<U, Count> const& rhs)
 	{
 		pstate{rhs}.swap(*this);
 		return *this;
@@ -456,26 +1099,57 @@ public:
 
 	template<class U>
 	typename std::enable_if_t<std::is_convertible_v<U*, T*>, pstate&>
-	operator=(pstate<U>&& rhs)
+	operator=(pstate<U, Count>&& rhs)
 	{
 		pstate{std::move(rhs)}.swap(*this);
 		return *this;
 	}
 
 private:
-	ctrl_blk*     m_ctrl;
+	ctrl_type*    m_ctrl;
 	element_type* m_ptr;
 };
 
+template<class Count>
+struct shared_factory;
+
+/* The final release of a control block is kept out of line. If the deallocation is inlined
+ * into a pointer's destructor, GCC cannot tell that other pointers keep the block alive, and
+ * reports their later count updates as -Wuse-after-free.
+ */
+template<class Ctrl>
+UTIL_NOINLINE void
+release_use(Ctrl* cblk)
+{
+	cblk->on_zero_use_count();
+}
+
+template<class Ctrl>
+UTIL_NOINLINE void
+release_weak(Ctrl* cblk)
+{
+	cblk->on_zero_weak_count();
+}
+
 }    // namespace detail
 
-template<class U>
+template<class U, class Count = nonatomic_refcount>
 class weak_ptr;
 
-template<class U>
+template<class U, class Count = nonatomic_refcount>
 class enable_shared_from_this;
 
-template<class T>
+/** \brief Shared-ownership smart pointer.
+ *
+ * Count is the reference counting policy: nonatomic_refcount (the default) for objects
+ * confined to one thread, or atomic_refcount for objects shared between threads. Pointers
+ * with different policies are distinct types, and can be used together in one program.
+ * The aliases in namespace util::mt select atomic_refcount.
+ *
+ * T may be an array type, T[] or T[N]; make_shared<T[]>(n) and make_shared<T[N]>() place the
+ * elements in the same allocation as the control block.
+ */
+template<class T, class Count = nonatomic_refcount>
 class shared_ptr
 {
 private:
@@ -485,68 +1159,113 @@ private:
 	};
 
 public:
-	using element_type = T;
+	using element_type  = std::remove_extent_t<T>;
+	using refcount_type = Count;
+	using ctrl_blk_type = detail::basic_ctrl_blk<Count>;
 
 public:
-	template<class U>
+	template<class U, class C>
 	friend class shared_ptr;
 
-	template<class U>
+	template<class U, class C>
 	friend class weak_ptr;
 
-	template<class U, class... _Args>
-	friend shared_ptr<U>
-	make_shared(_Args&&...);
+	template<class C>
+	friend struct detail::shared_factory;
 
-	template<class U, class _Alloc, class... _Args>
-	friend shared_ptr<U>
-	allocate_shared(_Alloc&&, _Args&&...);
+	template<class U, class V, class C>
+	friend shared_ptr<U, C>
+	dynamic_pointer_cast(shared_ptr<V, C> const&);
 
-	template<class U, class V>
-	friend shared_ptr<U>
-	dynamic_pointer_cast(shared_ptr<V> const&);
-
-	template<class U, class V>
-	friend shared_ptr<U>
-	static_pointer_cast(shared_ptr<V> const&);
+	template<class U, class V, class C>
+	friend shared_ptr<U, C>
+	static_pointer_cast(shared_ptr<V, C> const&);
 
 protected:
 	template<class... Args>
 	static shared_ptr
 	create(Args&&... args)
 	{
-		static_assert(std::is_constructible<T, Args...>::value, "Can't construct object in make_shared");
-		using allocator_type      = std::allocator<element_type>;
-		using ctrl_blk_type       = detail::value_ctrl_blk<element_type, allocator_type>;
-		using ctrl_blk_alloc_type = typename allocator_type::template rebind<ctrl_blk_type>::other;
+		if constexpr (std::is_array<T>::value)
+		{
+			return create_array(std::allocator<element_type>{}, std::forward<Args>(args)...);
+		}
+		else
+		{
+			static_assert(std::is_constructible<T, Args...>::value, "Can't construct object in make_shared");
+			using allocator_type      = std::allocator<element_type>;
+			using ctrl_blk_type       = detail::value_ctrl_blk<element_type, allocator_type, Count>;
+			using ctrl_blk_alloc_type = typename allocator_type::template rebind<ctrl_blk_type>::other;
 
-		allocator_type alloc{};
-		ctrl_blk_type* cblk_ptr = ctrl_blk_alloc_type{alloc}.allocate(1);
-		new (cblk_ptr) ctrl_blk_type(std::move(alloc), std::forward<Args>(args)...);
-		shared_ptr result{dynamic_cast<detail::ctrl_blk*>(cblk_ptr), cblk_ptr->get_ptr()};
-		result.enable_weak_this(result.m_state.ptr(), result.m_state.ptr());
-		return result;
+			allocator_type alloc{};
+			ctrl_blk_type* cblk_ptr = ctrl_blk_alloc_type{alloc}.allocate(1);
+			new (cblk_ptr) ctrl_blk_type(std::move(alloc), std::forward<Args>(args)...);
+			shared_ptr result{static_cast<ctrl_blk_type*>(cblk_ptr), cblk_ptr->get_ptr()};
+			result.enable_weak_this(result.m_state.ptr(), result.m_state.ptr());
+			return result;
+		}
 	}
 
 	template<class _Alloc, class... Args>
 	static shared_ptr
 	allocate(_Alloc&& alloc, Args&&... args)
 	{
-		static_assert(std::is_constructible<T, Args...>::value, "Can't construct object in allocate_shared");
-		using allocator_type      = _Alloc;
-		using ctrl_blk_type       = detail::value_ctrl_blk<element_type, allocator_type>;
-		using ctrl_blk_alloc_type = typename allocator_type::template rebind<ctrl_blk_type>::other;
+		if constexpr (std::is_array<T>::value)
+		{
+			return create_array(std::forward<_Alloc>(alloc), std::forward<Args>(args)...);
+		}
+		else
+		{
+			static_assert(std::is_constructible<T, Args...>::value, "Can't construct object in allocate_shared");
+			using allocator_type      = _Alloc;
+			using ctrl_blk_type       = detail::value_ctrl_blk<element_type, allocator_type, Count>;
+			using ctrl_blk_alloc_type = typename allocator_type::template rebind<ctrl_blk_type>::other;
 
-		ctrl_blk_type* cblk_ptr = ctrl_blk_alloc_type{alloc}.allocate(1);
-		new (cblk_ptr) ctrl_blk_type(std::forward<_Alloc>(alloc), std::forward<Args>(args)...);
-		shared_ptr result{dynamic_cast<detail::ctrl_blk*>(cblk_ptr), cblk_ptr->get_ptr()};
-		result.enable_weak_this(result.m_state.ptr(), result.m_state.ptr());
-		return result;
+			ctrl_blk_type* cblk_ptr = ctrl_blk_alloc_type{alloc}.allocate(1);
+			new (cblk_ptr) ctrl_blk_type(std::forward<_Alloc>(alloc), std::forward<Args>(args)...);
+			shared_ptr result{static_cast<ctrl_blk_type*>(cblk_ptr), cblk_ptr->get_ptr()};
+			result.enable_weak_this(result.m_state.ptr(), result.m_state.ptr());
+			return result;
+		}
+	}
+
+	/* For T[N], args is empty or an initial value for the elements; for T[], args is the
+	 * element count, optionally followed by an initial value.
+	 */
+	template<class _Alloc, class... Args>
+	static shared_ptr
+	create_array(_Alloc&& alloc, Args&&... args)
+	{
+		if constexpr (std::extent<T>::value > 0)
+		{
+			return create_array_n(std::forward<_Alloc>(alloc), std::extent<T>::value, std::forward<Args>(args)...);
+		}
+		else
+		{
+			return create_array_n(std::forward<_Alloc>(alloc), std::forward<Args>(args)...);
+		}
+	}
+
+	template<class _Alloc>
+	static shared_ptr
+	create_array_n(_Alloc&& alloc, std::size_t size, element_type const* init = nullptr)
+	{
+		using ctrl_blk_type = detail::array_ctrl_blk<element_type, std::decay_t<_Alloc>, Count>;
+
+		auto cblk_ptr = ctrl_blk_type::layout_type::create(std::forward<_Alloc>(alloc), size, init);
+		return shared_ptr{static_cast<ctrl_blk_type*>(cblk_ptr), cblk_ptr->get_ptr()};
+	}
+
+	template<class _Alloc>
+	static shared_ptr
+	create_array_n(_Alloc&& alloc, std::size_t size, element_type const& init)
+	{
+		return create_array_n(std::forward<_Alloc>(alloc), size, &init);
 	}
 
 	template<class U>
 	static shared_ptr
-	static_ptr_cast(shared_ptr<U> const& p)
+	static_ptr_cast(shared_ptr<U, Count> const& p)
 	{
 		auto cp = p.get_ctrl_blk();
 		if (cp)
@@ -558,7 +1277,7 @@ protected:
 
 	template<class U>
 	static shared_ptr
-	dynamic_ptr_cast(shared_ptr<U> const& p)
+	dynamic_ptr_cast(shared_ptr<U, Count> const& p)
 	{
 		element_type* ep = dynamic_cast<element_type*>(p.get());
 		if (ep)
@@ -578,14 +1297,23 @@ public:
 
 	shared_ptr(element_type* ep) : m_state{ep}
 	{
-		using allocator_type      = std::allocator<element_type>;
-		using deleter_type        = alloc_deleter<allocator_type>;
-		using ctrl_blk_type       = detail::ptr_ctrl_blk<element_type, deleter_type, allocator_type>;
+		// an array allocated with new[] must be released with delete[]
+		using allocator_type = std::allocator<element_type>;
+		using deleter_type
+				= std::conditional_t<std::is_array<T>::value, std::default_delete<T>, alloc_deleter<allocator_type>>;
+		using ctrl_blk_type       = detail::ptr_ctrl_blk<element_type, deleter_type, allocator_type, Count>;
 		using ctrl_blk_alloc_type = typename allocator_type::template rebind<ctrl_blk_type>::other;
 
 		allocator_type alloc{};
 		ctrl_blk_type* cblk_ptr = ctrl_blk_alloc_type{alloc}.allocate(1);
-		new (cblk_ptr) ctrl_blk_type(ep, deleter_type{alloc}, alloc);
+		if constexpr (std::is_array<T>::value)
+		{
+			new (cblk_ptr) ctrl_blk_type(ep, deleter_type{}, alloc);
+		}
+		else
+		{
+			new (cblk_ptr) ctrl_blk_type(ep, deleter_type{alloc}, alloc);
+		}
 		// m_cblk_ptr = cblk_ptr;
 		m_state.ctrl(cblk_ptr);
 		enable_weak_this(ep, ep);
@@ -599,7 +1327,7 @@ public:
 	{
 		using allocator_type      = _Alloc;
 		using deleter_type        = alloc_deleter<allocator_type>;
-		using ctrl_blk_type       = detail::ptr_ctrl_blk<element_type, deleter_type, allocator_type>;
+		using ctrl_blk_type       = detail::ptr_ctrl_blk<element_type, deleter_type, allocator_type, Count>;
 		using ctrl_blk_alloc_type = typename allocator_type::template rebind<ctrl_blk_type>::other;
 
 		ctrl_blk_type* cblk_ptr = ctrl_blk_alloc_type{alloc}.allocate(1);
@@ -615,7 +1343,7 @@ public:
 	{
 		using allocator_type      = std::allocator<element_type>;
 		using deleter_type        = _Del;
-		using ctrl_blk_type       = detail::ptr_ctrl_blk<element_type, deleter_type, allocator_type>;
+		using ctrl_blk_type       = detail::ptr_ctrl_blk<element_type, deleter_type, allocator_type, Count>;
 		using ctrl_blk_alloc_type = typename allocator_type::template rebind<ctrl_blk_type>::other;
 
 		allocator_type alloc{};
@@ -632,7 +1360,7 @@ public:
 
 		using allocator_type = std::remove_reference_t<_Alloc>;
 		using deleter_type   = _Del;
-		using ctrl_blk_type  = detail::ptr_ctrl_blk<element_type, deleter_type, allocator_type>;
+		using ctrl_blk_type  = detail::ptr_ctrl_blk<element_type, deleter_type, allocator_type, Count>;
 
 		using ctrl_blk_alloc_type =
 				typename std::allocator_traits<allocator_type>::template rebind_alloc<ctrl_blk_type>;
@@ -653,8 +1381,8 @@ public:
 		}
 	}
 
-	template<class U, class = typename std::enable_if_t<std::is_convertible<U*, element_type*>::value>>
-	shared_ptr(shared_ptr<U> const& rhs) : m_state{rhs.m_state}
+	template<class U, class = typename std::enable_if_t<std::is_convertible<U*, T*>::value>>
+	shared_ptr(shared_ptr<U, Count> const& rhs) : m_state{rhs.m_state}
 	{
 		if (m_state.ctrl())
 		{
@@ -664,16 +1392,16 @@ public:
 
 	shared_ptr(shared_ptr&& rhs) : m_state{std::move(rhs.m_state)} {}
 
-	template<class U, class = typename std::enable_if_t<std::is_convertible<U*, element_type*>::value>>
-	shared_ptr(shared_ptr<U>&& rhs) : m_state{std::move(rhs.m_state)}
+	template<class U, class = typename std::enable_if_t<std::is_convertible<U*, T*>::value>>
+	shared_ptr(shared_ptr<U, Count>&& rhs) : m_state{std::move(rhs.m_state)}
 	{}
 
 	shared_ptr(std::nullptr_t) : m_state{} {}
 
 	template<class U>
 	shared_ptr(
-			weak_ptr<U> const& wp,
-			typename std::enable_if_t<std::is_convertible<U*, element_type*>::value, sig_flag> = sig_flag{});
+			weak_ptr<U, Count> const& wp,
+			typename std::enable_if_t<std::is_convertible<U*, T*>::value, sig_flag> = sig_flag{});
 
 	template<class U, class _Del>
 	shared_ptr(
@@ -693,7 +1421,7 @@ public:
 			using uptr_element_type   = U;
 			using uptr_deleter_type   = _Del;
 			using allocator_type      = std::allocator<uptr_element_type>;
-			using ctrl_blk_type       = detail::ptr_ctrl_blk<uptr_element_type, uptr_deleter_type, allocator_type>;
+			using ctrl_blk_type       = detail::ptr_ctrl_blk<uptr_element_type, uptr_deleter_type, allocator_type, Count>;
 			using ctrl_blk_alloc_type = typename allocator_type::template rebind<ctrl_blk_type>::other;
 
 			allocator_type alloc;
@@ -723,7 +1451,7 @@ public:
 			using uptr_element_type   = U;
 			using uptr_deleter_type   = _Del;
 			using allocator_type      = std::allocator<uptr_element_type>;
-			using ctrl_blk_type       = detail::ptr_ctrl_blk<uptr_element_type, uptr_deleter_type, allocator_type>;
+			using ctrl_blk_type       = detail::ptr_ctrl_blk<uptr_element_type, uptr_deleter_type, allocator_type, Count>;
 			using ctrl_blk_alloc_type = typename allocator_type::template rebind<ctrl_blk_type>::other;
 
 			allocator_type alloc;
@@ -736,7 +1464,7 @@ public:
 	}
 
 	template<class U>
-	shared_ptr(shared_ptr<U> const& rhs, element_type* p) noexcept;
+	shared_ptr(shared_ptr<U, Count> const& rhs, element_type* p) noexcept;
 
 	~shared_ptr()
 	{
@@ -748,7 +1476,7 @@ public:
 				auto cblk_ptr = m_state.ctrl();
 				m_state.ctrl(nullptr);
 				m_state.ptr(nullptr);
-				cblk_ptr->on_zero_use_count();
+				detail::release_use(cblk_ptr);
 			}
 			else
 			{
@@ -772,8 +1500,8 @@ public:
 	}
 
 	template<class U>
-	typename std::enable_if_t<std::is_convertible<U*, element_type*>::value, shared_ptr&>
-	operator=(shared_ptr<U> const& rhs)
+	typename std::enable_if_t<std::is_convertible<U*, T*>::value, shared_ptr&>
+	operator=(shared_ptr<U, Count> const& rhs)
 	{
 		shared_ptr{rhs}.swap(*this);
 		return *this;
@@ -787,14 +1515,14 @@ public:
 	}
 
 	template<class U>
-	typename std::enable_if_t<std::is_convertible<U*, element_type*>::value, shared_ptr&>
-	operator=(shared_ptr<U>&& rhs)
+	typename std::enable_if_t<std::is_convertible<U*, T*>::value, shared_ptr&>
+	operator=(shared_ptr<U, Count>&& rhs)
 	{
 		shared_ptr{std::move(rhs)}.swap(*this);
 		return *this;
 	}
 
-	detail::ctrl_blk*
+	ctrl_blk_type*
 	get_ctrl_blk() const
 	{
 		return m_state.ctrl();
@@ -812,15 +1540,15 @@ public:
 	}
 
 	template<class U>
-	typename std::enable_if_t<std::is_convertible<U*, element_type*>::value, bool>
-	operator==(shared_ptr<U> const& rhs) const
+	typename std::enable_if_t<std::is_convertible<U*, T*>::value, bool>
+	operator==(shared_ptr<U, Count> const& rhs) const
 	{
 		return m_state.ptr() == rhs.m_state.ptr();
 	}
 
 	template<class U>
-	typename std::enable_if_t<std::is_convertible<U*, element_type*>::value, bool>
-	operator!=(shared_ptr<U> const& rhs) const
+	typename std::enable_if_t<std::is_convertible<U*, T*>::value, bool>
+	operator!=(shared_ptr<U, Count> const& rhs) const
 	{
 		return !(*this == rhs);
 	}
@@ -851,6 +1579,12 @@ public:
 		return *m_state.ptr();
 	}
 
+	element_type& operator[](std::ptrdiff_t index) const
+	{
+		static_assert(std::is_array<T>::value, "operator[] requires an array type");
+		return m_state.ptr()[index];
+	}
+
 	long
 	use_count() const
 	{
@@ -864,16 +1598,16 @@ public:
 	}
 
 private:
-	shared_ptr(detail::ctrl_blk* p, element_type* ep) : m_state{p, ep} {}
+	shared_ptr(ctrl_blk_type* p, element_type* ep) : m_state{p, ep} {}
 
 	template<class Y, class U>
-	typename std::enable_if_t<std::is_convertible<U*, const enable_shared_from_this<Y>*>::value>
-	enable_weak_this(const enable_shared_from_this<Y>* ep, U* p) _NOEXCEPT
+	typename std::enable_if_t<std::is_convertible<U*, const enable_shared_from_this<Y, Count>*>::value>
+	enable_weak_this(const enable_shared_from_this<Y, Count>* ep, U* p) _NOEXCEPT
 	{
 		typedef typename std::remove_cv<Y>::type RawY;
 		if (ep && ep->m_weak_this.expired())
 		{
-			ep->m_weak_this = shared_ptr<RawY>(*this, const_cast<RawY*>(static_cast<const Y*>(p)));
+			ep->m_weak_this = shared_ptr<RawY, Count>(*this, const_cast<RawY*>(static_cast<const Y*>(p)));
 		}
 	}
 
@@ -882,45 +1616,71 @@ private:
 	{}
 
 
-	detail::pstate<element_type> m_state;
+	detail::pstate<element_type, Count> m_state;
+};
+
+namespace detail
+{
+
+template<class Count>
+struct shared_factory
+{
+	template<class T, class... Args>
+	static shared_ptr<T, Count>
+	make(Args&&... args)
+	{
+		return shared_ptr<T, Count>::create(std::forward<Args>(args)...);
+	}
+
+	template<class T, class Alloc, class... Args>
+	static shared_ptr<T, Count>
+	allocate(Alloc&& alloc, Args&&... args)
+	{
+		return shared_ptr<T, Count>::allocate(std::forward<Alloc>(alloc), std::forward<Args>(args)...);
+	}
 };
 
+}    // namespace detail
+
 template<class T, class... Args>
 shared_ptr<T>
 make_shared(Args&&... args)
 {
-	return shared_ptr<T>::create(std::forward<Args>(args)...);
+	return detail::shared_factory<nonatomic_refcount>::make<T>(std::forward<Args>(args)...);
 }
 
 template<class T, class Alloc, class... Args>
 shared_ptr<T>
 allocate_shared(Alloc&& alloc, Args&&... args)
 {
-	return shared_ptr<T>::allocate(std::forward<Alloc>(alloc), std::forward<Args>(args)...);
+	return detail::shared_factory<nonatomic_refcount>::allocate<T>(
+			std::forward<Alloc>(alloc), std::forward<Args>(args)...);
 }
 
-template<class T, class U>
-shared_ptr<T>
-dynamic_pointer_cast(shared_ptr<U> const& uptr)
+template<class T, class U, class Count>
+shared_ptr<T, Count>
+dynamic_pointer_cast(shared_ptr<U, Count> const& uptr)
 {
-	return shared_ptr<T>::dynamic_ptr_cast(uptr);
+	return shared_ptr<T, Count>::dynamic_ptr_cast(uptr);
 }
 
-template<class T, class U>
-shared_ptr<T>
-static_pointer_cast(shared_ptr<U> const& uptr)
+template<class T, class U, class Count>
+shared_ptr<T, Count>
+static_pointer_cast(shared_ptr<U, Count> const& uptr)
 {
-	return shared_ptr<T>::static_ptr_cast(uptr);
+	return shared_ptr<T, Count>::static_ptr_cast(uptr);
 }
 
-template<class T>
+template<class T, class Count>
 class weak_ptr
 {
+	static_assert(detail::has_weak_count<Count>::value, "the reference counting policy does not support weak_ptr");
+
 public:
-	typedef T element_type;
+	typedef std::remove_extent_t<T> element_type;
 
 private:
-	detail::pstate<T> m_state;
+	detail::pstate<element_type, Count> m_state;
 
 	struct sig_flag
 	{
@@ -932,8 +1692,8 @@ public:
 
 	template<class U>
 	weak_ptr(
-			shared_ptr<U> const& sp,
-			typename std::enable_if_t<std::is_convertible<U*, element_type*>::value, sig_flag> = sig_flag{}) noexcept
+			shared_ptr<U, Count> const& sp,
+			typename std::enable_if_t<std::is_convertible<U*, T*>::value, sig_flag> = sig_flag{}) noexcept
 		: m_state{sp.m_state}
 	{
 		if (m_state.ctrl())
@@ -952,8 +1712,8 @@ public:
 
 	template<class U>
 	weak_ptr(
-			weak_ptr<U> const& wp,
-			typename std::enable_if_t<std::is_convertible<U*, element_type*>::value, sig_flag> = sig_flag{}) noexcept
+			weak_ptr<U, Count> const& wp,
+			typename std::enable_if_t<std::is_convertible<U*, T*>::value, sig_flag> = sig_flag{}) noexcept
 		: m_state{wp.m_state}
 	{
 		if (m_state.ctrl())
@@ -966,8 +1726,8 @@ public:
 
 	template<class U>
 	weak_ptr(
-			weak_ptr<U>&& wp,
-			typename std::enable_if_t<std::is_convertible<U*, element_type*>::value, sig_flag> = sig_flag{}) noexcept
+			weak_ptr<U, Count>&& wp,
+			typename std::enable_if_t<std::is_convertible<U*, T*>::value, sig_flag> = sig_flag{}) noexcept
 		: m_state{std::move(wp.m_state)}
 	{}
 
@@ -982,7 +1742,7 @@ public:
 				auto cblk_ptr = m_state.ctrl();
 				m_state.ctrl(nullptr);
 				m_state.ptr(nullptr);
-				cblk_ptr->on_zero_weak_count();
+				detail::release_weak(cblk_ptr);
 			}
 			else
 			{
@@ -1000,8 +1760,8 @@ public:
 	}
 
 	template<class U>
-	typename std::enable_if_t<std::is_convertible<U*, element_type*>::value, weak_ptr&>
-	operator=(weak_ptr<U> const& rhs) noexcept
+	typename std::enable_if_t<std::is_convertible<U*, T*>::value, weak_ptr&>
+	operator=(weak_ptr<U, Count> const& rhs) noexcept
 	{
 		weak_ptr{rhs}.swap(*this);
 		return *this;
@@ -1015,16 +1775,16 @@ public:
 	}
 
 	template<class U>
-	typename std::enable_if_t<std::is_convertible<U*, element_type*>::value, weak_ptr&>
-	operator=(weak_ptr<U>&& rhs) noexcept
+	typename std::enable_if_t<std::is_convertible<U*, T*>::value, weak_ptr&>
+	operator=(weak_ptr<U, Count>&& rhs) noexcept
 	{
 		weak_ptr{std::move(rhs)}.swap(*this);
 		return *this;
 	}
 
 	template<class U>
-	typename std::enable_if_t<std::is_convertible<U*, element_type*>::value, weak_ptr&>
-	operator=(shared_ptr<U> const& rhs) noexcept
+	typename std::enable_if_t<std::is_convertible<U*, T*>::value, weak_ptr&>
+	operator=(shared_ptr<U, Count> const& rhs) noexcept
 	{
 		weak_ptr{rhs}.swap(*this);
 		return *this;
@@ -1060,10 +1820,10 @@ public:
 		return m_state.ctrl() == 0 || m_state.ctrl()->use_count() == 0;
 	}
 
-	shared_ptr<element_type>
+	shared_ptr<element_type, Count>
 	lock() const noexcept
 	{
-		shared_ptr<element_type> result;
+		shared_ptr<element_type, Count> result;
 		if (m_state.ctrl())
 		{
 			result.m_state.ctrl(m_state.ctrl()->lock());
@@ -1079,23 +1839,23 @@ public:
 		return result;
 	}
 
-	template<class U>
+	template<class U, class C>
 	friend class weak_ptr;
-	template<class U>
+	template<class U, class C>
 	friend class shared_ptr;
 };
 
-template<class T>
+template<class T, class Count>
 inline void
-swap(weak_ptr<T>& x, weak_ptr<T>& y) noexcept
+swap(weak_ptr<T, Count>& x, weak_ptr<T, Count>& y) noexcept
 {
 	x.swap(y);
 }
 
-template<class T>
+template<class T, class Count>
 template<class U>
-shared_ptr<T>::shared_ptr(
-		weak_ptr<U> const& wp,
+shared_ptr<T, Count>::shared_ptr(
+		weak_ptr<U, Count> const& wp,
 		typename std::enable_if_t<std::is_convertible<U*, T*>::value, sig_flag>)
 	: m_state{(wp.m_state.ctrl() ? wp.m_state.ctrl()->lock() : nullptr), wp.m_state.ptr()}
 {
@@ -1105,18 +1865,19 @@ shared_ptr<T>::shared_ptr(
 	}
 }
 
-template<class T>
+template<class T, class Count>
 template<class U>
-shared_ptr<T>::shared_ptr(shared_ptr<U> const& rhs, element_type* p) noexcept : m_state{rhs.m_state.ctrl(), p}
+shared_ptr<T, Count>::shared_ptr(shared_ptr<U, Count> const& rhs, element_type* p) noexcept
+	: m_state{rhs.m_state.ctrl(), p}
 {
 	if (m_state.ctrl())
 		m_state.ctrl()->increment_use_count();
 }
 
-template<class T>
+template<class T, class Count>
 class enable_shared_from_this
 {
-	mutable weak_ptr<T> m_weak_this;
+	mutable weak_ptr<T, Count> m_weak_this;
 
 protected:
 	enable_shared_from_this() noexcept {}
@@ -1129,43 +1890,130 @@ protected:
 	~enable_shared_from_this() {}
 
 public:
-	shared_ptr<T>
+	shared_ptr<T, Count>
 	shared_from_this()
 	{
-		return shared_ptr<T>(m_weak_this);
+		return shared_ptr<T, Count>(m_weak_this);
 	}
 
-	shared_ptr<T const>
+	shared_ptr<T const, Count>
 	shared_from_this() const
 	{
-		return shared_ptr<const T>(m_weak_this);
+		return shared_ptr<const T, Count>(m_weak_this);
 	}
 
-	weak_ptr<T>
+	weak_ptr<T, Count>
 	weak_from_this() noexcept
 	{
 		return m_weak_this;
 	}
 
-	weak_ptr<const T>
+	weak_ptr<const T, Count>
 	weak_from_this() const noexcept
 	{
 		return m_weak_this;
 	}
 
-	template<class U>
+	template<class U, class C>
 	friend class shared_ptr;
 };
 
+/** \brief Shared pointers with atomic reference counts, for objects shared between threads.
+ */
+namespace mt
+{
+
+template<class T>
+using shared_ptr = util::shared_ptr<T, atomic_refcount>;
+
+template<class T>
+using weak_ptr = util::weak_ptr<T, atomic_refcount>;
+
+template<class T>
+using enable_shared_from_this = util::enable_shared_from_this<T, atomic_refcount>;
+
+template<class T, class... Args>
+shared_ptr<T>
+make_shared(Args&&... args)
+{
+	return detail::shared_factory<atomic_refcount>::make<T>(std::forward<Args>(args)...);
+}
+
+template<class T, class Alloc, class... Args>
+shared_ptr<T>
+allocate_shared(Alloc&& alloc, Args&&... args)
+{
+	return detail::shared_factory<atomic_refcount>::allocate<T>(
+			std::forward<Alloc>(alloc), std::forward<Args>(args)...);
+}
+
+}    // namespace mt
+
+/** \brief Shared pointers with compact, devirtualized control blocks.
+ */
+namespace compact
+{
+
+template<class T>
+using shared_ptr = util::shared_ptr<T, compact_refcount>;
+
+template<class T>
+using weak_ptr = util::weak_ptr<T, compact_refcount>;
+
+template<class T>
+using enable_shared_from_this = util::enable_shared_from_this<T, compact_refcount>;
+
+template<class T, class... Args>
+shared_ptr<T>
+make_shared(Args&&... args)
+{
+	return detail::shared_factory<compact_refcount>::make<T>(std::forward<Args>(args)...);
+}
+
+template<class T, class Alloc, class... Args>
+shared_ptr<T>
+allocate_shared(Alloc&& alloc, Args&&... args)
+{
+	return detail::shared_factory<compact_refcount>::allocate<T>(
+			std::forward<Alloc>(alloc), std::forward<Args>(args)...);
+}
+
+}    // namespace compact
+
+/** \brief Shared pointers with compact control blocks and no weak references.
+ */
+namespace noweak
+{
+
+template<class T>
+using shared_ptr = util::shared_ptr<T, compact_noweak_refcount>;
+
+template<class T, class... Args>
+shared_ptr<T>
+make_shared(Args&&... args)
+{
+	return detail::shared_factory<compact_noweak_refcount>::make<T>(std::forward<Args>(args)...);
+}
+
+template<class T, class Alloc, class... Args>
+shared_ptr<T>
+allocate_shared(Alloc&& alloc, Args&&... args)
+{
+	return detail::shared_factory<compact_noweak_refcount>::allocate<T>(
+			std::forward<Alloc>(alloc), std::forward<Args>(args)...);
+}
+
+}    // namespace noweak
+
 }    // namespace util
 
 namespace std
 {
 
-template<class U>
-struct hash<util::shared_ptr<U>>
+template<class U, class Count>
+struct hash<util::shared_ptr<U, Count>>
 {
-	typedef util::shared_ptr<U> argument_type;
+	typedef util::shared_ptr<U, Count> argument_type;
 	typedef std::size_t         result_type;
 
 	result_type
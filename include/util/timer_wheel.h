@@ -0,0 +1,610 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef UTIL_TIMER_WHEEL_H
+#define UTIL_TIMER_WHEEL_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <system_error>
+#include <util/intrusive_ptr.h>
+#include <util/pool_allocator.h>
+#include <util/unique_function.h>
+
+/*
+ * Number of levels in a timer_wheel. Each level has 64 slots, and each slot of a level spans
+ * 64 slots of the level below, so the wheel covers 2^(6 * UTIL_TIMER_WHEEL_LEVELS) ticks (with
+ * the default of 6 levels and 1 ms ticks, a little over two years). Timers beyond the range of
+ * the wheel are parked in the top level, and re-examined each time that level wraps.
+ */
+#ifndef UTIL_TIMER_WHEEL_LEVELS
+#define UTIL_TIMER_WHEEL_LEVELS 6
+#endif
+
+/*
+ * If UTIL_TIMER_WHEEL_POOL_TIMERS is non-zero, timers are allocated from an object_pool, with a
+ * cache of free blocks per thread, rather than from the heap.
+ */
+#ifndef UTIL_TIMER_WHEEL_POOL_TIMERS
+#define UTIL_TIMER_WHEEL_POOL_TIMERS 1
+#endif
+
+namespace util
+{
+
+/** \brief Hierarchical timing wheel, with O(1) start and cancellation of timers.
+ *
+ * Time is divided into ticks of a configurable duration. Timers are kept in intrusive doubly
+ * linked lists, one per slot; level 0 has a slot per tick, and each slot of a higher level holds
+ * the timers that expire within one rotation of the level below. Starting a timer links it into
+ * the slot for its expiry tick, and cancelling it unlinks it; neither operation searches. As
+ * time advances, the slots of higher levels are redistributed to lower levels when the level
+ * below wraps around, so each timer is moved at most once per level.
+ *
+ * Deadlines are rounded up to a whole tick, so a timer never fires early, and timers that expire
+ * within the same tick are coalesced, firing together in a single pass. A wheel-wide slack may
+ * also be configured, permitting a deadline to be deferred by up to the slack so that timers
+ * with nearby deadlines share an expiry tick.
+ *
+ * The wheel is not driven by a thread of its own. The owning event loop calls advance() to fire
+ * the timers that have expired, and next_deadline() to determine how long it may wait before
+ * calling advance() again. A timer_wheel, and its timers, must be used from a single thread.
+ *
+ * Completion handlers receive std::errc::timed_out when a timer expires, and
+ * std::errc::operation_canceled when it is cancelled (including when the wheel is destroyed).
+ */
+class timer_wheel
+{
+public:
+	using clock_type   = std::chrono::steady_clock;
+	using time_point   = clock_type::time_point;
+	using duration     = clock_type::duration;
+	using handler_type = util::unique_function<void(std::error_code const&)>;
+
+	static constexpr unsigned    slot_bits   = 6;
+	static constexpr std::size_t slot_count  = std::size_t{1} << slot_bits;
+	static constexpr unsigned    level_count = UTIL_TIMER_WHEEL_LEVELS;
+
+	static_assert(level_count > 1 && level_count * slot_bits < 64, "unsupported number of timer wheel levels");
+
+	class timer;
+
+	using timer_ptr = util::intrusive_ptr<timer>;
+
+	/** \brief Construct a wheel.
+	 *
+	 * \param tick the granularity of the wheel
+	 * \param slack the amount by which a deadline may be deferred in order to coalesce it with others
+	 * \param origin the time corresponding to tick zero
+	 */
+	explicit timer_wheel(
+			duration   tick   = std::chrono::milliseconds{1},
+			duration   slack  = duration::zero(),
+			time_point origin = clock_type::now());
+
+	timer_wheel(timer_wheel const&) = delete;
+	timer_wheel&
+	operator=(timer_wheel const&) = delete;
+
+	/** \brief Destroy the wheel, cancelling any pending timers.
+	 */
+	~timer_wheel();
+
+	timer_ptr
+	create_timer();
+
+	/** \brief Start a timer that expires after \e delay.
+	 *
+	 * If the timer is already pending, \e handler is invoked immediately with
+	 * std::errc::operation_in_progress, and the pending timer is unaffected.
+	 */
+	void
+	start(timer_ptr const& t, duration delay, handler_type handler)
+	{
+		start_at(t, clock_type::now() + delay, std::move(handler));
+	}
+
+	/** \brief Start a timer that expires at \e deadline.
+	 */
+	void
+	start_at(timer_ptr const& t, time_point deadline, handler_type handler);
+
+	/** \brief Cancel a pending timer; its handler is invoked with std::errc::operation_canceled.
+	 *
+	 * \return false if the timer was not pending
+	 */
+	bool
+	cancel(timer_ptr const& t);
+
+	/** \brief Cancel all pending timers.
+	 *
+	 * \return the number of timers cancelled
+	 */
+	std::size_t
+	cancel_all();
+
+	/** \brief Fire all timers whose deadlines have passed at \e now.
+	 *
+	 * Handlers may start and cancel timers (including the one being fired).
+	 *
+	 * \return the number of timers fired
+	 */
+	std::size_t
+	advance(time_point now = clock_type::now());
+
+	/** \brief The earliest time at which advance() may have work to do.
+	 *
+	 * This is exact when the next timer to expire is within the current rotation of level 0;
+	 * otherwise it is the end of that rotation, when timers are redistributed from higher levels.
+	 * It is time_point::max() when no timers are pending.
+	 */
+	time_point
+	next_deadline() const;
+
+	/** \brief Number of pending timers.
+	 */
+	std::size_t
+	size() const
+	{
+		return m_size;
+	}
+
+	bool
+	empty() const
+	{
+		return m_size == 0;
+	}
+
+	duration
+	tick() const
+	{
+		return m_tick;
+	}
+
+private:
+	struct link
+	{
+		link* prev;
+		link* next;
+	};
+
+	using tick_type = std::uint64_t;
+
+	static constexpr tick_type slot_mask = slot_count - 1;
+
+	static void
+	init(link& head)
+	{
+		head.prev = &head;
+		head.next = &head;
+	}
+
+	static void
+	push_back(link& head, link* node)
+	{
+		node->prev       = head.prev;
+		node->next       = &head;
+		head.prev->next  = node;
+		head.prev        = node;
+	}
+
+	static void
+	unlink(link* node)
+	{
+		node->prev->next = node->next;
+		node->next->prev = node->prev;
+		node->prev       = nullptr;
+		node->next       = nullptr;
+	}
+
+	// move the contents of one list to another (empty) list
+	static void
+	splice(link& from, link& to)
+	{
+		if (from.next == &from)
+		{
+			init(to);
+		}
+		else
+		{
+			to.next       = from.next;
+			to.prev       = from.prev;
+			to.next->prev = &to;
+			to.prev->next = &to;
+			init(from);
+		}
+	}
+
+	tick_type
+	expiry_tick(time_point deadline) const;
+
+	time_point
+	tick_time(tick_type t) const
+	{
+		return m_origin + m_tick * static_cast<duration::rep>(t);
+	}
+
+	void
+	insert(timer* t);
+
+	void
+	cascade();
+
+	std::size_t
+	fire(link& slot, std::error_code const& err);
+
+	duration      m_tick;
+	tick_type     m_slack_mask;
+	time_point    m_origin;
+	tick_type     m_now;
+	std::size_t   m_size;
+	std::uint64_t m_occupied[level_count];    // may have bits set for slots that have since emptied
+	link          m_slots[level_count][slot_count];
+};
+
+/** \brief A timer, which may be started and cancelled any number of times.
+ *
+ * Timers are reference counted; the wheel holds a reference to each pending timer.
+ */
+class timer_wheel::timer : private timer_wheel::link, public util::intrusive_refcount<timer_wheel::timer>
+{
+public:
+	~timer() = default;
+
+	bool
+	pending() const noexcept
+	{
+		return next != nullptr;
+	}
+
+	/** \brief The wheel that created this timer.
+	 *
+	 * The wheel may be used through a pending timer, since the wheel cancels its pending timers
+	 * when it is destroyed; a timer that is not pending may outlive its wheel.
+	 */
+	timer_wheel*
+	wheel() const noexcept
+	{
+		return m_wheel;
+	}
+
+#if (UTIL_TIMER_WHEEL_POOL_TIMERS)
+	static void*
+	operator new(std::size_t size)
+	{
+		if (size == sizeof(timer))
+		{
+			return object_pool<timer>::instance().allocate();
+		}
+		return ::operator new(size);
+	}
+
+	static void
+	operator delete(void* p, std::size_t size) noexcept
+	{
+		if (size == sizeof(timer))
+		{
+			object_pool<timer>::instance().deallocate(p);
+			return;
+		}
+		::operator delete(p);
+	}
+#endif
+
+private:
+	friend class timer_wheel;
+
+	explicit timer(timer_wheel* wheel) noexcept : link{nullptr, nullptr}, m_wheel{wheel}, m_expiry{0} {}
+
+	static timer*
+	from_link(link* l) noexcept
+	{
+		return static_cast<timer*>(l);
+	}
+
+	timer_wheel*  m_wheel;
+	tick_type     m_expiry;
+	handler_type  m_handler;
+};
+
+inline timer_wheel::timer_wheel(duration tick, duration slack, time_point origin)
+	: m_tick{(tick > duration::zero()) ? tick : duration{1}},
+	  m_slack_mask{0},
+	  m_origin{origin},
+	  m_now{0},
+	  m_size{0},
+	  m_occupied{}
+{
+	// the slack is applied by rounding expiry ticks up to a multiple of the largest power of two not exceeding it
+	auto slack_ticks = static_cast<tick_type>((slack > duration::zero()) ? slack / m_tick : 0);
+	while ((m_slack_mask << 1 | 1) <= slack_ticks)
+	{
+		m_slack_mask = m_slack_mask << 1 | 1;
+	}
+	for (auto& level : m_slots)
+	{
+		for (auto& slot : level)
+		{
+			init(slot);
+		}
+	}
+}
+
+inline timer_wheel::~timer_wheel()
+{
+	cancel_all();
+}
+
+inline timer_wheel::timer_ptr
+timer_wheel::create_timer()
+{
+	return timer_ptr{new timer{this}};
+}
+
+inline void
+timer_wheel::start_at(timer_ptr const& t, time_point deadline, handler_type handler)
+{
+	if (t->pending())
+	{
+		handler(make_error_code(std::errc::operation_in_progress));
+		return;
+	}
+	t->m_expiry  = expiry_tick(deadline);
+	t->m_handler = std::move(handler);
+	intrusive_ptr_add_ref(t.get());    // released when the timer fires or is cancelled
+	insert(t.get());
+	++m_size;
+}
+
+inline bool
+timer_wheel::cancel(timer_ptr const& t)
+{
+	if (!t->pending())
+	{
+		return false;
+	}
+	unlink(t.get());
+	--m_size;
+	timer_ptr held{t.get(), false};    // adopt the wheel's reference
+	auto      handler = std::move(held->m_handler);
+	handler(make_error_code(std::errc::operation_canceled));
+	return true;
+}
+
+inline std::size_t
+timer_wheel::cancel_all()
+{
+	std::size_t count{0};
+	auto        err = make_error_code(std::errc::operation_canceled);
+
+	// handlers may start new timers, so repeat until the wheel is empty
+	while (m_size > 0)
+	{
+		for (auto& level : m_slots)
+		{
+			for (auto& slot : level)
+			{
+				count += fire(slot, err);
+			}
+		}
+	}
+	for (auto& occupied : m_occupied)
+	{
+		occupied = 0;
+	}
+	return count;
+}
+
+inline std::size_t
+timer_wheel::advance(time_point now)
+{
+	std::size_t count{0};
+	if (now < m_origin)
+	{
+		return count;
+	}
+	auto target = static_cast<tick_type>((now - m_origin) / m_tick);
+
+	while (m_now < target)
+	{
+		if (m_size == 0)
+		{
+			m_now = target;
+			break;
+		}
+
+		// skip directly to the next occupied slot of level 0, or to the end of its rotation
+		auto      index   = m_now & slot_mask;
+		auto      base    = m_now - index;
+		tick_type pending = (index < slot_mask) ? (m_occupied[0] & (~tick_type{0} << (index + 1))) : 0;
+		tick_type next    = pending ? base + static_cast<tick_type>(__builtin_ctzll(pending)) : base + slot_count;
+
+		m_now = (next < target) ? next : target;
+		index = m_now & slot_mask;
+		if (index == 0)
+		{
+			cascade();
+		}
+		if (m_occupied[0] & (tick_type{1} << index))
+		{
+			m_occupied[0] &= ~(tick_type{1} << index);
+			count += fire(m_slots[0][index], make_error_code(std::errc::timed_out));
+		}
+	}
+	return count;
+}
+
+inline timer_wheel::time_point
+timer_wheel::next_deadline() const
+{
+	if (m_size == 0)
+	{
+		return time_point::max();
+	}
+	auto      index   = m_now & slot_mask;
+	auto      base    = m_now - index;
+	tick_type pending = (index < slot_mask) ? (m_occupied[0] & (~tick_type{0} << (index + 1))) : 0;
+	return tick_time(pending ? base + static_cast<tick_type>(__builtin_ctzll(pending)) : base + slot_count);
+}
+
+inline timer_wheel::tick_type
+timer_wheel::expiry_tick(time_point deadline) const
+{
+	// round up to a whole tick, then up to the slack granularity
+	tick_type result{0};
+	if (deadline > m_origin)
+	{
+		auto elapsed = deadline - m_origin;
+		result       = static_cast<tick_type>(elapsed / m_tick);
+		if (elapsed % m_tick != duration::zero())
+		{
+			++result;
+		}
+	}
+	result = (result + m_slack_mask) & ~m_slack_mask;
+
+	// the current tick has already been processed
+	return (result > m_now) ? result : m_now + 1;
+}
+
+inline void
+timer_wheel::insert(timer* t)
+{
+	unsigned  level{0};
+	tick_type slot;
+	auto      diff = t->m_expiry ^ m_now;
+	if (diff != 0)
+	{
+		level = static_cast<unsigned>(63 - __builtin_clzll(diff)) / slot_bits;
+	}
+	if (level < level_count)
+	{
+		slot = (t->m_expiry >> (level * slot_bits)) & slot_mask;
+	}
+	else
+	{
+		// beyond the current rotation of the top level; park in the slot examined when the top level wraps
+		level = level_count - 1;
+		slot  = 0;
+	}
+	push_back(m_slots[level][slot], t);
+	m_occupied[level] |= tick_type{1} << slot;
+}
+
+inline void
+timer_wheel::cascade()
+{
+	// level l is due when the indices of all levels below it have wrapped to zero
+	unsigned top{1};
+	while (top + 1 < level_count && ((m_now >> (top * slot_bits)) & slot_mask) == 0)
+	{
+		++top;
+	}
+
+	// redistribute from the top down, since a higher level may refill a lower level's current slot
+	for (unsigned level = top; level > 0; --level)
+	{
+		auto index = (m_now >> (level * slot_bits)) & slot_mask;
+		if (m_occupied[level] & (tick_type{1} << index))
+		{
+			m_occupied[level] &= ~(tick_type{1} << index);
+			link pending;
+			splice(m_slots[level][index], pending);
+			while (pending.next != &pending)
+			{
+				auto t = timer::from_link(pending.next);
+				unlink(t);
+				insert(t);
+			}
+		}
+	}
+}
+
+inline std::size_t
+timer_wheel::fire(link& slot, std::error_code const& err)
+{
+	std::size_t count{0};
+
+	// detach the slot, so that handlers may start timers that land in it, and may cancel timers still in the batch
+	link batch;
+	splice(slot, batch);
+	while (batch.next != &batch)
+	{
+		auto t = timer::from_link(batch.next);
+		unlink(t);
+		--m_size;
+		timer_ptr held{t, false};    // adopt the wheel's reference
+		auto      handler = std::move(t->m_handler);
+		handler(err);
+		++count;
+	}
+	return count;
+}
+
+/** \brief AsyncAdapter for util::promise_timer, using a timer_wheel as its loop.
+ *
+ * Only the timer operations of the AsyncAdapter concept are provided; the owner of the wheel
+ * drives it by calling timer_wheel::advance().
+ */
+class timer_wheel_adapter
+{
+public:
+	using loop_type        = timer_wheel*;
+	using loop_param_type  = timer_wheel*;
+	using timer_type       = timer_wheel::timer_ptr;
+	using timer_param_type = timer_type const&;
+	using scheduled_action = timer_wheel::handler_type;
+
+	static timer_type
+	create_timer(loop_param_type wheel)
+	{
+		return wheel->create_timer();
+	}
+
+	static void
+	start_timer(timer_param_type timer, std::chrono::milliseconds ms, scheduled_action action)
+	{
+		timer->wheel()->start(timer, ms, std::move(action));
+	}
+
+	static void
+	cancel_timer(timer_param_type timer)
+	{
+		if (timer->pending())
+		{
+			timer->wheel()->cancel(timer);
+		}
+	}
+
+	static void
+	schedule(loop_param_type wheel, std::chrono::milliseconds ms, scheduled_action action)
+	{
+		wheel->start(wheel->create_timer(), ms, std::move(action));
+	}
+};
+
+}    // namespace util
+
+#endif    // UTIL_TIMER_WHEEL_H
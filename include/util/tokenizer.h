@@ -0,0 +1,427 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef UTIL_TOKENIZER_H
+#define UTIL_TOKENIZER_H
+
+#include <charconv>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <util/buffer.h>
+
+#ifndef UTIL_TOKENIZER_MAX_NUMBER_SIZE
+#define UTIL_TOKENIZER_MAX_NUMBER_SIZE 1024
+#endif
+
+namespace util
+{
+
+/** \brief Splits a segment sequence into delimited tokens, and extracts numbers, without copying.
+ *
+ * The tokenizer takes ownership of a segment sequence, such as that released by imemqbuf
+ * or omemqbuf. Delimiters are located with memchr() within each segment. A token that lies
+ * entirely within one segment is returned as a view of (or string_alias sharing) the segment
+ * itself; only tokens that straddle a segment boundary are assembled in a scratch buffer.
+ *
+ * Views returned by next() and next_line() remain valid until the next call to any member
+ * function that advances the tokenizer. Aliases returned by next_alias() share ownership of
+ * the underlying segment (or of a copy, for straddling tokens) and remain valid indefinitely.
+ *
+ * A delimiter at the end of the input does not produce an empty final token.
+ */
+class segment_tokenizer
+{
+public:
+	using buffer_type = std::deque<util::shared_buffer>;
+
+	segment_tokenizer(std::deque<util::const_buffer>&& segments) : m_index{0}, m_offset{0}
+	{
+		for (auto& segment : segments)
+		{
+			m_buf.emplace_back(std::move(segment));
+		}
+		segments.clear();
+		skip_empty();
+	}
+
+	segment_tokenizer(std::deque<util::mutable_buffer>&& segments) : m_index{0}, m_offset{0}
+	{
+		for (auto& segment : segments)
+		{
+			m_buf.emplace_back(std::move(segment));
+		}
+		segments.clear();
+		skip_empty();
+	}
+
+	/** \brief Obtain the next token terminated by \e delim (or by the end of input).
+	 *
+	 * The delimiter is consumed, and is not part of the token.
+	 *
+	 * \return false if the input is exhausted
+	 */
+	bool
+	next(char delim, std::string_view& token)
+	{
+		token_ref ref;
+		bool      result = scan(delim, ref);
+		token            = ref.view;
+		return result;
+	}
+
+	/** \brief Obtain the next line; a trailing carriage return is removed.
+	 */
+	bool
+	next_line(std::string_view& line)
+	{
+		bool result = next('\n', line);
+		if (result && !line.empty() && line.back() == '\r')
+		{
+			line.remove_suffix(1);
+		}
+		return result;
+	}
+
+	/** \brief Obtain the next token as a string_alias.
+	 *
+	 * If the token lies within one segment, the alias shares the segment, and no bytes are copied.
+	 */
+	bool
+	next_alias(char delim, string_alias& token)
+	{
+		token_ref ref;
+		bool      result = scan(delim, ref);
+		if (result)
+		{
+			if (ref.straddled)
+			{
+				token = string_alias{shared_buffer{ref.view.data(), ref.view.size()}};
+			}
+			else
+			{
+				token = string_alias{m_buf[ref.segment], ref.offset, ref.view.size()};
+			}
+		}
+		return result;
+	}
+
+	/** \brief Skip spaces, tabs, carriage returns and newlines.
+	 *
+	 * \return false if the input is exhausted
+	 */
+	bool
+	skip_whitespace()
+	{
+		while (m_index < m_buf.size())
+		{
+			auto view = current();
+			auto p    = view.data();
+			auto end  = view.data() + view.size();
+			while (p != end && is_space(*p))
+			{
+				++p;
+			}
+			m_offset += static_cast<size_type>(p - view.data());
+			if (p != end)
+			{
+				return true;
+			}
+			next_segment();
+		}
+		return false;
+	}
+
+	/** \brief Extract a number, skipping leading whitespace.
+	 *
+	 * Integers are parsed in base 10 and floating point values in general format, with
+	 * std::from_chars. The characters following the number are not consumed.
+	 *
+	 * \param value side-effected with the extracted value
+	 * \param err side-effected with std::errc::invalid_argument if the input does not begin with a
+	 * number, or std::errc::result_out_of_range if the value is not representable; in either case,
+	 * nothing is consumed.
+	 * \return true if a value was extracted; false if the input is exhausted or an error occurred
+	 */
+	template<class T, class = std::enable_if_t<std::is_arithmetic<T>::value && !std::is_same<T, bool>::value>>
+	bool
+	next_number(T& value, std::error_code& err)
+	{
+		err.clear();
+		bool result{false};
+		if (!skip_whitespace())
+			goto exit;
+
+		{
+			// a partial parse (e.g., "1e" of "1e10") can stop short of the segment end, so
+			// straddling is determined by the run of number characters, not by from_chars
+			auto view = current();
+			auto run  = view.data();
+			auto end  = view.data() + view.size();
+			while (run != end && is_number_char(*run))
+			{
+				++run;
+			}
+			if (run != end || is_last_segment())
+			{
+				// the number ends within this segment
+				auto res = from_chars(view.data(), run, value);
+				if (res.ec != std::errc{})
+				{
+					err = std::make_error_code(res.ec);
+					goto exit;
+				}
+				consume(static_cast<size_type>(res.ptr - view.data()));
+				result = true;
+				goto exit;
+			}
+		}
+
+		// the number may continue in the next segment
+		gather_number();
+		{
+			auto res = from_chars(m_scratch.data(), m_scratch.data() + m_scratch.size(), value);
+			if (res.ec != std::errc{})
+			{
+				err = std::make_error_code(res.ec);
+				goto exit;
+			}
+			consume(static_cast<size_type>(res.ptr - m_scratch.data()));
+			result = true;
+		}
+
+	exit:
+		return result;
+	}
+
+	template<class T, class = std::enable_if_t<std::is_arithmetic<T>::value && !std::is_same<T, bool>::value>>
+	bool
+	next_number(T& value)
+	{
+		std::error_code err;
+		bool            result = next_number(value, err);
+		if (err)
+		{
+			throw std::system_error{err};
+		}
+		return result;
+	}
+
+	bool
+	at_end() const
+	{
+		return m_index >= m_buf.size();
+	}
+
+	/** \brief Number of tokens that required assembly in the scratch buffer.
+	 */
+	std::size_t
+	straddle_count() const
+	{
+		return m_straddle_count;
+	}
+
+private:
+	struct token_ref
+	{
+		std::string_view view;
+		std::size_t      segment{0};
+		size_type        offset{0};
+		bool             straddled{false};
+	};
+
+	static bool
+	is_space(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+	}
+
+	static bool
+	is_number_char(char c)
+	{
+		return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '+' || c == '-'
+			   || c == '.';
+	}
+
+	template<class T>
+	static std::from_chars_result
+	from_chars(const char* first, const char* last, T& value)
+	{
+		if (first != last && *first == '+')    // from_chars does not accept a leading plus sign
+		{
+			++first;
+			if (first == last || *first == '-')
+			{
+				return std::from_chars_result{first - 1, std::errc::invalid_argument};
+			}
+		}
+		return std::from_chars(first, last, value);
+	}
+
+	std::string_view
+	current() const
+	{
+		auto const& segment = m_buf[m_index];
+		return std::string_view{reinterpret_cast<const char*>(segment.data()) + m_offset, segment.size() - m_offset};
+	}
+
+	void
+	skip_empty()
+	{
+		while (m_index < m_buf.size() && m_offset >= m_buf[m_index].size())
+		{
+			++m_index;
+			m_offset = 0;
+		}
+	}
+
+	void
+	next_segment()
+	{
+		++m_index;
+		m_offset = 0;
+		skip_empty();
+	}
+
+	void
+	consume(size_type n)
+	{
+		while (n > 0 && m_index < m_buf.size())
+		{
+			auto chunk = std::min(n, m_buf[m_index].size() - m_offset);
+			m_offset += chunk;
+			n -= chunk;
+			skip_empty();
+		}
+	}
+
+	bool
+	scan(char delim, token_ref& ref)
+	{
+		if (m_index >= m_buf.size())
+		{
+			return false;
+		}
+
+		auto view  = current();
+		auto found = static_cast<const char*>(std::memchr(view.data(), delim, view.size()));
+		if (found)
+		{
+			ref.view    = std::string_view{view.data(), static_cast<std::size_t>(found - view.data())};
+			ref.segment = m_index;
+			ref.offset  = m_offset;
+			m_offset += static_cast<size_type>(ref.view.size() + 1);
+			skip_empty();
+			return true;
+		}
+
+		if (is_last_segment())
+		{
+			// final token, not followed by a delimiter
+			ref.view    = view;
+			ref.segment = m_index;
+			ref.offset  = m_offset;
+			next_segment();
+			return true;
+		}
+
+		// token straddles segments
+		ref.segment   = m_index;
+		ref.offset    = m_offset;
+		ref.straddled = true;
+		m_scratch.assign(view.data(), view.size());
+		next_segment();
+		while (m_index < m_buf.size())
+		{
+			view  = current();
+			found = static_cast<const char*>(std::memchr(view.data(), delim, view.size()));
+			if (found)
+			{
+				m_scratch.append(view.data(), static_cast<std::size_t>(found - view.data()));
+				m_offset += static_cast<size_type>(found - view.data()) + 1;
+				skip_empty();
+				break;
+			}
+			m_scratch.append(view.data(), view.size());
+			next_segment();
+		}
+		ref.view = std::string_view{m_scratch};
+		++m_straddle_count;
+		return true;
+	}
+
+	bool
+	is_last_segment() const
+	{
+		for (auto index = m_index + 1; index < m_buf.size(); ++index)
+		{
+			if (m_buf[index].size() > 0)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// copy the run of number characters beginning at the current position into m_scratch
+	void
+	gather_number()
+	{
+		m_scratch.clear();
+		auto index  = m_index;
+		auto offset = m_offset;
+		while (index < m_buf.size() && m_scratch.size() < UTIL_TOKENIZER_MAX_NUMBER_SIZE)
+		{
+			auto const& segment = m_buf[index];
+			auto        p       = reinterpret_cast<const char*>(segment.data()) + offset;
+			auto        end     = reinterpret_cast<const char*>(segment.data()) + segment.size();
+			auto        start   = p;
+			while (p != end && is_number_char(*p))
+			{
+				++p;
+			}
+			m_scratch.append(start, static_cast<std::size_t>(p - start));
+			if (p != end)
+			{
+				break;
+			}
+			++index;
+			offset = 0;
+		}
+		++m_straddle_count;
+	}
+
+	buffer_type m_buf;
+	std::size_t m_index;
+	size_type   m_offset;
+	std::string m_scratch;
+	std::size_t m_straddle_count{0};
+};
+
+}    // namespace util
+
+#endif    // UTIL_TOKENIZER_H
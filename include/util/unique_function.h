@@ -0,0 +1,332 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef UTIL_UNIQUE_FUNCTION_H
+#define UTIL_UNIQUE_FUNCTION_H
+
+#include <cassert>
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#ifndef UTIL_UNIQUE_FUNCTION_INLINE_SIZE
+#define UTIL_UNIQUE_FUNCTION_INLINE_SIZE (6 * sizeof(void*))
+#endif
+
+namespace util
+{
+
+template<class Signature, std::size_t InlineSize = UTIL_UNIQUE_FUNCTION_INLINE_SIZE>
+class unique_function;
+
+/** \brief Move-only polymorphic function wrapper with inline storage.
+ *
+ * Like std::function, but the target need not be copyable, and any target of up to
+ * InlineSize bytes that is nothrow move constructible is stored within the object itself,
+ * without allocation. Larger targets are allocated on the heap. With the default InlineSize,
+ * a unique_function occupies 64 bytes.
+ *
+ * As with std::function, operator() is const, and invokes the target as a non-const object.
+ */
+template<class R, class... Args, std::size_t InlineSize>
+class unique_function<R(Args...), InlineSize>
+{
+	using storage_type = std::aligned_storage_t<InlineSize, alignof(std::max_align_t)>;
+
+	struct ops_type
+	{
+		R (*invoke)(storage_type*, Args&&...);
+		void (*relocate)(storage_type* from, storage_type* to) noexcept;
+		void (*destroy)(storage_type*) noexcept;
+	};
+
+	template<class F>
+	static constexpr bool stored_inline = sizeof(F) <= InlineSize && alignof(F) <= alignof(std::max_align_t)
+										  && std::is_nothrow_move_constructible<F>::value;
+
+	template<class F, class Enable = void>
+	struct manager
+	{
+		static F*
+		target(storage_type* s)
+		{
+			return *reinterpret_cast<F**>(s);
+		}
+
+		template<class G>
+		static void
+		create(storage_type* s, G&& f)
+		{
+			::new (static_cast<void*>(s)) F*{new F(std::forward<G>(f))};
+		}
+
+		static void
+		relocate(storage_type* from, storage_type* to) noexcept
+		{
+			::new (static_cast<void*>(to)) F*{target(from)};
+		}
+
+		static void
+		destroy(storage_type* s) noexcept
+		{
+			delete target(s);
+		}
+	};
+
+	template<class F>
+	struct manager<F, std::enable_if_t<stored_inline<F>>>
+	{
+		static F*
+		target(storage_type* s)
+		{
+			return std::launder(reinterpret_cast<F*>(s));
+		}
+
+		template<class G>
+		static void
+		create(storage_type* s, G&& f)
+		{
+			::new (static_cast<void*>(s)) F(std::forward<G>(f));
+		}
+
+		static void
+		relocate(storage_type* from, storage_type* to) noexcept
+		{
+			::new (static_cast<void*>(to)) F(std::move(*target(from)));
+			target(from)->~F();
+		}
+
+		static void
+		destroy(storage_type* s) noexcept
+		{
+			target(s)->~F();
+		}
+	};
+
+	template<class F>
+	static R
+	invoke(storage_type* s, Args&&... args)
+	{
+		if constexpr (std::is_void<R>::value)
+		{
+			// as for std::function, the result of a target invoked for a void signature is discarded
+			std::invoke(*manager<F>::target(s), std::forward<Args>(args)...);
+		}
+		else
+		{
+			return std::invoke(*manager<F>::target(s), std::forward<Args>(args)...);
+		}
+	}
+
+	template<class F>
+	static constexpr ops_type ops_for{&invoke<F>, &manager<F>::relocate, &manager<F>::destroy};
+
+	template<class F, class = void>
+	struct has_operator_bool : std::false_type
+	{};
+
+	template<class F>
+	struct has_operator_bool<F, std::void_t<decltype(std::declval<F const&>().operator bool())>> : std::true_type
+	{};
+
+	template<class F>
+	static bool
+	is_null(F const& f)
+	{
+		if constexpr (std::is_pointer<F>::value || std::is_member_pointer<F>::value)
+		{
+			return f == nullptr;
+		}
+		else if constexpr (has_operator_bool<F>::value)
+		{
+			// empty std::function, unique_function, etc.
+			return !static_cast<bool>(f);
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+public:
+	using result_type = R;
+
+	unique_function() noexcept : m_ops{nullptr} {}
+
+	unique_function(std::nullptr_t) noexcept : m_ops{nullptr} {}
+
+	template<
+			class F,
+			class = std::enable_if_t<
+					!std::is_same<std::decay_t<F>, unique_function>::value
+					&& std::is_invocable_r<R, std::decay_t<F>&, Args...>::value>>
+	unique_function(F&& f) : m_ops{nullptr}
+	{
+		using target_type = std::decay_t<F>;
+		if (!is_null(f))
+		{
+			manager<target_type>::create(&m_storage, std::forward<F>(f));
+			m_ops = &ops_for<target_type>;
+		}
+	}
+
+	unique_function(unique_function&& rhs) noexcept : m_ops{rhs.m_ops}
+	{
+		if (m_ops)
+		{
+			m_ops->relocate(&rhs.m_storage, &m_storage);
+			rhs.m_ops = nullptr;
+		}
+	}
+
+	unique_function(unique_function const&) = delete;
+
+	~unique_function()
+	{
+		reset();
+	}
+
+	unique_function&
+	operator=(unique_function&& rhs) noexcept
+	{
+		if (this != &rhs)
+		{
+			reset();
+			if (rhs.m_ops)
+			{
+				rhs.m_ops->relocate(&rhs.m_storage, &m_storage);
+				m_ops     = rhs.m_ops;
+				rhs.m_ops = nullptr;
+			}
+		}
+		return *this;
+	}
+
+	unique_function&
+	operator=(unique_function const&) = delete;
+
+	unique_function&
+	operator=(std::nullptr_t) noexcept
+	{
+		reset();
+		return *this;
+	}
+
+	template<
+			class F,
+			class = std::enable_if_t<
+					!std::is_same<std::decay_t<F>, unique_function>::value
+					&& std::is_invocable_r<R, std::decay_t<F>&, Args...>::value>>
+	unique_function&
+	operator=(F&& f)
+	{
+		unique_function{std::forward<F>(f)}.swap(*this);
+		return *this;
+	}
+
+	void
+	swap(unique_function& rhs) noexcept
+	{
+		unique_function tmp{std::move(rhs)};
+		rhs   = std::move(*this);
+		*this = std::move(tmp);
+	}
+
+	explicit operator bool() const noexcept
+	{
+		return m_ops != nullptr;
+	}
+
+	R
+	operator()(Args... args) const
+	{
+		assert(m_ops);
+		return m_ops->invoke(const_cast<storage_type*>(&m_storage), std::forward<Args>(args)...);
+	}
+
+	/** \brief True if a target of type F would be stored without allocation.
+	 */
+	template<class F>
+	static constexpr bool
+	is_stored_inline()
+	{
+		return stored_inline<std::decay_t<F>>;
+	}
+
+private:
+	void
+	reset() noexcept
+	{
+		if (m_ops)
+		{
+			auto ops = m_ops;
+			m_ops    = nullptr;
+			ops->destroy(&m_storage);
+		}
+	}
+
+	storage_type    m_storage;
+	ops_type const* m_ops;
+};
+
+template<class R, class... Args, std::size_t N>
+inline bool
+operator==(unique_function<R(Args...), N> const& f, std::nullptr_t) noexcept
+{
+	return !f;
+}
+
+template<class R, class... Args, std::size_t N>
+inline bool
+operator==(std::nullptr_t, unique_function<R(Args...), N> const& f) noexcept
+{
+	return !f;
+}
+
+template<class R, class... Args, std::size_t N>
+inline bool
+operator!=(unique_function<R(Args...), N> const& f, std::nullptr_t) noexcept
+{
+	return static_cast<bool>(f);
+}
+
+template<class R, class... Args, std::size_t N>
+inline bool
+operator!=(std::nullptr_t, unique_function<R(Args...), N> const& f) noexcept
+{
+	return static_cast<bool>(f);
+}
+
+template<class R, class... Args, std::size_t N>
+inline void
+swap(unique_function<R(Args...), N>& x, unique_function<R(Args...), N>& y) noexcept
+{
+	x.swap(y);
+}
+
+}    // namespace util
+
+#endif    // UTIL_UNIQUE_FUNCTION_H
@@ -0,0 +1,610 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef UTIL_WORK_STEALING_POOL_H
+#define UTIL_WORK_STEALING_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <boost/predef.h>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <util/mt_promise.h>
+#include <util/pool_allocator.h>
+#include <util/unique_function.h>
+#include <utility>
+#include <vector>
+
+#if (BOOST_OS_LINUX)
+#include <linux/futex.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#include <condition_variable>
+#include <mutex>
+#endif
+
+#ifndef UTIL_WORK_STEALING_CAPACITY
+#define UTIL_WORK_STEALING_CAPACITY 256
+#endif
+
+#ifndef UTIL_WORK_STEALING_SPIN
+#define UTIL_WORK_STEALING_SPIN 64
+#endif
+
+namespace util
+{
+namespace detail
+{
+
+/** \brief Chase-Lev work-stealing deque of pointers.
+ *
+ * The owning thread pushes and pops at the bottom; any thread may steal from the top. The
+ * ring grows (by doubling) when full; rings that have been replaced are retained until the
+ * deque is destroyed, since a thief may still be reading one.
+ *
+ * The synchronization follows Lê et al., "Correct and Efficient Work-Stealing for Weak Memory
+ * Models" (PPoPP 2013), with the standalone fences expressed as sequentially consistent
+ * accesses to top and bottom.
+ */
+template<class T>
+class chase_lev_deque
+{
+public:
+	explicit chase_lev_deque(std::int64_t capacity = UTIL_WORK_STEALING_CAPACITY) : m_top{0}, m_bottom{0}
+	{
+		std::int64_t size{1};
+		while (size < capacity)
+		{
+			size <<= 1;
+		}
+		m_rings.push_back(std::make_unique<ring>(size));
+		m_ring.store(m_rings.back().get(), std::memory_order_relaxed);
+	}
+
+	chase_lev_deque(chase_lev_deque const&) = delete;
+	chase_lev_deque&
+	operator=(chase_lev_deque const&) = delete;
+
+	/** \brief Push an item at the bottom; owner only.
+	 */
+	void
+	push(T* item)
+	{
+		auto b = m_bottom.load(std::memory_order_relaxed);
+		auto t = m_top.load(std::memory_order_acquire);
+		auto r = m_ring.load(std::memory_order_relaxed);
+		if (b - t > r->mask)
+		{
+			r = grow(r, t, b);
+		}
+		r->put(b, item);
+		m_bottom.store(b + 1, std::memory_order_release);
+	}
+
+	/** \brief Pop the most recently pushed item; owner only.
+	 *
+	 * \return nullptr if the deque is empty
+	 */
+	T*
+	pop()
+	{
+		auto b = m_bottom.load(std::memory_order_relaxed) - 1;
+		auto r = m_ring.load(std::memory_order_relaxed);
+		m_bottom.store(b, std::memory_order_seq_cst);
+		auto t    = m_top.load(std::memory_order_seq_cst);
+		T*   item = nullptr;
+		if (t <= b)
+		{
+			item = r->get(b);
+			if (t == b)
+			{
+				// last item; race any thief for it
+				if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				{
+					item = nullptr;
+				}
+				m_bottom.store(b + 1, std::memory_order_relaxed);
+			}
+		}
+		else
+		{
+			m_bottom.store(b + 1, std::memory_order_relaxed);
+		}
+		return item;
+	}
+
+	/** \brief Steal the least recently pushed item; any thread.
+	 *
+	 * \return nullptr if the deque is empty, or if another thread took the item first
+	 */
+	T*
+	steal()
+	{
+		auto t = m_top.load(std::memory_order_seq_cst);
+		auto b = m_bottom.load(std::memory_order_seq_cst);
+		if (t >= b)
+		{
+			return nullptr;
+		}
+		auto item = m_ring.load(std::memory_order_acquire)->get(t);
+		if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		{
+			return nullptr;
+		}
+		return item;
+	}
+
+	/** \brief Approximate number of items.
+	 */
+	std::int64_t
+	size() const
+	{
+		auto b = m_bottom.load(std::memory_order_relaxed);
+		auto t = m_top.load(std::memory_order_relaxed);
+		return std::max(b - t, std::int64_t{0});
+	}
+
+private:
+	struct ring
+	{
+		explicit ring(std::int64_t capacity) : mask{capacity - 1}, slots{new std::atomic<T*>[capacity]} {}
+
+		void
+		put(std::int64_t index, T* item)
+		{
+			slots[index & mask].store(item, std::memory_order_relaxed);
+		}
+
+		T*
+		get(std::int64_t index) const
+		{
+			return slots[index & mask].load(std::memory_order_relaxed);
+		}
+
+		std::int64_t                       mask;
+		std::unique_ptr<std::atomic<T*>[]> slots;
+	};
+
+	ring*
+	grow(ring* r, std::int64_t t, std::int64_t b)
+	{
+		m_rings.push_back(std::make_unique<ring>((r->mask + 1) * 2));
+		auto bigger = m_rings.back().get();
+		for (auto i = t; i < b; ++i)
+		{
+			bigger->put(i, r->get(i));
+		}
+		m_ring.store(bigger, std::memory_order_release);
+		return bigger;
+	}
+
+	alignas(64) std::atomic<std::int64_t> m_top;
+	alignas(64) std::atomic<std::int64_t> m_bottom;
+	std::atomic<ring*>                    m_ring;
+	std::vector<std::unique_ptr<ring>>    m_rings;
+};
+
+/** \brief Event count on which idle threads park.
+ *
+ * A thread calls prepare_wait(), checks for work once more, and then either cancel_wait()s or
+ * wait()s with the key obtained from prepare_wait(). A notify after prepare_wait() causes
+ * the wait to return immediately, so a wakeup cannot be lost between the check and the wait.
+ */
+class event_count
+{
+public:
+	event_count() : m_epoch{0}, m_waiters{0} {}
+
+	std::uint32_t
+	prepare_wait()
+	{
+		m_waiters.fetch_add(1, std::memory_order_seq_cst);
+		return m_epoch.load(std::memory_order_seq_cst);
+	}
+
+	void
+	cancel_wait()
+	{
+		m_waiters.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	void
+	wait(std::uint32_t key)
+	{
+#if (BOOST_OS_LINUX)
+		while (m_epoch.load(std::memory_order_acquire) == key)
+		{
+			::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&m_epoch), FUTEX_WAIT_PRIVATE, key, nullptr, nullptr, 0);
+		}
+#else
+		std::unique_lock<std::mutex> lock{m_mutex};
+		m_cond.wait(lock, [&]() { return m_epoch.load(std::memory_order_acquire) != key; });
+#endif
+		m_waiters.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	void
+	notify_one()
+	{
+		notify(1);
+	}
+
+	void
+	notify_all()
+	{
+		notify(std::numeric_limits<int>::max());
+	}
+
+private:
+	void
+	notify(int count)
+	{
+		// order the caller's publication of work before the check for waiters
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (m_waiters.load(std::memory_order_seq_cst) == 0)
+		{
+			return;
+		}
+		m_epoch.fetch_add(1, std::memory_order_seq_cst);
+#if (BOOST_OS_LINUX)
+		::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&m_epoch), FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+#else
+		{
+			std::lock_guard<std::mutex> lock{m_mutex};
+		}
+		if (count == 1)
+		{
+			m_cond.notify_one();
+		}
+		else
+		{
+			m_cond.notify_all();
+		}
+#endif
+	}
+
+	static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t), "futex word must be 32 bits");
+
+	std::atomic<std::uint32_t> m_epoch;
+	std::atomic<std::int32_t>  m_waiters;
+#if (!BOOST_OS_LINUX)
+	std::mutex              m_mutex;
+	std::condition_variable m_cond;
+#endif
+};
+
+struct ws_task
+{
+	template<class F>
+	explicit ws_task(F&& f) : func{std::forward<F>(f)}
+	{}
+
+	util::unique_function<void()> func;
+	ws_task*                      next{nullptr};
+};
+
+}    // namespace detail
+
+/** \brief Thread pool in which each worker has its own deque of tasks, and idle workers steal.
+ *
+ * Work posted from a worker thread is pushed onto that worker's Chase-Lev deque, and is
+ * popped in LIFO order by the worker, or stolen in FIFO order by idle workers. Work posted
+ * from other threads goes to a lock-free injection stack, from which a worker takes the
+ * entire batch at once. Task nodes come from an object_pool, so posting does not allocate
+ * unless the task's callable exceeds util::unique_function's inline storage.
+ *
+ * Idle workers spin briefly (UTIL_WORK_STEALING_SPIN attempts), then park on a futex (a
+ * condition variable on platforms other than Linux). Tasks must not throw.
+ *
+ * Work posted before the pool is destroyed, including work posted by that work, is run
+ * before the destructor returns.
+ */
+class work_stealing_pool
+{
+public:
+	class executor_type
+	{
+	public:
+		template<class F>
+		void
+		post(F&& f) const
+		{
+			m_pool->post(std::forward<F>(f));
+		}
+
+	private:
+		friend class work_stealing_pool;
+
+		explicit executor_type(work_stealing_pool* pool) : m_pool{pool} {}
+
+		work_stealing_pool* m_pool;
+	};
+
+	/** \brief Start the workers.
+	 *
+	 * \param threads the number of workers
+	 * \param pin_threads if true (and supported by the platform), worker i is bound to core i modulo the
+	 * number of cores
+	 */
+	explicit work_stealing_pool(std::size_t threads = std::thread::hardware_concurrency(), bool pin_threads = false)
+		: m_stopping{false}, m_injected{nullptr}
+	{
+		threads = std::max(threads, std::size_t{1});
+		m_workers.reserve(threads);
+		for (std::size_t i = 0; i < threads; ++i)
+		{
+			m_workers.push_back(std::make_unique<worker>(i));
+		}
+		for (auto& w : m_workers)
+		{
+			w->thread = std::thread{[this, index = w->index]() { run(index); }};
+			if (pin_threads)
+			{
+				pin(w->thread, w->index);
+			}
+		}
+	}
+
+	work_stealing_pool(work_stealing_pool const&) = delete;
+	work_stealing_pool&
+	operator=(work_stealing_pool const&) = delete;
+
+	~work_stealing_pool()
+	{
+		m_stopping.store(true, std::memory_order_seq_cst);
+		m_event.notify_all();
+		for (auto& w : m_workers)
+		{
+			w->thread.join();
+		}
+	}
+
+	template<class F>
+	void
+	post(F&& f)
+	{
+		auto  task = new (object_pool<detail::ws_task>::instance().allocate()) detail::ws_task{std::forward<F>(f)};
+		auto& ctx  = context();
+		if (ctx.pool == this)
+		{
+			m_workers[ctx.index]->deque.push(task);
+		}
+		else
+		{
+			auto head = m_injected.load(std::memory_order_relaxed);
+			do
+			{
+				task->next = head;
+			}
+			while (!m_injected.compare_exchange_weak(head, task, std::memory_order_release, std::memory_order_relaxed));
+		}
+		m_event.notify_one();
+	}
+
+	/** \brief Post \e func, and obtain a promise for its result.
+	 *
+	 * The promise is resolved on the worker that runs \e func.
+	 */
+	template<class F, class R = std::invoke_result_t<std::decay_t<F>&>>
+	mt::promise<R>
+	submit(F&& func)
+	{
+		mt::promise<R> result;
+		post([result, func = std::forward<F>(func)]() mutable {
+			if constexpr (std::is_void<R>::value)
+			{
+				func();
+				result.resolve();
+			}
+			else
+			{
+				result.resolve(func());
+			}
+		});
+		return result;
+	}
+
+	executor_type
+	executor()
+	{
+		return executor_type{this};
+	}
+
+	std::size_t
+	size() const
+	{
+		return m_workers.size();
+	}
+
+	/** \brief Number of tasks taken from another worker's deque since the pool started.
+	 */
+	std::uint64_t
+	steal_count() const
+	{
+		std::uint64_t count{0};
+		for (auto& w : m_workers)
+		{
+			count += w->steals.load(std::memory_order_relaxed);
+		}
+		return count;
+	}
+
+private:
+	struct alignas(64) worker
+	{
+		explicit worker(std::size_t i) : index{i}, rng{static_cast<std::uint32_t>(i) * 2654435761u + 1} {}
+
+		std::size_t                              index;
+		std::uint32_t                            rng;
+		std::atomic<std::uint64_t>               steals{0};
+		detail::chase_lev_deque<detail::ws_task> deque;
+		std::thread                              thread;
+	};
+
+	struct worker_context
+	{
+		work_stealing_pool* pool{nullptr};
+		std::size_t         index{0};
+	};
+
+	static worker_context&
+	context()
+	{
+		static thread_local worker_context ctx;
+		return ctx;
+	}
+
+	static void
+	pin(std::thread& thread, std::size_t index)
+	{
+#if (BOOST_OS_LINUX)
+		auto      cores = std::max(std::thread::hardware_concurrency(), 1u);
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(static_cast<int>(index % cores), &set);
+		::pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+#else
+		(void)thread;
+		(void)index;
+#endif
+	}
+
+	void
+	run(std::size_t index)
+	{
+		context() = worker_context{this, index};
+		for (;;)
+		{
+			auto task = find(index);
+			for (int spin = 0; !task && spin < UTIL_WORK_STEALING_SPIN; ++spin)
+			{
+				std::this_thread::yield();
+				task = find(index);
+			}
+			if (!task)
+			{
+				auto key = m_event.prepare_wait();
+				task     = find(index);
+				if (!task)
+				{
+					if (m_stopping.load(std::memory_order_seq_cst))
+					{
+						m_event.cancel_wait();
+						break;
+					}
+					m_event.wait(key);
+					continue;
+				}
+				m_event.cancel_wait();
+			}
+			task->func();
+			task->~ws_task();
+			object_pool<detail::ws_task>::instance().deallocate(task);
+		}
+		context() = worker_context{};
+	}
+
+	detail::ws_task*
+	find(std::size_t index)
+	{
+		auto& self = *m_workers[index];
+		auto  task = self.deque.pop();
+		if (!task)
+		{
+			task = take_injected(self);
+		}
+		if (!task)
+		{
+			task = steal(self);
+		}
+		return task;
+	}
+
+	// take the whole injection stack; run the oldest task, and push the rest onto our own deque
+	detail::ws_task*
+	take_injected(worker& self)
+	{
+		if (!m_injected.load(std::memory_order_relaxed))
+		{
+			return nullptr;
+		}
+		auto task = m_injected.exchange(nullptr, std::memory_order_acquire);
+		while (task && task->next)
+		{
+			auto next = task->next;
+			self.deque.push(task);
+			task = next;
+		}
+		if (self.deque.size() > 0)
+		{
+			m_event.notify_one();    // let an idle worker steal the remainder
+		}
+		return task;
+	}
+
+	detail::ws_task*
+	steal(worker& self)
+	{
+		auto count = m_workers.size();
+		if (count < 2)
+		{
+			return nullptr;
+		}
+		// xorshift, to pick a random first victim
+		self.rng ^= self.rng << 13;
+		self.rng ^= self.rng >> 17;
+		self.rng ^= self.rng << 5;
+		auto start = self.rng % count;
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			auto& victim = *m_workers[(start + i) % count];
+			if (&victim != &self)
+			{
+				auto task = victim.deque.steal();
+				if (task)
+				{
+					self.steals.fetch_add(1, std::memory_order_relaxed);
+					return task;
+				}
+			}
+		}
+		return nullptr;
+	}
+
+	std::vector<std::unique_ptr<worker>> m_workers;
+	detail::event_count                  m_event;
+	std::atomic<bool>                    m_stopping;
+	std::atomic<detail::ws_task*>        m_injected;
+};
+
+}    // namespace util
+
+#endif    // UTIL_WORK_STEALING_POOL_H
@@ -0,0 +1,161 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <doctest.h>
+#include <thread>
+#include <util/atomic_shared_ptr.h>
+#include <vector>
+
+namespace
+{
+
+struct config
+{
+	config(int v, std::atomic<int>& live) : version{v}, check{v * 3}, m_live{live}
+	{
+		++m_live;
+	}
+
+	~config()
+	{
+		--m_live;
+	}
+
+	int               version;
+	int               check;
+	std::atomic<int>& m_live;
+};
+
+}    // namespace
+
+TEST_CASE("util::atomic_shared_ptr [ smoke ] { load store exchange }")
+{
+	std::atomic<int> live{0};
+	{
+		util::atomic_shared_ptr<config> ap;
+		CHECK(ap.is_lock_free());
+		CHECK(!ap.load());
+
+		auto first = util::mt::make_shared<config>(1, live);
+		ap.store(first);
+		CHECK(ap.load() == first);
+		CHECK(first.use_count() == 2);
+
+		auto old = ap.exchange(util::mt::make_shared<config>(2, live));
+		CHECK(old == first);
+		CHECK(ap.load()->version == 2);
+		CHECK(live == 2);
+
+		old.reset();
+		first.reset();
+		CHECK(live == 1);
+
+		ap.store(nullptr);
+		CHECK(!ap.load());
+		CHECK(live == 0);
+
+		ap.store(util::mt::make_shared<config>(3, live));
+	}
+	CHECK(live == 0);
+}
+
+TEST_CASE("util::atomic_shared_ptr [ smoke ] { compare_exchange }")
+{
+	std::atomic<int>                live{0};
+	auto                            a = util::mt::make_shared<config>(1, live);
+	auto                            b = util::mt::make_shared<config>(2, live);
+	util::atomic_shared_ptr<config> ap{a};
+
+	util::mt::shared_ptr<config> expected = b;
+	CHECK(!ap.compare_exchange_strong(expected, b));
+	CHECK(expected == a);
+	CHECK(ap.compare_exchange_strong(expected, b));
+	CHECK(ap.load() == b);
+
+	expected.reset();
+	CHECK(!ap.compare_exchange_weak(expected, nullptr));
+	CHECK(expected == b);
+	CHECK(ap.compare_exchange_weak(expected, nullptr));
+	CHECK(!ap.load());
+
+	expected.reset();
+	CHECK(ap.compare_exchange_strong(expected, a));
+	CHECK(ap.load() == a);
+	CHECK(a.use_count() == 2);
+}
+
+TEST_CASE("util::atomic_shared_ptr [ smoke ] { concurrent readers and writers }")
+{
+	std::atomic<int> live{0};
+	std::atomic<int> mismatches{0};
+	{
+		util::atomic_shared_ptr<config> ap{util::mt::make_shared<config>(0, live)};
+		std::atomic<bool>               done{false};
+
+		std::vector<std::thread> readers;
+		for (int t = 0; t < 4; ++t)
+		{
+			readers.emplace_back([&]() {
+				int last{0};
+				while (!done.load(std::memory_order_relaxed))
+				{
+					auto p = ap.load();
+					if (!p || p->check != p->version * 3 || p->version < last)
+					{
+						++mismatches;
+					}
+					last = p ? p->version : last;
+				}
+			});
+		}
+
+		std::thread swapper{[&]() {
+			for (int i = 0; i < 2000; ++i)
+			{
+				auto expected = ap.load();
+				auto desired  = util::mt::make_shared<config>(expected->version + 1, live);
+				while (!ap.compare_exchange_weak(expected, desired))
+				{
+					desired = util::mt::make_shared<config>(expected->version + 1, live);
+				}
+			}
+		}};
+
+		for (int i = 0; i < 2000; ++i)
+		{
+			auto old = ap.load();
+			ap.store(util::mt::make_shared<config>(old->version + 1, live));
+		}
+		swapper.join();
+		done = true;
+		for (auto& reader : readers)
+		{
+			reader.join();
+		}
+		CHECK(ap.load()->version <= 4000);
+		CHECK(live == 1);
+	}
+	CHECK(mismatches == 0);
+	CHECK(live == 0);
+}
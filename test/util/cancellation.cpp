@@ -0,0 +1,118 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <doctest.h>
+#include <iostream>
+#include <util/cancellation.h>
+#include <vector>
+
+using util::cancellation_registration;
+using util::cancellation_source;
+using util::cancellation_token;
+
+TEST_CASE("util::cancellation_source [ smoke ] { callbacks }")
+{
+	cancellation_source source;
+	auto                token = source.token();
+	std::vector<int>    fired;
+
+	SUBCASE("callbacks run once, in registration order")
+	{
+		auto r1 = token.on_cancel([&]() { fired.push_back(1); });
+		auto r2 = token.on_cancel([&]() { fired.push_back(2); });
+		CHECK(r1.pending());
+		CHECK(!token.is_cancelled());
+
+		source.cancel();
+		source.cancel();
+		CHECK(token.is_cancelled());
+		CHECK(source.is_cancelled());
+		CHECK(fired == std::vector<int>{1, 2});
+		CHECK(!r1.pending());
+	}
+
+	SUBCASE("destroying a registration deregisters the callback")
+	{
+		{
+			auto r = token.on_cancel([&]() { fired.push_back(1); });
+		}
+		auto r2 = token.on_cancel([&]() { fired.push_back(2); });
+		r2.reset();
+		source.cancel();
+		CHECK(fired.empty());
+	}
+
+	SUBCASE("registering with a cancelled token runs the callback immediately")
+	{
+		source.cancel();
+		auto r = token.on_cancel([&]() { fired.push_back(1); });
+		CHECK(fired == std::vector<int>{1});
+		CHECK(!r.pending());
+	}
+
+	SUBCASE("callbacks may deregister others, and destroy their own registration")
+	{
+		cancellation_registration r2;
+		cancellation_registration r1 = token.on_cancel([&]() {
+			fired.push_back(1);
+			r2.reset();
+			r1.reset();
+		});
+		r2 = token.on_cancel([&]() { fired.push_back(2); });
+		source.cancel();
+		CHECK(fired == std::vector<int>{1});
+	}
+
+	SUBCASE("captured state is released once the callback has run")
+	{
+		auto captured = std::make_shared<int>(0);
+		auto r        = token.on_cancel([captured]() {});
+		CHECK(captured.use_count() == 2);
+		source.cancel();
+		CHECK(captured.use_count() == 1);
+	}
+
+	SUBCASE("the source may be destroyed by a callback")
+	{
+		auto owned = std::make_unique<cancellation_source>();
+		auto r     = owned->token().on_cancel([&]() {
+			owned.reset();
+			fired.push_back(1);
+		});
+		owned->cancel();
+		CHECK(fired == std::vector<int>{1});
+	}
+}
+
+TEST_CASE("util::cancellation_token [ smoke ] { default }")
+{
+	cancellation_token token;
+	bool               fired{false};
+	CHECK(!token.can_be_cancelled());
+	CHECK(!token.is_cancelled());
+	auto r = token.on_cancel([&]() { fired = true; });
+	CHECK(!r.pending());
+	CHECK(!fired);
+	CHECK(token == cancellation_token{});
+}
@@ -0,0 +1,96 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include <doctest.h>
+#include <string>
+#include <util/buffer.h>
+#include <util/checksum.h>
+
+TEST_CASE("util::checksum [ smoke ] { crc32 matches buffer checksum }")
+{
+	std::string          content{"The quick brown fox jumps over the lazy dog"};
+	util::mutable_buffer buf{content};
+	CHECK(util::crc32(content.data(), content.size()) == buf.checksum());
+	CHECK(util::crc32(content.data(), content.size()) == 0x414fa339);
+	CHECK(util::crc32(nullptr, 0) == 0);
+}
+
+TEST_CASE("util::checksum [ smoke ] { adler32 }")
+{
+	std::string content{"Wikipedia"};
+	CHECK(util::adler32(content.data(), content.size()) == 0x11e60398);
+	CHECK(util::adler32(nullptr, 0) == 1);
+}
+
+TEST_CASE("util::checksum [ smoke ] { combine }")
+{
+	std::string content;
+	for (int i = 0; i < 20000; ++i)
+	{
+		content.push_back(static_cast<char>((i * 7919) & 0xff));
+	}
+	auto crc   = util::crc32(content.data(), content.size());
+	auto adler = util::adler32(content.data(), content.size());
+
+	for (std::size_t split : {std::size_t{0}, std::size_t{1}, std::size_t{17}, std::size_t{5552}, content.size()})
+	{
+		auto tail = content.size() - split;
+		auto crc1 = util::crc32(content.data(), split);
+		auto crc2 = util::crc32(content.data() + split, tail);
+		CHECK(util::crc32_combine(crc1, crc2, tail) == crc);
+
+		auto adler1 = util::adler32(content.data(), split);
+		auto adler2 = util::adler32(content.data() + split, tail);
+		CHECK(util::adler32_combine(adler1, adler2, tail) == adler);
+	}
+}
+
+TEST_CASE("util::checksum [ smoke ] { block_checksum rewrite }")
+{
+	std::string content(1000, 'x');
+	for (std::size_t i = 0; i < content.size(); ++i)
+	{
+		content[i] = static_cast<char>('a' + (i % 26));
+	}
+	auto block_data = [&](util::size_type index) {
+		return reinterpret_cast<const util::byte_type*>(content.data()) + index * 64;
+	};
+
+	util::block_checksum sums{util::checksum_mode::crc32_adler32, 64};
+	sums.written(0, content.size(), block_data);
+	auto result = sums.result(content.size(), block_data);
+	CHECK(result.crc == util::crc32(content.data(), content.size()));
+	CHECK(result.fast == util::adler32(content.data(), content.size()));
+
+	content[130] = '#';
+	content[131] = '#';
+	sums.written(130, 132, block_data);
+	result = sums.result(content.size(), block_data);
+	CHECK(result.crc == util::crc32(content.data(), content.size()));
+	CHECK(result.fast == util::adler32(content.data(), content.size()));
+
+	result = sums.result(500, block_data);
+	CHECK(result.crc == util::crc32(content.data(), 500));
+}
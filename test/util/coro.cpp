@@ -0,0 +1,189 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <doctest.h>
+#include <iostream>
+#include <stdexcept>
+#include <util/coro.h>
+
+using util::promise;
+
+namespace
+{
+
+promise<int>
+add_one(promise<int> p)
+{
+	auto v = co_await p;
+	co_return v + 1;
+}
+
+promise<int>
+sum_of(promise<int> a, promise<int> b)
+{
+	co_return co_await add_one(a) + co_await add_one(b);
+}
+
+promise<void>
+wait_for(promise<void> p, int& count)
+{
+	co_await p;
+	++count;
+}
+
+promise<int>
+recover(promise<int> p)
+{
+	auto [err, value] = co_await util::as_result(p);
+	co_return err ? -1 : value;
+}
+
+promise<void>
+throws_system_error()
+{
+	throw std::system_error{make_error_code(std::errc::timed_out)};
+	co_return;
+}
+
+promise<int>
+throws_other()
+{
+	throw std::runtime_error{"oops"};
+	co_return 0;
+}
+
+promise<int>
+count_down(promise<int> p, int n)
+{
+	int total{0};
+	for (int i = 0; i < n; ++i)
+	{
+		total += co_await add_one(p);
+	}
+	co_return total;
+}
+
+}    // namespace
+
+TEST_CASE("util::coro [ smoke ] { await }")
+{
+	SUBCASE("resolved later")
+	{
+		promise<int> a;
+		promise<int> b;
+		int          result{0};
+		sum_of(a, b).then([&](int v) { result = v; });
+		a.resolve(1);
+		CHECK(result == 0);
+		b.resolve(2);
+		CHECK(result == 5);
+	}
+
+	SUBCASE("resolved before")
+	{
+		int  result{0};
+		auto p = promise<int>::build(4);
+		add_one(p).then([&](int v) { result = v; });
+		CHECK(result == 5);
+
+		int  count{0};
+		auto q = promise<void>::build();
+		wait_for(q, count);
+		CHECK(count == 1);
+	}
+
+	SUBCASE("void")
+	{
+		int           count{0};
+		promise<void> p;
+		wait_for(p, count);
+		CHECK(count == 0);
+		p.resolve();
+		CHECK(count == 1);
+	}
+
+	SUBCASE("loop")
+	{
+		int  result{0};
+		auto p = promise<int>::build(1);
+		count_down(p, 1000).then([&](int v) { result = v; });
+		CHECK(result == 2000);
+	}
+}
+
+TEST_CASE("util::coro [ smoke ] { errors }")
+{
+	SUBCASE("rejection propagates")
+	{
+		std::error_code caught;
+		promise<int>    p;
+		add_one(p).then([](int) {}, [&](std::error_code const& err) { caught = err; });
+		p.reject(make_error_code(std::errc::timed_out));
+		CHECK(caught == std::errc::timed_out);
+	}
+
+	SUBCASE("as_result")
+	{
+		int          result{0};
+		promise<int> p;
+		recover(p).then([&](int v) { result = v; });
+		p.reject(make_error_code(std::errc::timed_out));
+		CHECK(result == -1);
+
+		promise<int> q;
+		recover(q).then([&](int v) { result = v; });
+		q.resolve(3);
+		CHECK(result == 3);
+	}
+
+	SUBCASE("exceptions")
+	{
+		std::error_code caught;
+		throws_system_error().catcher([&](std::error_code const& err) { caught = err; });
+		CHECK(caught == std::errc::timed_out);
+		throws_other().catcher([&](std::error_code const& err) { caught = err; });
+		CHECK(caught == util::errc::unhandled_exception);
+	}
+}
+
+#if (UTIL_CORO_POOL_FRAMES)
+
+TEST_CASE("util::coro [ smoke ] { frame pool }")
+{
+	auto& small  = util::detail::coro_frame_pool<128>::instance();
+	auto& medium = util::detail::coro_frame_pool<256>::instance();
+	auto  before = small.stats().in_use + medium.stats().in_use;
+	{
+		promise<int> p;
+		promise<int> q;
+		auto         r = add_one(p);
+		auto         s = add_one(q);
+		CHECK(small.stats().in_use + medium.stats().in_use == before + 2);
+		p.resolve(1);
+		q.resolve(2);
+	}
+	CHECK(small.stats().in_use + medium.stats().in_use == before);
+}
+
+#endif
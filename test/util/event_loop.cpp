@@ -0,0 +1,227 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <atomic>
+#include <doctest.h>
+#include <iostream>
+#include <thread>
+#include <unistd.h>
+#include <util/event_loop.h>
+#include <util/executor.h>
+#include <util/promise_timer.h>
+
+#if (BOOST_OS_LINUX)
+
+using namespace std::chrono_literals;
+
+TEST_CASE("util::event_loop [ smoke ] { dispatch }")
+{
+	util::event_loop loop;
+
+	SUBCASE("same thread")
+	{
+		int count{0};
+		loop.dispatch([&]() {
+			++count;
+			loop.dispatch([&]() { ++count; });    // runs in the next iteration
+		});
+		CHECK(loop.poll() == 1);
+		CHECK(count == 1);
+		CHECK(loop.poll() == 1);
+		CHECK(count == 2);
+	}
+
+	SUBCASE("other threads")
+	{
+		constexpr int    per_thread = 1000;
+		std::atomic<int> count{0};
+		std::thread      runner{[&]() { loop.run(); }};
+		std::thread      producers[4];
+		for (auto& producer : producers)
+		{
+			producer = std::thread{[&]() {
+				for (int i = 0; i < per_thread; ++i)
+				{
+					loop.dispatch([&]() { count.fetch_add(1, std::memory_order_relaxed); });
+				}
+			}};
+		}
+		for (auto& producer : producers)
+		{
+			producer.join();
+		}
+		loop.dispatch([&]() { loop.stop(); });
+		runner.join();
+		CHECK(count.load() == 4 * per_thread);
+	}
+
+	SUBCASE("stop from another thread")
+	{
+		std::thread runner{[&]() { loop.run(); }};
+		std::this_thread::sleep_for(10ms);
+		loop.stop();
+		runner.join();
+	}
+}
+
+TEST_CASE("util::event_loop [ smoke ] { timers }")
+{
+	util::event_loop loop;
+
+	SUBCASE("schedule")
+	{
+		std::error_code              result;
+		util::event_loop::time_point fired;
+		auto                         start = util::event_loop::clock_type::now();
+		loop.schedule(20ms, [&](std::error_code const& err) {
+			result = err;
+			fired  = util::event_loop::clock_type::now();
+			loop.stop();
+		});
+		loop.run();
+		CHECK(result == make_error_code(std::errc::timed_out));
+		CHECK(fired - start >= 20ms);
+	}
+
+	SUBCASE("an earlier timer re-arms the timerfd")
+	{
+		std::vector<int> fired;
+		loop.schedule(200ms, [&](std::error_code const&) { fired.push_back(2); });
+		loop.dispatch([&]() {
+			loop.schedule(10ms, [&](std::error_code const&) {
+				fired.push_back(1);
+				loop.stop();
+			});
+		});
+		auto start = util::event_loop::clock_type::now();
+		loop.run();
+		CHECK(fired == std::vector<int>{1});
+		CHECK(util::event_loop::clock_type::now() - start < 150ms);
+		loop.timers().cancel_all();    // before fired goes out of scope
+	}
+
+	SUBCASE("shutdown cancels timers")
+	{
+		std::error_code result;
+		loop.schedule(10s, [&](std::error_code const& err) { result = err; });
+		loop.dispatch([&]() { loop.shutdown(); });
+		loop.run();
+		CHECK(result == make_error_code(std::errc::operation_canceled));
+		CHECK(loop.timers().empty());
+	}
+
+	SUBCASE("destruction cancels timers")
+	{
+		std::error_code result;
+		{
+			util::event_loop other;
+			other.schedule(10s, [&](std::error_code const& err) { result = err; });
+		}
+		CHECK(result == make_error_code(std::errc::operation_canceled));
+	}
+}
+
+TEST_CASE("util::event_loop [ smoke ] { watch }")
+{
+	util::event_loop loop;
+	int              fds[2];
+	REQUIRE(::pipe(fds) == 0);
+
+	SUBCASE("readiness")
+	{
+		char received{0};
+		loop.watch(fds[0], EPOLLIN, [&](std::uint32_t events) {
+			CHECK((events & EPOLLIN) != 0);
+			CHECK(::read(fds[0], &received, 1) == 1);
+			loop.unwatch(fds[0]);
+			loop.stop();
+		});
+		std::thread writer{[&]() {
+			std::this_thread::sleep_for(5ms);
+			char c{'x'};
+			CHECK(::write(fds[1], &c, 1) == 1);
+		}};
+		loop.run();
+		writer.join();
+		CHECK(received == 'x');
+	}
+
+	SUBCASE("errors")
+	{
+		std::error_code err;
+		loop.watch(fds[0], EPOLLIN, [](std::uint32_t) {}, err);
+		CHECK(!err);
+		loop.watch(fds[0], EPOLLIN, [](std::uint32_t) {}, err);
+		CHECK(err == std::errc::file_exists);
+		loop.modify(fds[0], EPOLLIN | EPOLLET, err);
+		CHECK(!err);
+		loop.unwatch(fds[0], err);
+		CHECK(!err);
+		loop.unwatch(fds[0], err);
+		CHECK(err == std::errc::no_such_file_or_directory);
+		CHECK_THROWS_AS(loop.modify(fds[0], EPOLLIN), std::system_error);
+	}
+
+	::close(fds[0]);
+	::close(fds[1]);
+}
+
+TEST_CASE("util::event_loop [ smoke ] { event_loop_adapter }")
+{
+	using async_io = util::event_loop_adapter;
+	using util::promise;
+
+	auto lp = async_io::create_loop();
+
+	SUBCASE("promise_timer")
+	{
+		std::error_code result;
+		promise<int>    p;
+		p.timeout(util::promise_timer<async_io>{10ms, lp});
+		p.then([](int) { CHECK(false); },
+			   [&](std::error_code const& err) {
+				   result = err;
+				   async_io::stop_loop(lp);
+			   });
+		async_io::run_loop(lp);
+		CHECK(result == make_error_code(std::errc::timed_out));
+	}
+
+	SUBCASE("then_on")
+	{
+		int                           result{0};
+		promise<int>                  p;
+		util::loop_executor<async_io> ex{lp};
+		p.then_on(ex, [](int v) { return v + 1; }).then_on(ex, [&](int v) {
+			result = v;
+			async_io::stop_loop(lp);
+		});
+		std::thread resolver{[&]() { async_io::dispatch(lp, [&]() { p.resolve(4); }); }};
+		async_io::run_loop(lp);
+		resolver.join();
+		CHECK(result == 5);
+	}
+}
+
+#endif
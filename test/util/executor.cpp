@@ -0,0 +1,165 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <atomic>
+#include <doctest.h>
+#include <memory>
+#include <thread>
+#include <util/event_loop.h>
+#include <util/executor.h>
+#include <util/mt_promise.h>
+#include <util/promise.h>
+
+TEST_CASE("util::executor [ smoke ] { inline_executor }")
+{
+	util::inline_executor ex;
+	int                   count{0};
+	ex.post([&]() { ++count; });
+	CHECK(count == 1);
+}
+
+TEST_CASE("util::executor [ smoke ] { thread_pool }")
+{
+	SUBCASE("runs all work")
+	{
+		std::atomic<int> count{0};
+		{
+			util::thread_pool pool{3};
+			CHECK(pool.size() == 3);
+			auto ex = pool.executor();
+			for (int i = 0; i < 1000; ++i)
+			{
+				ex.post([&]() { count.fetch_add(1, std::memory_order_relaxed); });
+			}
+		}
+		CHECK(count.load() == 1000);
+	}
+
+	SUBCASE("move-only work")
+	{
+		std::atomic<int> result{0};
+		{
+			util::thread_pool pool{1};
+			pool.post([p = std::make_unique<int>(9), &result]() { result = *p; });
+		}
+		CHECK(result.load() == 9);
+	}
+
+	SUBCASE("mt::promise continuations")
+	{
+		std::atomic<bool>       on_pool{false};
+		std::atomic<int>        result{0};
+		util::mt::promise<int>  p;
+		util::mt::promise<void> done;
+		auto const              caller = std::this_thread::get_id();
+		{
+			util::thread_pool pool{2};
+
+			auto doubled = p.then_on(pool.executor(), [&](int v) {
+				on_pool = std::this_thread::get_id() != caller;
+				return v * 2;
+			});
+			doubled.then([&, done](int v) mutable {
+				result = v;
+				done.resolve();
+			});
+			p.resolve(21);
+			while (!done.is_finished())
+			{
+				std::this_thread::yield();
+			}
+		}
+		CHECK(on_pool.load());
+		CHECK(result.load() == 42);
+	}
+}
+
+TEST_CASE("util::executor [ smoke ] { runs_on_calling_thread }")
+{
+	CHECK(util::runs_on_calling_thread<util::inline_executor>::value);
+	CHECK(!util::runs_on_calling_thread<util::thread_pool::executor_type>::value);
+}
+
+#if (BOOST_OS_LINUX)
+
+TEST_CASE("util::executor [ smoke ] { promise::then_on thread_pool }")
+{
+	using async_io = util::event_loop_adapter;
+
+	auto                          lp = async_io::create_loop();
+	util::loop_executor<async_io> home{lp};
+	auto const                    owner = std::this_thread::get_id();
+	std::thread::id               ran_on;
+	bool                          settled_on_owner{true};
+	int                           result{0};
+	std::error_code               thrown;
+	bool                          void_done{false};
+	int                           remaining{3};
+
+	auto finished = [&]() {
+		settled_on_owner = settled_on_owner && std::this_thread::get_id() == owner;
+		if (--remaining == 0)
+		{
+			async_io::stop_loop(lp);
+		}
+	};
+
+	{
+		util::thread_pool   pool{2};
+		util::promise<int>  p;
+		util::promise<int>  failing;
+		util::promise<void> q;
+
+		p.then_on(pool.executor(), home, [&](int v) {
+			 ran_on = std::this_thread::get_id();
+			 return v * 2;
+		 }).then([&](int v) {
+			result = v;
+			finished();
+		});
+		failing.then_on(pool.executor(), home, [](int) -> int {
+			 throw std::system_error{make_error_code(std::errc::io_error)};
+		 }).then([](int) { CHECK(false); }, [&](std::error_code const& err) {
+			thrown = err;
+			finished();
+		});
+		q.then_on(pool.executor(), home, []() {}).then([&]() {
+			void_done = true;
+			finished();
+		});
+
+		p.resolve(21);
+		failing.resolve(0);
+		q.resolve();
+		async_io::run_loop(lp);
+	}
+
+	CHECK(ran_on != owner);
+	CHECK(settled_on_owner);
+	CHECK(result == 42);
+	CHECK(thrown == std::errc::io_error);
+	CHECK(void_done);
+}
+
+#endif
@@ -0,0 +1,176 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <doctest.h>
+#include <sstream>
+#include <string>
+#include <util/filter.h>
+#include <util/membuf.h>
+
+namespace
+{
+
+std::string
+make_content(std::size_t n)
+{
+	std::ostringstream os;
+	for (std::size_t i = 0; os.tellp() < static_cast<std::streamoff>(n); ++i)
+	{
+		os << "line " << i << ": the quick brown fox jumps over the lazy dog\n";
+	}
+	return os.str().substr(0, n);
+}
+
+std::string
+read_all(std::streambuf& sbuf)
+{
+	std::istream       is{&sbuf};
+	std::ostringstream os;
+	os << is.rdbuf();
+	return os.str();
+}
+
+}    // namespace
+
+TEST_CASE("util::filter [ smoke ] { pass through }")
+{
+	auto content = make_content(100000);
+
+	util::filter_chain chain;
+	chain.emplace_back<util::pass_through_filter>();
+	util::ofilterbuf obuf{std::move(chain), 4096};
+	std::ostream     os{&obuf};
+	os << content;
+	CHECK(obuf.position() == content.size());
+
+	auto segments = obuf.release_buffer();
+	CHECK(segments.size() == (content.size() + 4095) / 4096);
+	util::imemqbuf ibuf{std::move(segments)};
+	CHECK(read_all(ibuf) == content);
+}
+
+TEST_CASE("util::filter [ smoke ] { deflate and inflate }")
+{
+	auto content = make_content(200000);
+
+	util::filter_chain deflater{1024};
+	deflater.emplace_back<util::deflate_filter>();
+	util::ofilterbuf obuf{std::move(deflater), 1024};
+	std::ostream     os{&obuf};
+	os << content;
+	auto compressed = obuf.release_buffer();
+
+	std::size_t compressed_size{0};
+	for (auto const& segment : compressed)
+	{
+		compressed_size += segment.size();
+	}
+	CHECK(compressed_size > 0);
+	CHECK(compressed_size < content.size() / 4);
+
+	util::filter_chain inflater;
+	inflater.emplace_back<util::inflate_filter>();
+	util::ifilterbuf ibuf{std::move(inflater), std::move(compressed), 512};
+	CHECK(read_all(ibuf) == content);
+	CHECK(!ibuf.error());
+}
+
+TEST_CASE("util::filter [ smoke ] { write after release }")
+{
+	auto content = make_content(5000);
+
+	util::filter_chain deflater;
+	deflater.emplace_back<util::deflate_filter>();
+	util::ofilterbuf obuf{std::move(deflater), 1024};
+	std::ostream     os{&obuf};
+	os << content;
+	auto compressed = obuf.release_buffer();
+	CHECK(os.good());
+
+	os << content;
+	CHECK(os.bad());
+	CHECK(obuf.position() == content.size());
+
+	os.clear();
+	os.put('x');
+	CHECK(os.bad());
+}
+
+TEST_CASE("util::filter [ smoke ] { omemqbuf segments through multi-stage chain }")
+{
+	auto content = make_content(50000);
+
+	util::omemqbuf mbuf{1000};
+	std::ostream   os{&mbuf};
+	os << content;
+
+	// deflate followed by inflate is the identity
+	util::filter_chain chain{256};
+	chain.emplace_back<util::deflate_filter>(9).emplace_back<util::inflate_filter>();
+	util::segment_queue_sink out{333};
+	chain.write(mbuf.release_buffer(), out);
+	chain.finish(out);
+	CHECK(out.size() == content.size());
+
+	util::imemqbuf ibuf{out.release_buffer()};
+	CHECK(read_all(ibuf) == content);
+}
+
+TEST_CASE("util::filter [ smoke ] { inflate errors }")
+{
+	auto content = make_content(10000);
+
+	util::segment_queue_sink compressed;
+	util::filter_chain       deflater;
+	deflater.emplace_back<util::deflate_filter>();
+	deflater.write(reinterpret_cast<const util::byte_type*>(content.data()), content.size(), compressed);
+	deflater.finish(compressed);
+	auto segments = compressed.release_buffer();
+	REQUIRE(segments.size() == 1);
+	auto& segment = segments.front();
+
+	SUBCASE("truncated")
+	{
+		util::filter_chain       inflater;
+		util::segment_queue_sink out;
+		std::error_code          err;
+		inflater.emplace_back<util::inflate_filter>();
+		inflater.write(segment.data(), segment.size() / 2, out, err);
+		CHECK(!err);
+		inflater.finish(out, err);
+		CHECK(err == util::errc::filter_data_truncated);
+	}
+
+	SUBCASE("corrupt")
+	{
+		util::filter_chain       inflater;
+		util::segment_queue_sink out;
+		std::error_code          err;
+		inflater.emplace_back<util::inflate_filter>();
+		segment.data()[0] = 0xff;
+		inflater.write(segment.data(), segment.size(), out, err);
+		CHECK(err == util::errc::filter_data_corrupt);
+		CHECK_THROWS_AS(inflater.finish(out), std::system_error);
+	}
+}
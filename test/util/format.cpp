@@ -0,0 +1,107 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <doctest.h>
+#include <limits>
+#include <string>
+#include <util/format.h>
+#include <util/membuf.h>
+#include <util/memio.h>
+
+namespace
+{
+
+template<class Sink>
+void
+format_sample(Sink& sink)
+{
+	util::formatter<Sink> fmt{sink};
+	fmt << "int " << -42 << ' ' << std::numeric_limits<std::int64_t>::min() << ' ' << 18446744073709551615ull << '\n';
+	fmt << "float " << 0.1 << ' ' << 1e300 << ' ' << -2.5f << '\n';
+	fmt << "fixed ";
+	fmt.fixed(3.14159, 2).put(' ').fixed(-0.5, 0).put(' ').fixed(1e20, 1).put('\n');
+	fmt << "hex ";
+	fmt.integer(255, 16).put('\n');
+	fmt << "width [";
+	fmt.integer(-42, 6, '0').put('|').integer(42, 6, ' ').put('|').fixed(2.5, 2, 8).put('|');
+	fmt.left("ab", 4, '.').put('|').right("ab", 4, '.').put(']').put('\n');
+	fmt << "json ";
+	fmt.quoted("say \"hi\"\\\n\t\x01").put('\n');
+	fmt << true << ' ' << false;
+}
+
+std::string const expected = "int -42 -9223372036854775808 18446744073709551615\n"
+							 "float 0.1 1e+300 -2.5\n"
+							 "fixed 3.14 -0 100000000000000000000.0\n"
+							 "hex ff\n"
+							 "width [-00042|    42|    2.50|ab..|..ab]\n"
+							 "json \"say \\\"hi\\\"\\\\\\n\\t\\u0001\"\n"
+							 "true false";
+
+}    // namespace
+
+TEST_CASE("util::format [ smoke ] { omembuf }")
+{
+	util::omembuf mbuf{util::mutable_buffer{8}};
+	format_sample(mbuf);
+	CHECK(mbuf.release_buffer().to_string() == expected);
+}
+
+TEST_CASE("util::format [ smoke ] { omemqbuf with conversions straddling segments }")
+{
+	util::omemqbuf mbuf{16};
+	format_sample(mbuf);
+	util::const_buffer result{mbuf.release_buffer()};
+	CHECK(result.to_string() == expected);
+}
+
+TEST_CASE("util::format [ smoke ] { memio sinks }")
+{
+	util::membuf_sink sink{4};
+	format_sample(sink);
+	CHECK(sink.release_buffer().to_string() == expected);
+
+	util::memqbuf_sink qsink{64};
+	format_sample(qsink);
+	util::const_buffer result{qsink.release_buffer()};
+	CHECK(result.to_string() == expected);
+}
+
+TEST_CASE("util::format [ smoke ] { shortest floating point round trips }")
+{
+	util::membuf_sink       sink;
+	util::formatter<decltype(sink)> fmt{sink};
+	double                  values[] = {1.0 / 3.0, 2.0 / 3.0, 1e-310, 123456789.125, -0.0};
+	for (auto v : values)
+	{
+		fmt << v << ' ';
+	}
+	std::istringstream is{sink.release_buffer().to_string()};
+	for (auto v : values)
+	{
+		double parsed{0};
+		is >> parsed;
+		CHECK(parsed == v);
+	}
+}
@@ -26,15 +26,15 @@
 #define UTIL_TEST_GHETTO_ASYNC_H
 
 #include <chrono>
-#include <functional>
 #include <map>
 #include <thread>
+#include <util/unique_function.h>
 
 namespace ghetto_async
 {
 
-using void_handler    = std::function<void()>;
-using err_handler     = std::function<void(std::error_code const&)>;
+using void_handler    = util::unique_function<void()>;
+using err_handler     = util::unique_function<void(std::error_code const&)>;
 using event_id_type   = std::uint32_t;
 using time_point_type = std::chrono::time_point<std::chrono::system_clock>;
 using millisecs       = std::chrono::milliseconds;
@@ -224,7 +224,9 @@ public:
 	using timer_type       = std::shared_ptr<timer_impl>;
 	using timer_param_type = timer_type const&;
 
-	loop_impl() : m_next_id{1}, m_running{false}, m_shutting_down{false} {}
+	loop_impl()
+		: m_next_id{1}, m_running{false}, m_shutting_down{false}, m_stop_requested{false}, m_shutdown_requested{false}
+	{}
 
 	unsigned
 	run()
@@ -371,8 +373,8 @@ public:
 	using loop_param_type   = loop_type const&;
 	using timer_type        = loop_impl::timer_type;
 	using timer_param_type  = loop_impl::timer_param_type;
-	using scheduled_action  = std::function<void(std::error_code const&)>;
-	using dispatched_action = std::function<void()>;
+	using scheduled_action  = err_handler;
+	using dispatched_action = void_handler;
 
 	static timer_type
 	create_timer(loop_param_type loop)
@@ -425,7 +427,7 @@ public:
 	static void
 	dispatch(loop_param_type loop, dispatched_action action)
 	{
-		loop->dispatch(action);
+		loop->dispatch(std::move(action));
 	}
 };
 
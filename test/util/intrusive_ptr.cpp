@@ -0,0 +1,171 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <atomic>
+#include <doctest.h>
+#include <thread>
+#include <util/buffer.h>
+#include <util/intrusive_ptr.h>
+#include <vector>
+
+namespace
+{
+
+struct counted : util::intrusive_refcount<counted>, util::enable_intrusive_from_this<counted>
+{
+	counted(int& dtor_count) : m_dtor_count{dtor_count} {}
+	virtual ~counted()
+	{
+		++m_dtor_count;
+	}
+
+	int& m_dtor_count;
+};
+
+struct derived_counted : counted
+{
+	derived_counted(int& dtor_count) : counted{dtor_count} {}
+};
+
+struct atomic_counted : util::atomic_intrusive_refcount<atomic_counted>
+{
+	atomic_counted(std::atomic<int>& dtor_count) : m_dtor_count{dtor_count} {}
+	~atomic_counted()
+	{
+		++m_dtor_count;
+	}
+
+	std::atomic<int>& m_dtor_count;
+};
+
+}    // namespace
+
+TEST_CASE("util::intrusive_ptr [ smoke ] { copy, move and release }")
+{
+	int dtor_count{0};
+	{
+		auto p = util::make_intrusive<counted>(dtor_count);
+		CHECK(p.use_count() == 1);
+		CHECK(sizeof(p) == sizeof(counted*));
+
+		auto copy = p;
+		CHECK(p.use_count() == 2);
+		CHECK(copy == p);
+
+		auto moved = std::move(copy);
+		CHECK(!copy);
+		CHECK(copy == nullptr);
+		CHECK(p.use_count() == 2);
+
+		moved.reset();
+		CHECK(p.use_count() == 1);
+		CHECK(dtor_count == 0);
+	}
+	CHECK(dtor_count == 1);
+}
+
+TEST_CASE("util::intrusive_ptr [ smoke ] { raw pointer, detach and from this }")
+{
+	int dtor_count{0};
+	{
+		util::intrusive_ptr<counted> p{new derived_counted{dtor_count}};
+		CHECK(p.use_count() == 1);
+
+		// a raw pointer to a shared object can be re-wrapped, since the count is in the object
+		util::intrusive_ptr<counted> again{p.get()};
+		CHECK(p.use_count() == 2);
+
+		auto self = p->intrusive_from_this();
+		CHECK(self == p);
+		CHECK(p.use_count() == 3);
+
+		auto raw = self.detach();
+		CHECK(!self);
+		CHECK(p.use_count() == 3);
+		util::intrusive_ptr<counted> adopted{raw, false};
+		CHECK(p.use_count() == 3);
+
+		auto down = util::dynamic_pointer_cast<derived_counted>(p);
+		CHECK(down);
+		CHECK(p.use_count() == 4);
+	}
+	CHECK(dtor_count == 1);
+}
+
+TEST_CASE("util::intrusive_ptr [ smoke ] { adopt unique_ptr }")
+{
+	int dtor_count{0};
+	{
+		std::unique_ptr<derived_counted> up{new derived_counted{dtor_count}};
+		util::intrusive_ptr<counted>     p{std::move(up)};
+		CHECK(!up);
+		CHECK(p.use_count() == 1);
+	}
+	CHECK(dtor_count == 1);
+}
+
+TEST_CASE("util::intrusive_ptr [ smoke ] { atomic count across threads }")
+{
+	std::atomic<int> dtor_count{0};
+	{
+		auto                     p = util::make_intrusive<atomic_counted>(dtor_count);
+		std::vector<std::thread> threads;
+		for (int t = 0; t < 4; ++t)
+		{
+			threads.emplace_back([p]() {
+				for (int i = 0; i < 100000; ++i)
+				{
+					util::intrusive_ptr<atomic_counted> copy{p};
+				}
+			});
+		}
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+		CHECK(p.use_count() == 1);
+		CHECK(dtor_count == 0);
+	}
+	CHECK(dtor_count == 1);
+}
+
+TEST_CASE("util::intrusive_ptr [ smoke ] { shared_buffer region sharing }")
+{
+	CHECK(sizeof(util::shared_buffer) == sizeof(util::buffer) + sizeof(void*));
+
+	util::mutable_buffer mbuf{16};
+	mbuf.putn(0, "zoot", 4);
+	mbuf.size(4);
+	auto region = mbuf.data();
+
+	util::shared_buffer sbuf{std::move(mbuf)};
+	CHECK(sbuf.data() == region);
+	CHECK(sbuf.ref_count() == 1);
+	{
+		auto slice = sbuf.slice(1, 2);
+		CHECK(sbuf.ref_count() == 2);
+		CHECK(slice.to_string() == "oo");
+	}
+	CHECK(sbuf.ref_count() == 1);
+}
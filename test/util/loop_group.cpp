@@ -0,0 +1,209 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <atomic>
+#include <doctest.h>
+#include <thread>
+#include <util/loop_group.h>
+#include <util/mt_promise.h>
+#include <vector>
+
+#if (BOOST_OS_LINUX)
+
+namespace
+{
+
+void
+wait_for(std::atomic<int> const& count, int expected)
+{
+	while (count.load() < expected)
+	{
+		std::this_thread::yield();
+	}
+}
+
+}    // namespace
+
+TEST_CASE("util::loop_group [ smoke ] { spsc_queue }")
+{
+	SUBCASE("single thread")
+	{
+		util::detail::spsc_queue<int> queue{3};
+		CHECK(queue.capacity() == 4);
+		for (int i = 0; i < 4; ++i)
+		{
+			CHECK(queue.try_push(i));
+		}
+		int value{-1};
+		CHECK(!queue.try_push(value));
+		for (int i = 0; i < 4; ++i)
+		{
+			CHECK(queue.try_pop(value));
+			CHECK(value == i);
+		}
+		CHECK(!queue.try_pop(value));
+	}
+
+	SUBCASE("two threads")
+	{
+		constexpr int                 count = 100000;
+		util::detail::spsc_queue<int> queue{64};
+		int                           expected{0};
+		bool                          ordered{true};
+
+		std::thread producer{[&]() {
+			for (int i = 0; i < count; ++i)
+			{
+				int value = i;
+				while (!queue.try_push(value))
+				{
+					std::this_thread::yield();
+				}
+			}
+		}};
+		while (expected < count)
+		{
+			int value;
+			if (queue.try_pop(value))
+			{
+				ordered = ordered && value == expected;
+				++expected;
+			}
+			else
+			{
+				std::this_thread::yield();
+			}
+		}
+		producer.join();
+		CHECK(ordered);
+	}
+}
+
+TEST_CASE("util::loop_group [ smoke ] { dispatch }")
+{
+	SUBCASE("from outside the group")
+	{
+		util::loop_group group{3, false};
+		std::atomic<int> count{0};
+		std::atomic<int> misplaced{0};
+		CHECK(group.size() == 3);
+		CHECK(group.current() == util::loop_group::npos);
+		for (std::size_t i = 0; i < group.size(); ++i)
+		{
+			group.dispatch(i, [&, i]() {
+				misplaced += (group.current() == i) ? 0 : 1;
+				++count;
+			});
+		}
+		wait_for(count, 3);
+		CHECK(misplaced.load() == 0);
+	}
+
+	SUBCASE("between loops, in order, through a full queue")
+	{
+		constexpr int    messages = 10000;
+		util::loop_group group{2, false, 4};
+		std::atomic<int> received{0};
+		std::atomic<int> misordered{0};
+		group.dispatch(0, [&]() {
+			for (int i = 0; i < messages; ++i)
+			{
+				group.dispatch(1, [&, i]() {
+					misordered += (received.load() == i && group.current() == 1) ? 0 : 1;
+					++received;
+				});
+			}
+		});
+		wait_for(received, messages);
+		CHECK(misordered.load() == 0);
+		CHECK(group.overflow_count() > 0);
+	}
+}
+
+TEST_CASE("util::loop_group [ smoke ] { submit }")
+{
+	util::loop_group group{2, false};
+	std::atomic<int> done{0};
+	int              result{0};
+	std::size_t      resumed_on{util::loop_group::npos};
+
+	group.dispatch(0, [&]() {
+		group.submit(1, [&]() { return static_cast<int>(group.current()) + 41; }).then([&](int value) {
+			result     = value;
+			resumed_on = group.current();
+			group.submit(1, []() {}).then([&]() { ++done; });
+		});
+	});
+	wait_for(done, 1);
+	CHECK(result == 42);
+	CHECK(resumed_on == 0);
+}
+
+TEST_CASE("util::loop_group [ smoke ] { submit errors }")
+{
+	util::loop_group group{2, false};
+
+	SUBCASE("not called from a loop")
+	{
+		CHECK_THROWS_AS(group.submit(1, []() { return 1; }), std::logic_error);
+	}
+
+	SUBCASE("function throws")
+	{
+		std::atomic<int> done{0};
+		std::error_code  system_err;
+		std::error_code  other_err;
+
+		group.dispatch(0, [&]() {
+			group.submit(1, []() -> int { throw std::system_error{make_error_code(std::errc::io_error)}; })
+					.then([](int /* unused */) { CHECK(false); }, [&](std::error_code const& err) {
+						system_err = err;
+						group.submit(1, []() { throw 7; }).then([]() { CHECK(false); }, [&](std::error_code const& err) {
+							other_err = err;
+							++done;
+						});
+					});
+		});
+		wait_for(done, 1);
+		CHECK(system_err == std::errc::io_error);
+		CHECK(other_err == util::errc::unhandled_exception);
+	}
+}
+
+TEST_CASE("util::loop_group [ smoke ] { executor }")
+{
+	util::loop_group       group{2, false};
+	std::atomic<int>       done{0};
+	std::size_t            ran_on{util::loop_group::npos};
+	util::mt::promise<int> p;
+	p.then_on(group.executor(1), [&](int value) {
+		ran_on = group.current();
+		done   = value;
+	});
+	p.resolve(1);
+	wait_for(done, 1);
+	CHECK(ran_on == 1);
+}
+
+#endif
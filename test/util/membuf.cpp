@@ -658,3 +658,78 @@ TEST_CASE("util::membuf [ smoke ] { omemqbuf setbuf }")
 	pos = omb.pubseekoff(0, std::ios_base::end);
 	CHECK(pos == sizeof(space));
 }
+
+TEST_CASE("util::membuf [ smoke ] { omembuf checksum on write }")
+{
+	std::string content;
+	for (int i = 0; i < 10000; ++i)
+	{
+		content.push_back(static_cast<char>('A' + (i % 53)));
+	}
+
+	util::omembuf omb{};
+	omb.enable_checksum(util::checksum_mode::crc32_adler32);
+	std::ostream os{&omb};
+	os.write(content.data(), 4);    // placeholder for length prefix
+	for (std::size_t i = 4; i < content.size(); ++i)
+	{
+		os.put(content[i]);
+	}
+	os.seekp(0, std::ios_base::beg);
+	content[0] = 'L';
+	content[1] = 'E';
+	content[2] = 'N';
+	content[3] = '!';
+	os.write(content.data(), 4);
+	os.seekp(0, std::ios_base::end);
+	os << "tail";
+	content.append("tail");
+
+	CHECK(omb.checksum() == util::crc32(content.data(), content.size()));
+
+	util::checksum_result sums;
+	auto                  buf = omb.release_buffer(sums);
+	CHECK(buf.to_string() == content);
+	CHECK(sums.crc == buf.checksum());
+	CHECK(sums.fast == util::adler32(content.data(), content.size()));
+}
+
+TEST_CASE("util::membuf [ smoke ] { omemqbuf checksum on write }")
+{
+	std::string content;
+	for (int i = 0; i < 1000; ++i)
+	{
+		content.push_back(static_cast<char>('a' + (i % 23)));
+	}
+
+	util::omemqbuf omb{64};
+	omb.enable_checksum(util::checksum_mode::crc32_adler32);
+	std::ostream os{&omb};
+	os << content;
+	CHECK(omb.checksum() == util::crc32(content.data(), content.size()));
+
+	// rewrite a range that straddles a segment boundary
+	os.seekp(60, std::ios_base::beg);
+	os << "########";
+	content.replace(60, 8, "########");
+	os.seekp(0, std::ios_base::end);
+	os.put('!');
+	content.push_back('!');
+
+	util::checksum_result sums;
+	auto                  bufs = omb.release_buffer(sums);
+	util::const_buffer    flat{bufs};
+	CHECK(flat.to_string() == content);
+	CHECK(sums.crc == flat.checksum());
+	CHECK(sums.fast == util::adler32(content.data(), content.size()));
+}
+
+TEST_CASE("util::membuf [ smoke ] { omemqbuf checksum without checksum on write }")
+{
+	std::string    content{"abcdefghijklmnopqrstuvwxyz0123456789"};
+	util::omemqbuf omb{16};
+	std::ostream   os{&omb};
+	os << content;
+	CHECK(omb.checksum_enabled() == util::checksum_mode::none);
+	CHECK(omb.checksum() == util::crc32(content.data(), content.size()));
+}
@@ -0,0 +1,160 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <doctest.h>
+#include <sstream>
+#include <string>
+#include <util/membuf.h>
+#include <util/memio.h>
+
+namespace
+{
+
+// a trivial templated serializer, usable with any sink
+template<class Sink>
+void
+write_record(Sink& sink, std::uint32_t id, std::string const& name)
+{
+	auto p = sink.prepare(sizeof(id));
+	std::memcpy(p, &id, sizeof(id));
+	sink.commit(sizeof(id));
+	sink.put(static_cast<char>(name.size()));
+	sink.putn(name.data(), name.size());
+}
+
+template<class Source>
+bool
+read_record(Source& source, std::uint32_t& id, std::string& name)
+{
+	char len{0};
+	if (source.getn(&id, sizeof(id)) != sizeof(id) || !source.get(len))
+	{
+		return false;
+	}
+	name.resize(static_cast<std::size_t>(len));
+	return source.getn(&name[0], name.size()) == name.size();
+}
+
+}    // namespace
+
+TEST_CASE("util::memio [ smoke ] { membuf_sink and membuf_source }")
+{
+	util::membuf_sink sink{8};
+	for (std::uint32_t i = 0; i < 100; ++i)
+	{
+		write_record(sink, i, "record" + std::to_string(i));
+	}
+	auto size = sink.position();
+	auto buf  = sink.release_buffer();
+	CHECK(buf.size() == size);
+	CHECK(sink.position() == 0);
+
+	util::membuf_source source{std::move(buf)};
+	std::uint32_t       id{0};
+	std::string         name;
+	for (std::uint32_t i = 0; i < 100; ++i)
+	{
+		REQUIRE(read_record(source, id, name));
+		CHECK(id == i);
+		CHECK(name == "record" + std::to_string(i));
+	}
+	CHECK(source.at_end());
+	CHECK(source.peek() == -1);
+	CHECK(source.position() == size);
+}
+
+TEST_CASE("util::memio [ smoke ] { memqbuf_sink and memqbuf_source }")
+{
+	util::memqbuf_sink sink{16};
+	for (std::uint32_t i = 0; i < 100; ++i)
+	{
+		write_record(sink, i, "record" + std::to_string(i));
+	}
+	auto size     = sink.position();
+	auto segments = sink.release_buffer();
+	CHECK(segments.size() > 1);
+	util::size_type total{0};
+	for (auto const& segment : segments)
+	{
+		CHECK(segment.size() <= 16);
+		total += segment.size();
+	}
+	CHECK(total == size);
+
+	util::memqbuf_source source{std::move(segments)};
+	std::uint32_t        id{0};
+	std::string          name;
+	for (std::uint32_t i = 0; i < 100; ++i)
+	{
+		REQUIRE(read_record(source, id, name));
+		CHECK(id == i);
+		CHECK(name == "record" + std::to_string(i));
+	}
+	CHECK(source.at_end());
+	CHECK(source.position() == size);
+}
+
+TEST_CASE("util::memio [ smoke ] { memqbuf_source reads omemqbuf segments }")
+{
+	util::omemqbuf obuf{16};
+	std::ostream   os{&obuf};
+	os << "the quick brown fox jumps over the lazy dog";
+
+	util::memqbuf_source source{obuf.release_buffer()};
+	std::string          s;
+	for (auto view = source.contiguous(); !view.empty(); view = source.contiguous())
+	{
+		CHECK(view.size() <= 16);
+		s.append(view.data(), view.size());
+		source.advance(view.size());
+	}
+	CHECK(s == "the quick brown fox jumps over the lazy dog");
+}
+
+TEST_CASE("util::memio [ smoke ] { streambuf adapters }")
+{
+	util::memqbuf_sink sink{8};
+	{
+		util::sink_streambuf<util::memqbuf_sink> sbuf{sink};
+		std::ostream                             os{&sbuf};
+		os << "some " << 42 << " words " << 7.5;
+	}
+	CHECK(sink.position() == 17);
+
+	util::memqbuf_source source{sink.release_buffer()};
+	{
+		util::source_streambuf<util::memqbuf_source> sbuf{source};
+		std::istream                                 is{&sbuf};
+		std::string                                  s0, s1;
+		int                                          i{0};
+		is >> s0 >> i >> s1;
+		CHECK(s0 == "some");
+		CHECK(i == 42);
+		CHECK(s1 == "words");
+	}
+	CHECK(source.position() == 13);    // the space following "words" is not consumed
+	std::string rest(3, ' ');
+	CHECK(source.getn(&rest[0], rest.size()) == 3);
+	CHECK(rest == " 7.");
+}
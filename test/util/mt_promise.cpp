@@ -0,0 +1,225 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <atomic>
+#include <deque>
+#include <doctest.h>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <util/mt_promise.h>
+#include <vector>
+
+namespace
+{
+
+// executor that queues work until drained by the test
+class queue_executor
+{
+public:
+	explicit queue_executor(std::deque<util::unique_function<void()>>& queue) : m_queue{&queue} {}
+
+	template<class F>
+	void
+	post(F&& f) const
+	{
+		m_queue->emplace_back(std::forward<F>(f));
+	}
+
+private:
+	std::deque<util::unique_function<void()>>* m_queue;
+};
+
+void
+drain(std::deque<util::unique_function<void()>>& queue)
+{
+	while (!queue.empty())
+	{
+		auto f = std::move(queue.front());
+		queue.pop_front();
+		f();
+	}
+}
+
+}    // namespace
+
+TEST_CASE("util::mt::promise [ smoke ] { resolve }")
+{
+	SUBCASE("resolved after then")
+	{
+		int                    result{0};
+		util::mt::promise<int> p;
+		p.then([](int v) { return v + 1; }).then([&](int v) { result = v; });
+		CHECK(!p.is_finished());
+		CHECK(p.resolve(1));
+		CHECK(p.is_resolved());
+		CHECK(result == 2);
+	}
+
+	SUBCASE("resolved before then")
+	{
+		int                    result{0};
+		util::mt::promise<int> p;
+		p.resolve(1);
+		p.then([](int v) { return v * 3; }).then([&](int v) { result = v; });
+		CHECK(result == 3);
+	}
+
+	SUBCASE("resolved once")
+	{
+		util::mt::promise<int> p;
+		CHECK(p.resolve(1));
+		CHECK(!p.resolve(2));
+		CHECK(!p.reject(make_error_code(std::errc::timed_out)));
+		CHECK(p.is_resolved());
+		CHECK(!p.is_rejected());
+	}
+
+	SUBCASE("void")
+	{
+		int                     count{0};
+		util::mt::promise<void> p;
+		p.then([&]() { ++count; }).then([&]() { ++count; });
+		p.resolve();
+		CHECK(count == 2);
+	}
+
+	SUBCASE("move-only value")
+	{
+		int                                     result{0};
+		util::mt::promise<std::unique_ptr<int>> p;
+		p.then([](std::unique_ptr<int> v) { return *v; }).then([&](int v) { result = v; });
+		p.resolve(std::make_unique<int>(5));
+		CHECK(result == 5);
+	}
+
+	SUBCASE("promise-returning continuation")
+	{
+		int                     result{0};
+		util::mt::promise<int>  inner;
+		util::mt::promise<void> p;
+		p.then([=]() { return inner; }).then([&](int v) { result = v; });
+		p.resolve();
+		CHECK(result == 0);
+		inner.resolve(7);
+		CHECK(result == 7);
+	}
+}
+
+TEST_CASE("util::mt::promise [ smoke ] { reject }")
+{
+	std::error_code        caught;
+	int                    calls{0};
+	util::mt::promise<int> p;
+	auto                   q = p.then([&](int v) { return v + calls++; });
+	q.then([&](int) { ++calls; }).catcher([&](std::error_code const& err) { caught = err; });
+	CHECK(p.reject(make_error_code(std::errc::timed_out)));
+	CHECK(p.is_rejected());
+	CHECK(calls == 0);
+	CHECK(caught == std::errc::timed_out);
+
+	bool                   called{false};
+	util::mt::promise<int> r;
+	r.catcher([&](std::error_code const&) { called = true; });
+	r.resolve(1);
+	CHECK(!called);
+}
+
+TEST_CASE("util::mt::promise [ smoke ] { executor }")
+{
+	std::deque<util::unique_function<void()>> queue;
+	queue_executor                            ex{queue};
+	int                                       result{0};
+
+	util::mt::promise<int> p;
+	p.then_on(ex, [](int v) { return v + 1; }).then_on(ex, [&](int v) { result = v; });
+	p.resolve(1);
+	CHECK(result == 0);
+	CHECK(queue.size() == 1);
+	drain(queue);
+	CHECK(result == 2);
+
+	std::error_code        caught;
+	util::mt::promise<int> q;
+	q.then_on(ex, [](int v) { return v; }).catcher_on(ex, [&](std::error_code const& err) { caught = err; });
+	q.reject(make_error_code(std::errc::timed_out));
+	CHECK(!caught);
+	drain(queue);
+	CHECK(caught == std::errc::timed_out);
+}
+
+TEST_CASE("util::mt::promise [ smoke ] { cross-thread }")
+{
+	constexpr int rounds = 2000;
+
+	SUBCASE("resolve races then")
+	{
+		std::atomic<int> sum{0};
+		for (int i = 0; i < rounds; ++i)
+		{
+			util::mt::promise<int> p;
+			std::thread            producer{[p, i]() mutable { p.resolve(i); }};
+			p.then([](int v) { return v + 1; }).then([&](int v) { sum.fetch_add(v, std::memory_order_relaxed); });
+			producer.join();
+		}
+		CHECK(sum.load() == rounds * (rounds + 1) / 2);
+	}
+
+	SUBCASE("then races resolve")
+	{
+		std::atomic<int> count{0};
+		for (int i = 0; i < rounds; ++i)
+		{
+			util::mt::promise<void> p;
+			std::thread             consumer{[p, &count]() mutable { p.then([&]() { count.fetch_add(1); }); }};
+			p.resolve();
+			consumer.join();
+		}
+		CHECK(count.load() == rounds);
+	}
+
+	SUBCASE("competing resolvers")
+	{
+		for (int i = 0; i < rounds / 10; ++i)
+		{
+			std::atomic<int>         winners{0};
+			util::mt::promise<int>   p;
+			std::vector<std::thread> threads;
+			for (int t = 0; t < 4; ++t)
+			{
+				threads.emplace_back([p, t, &winners]() mutable {
+					if (p.resolve(t))
+					{
+						winners.fetch_add(1);
+					}
+				});
+			}
+			for (auto& t : threads)
+			{
+				t.join();
+			}
+			CHECK(winners.load() == 1);
+		}
+	}
+}
@@ -0,0 +1,165 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <doctest.h>
+#include <thread>
+#include <util/pool_allocator.h>
+#include <vector>
+
+namespace
+{
+
+struct pooled_value
+{
+	pooled_value(int v, int& dtor_count) : value{v}, m_dtor_count{dtor_count} {}
+	~pooled_value()
+	{
+		++m_dtor_count;
+	}
+
+	int  value;
+	int& m_dtor_count;
+};
+
+struct thread_value
+{
+	thread_value(int v) : value{v} {}
+	int value;
+};
+
+struct reuse_value
+{
+	reuse_value(int v) : value{v} {}
+	int value;
+};
+
+}    // namespace
+
+TEST_CASE("util::pool_allocator [ smoke ] { make_pooled }")
+{
+	int dtor_count{0};
+	{
+		auto p = util::make_pooled<pooled_value>(7, dtor_count);
+		CHECK(p->value == 7);
+		CHECK(p.use_count() == 1);
+		auto q = p;
+		CHECK(p.use_count() == 2);
+	}
+	CHECK(dtor_count == 1);
+
+#if (!UTIL_USE_STD_SHARED_PTR)
+	auto stats = util::pooled_stats<pooled_value>();
+	CHECK(stats.in_use == 0);
+	CHECK(stats.high_water == 1);
+	CHECK(stats.capacity > 0);
+#endif
+}
+
+#if (!UTIL_USE_STD_SHARED_PTR)
+
+TEST_CASE("util::pool_allocator [ smoke ] { block reuse and stats }")
+{
+	void* first{nullptr};
+	{
+		auto p = util::make_pooled<reuse_value>(1);
+		first  = p.get();
+	}
+	{
+		auto p = util::make_pooled<reuse_value>(2);
+		CHECK(p.get() == first);    // the freed block is at the head of this thread's cache
+	}
+
+	std::vector<util::shared_ptr<reuse_value>> held;
+	for (int i = 0; i < 200; ++i)
+	{
+		held.push_back(util::make_pooled<reuse_value>(i));
+	}
+	auto stats = util::pooled_stats<reuse_value>();
+	CHECK(stats.in_use == 200);
+	CHECK(stats.high_water == 200);
+	CHECK(stats.capacity >= 200);
+	CHECK(stats.block_size >= sizeof(reuse_value));
+
+	auto capacity = stats.capacity;
+	held.clear();
+	stats = util::pooled_stats<reuse_value>();
+	CHECK(stats.in_use == 0);
+	CHECK(stats.high_water == 200);
+
+	for (int i = 0; i < 200; ++i)
+	{
+		held.push_back(util::make_pooled<reuse_value>(i));
+	}
+	CHECK(util::pooled_stats<reuse_value>().capacity == capacity);
+}
+
+TEST_CASE("util::pool_allocator [ smoke ] { release on other threads }")
+{
+	std::vector<util::mt::shared_ptr<thread_value>> values;
+	for (int i = 0; i < 1000; ++i)
+	{
+		values.push_back(util::mt::make_pooled<thread_value>(i));
+	}
+
+	using block_type
+			= util::detail::value_ctrl_blk<thread_value, util::pool_allocator<thread_value>, util::atomic_refcount>;
+	auto& pool = util::object_pool<block_type>::instance();
+	CHECK(pool.stats().in_use == 1000);
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; ++t)
+	{
+		std::vector<util::mt::shared_ptr<thread_value>> share(values.begin() + t * 250, values.begin() + (t + 1) * 250);
+		threads.emplace_back([share = std::move(share)]() mutable {
+			share.clear();
+			// allocate and release on this thread, too
+			for (int i = 0; i < 100; ++i)
+			{
+				auto p = util::mt::make_pooled<thread_value>(i);
+			}
+		});
+	}
+	values.clear();
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+
+	auto stats = pool.stats();
+	CHECK(stats.in_use == 0);
+	CHECK(stats.high_water >= 1000);
+}
+
+TEST_CASE("util::pool_allocator [ smoke ] { standard container }")
+{
+	std::vector<int, util::pool_allocator<int>> v;
+	for (int i = 0; i < 100; ++i)
+	{
+		v.push_back(i);
+	}
+	CHECK(v.size() == 100);
+	CHECK(v[99] == 99);
+}
+
+#endif
@@ -28,9 +28,10 @@
 #include <iostream>
 #include <unordered_map>
 #include <util/promise.h>
+#include <util/promise_timer.h>
+#include <util/timer_wheel.h>
 
 #if (TEST_ASYNC)
-#include <util/promise_timer.h>
 #include "ghetto_async.h"
 using async_io = ghetto_async::async_adapter;
 #endif
@@ -494,6 +495,70 @@ TEST_CASE("nodeoze/smoke/promise")
 				});
 	}
 
+	SUBCASE("when_all range")
+	{
+		promise<int>::promises_type promises(3);
+		std::vector<int>            result;
+		when_all(promises).then([&](std::vector<int>&& values) { result = std::move(values); });
+		promises[2].resolve(30);
+		promises[0].resolve(10);
+		CHECK(result.empty());
+		promises[1].resolve(20);
+		CHECK(result == std::vector<int>{10, 20, 30});
+	}
+
+	SUBCASE("when_all void range")
+	{
+		promise<void>::promises_type promises(2);
+		bool                         done{false};
+		when_all(promises).then([&]() { done = true; });
+		promises[1].resolve();
+		CHECK(!done);
+		promises[0].resolve();
+		CHECK(done);
+	}
+
+	SUBCASE("when_all empty range")
+	{
+		promise<int>::promises_type promises;
+		bool                        done{false};
+		when_all(promises).then([&](std::vector<int>&& values) {
+			CHECK(values.empty());
+			done = true;
+		});
+		CHECK(done);
+	}
+
+	SUBCASE("when_all range rejected")
+	{
+		promise<int>::promises_type promises(3);
+		std::error_code             result;
+		when_all(promises).then([](std::vector<int>&& /* unused */) { assert(0); },
+								[&](std::error_code const& err) { result = err; });
+		promises[0].resolve(10);
+		promises[1].reject(make_error_code(std::errc::timed_out));
+		promises[2].reject(make_error_code(std::errc::invalid_argument));
+		CHECK(result == make_error_code(std::errc::timed_out));
+	}
+
+	SUBCASE("when_all tuple")
+	{
+		promise<int>         p1;
+		promise<std::string> p2;
+		promise<void>        p3;
+		bool                 done{false};
+		when_all(p1, p2, p3).then([&](std::tuple<int, std::string, std::monostate>&& values) {
+			CHECK(std::get<0>(values) == 7);
+			CHECK(std::get<1>(values) == "seven");
+			done = true;
+		});
+		p3.resolve();
+		p2.resolve("seven");
+		CHECK(!done);
+		p1.resolve(7);
+		CHECK(done);
+	}
+
 	SUBCASE("any void with first succeed")
 	{
 		auto p1 = promise<void>();
@@ -744,8 +809,86 @@ TEST_CASE("nodeoze/smoke/promise")
 		p.resolve();
 	}
 
+#if (UTIL_PROMISE_POOL_SHARED)
+
+	SUBCASE("pooled shared state")
+	{
+		auto& pool   = util::object_pool<util::__promise_shared<int>>::instance();
+		auto  in_use = pool.stats().in_use;
+		int   result{0};
+		{
+			promise<int> p;
+			auto         q = p.then([](int v) { return v + 1; }).then([](int v) { return v * 2; });
+			CHECK(pool.stats().in_use == in_use + 3);
+			q.then([&](int v) { result = v; });
+			p.resolve(4);
+		}
+		CHECK(result == 10);
+		CHECK(pool.stats().in_use == in_use);
+	}
+
+#endif
+
+	SUBCASE("move-only continuations")
+	{
+		int          result{0};
+		promise<int> p;
+		auto         q = p.then([u = std::make_unique<int>(3)](int v) { return v * *u; });
+		q.then([u = std::make_unique<int>(1), &result](int v) { result = v + *u; });
+		p.resolve(5);
+		CHECK(result == 16);
+	}
+
+	SUBCASE("then_on inline executor")
+	{
+		int                   result{0};
+		int                   finally_count{0};
+		promise<int>          p;
+		util::inline_executor ex;
+		p.then_on(ex, [](int v) { return v + 1; })
+				.then_on(ex, [](int v) { return promise<int>::build(v * 2); })
+				.finally_on(ex, [&]() { ++finally_count; })
+				.then_on(ex, [&](int v) { result = v; });
+		p.resolve(4);
+		CHECK(result == 10);
+		CHECK(finally_count == 1);
+
+		std::error_code caught;
+		promise<void>   q;
+		q.then_on(ex, []() { return 1; }).catcher_on(ex, [&](std::error_code const& err) { caught = err; });
+		q.reject(make_error_code(std::errc::timed_out));
+		CHECK(caught == std::errc::timed_out);
+	}
+
 #if (TEST_ASYNC)
 
+	SUBCASE("then_on loop executor")
+	{
+		auto lp = async_io::create_loop();
+
+		util::loop_executor<async_io> ex{lp};
+		std::vector<int>              order;
+		promise<int>                  p;
+
+		p.then_on(ex, [&](int v) {
+			 order.push_back(v);
+			 return v + 1;
+		 })
+				.finally_on(ex, [&]() { order.push_back(0); })
+				.then_on(ex, [&](int v) { order.push_back(v); });
+
+		async_io::dispatch(lp, [&]() mutable {
+			p.resolve(1);
+			order.push_back(-1);    // continuations run after this handler returns
+		});
+
+		STOP_LOOP(lp, 100);
+		async_io::run_loop(lp);
+
+		// the second stage is posted before the first stage's finally
+		CHECK(order == std::vector<int>{-1, 1, 2, 0});
+	}
+
 	SUBCASE("leaks")
 	{
 		auto clean = std::make_shared<bool>(false);
@@ -849,3 +992,151 @@ TEST_CASE("nodeoze/smoke/promise")
 
 #endif
 }
+
+TEST_CASE("util::promise [ smoke ] { handler results are discarded }")
+{
+	int          finished{0};
+	promise<int> p;
+	p.then([](int v) { return v; }, [](std::error_code const& /* unused */) { return false; });
+	p.finally([&finished]() { return ++finished; });
+	p.resolve(1);
+	CHECK(finished == 1);
+}
+
+TEST_CASE("util::promise [ smoke ] { cancellation }")
+{
+	auto canceled = make_error_code(std::errc::operation_canceled);
+
+	SUBCASE("cancel rejects pending stages and releases continuations")
+	{
+		auto            captured = std::make_shared<int>(7);
+		std::error_code result;
+		promise<int>    p;
+		p.then([captured](int v) { return v + *captured; })
+				.then([captured](int v) { return v * 2; })
+				.then([](int /* unused */) { CHECK(false); }, [&](std::error_code const& err) { result = err; });
+		CHECK(captured.use_count() == 3);
+
+		p.cancel();
+		CHECK(p.is_rejected());
+		CHECK(result == canceled);
+		CHECK(captured.use_count() == 1);
+	}
+
+	SUBCASE("cancel is ignored once finished")
+	{
+		promise<int> p;
+		p.resolve(1);
+		p.cancel();
+		CHECK(p.is_resolved());
+	}
+
+	SUBCASE("token cancels every pending stage of a chain")
+	{
+		cancellation_source source;
+		promise<int>        head;
+		promise<int>        inner;
+		std::error_code     result;
+		bool                visited{false};
+
+		head.with_cancellation(source.token());
+		auto wait = head.then([&](int /* unused */) {
+			visited = true;
+			return inner;
+		});
+		auto tail = wait.then([](int v) { return v + 1; });
+		tail.then([](int /* unused */) { CHECK(false); }, [&](std::error_code const& err) { result = err; });
+		CHECK(tail.bound_token() == source.token());
+
+		head.resolve(1);    // the chain now waits on inner, which is not bound
+		CHECK(visited);
+		CHECK(!result);
+
+		source.cancel();
+		CHECK(result == canceled);
+		CHECK(!inner.is_finished());
+		inner.resolve(2);    // too late; has no effect
+		CHECK(result == canceled);
+	}
+
+	SUBCASE("binding to a cancelled token cancels immediately")
+	{
+		cancellation_source source;
+		source.cancel();
+		promise<void> p;
+		p.with_cancellation(source.token());
+		CHECK(p.is_rejected());
+	}
+
+	SUBCASE("destroyed promises leave the token's list")
+	{
+		cancellation_source source;
+		{
+			promise<int> p;
+			p.with_cancellation(source.token());
+		}
+		promise<int> q;
+		q.with_cancellation(source.token());
+		source.cancel();
+		CHECK(q.is_rejected());
+	}
+
+	SUBCASE("cancellation cancels the timer")
+	{
+		util::timer_wheel   wheel{std::chrono::milliseconds{1}};
+		cancellation_source source;
+		std::error_code     result;
+
+		promise<int> p;
+		p.with_cancellation(source.token());
+		p.timeout(util::promise_timer<util::timer_wheel_adapter>{std::chrono::milliseconds{10}, &wheel});
+		p.then([](int /* unused */) { CHECK(false); }, [&](std::error_code const& err) { result = err; });
+		CHECK(wheel.size() == 1);
+
+		source.cancel();
+		CHECK(result == canceled);
+		CHECK(wheel.empty());
+	}
+
+	SUBCASE("race cancels the losers")
+	{
+		promise<int>::promises_type promises(3);
+		auto                        captured = std::make_shared<int>(0);
+		int                         result{0};
+		promises[2].then([captured](int /* unused */) {}, [captured](std::error_code const&) {});
+
+		promise<int>::race(promises).then([&](int v) { result = v; });
+		promises[1].resolve(20);
+		CHECK(result == 20);
+		CHECK(promises[0].is_rejected());
+		CHECK(promises[2].is_rejected());
+		CHECK(captured.use_count() == 1);
+	}
+
+	SUBCASE("any cancels the losers, and ignores their rejections")
+	{
+		promise<void>::promises_type promises(3);
+		bool                         done{false};
+		promise<void>::any(promises).then([&]() { done = true; }, [](std::error_code const&) { CHECK(false); });
+		promises[0].reject(make_error_code(std::errc::timed_out));
+		CHECK(!done);
+		promises[2].resolve();
+		CHECK(done);
+		CHECK(promises[1].is_rejected());
+	}
+
+	SUBCASE("race branches keep observing their own token")
+	{
+		cancellation_source         source;
+		promise<int>::promises_type promises(2);
+		std::error_code             result;
+		promises[0].with_cancellation(source.token());
+
+		promise<int>::race(promises).then([](int /* unused */) { CHECK(false); },
+										  [&](std::error_code const& err) { result = err; });
+		source.cancel();
+		CHECK(result == canceled);
+		CHECK(promises[0].is_rejected());
+		CHECK(promises[1].is_rejected());
+	}
+}
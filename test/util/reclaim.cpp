@@ -0,0 +1,217 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <doctest.h>
+#include <thread>
+#include <util/reclaim.h>
+#include <vector>
+
+namespace
+{
+
+struct tracked
+{
+	tracked(int v, std::atomic<int>& live) : value{v}, check{~v}, m_live{live}
+	{
+		++m_live;
+	}
+
+	~tracked()
+	{
+		check = value;    // detectable by a reader that uses a reclaimed object
+		--m_live;
+	}
+
+	bool
+	valid() const
+	{
+		return check == ~value;
+	}
+
+	int               value;
+	int               check;
+	std::atomic<int>& m_live;
+};
+
+/* Readers use the current object while the calling thread replaces it \e swaps times.
+ */
+template<class Read, class Replace>
+int
+stress(int swaps, Read read, Replace replace)
+{
+	std::atomic<bool>        done{false};
+	std::atomic<int>         invalid{0};
+	std::vector<std::thread> readers;
+	for (int t = 0; t < 3; ++t)
+	{
+		readers.emplace_back([&]() {
+			while (!done.load(std::memory_order_relaxed))
+			{
+				if (!read())
+				{
+					++invalid;
+				}
+			}
+		});
+	}
+	for (int i = 1; i <= swaps; ++i)
+	{
+		replace(i);
+		if (i % 64 == 0)
+		{
+			std::this_thread::yield();
+		}
+	}
+	done = true;
+	for (auto& reader : readers)
+	{
+		reader.join();
+	}
+	return invalid.load();
+}
+
+}    // namespace
+
+TEST_CASE("util::epoch_domain [ smoke ] { pinned reader delays reclamation }")
+{
+	auto&            domain = util::epoch_domain::instance();
+	std::atomic<int> live{0};
+	std::atomic<int> stage{0};
+
+	std::thread reader{[&]() {
+		util::epoch_domain::guard guard;
+		stage = 1;
+		while (stage.load() != 2)
+		{
+			std::this_thread::yield();
+		}
+	}};
+	while (stage.load() != 1)
+	{
+		std::this_thread::yield();
+	}
+
+	domain.retire(new tracked{1, live});
+	CHECK(domain.flush() == 1);
+	CHECK(live == 1);
+
+	stage = 2;
+	reader.join();
+	CHECK(domain.flush() == 0);
+	CHECK(live == 0);
+}
+
+TEST_CASE("util::epoch_domain [ smoke ] { retire shared_ptr }")
+{
+	auto&            domain = util::epoch_domain::instance();
+	std::atomic<int> live{0};
+	auto             before = domain.stats();
+
+	auto p = util::mt::make_shared<tracked>(2, live);
+	auto q = p;
+	domain.retire(std::move(p));
+	{
+		util::epoch_domain::guard guard;
+		CHECK(q.use_count() == 2);
+	}
+	q.reset();
+	CHECK(live == 1);
+	CHECK(domain.flush() == 0);
+	CHECK(live == 0);
+
+	auto after = domain.stats();
+	CHECK(after.retired - before.retired == 1);
+	CHECK(after.reclaimed - before.reclaimed == 1);
+	CHECK(after.max_latency_ns >= after.mean_latency_ns);
+}
+
+TEST_CASE("util::epoch_domain [ smoke ] { stress }")
+{
+	auto&                 domain = util::epoch_domain::instance();
+	std::atomic<int>      live{0};
+	std::atomic<tracked*> current{new tracked{0, live}};
+
+	auto invalid = stress(
+			20000,
+			[&]() {
+				util::epoch_domain::guard guard;
+				return current.load(std::memory_order_acquire)->valid();
+			},
+			[&](int v) { domain.retire(current.exchange(new tracked{v, live}, std::memory_order_acq_rel)); });
+	CHECK(invalid == 0);
+
+	domain.retire(current.exchange(nullptr));
+	CHECK(domain.flush() == 0);
+	CHECK(live == 0);
+	CHECK(domain.stats().pending == 0);
+}
+
+TEST_CASE("util::hazard_domain [ smoke ] { protected object is not reclaimed }")
+{
+	auto&                 domain = util::hazard_domain::instance();
+	std::atomic<int>      live{0};
+	std::atomic<tracked*> current{new tracked{1, live}};
+
+	util::hazard_domain::hazard_pointer hp;
+	auto                                p = hp.protect(current);
+	domain.retire(current.exchange(new tracked{2, live}));
+	CHECK(domain.collect() == 1);
+	CHECK(live == 2);
+	CHECK(p->valid());
+
+	hp.reset();
+	CHECK(domain.collect() == 0);
+	CHECK(live == 1);
+
+	auto sp = util::mt::make_shared<tracked>(3, live);
+	p       = hp.protect(current);
+	domain.retire(current.exchange(nullptr));
+	domain.retire(sp);
+	CHECK(domain.collect() == 1);
+	hp.reset();
+	sp.reset();
+	CHECK(domain.collect() == 0);
+	CHECK(live == 0);
+}
+
+TEST_CASE("util::hazard_domain [ smoke ] { stress }")
+{
+	auto&                 domain = util::hazard_domain::instance();
+	std::atomic<int>      live{0};
+	std::atomic<tracked*> current{new tracked{0, live}};
+
+	auto invalid = stress(
+			20000,
+			[&]() {
+				util::hazard_domain::hazard_pointer hp;
+				return hp.protect(current)->valid();
+			},
+			[&](int v) { domain.retire(current.exchange(new tracked{v, live}, std::memory_order_acq_rel)); });
+	CHECK(invalid == 0);
+
+	domain.retire(current.exchange(nullptr));
+	CHECK(domain.collect() == 0);
+	CHECK(live == 0);
+	CHECK(domain.stats().pending == 0);
+}
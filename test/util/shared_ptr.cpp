@@ -22,9 +22,16 @@
  * THE SOFTWARE.
  */
 
+#include <atomic>
+#include <cstring>
 #include <doctest.h>
 #include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 #include <util/allocator.h>
+#include <util/biased_refcount.h>
 #include <util/shared_ptr.h>
 
 using namespace util;
@@ -680,3 +687,364 @@ TEST_CASE("util::shared_ptr [ smoke ] { shared alias }")
 	CHECK(inner_destruct);
 }
 #endif
+
+namespace shared_ptr_test
+{
+
+struct mt_target : util::mt::enable_shared_from_this<mt_target>
+{
+	mt_target(std::atomic<int>& dtor_count) : m_dtor_count{dtor_count} {}
+	~mt_target()
+	{
+		++m_dtor_count;
+	}
+
+	std::atomic<int>& m_dtor_count;
+};
+
+}    // namespace shared_ptr_test
+
+TEST_CASE("util::shared_ptr [ smoke ] { mt::shared_ptr concurrent copy and destroy }")
+{
+	using namespace shared_ptr_test;
+	std::atomic<int> dtor_count{0};
+	std::atomic<int> mismatch_count{0};
+	{
+		auto                     sp = util::mt::make_shared<mt_target>(dtor_count);
+		std::vector<std::thread> threads;
+		for (int t = 0; t < 4; ++t)
+		{
+			threads.emplace_back([sp, &mismatch_count]() {
+				for (int i = 0; i < 100000; ++i)
+				{
+					util::mt::shared_ptr<mt_target> copy{sp};
+					auto                            self = copy->shared_from_this();
+					if (self.get() != copy.get())
+					{
+						++mismatch_count;
+					}
+				}
+			});
+		}
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+		CHECK(mismatch_count == 0);
+		CHECK(sp.use_count() == 1);
+		CHECK(dtor_count == 0);
+	}
+	CHECK(dtor_count == 1);
+}
+
+TEST_CASE("util::shared_ptr [ smoke ] { mt::weak_ptr lock races final release }")
+{
+	using namespace shared_ptr_test;
+	std::atomic<int> dtor_count{0};
+	for (int round = 0; round < 200; ++round)
+	{
+		auto                                         sp = util::mt::make_shared<mt_target>(dtor_count);
+		util::mt::weak_ptr<mt_target>                wp{sp};
+		std::atomic<bool>                            go{false};
+		std::vector<util::mt::shared_ptr<mt_target>> locked(4);
+		std::vector<std::thread>                     threads;
+		for (std::size_t t = 0; t < locked.size(); ++t)
+		{
+			threads.emplace_back([&, t]() {
+				while (!go)
+				{
+					std::this_thread::yield();
+				}
+				locked[t] = wp.lock();
+			});
+		}
+		go = true;
+		sp.reset();
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+		for (auto& p : locked)
+		{
+			p.reset();
+		}
+		CHECK(wp.expired());
+		CHECK(dtor_count == round + 1);
+	}
+}
+
+#if (!UTIL_USE_STD_SHARED_PTR)
+namespace shared_ptr_test
+{
+
+struct biased_target
+{
+	biased_target(std::atomic<int>& dtor_count) : m_dtor_count{dtor_count} {}
+	~biased_target()
+	{
+		++m_dtor_count;
+	}
+
+	std::atomic<int>& m_dtor_count;
+};
+
+}    // namespace shared_ptr_test
+
+TEST_CASE("util::shared_ptr [ smoke ] { biased::shared_ptr owner thread }")
+{
+	using namespace shared_ptr_test;
+	std::atomic<int> dtor_count{0};
+	auto             sp = util::biased::make_shared<biased_target>(dtor_count);
+	CHECK(sp.use_count() == 1);
+	{
+		auto copy = sp;
+		CHECK(sp.use_count() == 2);
+		util::biased::weak_ptr<biased_target> wp{sp};
+		CHECK(wp.lock() == sp);
+		CHECK(sp.weak_count() == 2);
+	}
+	CHECK(sp.use_count() == 1);
+	CHECK(sp.weak_count() == 1);
+	sp.reset();
+	CHECK(dtor_count == 1);
+}
+
+TEST_CASE("util::shared_ptr [ smoke ] { biased::shared_ptr release on another thread }")
+{
+	using namespace shared_ptr_test;
+	std::atomic<int> dtor_count{0};
+	auto             sp   = util::biased::make_shared<biased_target>(dtor_count);
+	auto             copy = sp;    // counted in the owner's biased count
+	CHECK(sp.use_count() == 2);
+
+	std::thread{[moved = std::move(copy)]() mutable { moved.reset(); }}.join();
+	CHECK(sp.use_count() == 1);
+
+	// the owner's biased count does not reach zero, so destruction waits for a merge
+	sp.reset();
+	CHECK(dtor_count == 0);
+	util::biased_refcount::merge_queued();
+	CHECK(dtor_count == 1);
+}
+
+TEST_CASE("util::shared_ptr [ smoke ] { biased::shared_ptr outlives owner thread }")
+{
+	using namespace shared_ptr_test;
+	std::atomic<int>                        dtor_count{0};
+	util::biased::shared_ptr<biased_target> sp;
+	util::biased::weak_ptr<biased_target>   wp;
+	std::thread{[&]() {
+		auto local = util::biased::make_shared<biased_target>(dtor_count);
+		sp         = local;
+		wp         = local;
+	}}.join();
+	CHECK(sp.use_count() == 1);
+	CHECK(dtor_count == 0);
+	sp.reset();
+	CHECK(dtor_count == 1);
+	CHECK(wp.expired());
+}
+
+TEST_CASE("util::shared_ptr [ smoke ] { biased::shared_ptr concurrent copies }")
+{
+	using namespace shared_ptr_test;
+	std::atomic<int> dtor_count{0};
+	std::atomic<int> null_count{0};
+	for (int round = 0; round < 20; ++round)
+	{
+		auto                     sp = util::biased::make_shared<biased_target>(dtor_count);
+		std::vector<std::thread> threads;
+		for (int t = 0; t < 3; ++t)
+		{
+			threads.emplace_back([copy = sp, &null_count]() {
+				for (int i = 0; i < 10000; ++i)
+				{
+					auto inner = copy;
+					if (!inner)
+					{
+						++null_count;
+					}
+				}
+			});
+		}
+		for (int i = 0; i < 10000; ++i)
+		{
+			auto inner = sp;
+			if (!inner)
+			{
+				++null_count;
+			}
+		}
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+		sp.reset();
+		util::biased_refcount::merge_queued();
+		CHECK(dtor_count == round + 1);
+	}
+	CHECK(null_count == 0);
+}
+#endif
+
+#if (!UTIL_USE_STD_SHARED_PTR)
+TEST_CASE("util::shared_ptr [ smoke ] { compact control blocks }")
+{
+	CHECK(sizeof(util::detail::value_ctrl_blk<int, std::allocator<int>, util::compact_refcount>)
+		  < sizeof(util::detail::value_ctrl_blk<int, std::allocator<int>>));
+	CHECK(sizeof(util::detail::value_ctrl_blk<int, std::allocator<int>, util::compact_noweak_refcount>) == 16);
+
+	auto sp = util::compact::make_shared<std::string>("zoot");
+	CHECK(sp.use_count() == 1);
+	CHECK(sp.weak_count() == 1);
+	util::compact::weak_ptr<std::string> wp{sp};
+	CHECK(sp.weak_count() == 2);
+	{
+		auto locked = wp.lock();
+		CHECK(*locked == "zoot");
+		CHECK(sp.use_count() == 2);
+	}
+	sp.reset();
+	CHECK(wp.expired());
+	CHECK(!wp.lock());
+}
+
+TEST_CASE("util::shared_ptr [ smoke ] { noweak control blocks }")
+{
+	shared_ptr_test::int_free_call_count = 0;
+	{
+		util::noweak::shared_ptr<int> p{new int{27}, shared_ptr_test::int_free{}};
+		auto                          copy = p;
+		CHECK(p.use_count() == 2);
+		CHECK(p.weak_count() == 0);
+		copy.reset();
+		CHECK(shared_ptr_test::int_free_call_count == 0);
+	}
+	CHECK(shared_ptr_test::int_free_call_count == 1);
+
+	auto value = util::noweak::make_shared<std::string>("zoot");
+	auto alias = util::noweak::shared_ptr<const char>(value, value->data());
+	value.reset();
+	CHECK(*alias == 'z');
+}
+namespace shared_ptr_test
+{
+
+struct element
+{
+	element() : value{-1}
+	{
+		++live;
+	}
+
+	element(element const& rhs) : value{rhs.value}
+	{
+		if (value == throw_on_value && --throw_countdown == 0)
+		{
+			throw std::runtime_error{"element copy"};
+		}
+		++live;
+	}
+
+	element(int v) : value{v}
+	{
+		++live;
+	}
+
+	~element()
+	{
+		--live;
+	}
+
+	int value;
+
+	static inline int live{0};
+	static inline int throw_on_value{0};
+	static inline int throw_countdown{0};
+};
+
+}    // namespace shared_ptr_test
+
+TEST_CASE("util::shared_ptr [ smoke ] { make_shared arrays }")
+{
+	using shared_ptr_test::element;
+	{
+		auto a = util::make_shared<int[]>(5);
+		for (int i = 0; i < 5; ++i)
+		{
+			CHECK(a[i] == 0);
+			a[i] = i;
+		}
+		auto b = a;
+		CHECK(b[4] == 4);
+		CHECK(a.use_count() == 2);
+
+		auto c = util::make_shared<int[4]>(7);
+		CHECK(c[0] == 7);
+		CHECK(c[3] == 7);
+
+		auto d = util::mt::make_shared<double[]>(3, 1.5);
+		CHECK(d[2] == 1.5);
+
+		auto e = util::compact::make_shared<int[]>(100000);
+		CHECK(e[99999] == 0);
+
+		auto empty = util::make_shared<int[]>(0);
+		CHECK(empty.get() != nullptr);
+		CHECK(empty.use_count() == 1);
+	}
+
+	{
+		auto elements = util::make_shared<element[]>(8);
+		CHECK(element::live == 8);
+		CHECK(elements[7].value == -1);
+		util::weak_ptr<element[]> weak{elements};
+		CHECK(!weak.expired());
+		elements.reset();
+		CHECK(element::live == 0);
+		CHECK(weak.expired());
+
+		auto fixed = util::noweak::make_shared<element[3]>(element{9});
+		CHECK(element::live == 3);
+		CHECK(fixed[2].value == 9);
+	}
+	CHECK(element::live == 0);
+
+	element::throw_on_value  = 5;
+	element::throw_countdown = 3;
+	CHECK_THROWS_AS(util::make_shared<element[]>(4, element{5}), std::runtime_error);
+	CHECK(element::live == 0);
+	element::throw_on_value = 0;
+
+	std::unique_ptr<element[]> raw{new element[2]};
+	{
+		util::shared_ptr<element[]> owned{raw.release()};
+		CHECK(element::live == 2);
+	}
+	CHECK(element::live == 0);
+}
+
+TEST_CASE("util::shared_ptr [ smoke ] { aliasing into a shared array }")
+{
+	auto block = util::make_shared<char[]>(64);
+	std::memcpy(block.get(), "header:payload", 15);
+
+	util::shared_ptr<char> payload{block, block.get() + 7};
+	CHECK(block.use_count() == 2);
+	block.reset();
+	CHECK(payload.use_count() == 1);
+	CHECK(std::string{payload.get()} == "payload");
+
+	struct pair_type
+	{
+		int first;
+		int second;
+	};
+	auto pairs  = util::mt::make_shared<pair_type[]>(2);
+	pairs[1]    = pair_type{3, 4};
+	auto second = util::mt::shared_ptr<int>(pairs, &pairs[1].second);
+	CHECK(*second == 4);
+	CHECK(pairs.use_count() == 2);
+}
+
+#endif
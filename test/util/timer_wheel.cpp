@@ -0,0 +1,293 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <doctest.h>
+#include <iostream>
+#include <random>
+#include <util/promise_timer.h>
+#include <util/timer_wheel.h>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+
+using wheel_type = util::timer_wheel;
+using tp_type    = wheel_type::time_point;
+
+const tp_type origin{std::chrono::seconds{1000}};
+
+}    // namespace
+
+TEST_CASE("util::timer_wheel [ smoke ] { expiry }")
+{
+	std::vector<int> fired;
+	std::error_code  last;
+	wheel_type       wheel{1ms, 0ms, origin};    // destroyed first, since it cancels pending timers
+
+	auto start = [&](int id, std::chrono::milliseconds delay) {
+		auto t = wheel.create_timer();
+		wheel.start_at(t, origin + delay, [&fired, &last, id](std::error_code const& err) {
+			fired.push_back(id);
+			last = err;
+		});
+		return t;
+	};
+
+	SUBCASE("fires at the deadline, not before")
+	{
+		auto t = start(1, 5ms);
+		CHECK(t->pending());
+		CHECK(wheel.size() == 1);
+		CHECK(wheel.advance(origin + 4ms) == 0);
+		CHECK(fired.empty());
+		CHECK(wheel.advance(origin + 5ms) == 1);
+		CHECK(fired == std::vector<int>{1});
+		CHECK(last == make_error_code(std::errc::timed_out));
+		CHECK(!t->pending());
+		CHECK(wheel.empty());
+	}
+
+	SUBCASE("deadlines are rounded up to a tick")
+	{
+		auto t = wheel.create_timer();
+		wheel.start_at(t, origin + 2500us, [&](std::error_code const&) { fired.push_back(1); });
+		wheel.advance(origin + 2ms);
+		CHECK(fired.empty());
+		wheel.advance(origin + 3ms);
+		CHECK(fired.size() == 1);
+	}
+
+	SUBCASE("every level")
+	{
+		std::vector<std::chrono::milliseconds> delays{
+				1ms, 63ms, 64ms, 65ms, 4095ms, 4096ms, 4097ms, 262143ms, 262144ms, 300000ms, 20000000ms};
+		std::vector<util::timer_wheel::timer_ptr> timers;
+		for (std::size_t i = 0; i < delays.size(); ++i)
+		{
+			timers.push_back(start(static_cast<int>(i), delays[i]));
+		}
+		for (std::size_t i = 0; i < delays.size(); ++i)
+		{
+			wheel.advance(origin + delays[i] - 1ms);
+			CHECK(fired.size() == i);
+			wheel.advance(origin + delays[i]);
+			REQUIRE(fired.size() == i + 1);
+			CHECK(fired.back() == static_cast<int>(i));
+		}
+		CHECK(wheel.empty());
+	}
+
+	SUBCASE("beyond the range of the wheel")
+	{
+		auto range = 1ms * (std::int64_t{1} << (util::timer_wheel::slot_bits * util::timer_wheel::level_count));
+		start(1, 5ms);
+		auto t = wheel.create_timer();
+		wheel.start_at(t, origin + range + range / 2, [&](std::error_code const&) { fired.push_back(2); });
+		wheel.advance(origin + range);
+		CHECK(fired == std::vector<int>{1});
+		wheel.advance(origin + range + range / 2 - 1ms);
+		CHECK(fired == std::vector<int>{1});
+		wheel.advance(origin + range + range / 2);
+		CHECK(fired == std::vector<int>{1, 2});
+	}
+
+	SUBCASE("coalescing within a tick")
+	{
+		start(1, 7ms);
+		start(2, 7ms);
+		start(3, 8ms);
+		CHECK(wheel.advance(origin + 7ms) == 2);
+		CHECK(fired == std::vector<int>{1, 2});
+	}
+
+	SUBCASE("next deadline")
+	{
+		CHECK(wheel.next_deadline() == tp_type::max());
+		start(1, 10ms);
+		CHECK(wheel.next_deadline() == origin + 10ms);
+		wheel.advance(origin + 10ms);
+		start(2, 1000ms);
+		CHECK(wheel.next_deadline() <= origin + 1000ms);
+		CHECK(wheel.next_deadline() > origin + 10ms);
+	}
+}
+
+TEST_CASE("util::timer_wheel [ smoke ] { cancel }")
+{
+	std::vector<int> fired;
+	wheel_type       wheel{1ms, 0ms, origin};
+
+	SUBCASE("cancel invokes the handler")
+	{
+		std::error_code result;
+		auto            t = wheel.create_timer();
+		wheel.start_at(t, origin + 100ms, [&](std::error_code const& err) { result = err; });
+		CHECK(wheel.cancel(t));
+		CHECK(result == make_error_code(std::errc::operation_canceled));
+		CHECK(!t->pending());
+		CHECK(!wheel.cancel(t));
+		CHECK(wheel.advance(origin + 200ms) == 0);
+	}
+
+	SUBCASE("start while pending")
+	{
+		std::error_code result;
+		auto            t = wheel.create_timer();
+		wheel.start_at(t, origin + 10ms, [&](std::error_code const&) { fired.push_back(1); });
+		wheel.start_at(t, origin + 20ms, [&](std::error_code const& err) { result = err; });
+		CHECK(result == make_error_code(std::errc::operation_in_progress));
+		wheel.advance(origin + 20ms);
+		CHECK(fired == std::vector<int>{1});
+	}
+
+	SUBCASE("handlers may cancel and restart timers")
+	{
+		auto t1 = wheel.create_timer();
+		auto t2 = wheel.create_timer();
+		wheel.start_at(t1, origin + 5ms, [&](std::error_code const&) {
+			fired.push_back(1);
+			wheel.cancel(t2);
+			wheel.start_at(t1, origin + 6ms, [&](std::error_code const&) { fired.push_back(3); });
+		});
+		wheel.start_at(t2, origin + 5ms, [&](std::error_code const& err) {
+			CHECK(err == make_error_code(std::errc::operation_canceled));
+			fired.push_back(2);
+		});
+		wheel.advance(origin + 10ms);
+		CHECK(fired == std::vector<int>{1, 2, 3});
+	}
+
+	SUBCASE("the wheel holds pending timers")
+	{
+		wheel.start_at(wheel.create_timer(), origin + 5ms, [&](std::error_code const&) { fired.push_back(1); });
+		wheel.advance(origin + 5ms);
+		CHECK(fired == std::vector<int>{1});
+	}
+
+	SUBCASE("destruction cancels pending timers")
+	{
+		std::error_code result;
+		auto            t = std::make_unique<wheel_type>(1ms, 0ms, origin);
+		auto            timer = t->create_timer();
+		t->start_at(timer, origin + 5ms, [&](std::error_code const& err) { result = err; });
+		t.reset();
+		CHECK(result == make_error_code(std::errc::operation_canceled));
+		CHECK(!timer->pending());
+	}
+}
+
+TEST_CASE("util::timer_wheel [ smoke ] { random }")
+{
+	wheel_type                                wheel{1ms, 0ms, origin};
+	std::minstd_rand                          rng{42};
+	std::vector<util::timer_wheel::timer_ptr> timers;
+	std::vector<std::int64_t>                 deadlines;
+	std::int64_t                              now{0};
+	std::int64_t                              previous{0};
+	std::size_t                               mismatches{0};
+	std::size_t                               fired{0};
+
+	for (int i = 0; i < 2000; ++i)
+	{
+		auto exponent = rng() % 24;
+		auto deadline = now + 1 + static_cast<std::int64_t>(rng() % (std::uint64_t{1} << exponent));
+		auto index    = timers.size();
+		timers.push_back(wheel.create_timer());
+		deadlines.push_back(deadline);
+		wheel.start_at(timers[index], origin + 1ms * deadline, [&, index](std::error_code const& err) {
+			if (err == make_error_code(std::errc::timed_out))
+			{
+				++fired;
+				// fired by the first advance() at or after the deadline
+				mismatches += (deadlines[index] <= previous || deadlines[index] > now) ? 1 : 0;
+			}
+		});
+		if (rng() % 4 == 0)
+		{
+			wheel.cancel(timers[rng() % timers.size()]);
+		}
+		previous = now;
+		now += static_cast<std::int64_t>(rng() % 50);
+		wheel.advance(origin + 1ms * now);
+	}
+	while (!wheel.empty())
+	{
+		auto next = wheel.next_deadline();
+		mismatches += (next > origin + 1ms * now) ? 0 : 1;
+		previous = now;
+		now      = std::chrono::duration_cast<std::chrono::milliseconds>(next - origin).count();
+		wheel.advance(next);
+	}
+	CHECK(fired > 1000);
+	CHECK(mismatches == 0);
+}
+
+TEST_CASE("util::timer_wheel [ smoke ] { slack }")
+{
+	std::vector<int> fired;
+	wheel_type       wheel{1ms, 8ms, origin};
+
+	for (int i = 1; i <= 8; ++i)
+	{
+		wheel.start_at(wheel.create_timer(), origin + 1ms * i, [&fired, i](std::error_code const&) {
+			fired.push_back(i);
+		});
+	}
+	CHECK(wheel.advance(origin + 7ms) == 0);
+	CHECK(wheel.advance(origin + 8ms) == 8);
+	CHECK(fired.size() == 8);
+}
+
+TEST_CASE("util::timer_wheel [ smoke ] { promise_timer }")
+{
+	using util::promise;
+
+	wheel_type wheel{1ms};
+
+	SUBCASE("timeout")
+	{
+		std::error_code result;
+		promise<int>    p;
+		p.timeout(util::promise_timer<util::timer_wheel_adapter>{10ms, &wheel});
+		p.then([](int) { CHECK(false); }, [&](std::error_code const& err) { result = err; });
+		CHECK(wheel.size() == 1);
+		wheel.advance(wheel_type::clock_type::now() + 11ms);    // deadlines are rounded up to a tick
+		CHECK(result == make_error_code(std::errc::timed_out));
+		CHECK(wheel.empty());
+	}
+
+	SUBCASE("resolution cancels the timer")
+	{
+		int          result{0};
+		promise<int> p;
+		p.timeout(util::promise_timer<util::timer_wheel_adapter>{10ms, &wheel});
+		p.then([&](int value) { result = value; });
+		p.resolve(7);
+		CHECK(result == 7);
+		CHECK(wheel.empty());
+		CHECK(wheel.advance(wheel_type::clock_type::now() + 20ms) == 0);
+	}
+}
@@ -0,0 +1,150 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <doctest.h>
+#include <sstream>
+#include <string>
+#include <util/membuf.h>
+#include <util/tokenizer.h>
+#include <vector>
+
+namespace
+{
+
+std::deque<util::mutable_buffer>
+segments_of(std::string const& content, util::size_type segment_size)
+{
+	util::omemqbuf obuf{segment_size};
+	std::ostream   os{&obuf};
+	os << content;
+	return obuf.release_buffer();
+}
+
+}    // namespace
+
+TEST_CASE("util::tokenizer [ smoke ] { lines across segments }")
+{
+	std::ostringstream os;
+	for (int i = 0; i < 200; ++i)
+	{
+		os << "line number " << i << ((i % 3 == 0) ? "\r\n" : "\n");
+	}
+	os << "last line without newline";
+	auto content = os.str();
+
+	std::vector<std::string> expected;
+	{
+		std::istringstream is{content};
+		std::string        line;
+		while (std::getline(is, line))
+		{
+			if (!line.empty() && line.back() == '\r')
+			{
+				line.pop_back();
+			}
+			expected.push_back(line);
+		}
+	}
+
+	for (util::size_type segment_size : {16, 17, 64, 4096})
+	{
+		util::segment_tokenizer tok{segments_of(content, segment_size)};
+		std::vector<std::string> lines;
+		std::string_view         line;
+		while (tok.next_line(line))
+		{
+			lines.emplace_back(line);
+		}
+		CHECK(lines == expected);
+		CHECK(tok.at_end());
+		if (segment_size == 4096)
+		{
+			CHECK(tok.straddle_count() == 0);
+		}
+		else
+		{
+			CHECK(tok.straddle_count() > 0);
+		}
+	}
+}
+
+TEST_CASE("util::tokenizer [ smoke ] { aliases outlive the tokenizer }")
+{
+	std::vector<util::string_alias> fields;
+	{
+		util::segment_tokenizer tok{segments_of("alpha,beta,gamma-delta-epsilon,zeta,", 16)};
+		util::string_alias      field;
+		while (tok.next_alias(',', field))
+		{
+			fields.push_back(field);
+		}
+	}
+	REQUIRE(fields.size() == 4);
+	CHECK(fields[0].view() == "alpha");
+	CHECK(fields[1].view() == "beta");
+	CHECK(fields[2].view() == "gamma-delta-epsilon");
+	CHECK(fields[3].view() == "zeta");
+}
+
+TEST_CASE("util::tokenizer [ smoke ] { numbers }")
+{
+	std::string content{"  42 -17\t+8 3.25\n1e10 -0.5 123456789012 18446744073709551615 x"};
+	for (util::size_type segment_size : {16, 17, 18, 19, 20, 1024})
+	{
+		util::segment_tokenizer tok{segments_of(content, segment_size)};
+		int                     i{0};
+		double                  d{0};
+		std::int64_t            l{0};
+		std::uint64_t           u{0};
+		std::error_code         err;
+
+		CHECK(tok.next_number(i, err));
+		CHECK(i == 42);
+		CHECK(tok.next_number(i, err));
+		CHECK(i == -17);
+		CHECK(tok.next_number(i, err));
+		CHECK(i == 8);
+		CHECK(tok.next_number(d, err));
+		CHECK(d == 3.25);
+		CHECK(tok.next_number(d, err));
+		CHECK(d == 1e10);
+		CHECK(tok.next_number(d, err));
+		CHECK(d == -0.5);
+		CHECK(!tok.next_number(i, err));
+		CHECK(err == std::errc::result_out_of_range);
+		CHECK(tok.next_number(l, err));
+		CHECK(l == 123456789012);
+		CHECK(tok.next_number(u, err));
+		CHECK(u == 18446744073709551615ull);
+		CHECK(!tok.next_number(i, err));
+		CHECK(err == std::errc::invalid_argument);
+		CHECK_THROWS_AS(tok.next_number(i), std::system_error);
+
+		std::string_view rest;
+		CHECK(tok.next(' ', rest));
+		CHECK(rest == "x");
+		CHECK(!tok.next_number(i, err));
+		CHECK(!err);
+	}
+}
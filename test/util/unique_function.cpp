@@ -0,0 +1,196 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <doctest.h>
+#include <functional>
+#include <memory>
+#include <string>
+#include <util/unique_function.h>
+
+namespace
+{
+
+struct counted
+{
+	counted(int& live) : m_live{&live}
+	{
+		++*m_live;
+	}
+
+	counted(counted&& rhs) noexcept : m_live{rhs.m_live}
+	{
+		++*m_live;
+	}
+
+	~counted()
+	{
+		--*m_live;
+	}
+
+	int* m_live;
+};
+
+struct large_callable
+{
+	int
+	operator()(int x) const
+	{
+		return x + static_cast<int>(padding[0]);
+	}
+
+	char padding[256] = {1};
+};
+
+int
+twice(int x)
+{
+	return 2 * x;
+}
+
+}    // namespace
+
+TEST_CASE("util::unique_function [ smoke ] { basic }")
+{
+	util::unique_function<int(int)> f;
+	CHECK(!f);
+	CHECK(f == nullptr);
+
+	f = [](int x) { return x + 1; };
+	CHECK(f);
+	CHECK(f != nullptr);
+	CHECK(f(1) == 2);
+
+	f = &twice;
+	CHECK(f(4) == 8);
+
+	int (*null_fp)(int) = nullptr;
+	f                   = null_fp;
+	CHECK(!f);
+
+	f = nullptr;
+	CHECK(!f);
+
+	std::function<int(int)> empty_function;
+	f = empty_function;
+	CHECK(!f);
+
+	util::unique_function<int(int), 16> empty_unique;
+	f = std::move(empty_unique);
+	CHECK(!f);
+
+	f = std::function<int(int)>{&twice};
+	CHECK(f);
+	CHECK(f(3) == 6);
+}
+
+TEST_CASE("util::unique_function [ smoke ] { move only }")
+{
+	auto                         p = std::make_unique<int>(42);
+	util::unique_function<int()> f{[p = std::move(p)]() { return *p; }};
+	CHECK(f() == 42);
+
+	util::unique_function<int()> g{std::move(f)};
+	CHECK(!f);
+	CHECK(g() == 42);
+
+	f = std::move(g);
+	CHECK(!g);
+	CHECK(f() == 42);
+
+	swap(f, g);
+	CHECK(!f);
+	CHECK(g() == 42);
+}
+
+TEST_CASE("util::unique_function [ smoke ] { mutable state }")
+{
+	util::unique_function<int()> f{[n = 0]() mutable { return ++n; }};
+	CHECK(f() == 1);
+	CHECK(f() == 2);
+	auto g = std::move(f);
+	CHECK(g() == 3);
+}
+
+TEST_CASE("util::unique_function [ smoke ] { storage }")
+{
+	using func_type = util::unique_function<int(int)>;
+
+	auto small = [](int x) { return x; };
+	CHECK(func_type::is_stored_inline<decltype(small)>());
+	CHECK(!func_type::is_stored_inline<large_callable>());
+
+	func_type f{large_callable{}};
+	CHECK(f(1) == 2);
+	func_type g{std::move(f)};
+	CHECK(g(2) == 3);
+
+	std::string s(100, 'x');
+	util::unique_function<std::size_t()> h{[s]() { return s.size(); }};
+	CHECK(h() == 100);
+}
+
+TEST_CASE("util::unique_function [ smoke ] { lifetime }")
+{
+	int live{0};
+	{
+		util::unique_function<void()> f{[c = counted{live}]() {}};
+		CHECK(live == 1);
+		util::unique_function<void()> g{std::move(f)};
+		CHECK(live == 1);
+		f = std::move(g);
+		CHECK(live == 1);
+		f = nullptr;
+		CHECK(live == 0);
+		f = [c = counted{live}]() {};
+		CHECK(live == 1);
+	}
+	CHECK(live == 0);
+
+	{
+		util::unique_function<void(), 0> f{[c = counted{live}]() {}};
+		CHECK(live == 1);
+		auto g = std::move(f);
+		CHECK(live == 1);
+	}
+	CHECK(live == 0);
+}
+
+TEST_CASE("util::unique_function [ smoke ] { arguments }")
+{
+	util::unique_function<std::unique_ptr<int>(std::unique_ptr<int>&&)> f{
+			[](std::unique_ptr<int>&& p) { return std::move(p); }};
+	auto p = f(std::make_unique<int>(7));
+	REQUIRE(p);
+	CHECK(*p == 7);
+
+	util::unique_function<void(int&)> g{[](int& x) { x = 3; }};
+	int                               x{0};
+	g(x);
+	CHECK(x == 3);
+
+	// the result of a value-returning target is discarded for a void signature
+	util::unique_function<void(int&)> h{[](int& x) { return x = 4; }};
+	h(x);
+	CHECK(x == 4);
+}
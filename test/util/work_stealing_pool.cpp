@@ -0,0 +1,204 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <atomic>
+#include <doctest.h>
+#include <memory>
+#include <thread>
+#include <util/work_stealing_pool.h>
+#include <vector>
+
+namespace
+{
+
+void
+wait_for(std::atomic<int> const& count, int expected)
+{
+	while (count.load() < expected)
+	{
+		std::this_thread::yield();
+	}
+}
+
+void
+fan_out(util::work_stealing_pool& pool, std::atomic<int>& count, int depth)
+{
+	count.fetch_add(1);
+	if (depth > 0)
+	{
+		pool.post([&pool, &count, depth]() { fan_out(pool, count, depth - 1); });
+		pool.post([&pool, &count, depth]() { fan_out(pool, count, depth - 1); });
+	}
+}
+
+}    // namespace
+
+TEST_CASE("util::work_stealing_pool [ smoke ] { chase_lev_deque }")
+{
+	SUBCASE("single thread")
+	{
+		util::detail::chase_lev_deque<int> deque{4};
+		std::vector<int>                   items(100);
+		for (auto& item : items)
+		{
+			deque.push(&item);
+		}
+		CHECK(deque.size() == 100);
+		CHECK(deque.steal() == &items[0]);
+		CHECK(deque.steal() == &items[1]);
+		CHECK(deque.pop() == &items[99]);
+		CHECK(deque.pop() == &items[98]);
+		CHECK(deque.size() == 96);
+		while (deque.pop())
+		{}
+		CHECK(deque.size() == 0);
+		CHECK(deque.steal() == nullptr);
+	}
+
+	SUBCASE("concurrent steals")
+	{
+		constexpr int                      count = 20000;
+		util::detail::chase_lev_deque<int> deque{16};
+		std::vector<int>                   items(count);
+		std::vector<std::atomic<int>>      taken(count);
+		std::atomic<bool>                  done{false};
+
+		auto record = [&](int* item) { taken[item - items.data()].fetch_add(1); };
+
+		std::vector<std::thread> thieves;
+		for (int t = 0; t < 2; ++t)
+		{
+			thieves.emplace_back([&]() {
+				while (!done.load())
+				{
+					if (auto item = deque.steal())
+					{
+						record(item);
+					}
+				}
+			});
+		}
+		for (int i = 0; i < count; ++i)
+		{
+			deque.push(&items[i]);
+			if (i % 3 == 0)
+			{
+				if (auto item = deque.pop())
+				{
+					record(item);
+				}
+			}
+		}
+		while (auto item = deque.pop())
+		{
+			record(item);
+		}
+		done = true;
+		for (auto& t : thieves)
+		{
+			t.join();
+		}
+
+		int wrong{0};
+		for (auto& n : taken)
+		{
+			wrong += (n.load() != 1) ? 1 : 0;
+		}
+		CHECK(wrong == 0);
+	}
+}
+
+TEST_CASE("util::work_stealing_pool [ smoke ] { post }")
+{
+	SUBCASE("external threads")
+	{
+		std::atomic<int> count{0};
+		{
+			util::work_stealing_pool pool{3};
+			CHECK(pool.size() == 3);
+			std::vector<std::thread> producers;
+			for (int t = 0; t < 3; ++t)
+			{
+				producers.emplace_back([&]() {
+					for (int i = 0; i < 1000; ++i)
+					{
+						pool.post([&]() { count.fetch_add(1, std::memory_order_relaxed); });
+					}
+				});
+			}
+			for (auto& t : producers)
+			{
+				t.join();
+			}
+		}
+		CHECK(count.load() == 3000);
+	}
+
+	SUBCASE("fork/join")
+	{
+		std::atomic<int>         count{0};
+		util::work_stealing_pool pool{4};
+		pool.post([&]() { fan_out(pool, count, 10); });
+		wait_for(count, (1 << 11) - 1);
+		CHECK(count.load() == (1 << 11) - 1);
+	}
+
+	SUBCASE("pinned")
+	{
+		std::atomic<int> count{0};
+		{
+			util::work_stealing_pool pool{2, true};
+			for (int i = 0; i < 100; ++i)
+			{
+				pool.executor().post([&]() { count.fetch_add(1); });
+			}
+		}
+		CHECK(count.load() == 100);
+	}
+
+	SUBCASE("move-only work")
+	{
+		std::atomic<int> result{0};
+		{
+			util::work_stealing_pool pool{2};
+			pool.post([p = std::make_unique<int>(9), &result]() { result = *p; });
+		}
+		CHECK(result.load() == 9);
+	}
+}
+
+TEST_CASE("util::work_stealing_pool [ smoke ] { submit }")
+{
+	std::atomic<int>         result{0};
+	std::atomic<int>         finished{0};
+	util::work_stealing_pool pool{2};
+
+	pool.submit([]() { return 6; }).then([&](int v) {
+		result = v * 7;
+		finished.fetch_add(1);
+	});
+	pool.submit([]() {}).then([&]() { finished.fetch_add(1); });
+	wait_for(finished, 2);
+	CHECK(result.load() == 42);
+}